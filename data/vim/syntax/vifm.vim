@@ -119,31 +119,31 @@ syntax case match
 " Options
 syntax keyword vifmOption contained aproposprg autochpos cdpath cd chaselinks
 		\ classify columns co confirm cf cpoptions cpo cvoptions deleteprg dotdirs
-		\ dotfiles dirsize fastrun fillchars fcs findprg followlinks fusehome
-		\ gdefault grepprg history hi hlsearch hls iec ignorecase ic iooptions
-		\ incsearch is laststatus lines locateprg ls lsview mintimeoutlen number nu
-		\ numberwidth nuw relativenumber rnu rulerformat ruf runexec scrollbind scb
-		\ scrolloff so sort sortgroups sortorder sortnumbers shell sh shortmess shm
-		\ slowfs smartcase scs statusline stl suggestoptions syscalls tabstop
-		\ timefmt timeoutlen title tm trash trashdir ts tuioptions to undolevels ul
-		\ vicmd viewcolumns vifminfo vimhelp vixcmd wildmenu wmnu wildstyle
-		\ wordchars wrap wrapscan ws
+		\ dotfiles dirsize diskusage fastrun fillchars fcs findprg followlinks
+		\ fusehome gdefault grepprg history hi hlsearch hls iec ignorecase ic
+		\ iooptions iothreads incsearch is laststatus lines locateprg ls lsview
+		\ mintimeoutlen number nu numberwidth nuw relativenumber rnu rulerformat ruf
+		\ runexec scrollbind scb scrolloff so sort sortgroups sortorder sortnumbers
+		\ shell sh shortmess shm slowfs smartcase scs statusline stl suggestoptions
+		\ syscalls tabstop timefmt timeoutlen title tm trash trashdir ts tuioptions
+		\ to undolevels ul vicmd viewcolumns vifminfo vimhelp vixcmd wildmenu wmnu
+		\ wildstyle wordchars wrap wrapscan ws
 
 " Disabled boolean options
 syntax keyword vifmOption contained noautochpos nocf nochaselinks nodotfiles
-		\ nofastrun nofollowlinks nohlsearch nohls noiec noignorecase noic
-		\ noincsearch nois nolaststatus nols nolsview nonumber nonu norelativenumber
-		\ nornu noscrollbind noscb norunexec nosmartcase noscs nosortnumbers
-		\ nosyscalls notitle notrash novimhelp nowildmenu nowmnu nowrap nowrapscan
-		\ nows
+		\ nodiskusage nofastrun nofollowlinks nohlsearch nohls noiec noignorecase
+		\ noic noincsearch nois nolaststatus nols nolsview nonumber nonu
+		\ norelativenumber nornu noscrollbind noscb norunexec nosmartcase noscs
+		\ nosortnumbers nosyscalls notitle notrash novimhelp nowildmenu nowmnu
+		\ nowrap nowrapscan nows
 
 " Inverted boolean options
 syntax keyword vifmOption contained invautochpos invcf invchaselinks invdotfiles
-		\ invfastrun invfollowlinks invhlsearch invhls inviec invignorecase invic
-		\ invincsearch invis invlaststatus invls invlsview invnumber invnu
-		\ invrelativenumber invrnu invscrollbind invscb invrunexec invsmartcase
-		\ invscs invsortnumbers invsyscalls invtitle invtrash invvimhelp invwildmenu
-		\ invwmnu invwrap invwrapscan invws
+		\ invdiskusage invfastrun invfollowlinks invhlsearch invhls inviec
+		\ invignorecase invic invincsearch invis invlaststatus invls invlsview
+		\ invnumber invnu invrelativenumber invrnu invscrollbind invscb invrunexec
+		\ invsmartcase invscs invsortnumbers invsyscalls invtitle invtrash
+		\ invvimhelp invwildmenu invwmnu invwrap invwrapscan invws
 
 " Expressions
 syntax region vifmStatement start='^\(\s\|:\)*'
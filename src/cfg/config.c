@@ -215,6 +215,8 @@ cfg_init(void)
 	cfg.name_dec_count = 0;
 
 	cfg.fast_file_cloning = 0;
+	cfg.io_threads = 1;
+	cfg.disk_usage = 0;
 	cfg.cvoptions = 0;
 }
 
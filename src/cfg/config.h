@@ -246,6 +246,12 @@ typedef struct config_t
 	/* Controls use of fast file cloning for file systems that support it. */
 	int fast_file_cloning;
 
+	/* Maximum number of files copied at the same time. */
+	int io_threads;
+
+	/* Whether size of directories is calculated as space allocated for files. */
+	int disk_usage;
+
 	/* Whether various things should be reset on entering/leaving custom views. */
 	int cvoptions;
 }
@@ -68,6 +68,8 @@ static void set_view_property(FileView *view, char type, const char value[]);
 static int copy_file(const char src[], const char dst[]);
 static int copy_file_internal(FILE *const src, FILE *const dst);
 static void update_info_file(const char filename[]);
+static void read_dir_sizes(void);
+static void write_dir_sizes(void);
 static void process_hist_entry(FileView *view, const char dir[],
 		const char file[], int pos, char ***lh, int *nlh, int **lhp, size_t *nlhp);
 static char * convert_old_trash_path(const char trash_path[]);
@@ -358,6 +360,9 @@ read_info_file(int reread)
 	free(line4);
 	fclose(fp);
 
+	/* This is done after vifminfo is read as it contains 'vifminfo' option. */
+	read_dir_sizes();
+
 	dir_stack_freeze();
 }
 
@@ -480,6 +485,62 @@ write_info_file(void)
 			(void)remove(tmp_file);
 		}
 	}
+
+	write_dir_sizes();
+}
+
+/* Loads sizes of directories saved by previous runs if they are to be stored.
+ * They are stored separately from vifminfo as there can be lots of them. */
+static void
+read_dir_sizes(void)
+{
+	char *sizes_file;
+
+	if(!(cfg.vifm_info & VIFMINFO_DIRSIZES))
+	{
+		return;
+	}
+
+	sizes_file = format_str("%s/dirsizes", cfg.config_dir);
+	if(sizes_file != NULL)
+	{
+		(void)dcache_load(sizes_file);
+		free(sizes_file);
+	}
+}
+
+/* Saves sizes of directories merging them with those saved by other instances
+ * or removes the file if they aren't to be stored. */
+static void
+write_dir_sizes(void)
+{
+	char *const sizes_file = format_str("%s/dirsizes", cfg.config_dir);
+	char *tmp_file;
+
+	if(sizes_file == NULL)
+	{
+		LOG_ERROR_MSG("Can't update dirsizes file");
+		return;
+	}
+
+	tmp_file = format_str("%s_%u", sizes_file, get_pid());
+	if(tmp_file == NULL)
+	{
+		LOG_ERROR_MSG("Can't update dirsizes file");
+	}
+	else if(!(cfg.vifm_info & VIFMINFO_DIRSIZES))
+	{
+		(void)remove(sizes_file);
+	}
+	else if(dcache_save(tmp_file, sizes_file) != 0 ||
+			rename_file(tmp_file, sizes_file) != 0)
+	{
+		LOG_ERROR_MSG("Can't update dirsizes file");
+		(void)remove(tmp_file);
+	}
+
+	free(tmp_file);
+	free(sizes_file);
 }
 
 /* Copies the src file to the dst location.  Returns zero on success. */
@@ -1057,6 +1118,9 @@ write_options(FILE *const fp)
 		fprintf(fp, "%s", "fastfilecloning,");
 	fprintf(fp, "\n");
 
+	fprintf(fp, "=iothreads=%d\n", cfg.io_threads);
+	fprintf(fp, "=%sdiskusage\n", cfg.disk_usage ? "" : "no");
+
 	fprintf(fp, "=dirsize=%s", cfg.view_dir_size == VDS_SIZE ? "size" : "nitems");
 
 	str = classify_to_str();
@@ -1091,6 +1155,8 @@ write_options(FILE *const fp)
 		fprintf(fp, ",dirstack");
 	if(cfg.vifm_info & VIFMINFO_REGISTERS)
 		fprintf(fp, ",registers");
+	if(cfg.vifm_info & VIFMINFO_DIRSIZES)
+		fprintf(fp, ",dirsizes");
 	fprintf(fp, "\n");
 
 	fprintf(fp, "=%svimhelp\n", cfg.use_vim_help ? "" : "no");
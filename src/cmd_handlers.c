@@ -33,7 +33,7 @@
 #include <stdio.h> /* pclose() popen() snprintf() */
 #include <stdlib.h> /* EXIT_SUCCESS atoi() free() realloc() */
 #include <string.h> /* strchr() strcmp() strcasecmp() strcpy() strdup() strlen()
-                       strrchr() */
+                       strrchr() strspn() */
 #include <wctype.h> /* iswspace() */
 #include <wchar.h> /* wcslen() wcsncmp() */
 
@@ -729,7 +729,7 @@ const cmd_add_t cmds_list[] = {
 	{ .name = "tree",              .abbr = NULL,    .id = -1,
 	  .descr = "display filesystem as a tree",
 	  .flags = HAS_COMMENT,
-	  .handler = &tree_cmd,        .min_args = 0,   .max_args = 0, },
+	  .handler = &tree_cmd,        .min_args = 0,   .max_args = 1, },
 	{ .name = "undolist",          .abbr = "undol", .id = -1,
 	  .descr = "display list of operations",
 	  .flags = HAS_EMARK | HAS_COMMENT,
@@ -3922,7 +3922,21 @@ trashes_cmd(const cmd_info_t *cmd_info)
 static int
 tree_cmd(const cmd_info_t *cmd_info)
 {
-	(void)flist_load_tree(curr_view, flist_get_dir(curr_view));
+	int depth = 0;
+
+	if(cmd_info->argc == 1)
+	{
+		const char *value = cmd_info->argv[0];
+		if(!skip_prefix(&value, "depth=") ||
+				value[strspn(value, "0123456789")] != '\0' ||
+				(depth = str_to_int(value)) <= 0)
+		{
+			status_bar_errorf("Invalid argument: %s", cmd_info->argv[0]);
+			return 1;
+		}
+	}
+
+	(void)flist_load_tree_lazily(curr_view, flist_get_dir(curr_view), depth);
 	return 0;
 }
 
@@ -18,15 +18,19 @@
 
 #include "compare.h"
 
+
 #include <assert.h> /* assert() */
+#include <limits.h> /* INT_MAX */
 #include <stddef.h> /* size_t */
-#include <stdint.h> /* INTPTR_MAX INT64_MAX */
+#include <stdint.h> /* INTPTR_MAX INT64_MAX UINT64_C uint64_t */
 #include <stdio.h> /* FILE fclose() feof() fopen() fread() */
-#include <stdlib.h> /* free() malloc() qsort() */
-#include <string.h> /* memcmp() */
+#include <stdlib.h> /* calloc() free() malloc() qsort() */
+#include <string.h> /* memcmp() memcpy() memset() */
+#include <time.h> /* timespec */
 
 #include "compat/fs_limits.h"
 #include "compat/os.h"
+#include "compat/pthread.h"
 #include "compat/reallocarray.h"
 #include "modes/dialogs/msg_dialog.h"
 #include "ui/cancellation.h"
@@ -38,7 +42,9 @@
 #include "utils/path.h"
 #include "utils/str.h"
 #include "utils/string_array.h"
+#include "utils/tpool.h"
 #include "utils/trie.h"
+#include "utils/utils.h"
 #include "filelist.h"
 #include "running.h"
 
@@ -52,6 +58,45 @@
 /* Amount of data to hash for coarse comparison. */
 #define PREFIX_SIZE (256*1024)
 
+/* Maximum number of threads that hash files in background. */
+#define MAX_HASHING_THREADS 8
+
+/* How often to check for cancellation while waiting for a hash, in
+ * milliseconds. */
+#define HASH_POLL_PERIOD 100
+
+/* State of hashing job. */
+typedef enum
+{
+	HS_PENDING, /* Hash isn't computed yet. */
+	HS_DONE,    /* Hash is available. */
+	HS_FAILED,  /* File couldn't be read or hashing was cancelled. */
+}
+HashState;
+
+/* Hashing of a prefix of a single file, which is performed by pool threads. */
+typedef struct
+{
+	struct hasher_t *hasher; /* Hasher that owns this job. */
+	const char *path;        /* Path to the file (owned by list of files). */
+	unsigned long long hash; /* Result of hashing. */
+	HashState state;         /* State of the job. */
+}
+hash_job_t;
+
+/* Pool of threads that compute hashes of files while they are being listed. */
+typedef struct hasher_t
+{
+	tpool_t *pool;          /* Threads that do the hashing. */
+	hash_job_t **jobs;      /* Jobs in the order of files in the list. */
+	int njobs;              /* Number of elements in the jobs array. */
+	pthread_mutex_t lock;   /* Protects states of jobs and the flag below. */
+	pthread_cond_t changed; /* Signaled when a job is finished. */
+	int cancelled;          /* Whether unfinished jobs should be dropped. */
+	int stopped;            /* No more jobs are accepted after an error. */
+}
+hasher_t;
+
 /* List of entries bundled with its size. */
 typedef struct
 {
@@ -60,6 +105,46 @@ typedef struct
 }
 entries_t;
 
+/* Size of a file bundled with position of its entry in a list. */
+typedef struct
+{
+	uint64_t size; /* Size of the file. */
+	int idx;       /* Index of the entry. */
+}
+sized_entry_t;
+
+/* Key of an entry of a list bundled with position of the entry. */
+typedef struct
+{
+	int id;           /* Id of the entry. */
+	const char *name; /* Name of the entry. */
+	int idx;          /* Index of the entry. */
+}
+keyed_entry_t;
+
+/* State of alignment of two lists of entries.  Alignment is driven by rows of
+ * LCS matrix for suffixes of the lists, which are stored as bit-vectors (bit c
+ * of row x is zero if LCS of curr[x:] and other[m-c-1:] is larger than that of
+ * curr[x:] and other[m-c:]).  Only every block-th row is kept, the rest are
+ * recomputed block by block when they are needed. */
+typedef struct
+{
+	entries_t curr;         /* Left list. */
+	entries_t other;        /* Right list. */
+	int group_paths;        /* Whether entries with equal names also match. */
+
+	keyed_entry_t *by_id;   /* Entries of other list sorted by id. */
+	keyed_entry_t *by_name; /* Entries of other list sorted by name. */
+
+	int nwords;             /* Number of words in each row. */
+	uint64_t *mask;         /* Row of matches of an entry of left list. */
+	int block;              /* Distance between checkpoint rows. */
+	uint64_t *checkpoints;  /* Rows 0, block, 2*block, etc. */
+	uint64_t *rows;         /* Rows of currently loaded block. */
+	int loaded;             /* First row of the loaded block or -1. */
+}
+aligner_t;
+
 /* Entry in singly-bounded list of files that have matched fingerprints. */
 typedef struct compare_record_t
 {
@@ -74,16 +159,38 @@ static void leave_only_dups(entries_t *curr, entries_t *other);
 static int is_not_duplicate(FileView *view, const dir_entry_t *entry,
 		void *arg);
 static void fill_side_by_side(entries_t curr, entries_t other, int group_paths);
+static int aligner_init(aligner_t *al, entries_t curr, entries_t other,
+		int group_paths);
+static void aligner_free(aligner_t *al);
+static int entries_match(const aligner_t *al, int x, int y);
+static uint64_t * get_row(aligner_t *al, int x);
+static void make_row(aligner_t *al, int x, const uint64_t prev[],
+		uint64_t row[]);
+static void set_matches(aligner_t *al, int x, int set);
+static int count_zeros(const uint64_t row[], int nbits);
+static int count_bits(uint64_t word);
+static int id_key_sorter(const void *first, const void *second);
+static int name_key_sorter(const void *first, const void *second);
 static int id_sorter(const void *first, const void *second);
 static void put_or_free(FileView *view, dir_entry_t *entry, int id, int take);
 static entries_t make_diff_list(trie_t *trie, FileView *view, int *next_id,
-		CompareType ct, int skip_empty, int dups_only);
+		CompareType ct, int skip_empty, int dups_only, int by_size);
+static int * schedule_same_sizes(entries_t list, const strlist_t *files,
+		hasher_t *hasher);
+static int size_sorter(const void *first, const void *second);
 static void list_files_recursively(const char path[], int skip_dot_files,
-		strlist_t *list);
+		strlist_t *list, hasher_t *hasher);
 static char * get_file_fingerprint(const char path[], const dir_entry_t *entry,
-		CompareType ct);
+		CompareType ct, hasher_t *hasher, int idx);
 static char * get_contents_fingerprint(const char path[],
-		const dir_entry_t *entry);
+		const dir_entry_t *entry, hasher_t *hasher, int idx);
+static int hash_prefix(const char path[], unsigned long long *hash);
+static hasher_t * hasher_alloc(void);
+static void hasher_free(hasher_t *hasher);
+static void hasher_add(hasher_t *hasher, const char path[]);
+static void hash_job(void *arg);
+static int hasher_get(hasher_t *hasher, int idx, const char path[],
+		unsigned long long *hash);
 static int get_file_id(trie_t *trie, const char path[],
 		const char fingerprint[], int *id, CompareType ct);
 static int files_are_identical(const char a[], const char b[]);
@@ -101,9 +208,9 @@ compare_two_panes(CompareType ct, ListType lt, int group_paths, int skip_empty)
 	ui_cancellation_reset();
 	ui_cancellation_enable();
 
-	curr = make_diff_list(trie, curr_view, &next_id, ct, skip_empty, 0);
+	curr = make_diff_list(trie, curr_view, &next_id, ct, skip_empty, 0, 0);
 	other = make_diff_list(trie, other_view, &next_id, ct, skip_empty,
-			lt == LT_DUPS);
+			lt == LT_DUPS, 0);
 
 	ui_cancellation_disable();
 	trie_free_with_data(trie, &free_compare_records);
@@ -282,80 +389,75 @@ is_not_duplicate(FileView *view, const dir_entry_t *entry, void *arg)
 	return entry->id != -1;
 }
 
-/* Composes side-by-side comparison of files in two views. */
+/* Composes side-by-side comparison of files in two views.  Files are aligned
+ * by LCS of the lists preferring to consume left list when there is a choice
+ * (this matches the order in which edit distance matrix used to be
+ * backtracked). */
 static void
 fill_side_by_side(entries_t curr, entries_t other, int group_paths)
 {
 	enum { UP, LEFT, DIAG };
 
-	int i, j;
-	/* Describes results of solving sub-problems. */
-	int (*d)[other.nentries + 1] =
-		reallocarray(NULL, curr.nentries + 1, sizeof(*d));
-	/* Describes paths (backtracking handles ambiguity badly). */
-	char (*p)[other.nentries + 1] =
-		reallocarray(NULL, curr.nentries + 1, sizeof(*p));
+	aligner_t al;
+	const int n = curr.nentries, m = other.nentries;
+	int x = 0, y = 0;
+	/* LCS of curr[x:] and other[y:]. */
+	int lcs = 0;
+	const int have_rows = (aligner_init(&al, curr, other, group_paths) == 0);
 
-	for(i = 0; i <= curr.nentries; ++i)
+	if(have_rows && n != 0)
 	{
-		for(j = 0; j <= other.nentries; ++j)
-		{
-			if(i == 0)
-			{
-				d[i][j] = j;
-				p[i][j] = LEFT;
-			}
-			else if(j == 0)
-			{
-				d[i][j] = i;
-				p[i][j] = UP;
-			}
-			else
-			{
-				const dir_entry_t *centry = &curr.entries[curr.nentries - i];
-				const dir_entry_t *oentry = &other.entries[other.nentries - j];
-
-				d[i][j] = MIN(d[i - 1][j] + 1, d[i][j - 1] + 1);
-				p[i][j] = d[i][j] == d[i - 1][j] + 1 ? UP : LEFT;
-
-				if((centry->id == oentry->id ||
-							(group_paths && stroscmp(centry->name, oentry->name) == 0)) &&
-						d[i - 1][j - 1] <= d[i][j])
-				{
-					d[i][j] = d[i - 1][j - 1];
-					p[i][j] = DIAG;
-				}
-			}
-		}
+		lcs = count_zeros(get_row(&al, 0), m);
 	}
 
-	i = curr.nentries;
-	j = other.nentries;
-	while(i != 0 || j != 0)
+	while(x != n || y != m)
 	{
-		switch(p[i][j])
+		int step;
+		dir_entry_t *e;
+
+		if(x == n)
+		{
+			step = LEFT;
+		}
+		else if(y == m)
+		{
+			step = UP;
+		}
+		else if(entries_match(&al, x, y))
 		{
-			dir_entry_t *e;
+			step = DIAG;
+		}
+		else if(!have_rows || count_zeros(get_row(&al, x + 1), m - y) == lcs)
+		{
+			/* Skipping left entry doesn't make LCS shorter. */
+			step = UP;
+		}
+		else
+		{
+			step = LEFT;
+		}
 
+		switch(step)
+		{
 			case UP:
-				e = &curr.entries[curr.nentries - 1 - --i];
+				e = &curr.entries[x++];
 				flist_custom_put(curr_view, e);
 				flist_custom_add_separator(other_view, e->id);
 				break;
 			case LEFT:
-				e = &other.entries[other.nentries - 1 - --j];
+				e = &other.entries[y++];
 				flist_custom_put(other_view, e);
 				flist_custom_add_separator(curr_view, e->id);
 				break;
 			case DIAG:
-				flist_custom_put(curr_view, &curr.entries[curr.nentries - 1 - --i]);
-				flist_custom_put(other_view, &other.entries[other.nentries - 1 - --j]);
+				flist_custom_put(curr_view, &curr.entries[x++]);
+				flist_custom_put(other_view, &other.entries[y++]);
+				--lcs;
 				break;
 		}
 	}
 
-	free(d);
-	free(p);
+	aligner_free(&al);
 
 	/* Entries' data has been moved out of them, so need to free only the
 	 * lists. */
@@ -363,6 +465,291 @@ fill_side_by_side(entries_t curr, entries_t other, int group_paths)
 	dynarray_free(other.entries);
 }
 
+/* Prepares aligner for work and computes checkpoint rows.  Returns zero on
+ * success, otherwise non-zero is returned and only matching of entries is
+ * available. */
+static int
+aligner_init(aligner_t *al, entries_t curr, entries_t other, int group_paths)
+{
+	int i;
+	uint64_t *row;
+	const int n = curr.nentries, m = other.nentries;
+
+	al->curr = curr;
+	al->other = other;
+	al->group_paths = group_paths;
+	al->nwords = (m + 63)/64;
+	al->loaded = -1;
+
+	/* About square root of number of rows keeps memory usage low without
+	 * recomputing rows more than twice. */
+	al->block = 1;
+	while(al->block*al->block < n)
+	{
+		++al->block;
+	}
+
+	al->by_id = reallocarray(NULL, m, sizeof(*al->by_id));
+	al->by_name = reallocarray(NULL, m, sizeof(*al->by_name));
+	al->mask = calloc(al->nwords, sizeof(*al->mask));
+	al->checkpoints = reallocarray(NULL, (n + al->block - 1)/al->block,
+			al->nwords*sizeof(*al->checkpoints));
+	al->rows = reallocarray(NULL, al->block + 1,
+			al->nwords*sizeof(*al->rows));
+	if(m == 0 || n == 0)
+	{
+		return 1;
+	}
+	if(al->by_id == NULL || al->by_name == NULL || al->mask == NULL ||
+			al->checkpoints == NULL || al->rows == NULL)
+	{
+		return 1;
+	}
+
+	for(i = 0; i < m; ++i)
+	{
+		al->by_id[i].id = other.entries[i].id;
+		al->by_id[i].name = other.entries[i].name;
+		al->by_id[i].idx = i;
+	}
+	memcpy(al->by_name, al->by_id, m*sizeof(*al->by_name));
+	qsort(al->by_id, m, sizeof(*al->by_id), &id_key_sorter);
+	qsort(al->by_name, m, sizeof(*al->by_name), &name_key_sorter);
+
+	/* Row n corresponds to empty suffix of the left list, so every bit is set
+	 * there. */
+	row = &al->rows[0];
+	memset(row, 0xff, al->nwords*sizeof(*row));
+	if(m%64 != 0)
+	{
+		row[al->nwords - 1] = (UINT64_C(1) << m%64) - 1U;
+	}
+
+	for(i = n - 1; i >= 0; --i)
+	{
+		uint64_t *const next = &al->rows[(n - i)%2*al->nwords];
+		make_row(al, i, row, next);
+		row = next;
+
+		if(i%al->block == 0)
+		{
+			memcpy(&al->checkpoints[i/al->block*al->nwords], row,
+					al->nwords*sizeof(*row));
+		}
+	}
+
+	return 0;
+}
+
+/* Frees resources of the aligner. */
+static void
+aligner_free(aligner_t *al)
+{
+	free(al->by_id);
+	free(al->by_name);
+	free(al->mask);
+	free(al->checkpoints);
+	free(al->rows);
+}
+
+/* Checks whether x-th entry of the left list matches y-th entry of the right
+ * one.  Returns non-zero if so, otherwise zero is returned. */
+static int
+entries_match(const aligner_t *al, int x, int y)
+{
+	const dir_entry_t *const centry = &al->curr.entries[x];
+	const dir_entry_t *const oentry = &al->other.entries[y];
+	return centry->id == oentry->id
+	    || (al->group_paths && stroscmp(centry->name, oentry->name) == 0);
+}
+
+/* Retrieves x-th row recomputing its block if necessary.  Returns pointer to
+ * the row. */
+static uint64_t *
+get_row(aligner_t *al, int x)
+{
+	const int n = al->curr.nentries;
+	const int w = al->nwords;
+	const int first = x/al->block*al->block;
+
+	if(al->loaded != first)
+	{
+		const int last = MIN(first + al->block, n);
+		int i;
+
+		if(last == n)
+		{
+			memset(&al->rows[(last - first)*w], 0xff, w*sizeof(*al->rows));
+			if(al->other.nentries%64 != 0)
+			{
+				al->rows[(last - first)*w + w - 1] =
+					(UINT64_C(1) << al->other.nentries%64) - 1U;
+			}
+		}
+		else
+		{
+			memcpy(&al->rows[(last - first)*w], &al->checkpoints[last/al->block*w],
+					w*sizeof(*al->rows));
+		}
+
+		for(i = last - 1; i >= first; --i)
+		{
+			make_row(al, i, &al->rows[(i + 1 - first)*w],
+					&al->rows[(i - first)*w]);
+		}
+
+		al->loaded = first;
+	}
+
+	return &al->rows[(x - first)*w];
+}
+
+/* Computes x-th row from the next one by processing x-th entry of the left
+ * list in a bit-parallel way. */
+static void
+make_row(aligner_t *al, int x, const uint64_t prev[], uint64_t row[])
+{
+	int i;
+	uint64_t carry = 0U;
+
+	set_matches(al, x, 1);
+
+	for(i = 0; i < al->nwords; ++i)
+	{
+		const uint64_t u = prev[i] & al->mask[i];
+		const uint64_t sum = prev[i] + u;
+		const uint64_t total = sum + carry;
+		carry = (sum < prev[i]) || (total < sum);
+		row[i] = total | (prev[i] & ~u);
+	}
+
+	if(al->other.nentries%64 != 0)
+	{
+		row[al->nwords - 1] &= (UINT64_C(1) << al->other.nentries%64) - 1U;
+	}
+
+	set_matches(al, x, 0);
+}
+
+/* Sets or resets bits of the mask that correspond to entries of the right list
+ * that match x-th entry of the left list. */
+static void
+set_matches(aligner_t *al, int x, int set)
+{
+	const dir_entry_t *const entry = &al->curr.entries[x];
+	const int m = al->other.nentries;
+	const keyed_entry_t key = { .id = entry->id, .name = entry->name, .idx = -1 };
+	keyed_entry_t *match;
+	int i, j;
+
+	for(i = 0; i < 2; ++i)
+	{
+		keyed_entry_t *const list = (i == 0) ? al->by_id : al->by_name;
+		int (*const sorter)(const void *, const void *) =
+			(i == 0) ? &id_key_sorter : &name_key_sorter;
+
+		if(i == 1 && !al->group_paths)
+		{
+			break;
+		}
+
+		/* Find first of equal keys, no entry has negative index. */
+		match = list;
+		for(j = m; j > 0; )
+		{
+			const int half = j/2;
+			if(sorter(&match[half], &key) < 0)
+			{
+				match += half + 1;
+				j -= half + 1;
+			}
+			else
+			{
+				j = half;
+			}
+		}
+
+		for(; match != list + m; ++match)
+		{
+			uint64_t bit;
+			int c;
+
+			if((i == 0) ? (match->id != entry->id)
+			            : (stroscmp(match->name, entry->name) != 0))
+			{
+				break;
+			}
+
+			/* Bits go in reverse order of entries. */
+			c = m - 1 - match->idx;
+			bit = UINT64_C(1) << c%64;
+			if(set)
+			{
+				al->mask[c/64] |= bit;
+			}
+			else
+			{
+				al->mask[c/64] &= ~bit;
+			}
+		}
+	}
+}
+
+/* Counts zero bits among first nbits of a row.  Returns the count. */
+static int
+count_zeros(const uint64_t row[], int nbits)
+{
+	int i;
+	int ones = 0;
+
+	for(i = 0; i < nbits/64; ++i)
+	{
+		ones += count_bits(row[i]);
+	}
+	if(nbits%64 != 0)
+	{
+		ones += count_bits(row[i] & ((UINT64_C(1) << nbits%64) - 1U));
+	}
+
+	return nbits - ones;
+}
+
+/* Counts set bits of a word.  Returns the count. */
+static int
+count_bits(uint64_t word)
+{
+	word = word - ((word >> 1) & UINT64_C(0x5555555555555555));
+	word = (word & UINT64_C(0x3333333333333333))
+	     + ((word >> 2) & UINT64_C(0x3333333333333333));
+	word = (word + (word >> 4)) & UINT64_C(0x0f0f0f0f0f0f0f0f);
+	return (word*UINT64_C(0x0101010101010101)) >> 56;
+}
+
+/* qsort() comparer that sorts keyed entries by id.  Returns standard -1, 0, 1
+ * for comparisons. */
+static int
+id_key_sorter(const void *first, const void *second)
+{
+	const keyed_entry_t *a = first;
+	const keyed_entry_t *b = second;
+	if(a->id != b->id)
+	{
+		return (a->id < b->id) ? -1 : 1;
+	}
+	return a->idx - b->idx;
+}
+
+/* qsort() comparer that sorts keyed entries by name.  Returns standard -1, 0, 1
+ * for comparisons. */
+static int
+name_key_sorter(const void *first, const void *second)
+{
+	const keyed_entry_t *a = first;
+	const keyed_entry_t *b = second;
+	const int cmp = stroscmp(a->name, b->name);
+	return (cmp != 0) ? cmp : a->idx - b->idx;
+}
+
 int
 compare_one_pane(FileView *view, CompareType ct, ListType lt, int skip_empty)
 {
@@ -378,7 +765,8 @@ compare_one_pane(FileView *view, CompareType ct, ListType lt, int skip_empty)
 	ui_cancellation_reset();
 	ui_cancellation_enable();
 
-	curr = make_diff_list(trie, view, &next_id, ct, skip_empty, 0);
+	/* Files of unique size can't have duplicates within single pane. */
+	curr = make_diff_list(trie, view, &next_id, ct, skip_empty, 0, 1);
 
 	ui_cancellation_disable();
 	trie_free_with_data(trie, &free_compare_records);
@@ -479,29 +867,37 @@ put_or_free(FileView *view, dir_entry_t *entry, int id, int take)
 
 /* Makes sorted by path list of entries that.  The trie is used to keep track of
  * identical files.  With non-zero dups_only, new files aren't added to the
- * trie. */
+ * trie.  Non-zero by_size means that only files of the list are compared, in
+ * which case files of unique size get unique ids without reading them. */
 static entries_t
 make_diff_list(trie_t *trie, FileView *view, int *next_id, CompareType ct,
-		int skip_empty, int dups_only)
+		int skip_empty, int dups_only, int by_size)
 {
-	int i;
+	int i, j;
 	strlist_t files = {};
 	entries_t r = {};
 	int last_progress = 0;
+	int *job_ids = NULL;
+	/* Contents of files is hashed in background.  Without grouping by size all
+	 * files are hashed while they are being listed, otherwise hashing starts
+	 * after all sizes are known. */
+	hasher_t *const hasher = (ct == CT_CONTENTS) ? hasher_alloc() : NULL;
+	by_size = (by_size && ct == CT_CONTENTS);
 
 	show_progress("Listing...", 0);
-	list_files_recursively(flist_get_dir(view), view->hide_dot, &files);
+	list_files_recursively(flist_get_dir(view), view->hide_dot, &files,
+			by_size ? NULL : hasher);
 
 	show_progress("Querying...", 0);
 	for(i = 0; i < files.nitems && !ui_cancellation_requested(); ++i)
 	{
-		char progress_msg[128];
-		int progress;
-		int existing_id;
-		char *fingerprint;
 		const char *const path = files.items[i];
 		dir_entry_t *const entry = entry_list_add(view, &r.entries, &r.nentries,
 				path);
+		if(entry == NULL)
+		{
+			continue;
+		}
 
 		if(skip_empty && entry->size == 0)
 		{
@@ -510,18 +906,50 @@ make_diff_list(trie_t *trie, FileView *view, int *next_id, CompareType ct,
 			continue;
 		}
 
-		fingerprint = get_file_fingerprint(path, entry, ct);
+		entry->tag = i;
+		show_progress("Querying...", 1000);
+	}
+
+	if(by_size)
+	{
+		job_ids = schedule_same_sizes(r, &files, hasher);
+	}
+
+	for(i = 0, j = 0; i < r.nentries && !ui_cancellation_requested(); ++i)
+	{
+		char progress_msg[128];
+		int progress;
+		int existing_id;
+		char *fingerprint;
+		dir_entry_t *const entry = &r.entries[i];
+		const char *const path = files.items[entry->tag];
+		const int job_id = (job_ids == NULL) ? entry->tag : job_ids[i];
+
+		if(job_id < 0)
+		{
+			/* File of unique size, just make sure that it could be hashed like
+			 * other files. */
+			if(!is_regular_file(path) || os_access(path, R_OK) != 0)
+			{
+				free_dir_entry(view, entry);
+				continue;
+			}
+
+			entry->id = dups_only ? -1 : (*next_id)++;
+			r.entries[j++] = *entry;
+			continue;
+		}
+
+		fingerprint = get_file_fingerprint(path, entry, ct, hasher, job_id);
 		/* In case we couldn't obtain fingerprint (e.g., comparing by contents and
 		 * files isn't readable), ignore the file and keep going. */
 		if(is_null_or_empty(fingerprint))
 		{
 			free(fingerprint);
 			free_dir_entry(view, entry);
-			--r.nentries;
 			continue;
 		}
 
-		entry->tag = i;
 		if(get_file_id(trie, path, fingerprint, &existing_id, ct))
 		{
 			entry->id = existing_id;
@@ -538,8 +966,9 @@ make_diff_list(trie_t *trie, FileView *view, int *next_id, CompareType ct,
 		}
 
 		free(fingerprint);
+		r.entries[j++] = *entry;
 
-		progress = (i*100)/files.nitems;
+		progress = (i*100)/r.nentries;
 		if(progress != last_progress)
 		{
 			last_progress = progress;
@@ -549,13 +978,89 @@ make_diff_list(trie_t *trie, FileView *view, int *next_id, CompareType ct,
 		}
 	}
 
+	/* Keep entries that weren't processed due to cancellation to free them
+	 * along with all the others. */
+	while(i < r.nentries)
+	{
+		r.entries[j++] = r.entries[i++];
+	}
+	r.nentries = j;
+
+	/* Should go before freeing list of files as jobs refer to its items. */
+	hasher_free(hasher);
+	free(job_ids);
 	free_string_array(files.items, files.nitems);
 	return r;
 }
 
-/* Collects files under specified file system tree. */
+/* Groups entries of the list by size and schedules hashing of those that have
+ * files of the same size.  Returns array of job ids corresponding to entries of
+ * the list, which is -1 for files that need no hashing, or NULL on error. */
+static int *
+schedule_same_sizes(entries_t list, const strlist_t *files, hasher_t *hasher)
+{
+	int i;
+	int next_job_id;
+	int *const job_ids = reallocarray(NULL, list.nentries, sizeof(*job_ids));
+	sized_entry_t *const sizes = reallocarray(NULL, list.nentries,
+			sizeof(*sizes));
+	if(job_ids == NULL || sizes == NULL)
+	{
+		free(job_ids);
+		free(sizes);
+		return NULL;
+	}
+
+	for(i = 0; i < list.nentries; ++i)
+	{
+		sizes[i].size = list.entries[i].size;
+		sizes[i].idx = i;
+	}
+	qsort(sizes, list.nentries, sizeof(*sizes), &size_sorter);
+
+	for(i = 0; i < list.nentries; ++i)
+	{
+		const int unique =
+			(i == 0 || sizes[i - 1].size != sizes[i].size) &&
+			(i == list.nentries - 1 || sizes[i + 1].size != sizes[i].size);
+		job_ids[sizes[i].idx] = unique ? -1 : 0;
+	}
+	free(sizes);
+
+	/* Jobs are scheduled in order of entries, which is the order in which their
+	 * results are consumed. */
+	next_job_id = 0;
+	for(i = 0; i < list.nentries; ++i)
+	{
+		if(job_ids[i] == 0)
+		{
+			job_ids[i] = next_job_id++;
+			hasher_add(hasher, files->items[list.entries[i].tag]);
+		}
+	}
+
+	return job_ids;
+}
+
+/* qsort() comparer that sorts sized entries by size.  Returns standard -1, 0,
+ * 1 for comparisons. */
+static int
+size_sorter(const void *first, const void *second)
+{
+	const sized_entry_t *a = first;
+	const sized_entry_t *b = second;
+	if(a->size == b->size)
+	{
+		return a->idx - b->idx;
+	}
+	return (a->size < b->size) ? -1 : 1;
+}
+
+/* Collects files under specified file system tree.  Each file is also passed to
+ * the hasher, if it's not NULL. */
 static void
-list_files_recursively(const char path[], int skip_dot_files, strlist_t *list)
+list_files_recursively(const char path[], int skip_dot_files, strlist_t *list,
+		hasher_t *hasher)
 {
 	int i;
 
@@ -582,7 +1087,7 @@ list_files_recursively(const char path[], int skip_dot_files, strlist_t *list)
 		{
 			if(!is_symlink(full_path))
 			{
-				list_files_recursively(full_path, skip_dot_files, list);
+				list_files_recursively(full_path, skip_dot_files, list, hasher);
 			}
 			free(full_path);
 			update_string(&lst[i], NULL);
@@ -602,6 +1107,7 @@ list_files_recursively(const char path[], int skip_dot_files, strlist_t *list)
 		if(lst[i] != NULL)
 		{
 			list->nitems = put_into_string_array(&list->items, list->nitems, lst[i]);
+			hasher_add(hasher, lst[i]);
 		}
 	}
 
@@ -609,11 +1115,12 @@ list_files_recursively(const char path[], int skip_dot_files, strlist_t *list)
 }
 
 /* Computes fingerprint of the file specified by path and entry.  Type of the
- * fingerprint is determined by ct parameter.  Returns newly allocated string
- * with the fingerprint, which is empty or NULL on error. */
+ * fingerprint is determined by ct parameter.  Hasher can be NULL, idx is index
+ * of the file in the hasher.  Returns newly allocated string with the
+ * fingerprint, which is empty or NULL on error. */
 static char *
 get_file_fingerprint(const char path[], const dir_entry_t *entry,
-		CompareType ct)
+		CompareType ct, hasher_t *hasher, int idx)
 {
 	switch(ct)
 	{
@@ -629,16 +1136,35 @@ get_file_fingerprint(const char path[], const dir_entry_t *entry,
 		case CT_SIZE:
 			return format_str("%" PRINTF_ULL, (unsigned long long)entry->size);
 		case CT_CONTENTS:
-			return get_contents_fingerprint(path, entry);
+			return get_contents_fingerprint(path, entry, hasher, idx);
 	}
 	assert(0 && "Unexpected diffing type.");
 	return strdup("");
 }
 
-/* Makes fingerprint of file contents (all or part of it of fixed size).
- * Returns the fingerprint as a string, which is empty or NULL on error. */
+/* Makes fingerprint of file contents (all or part of it of fixed size).  Takes
+ * hash from the hasher when it's not NULL.  Returns the fingerprint as a
+ * string, which is empty or NULL on error. */
 static char *
-get_contents_fingerprint(const char path[], const dir_entry_t *entry)
+get_contents_fingerprint(const char path[], const dir_entry_t *entry,
+		hasher_t *hasher, int idx)
+{
+	unsigned long long hash;
+	const int failed = (hasher == NULL) ? hash_prefix(path, &hash)
+	                                    : hasher_get(hasher, idx, path, &hash);
+	if(failed)
+	{
+		return strdup("");
+	}
+
+	return format_str("%" PRINTF_ULL "|%" PRINTF_ULL,
+			(unsigned long long)entry->size, hash);
+}
+
+/* Hashes prefix of a file of at most PREFIX_SIZE bytes.  Returns zero on
+ * success and sets *hash, otherwise non-zero is returned. */
+static int
+hash_prefix(const char path[], unsigned long long *hash)
 {
 #if INTPTR_MAX == INT64_MAX
 #define XX_BITS 64
@@ -655,7 +1181,7 @@ get_contents_fingerprint(const char path[], const dir_entry_t *entry)
 	FILE *in = os_fopen(path, "rb");
 	if(in == NULL)
 	{
-		return strdup("");
+		return 1;
 	}
 
 	XX(reset)(&st, 0U);
@@ -673,8 +1199,8 @@ get_contents_fingerprint(const char path[], const dir_entry_t *entry)
 	}
 	fclose(in);
 
-	return format_str("%" PRINTF_ULL "|%" PRINTF_ULL,
-			(unsigned long long)entry->size, (unsigned long long)XX(digest)(&st));
+	*hash = XX(digest)(&st);
+	return 0;
 
 #undef XX_BITS
 #undef XX__
@@ -682,6 +1208,177 @@ get_contents_fingerprint(const char path[], const dir_entry_t *entry)
 #undef XX
 }
 
+/* Creates hasher with a pool of threads.  Returns NULL if threads aren't
+ * available, in which case files are hashed on demand. */
+static hasher_t *
+hasher_alloc(void)
+{
+	int nthreads;
+	hasher_t *const hasher = calloc(1, sizeof(*hasher));
+	if(hasher == NULL)
+	{
+		return NULL;
+	}
+
+	/* Reading files is the bottleneck, so use at least two threads to overlap
+	 * it with listing even on a single processor. */
+	nthreads = MAX(2, MIN(get_cpu_count(), MAX_HASHING_THREADS));
+	/* Queue is effectively unbounded to never block listing of files. */
+	hasher->pool = tpool_alloc(nthreads, INT_MAX);
+	if(hasher->pool == NULL)
+	{
+		free(hasher);
+		return NULL;
+	}
+
+	pthread_mutex_init(&hasher->lock, NULL);
+	pthread_cond_init(&hasher->changed, NULL);
+	return hasher;
+}
+
+/* Drops unfinished jobs, waits for threads and frees the hasher.  Freeing of
+ * NULL hasher is OK. */
+static void
+hasher_free(hasher_t *hasher)
+{
+	int i;
+
+	if(hasher == NULL)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&hasher->lock);
+	hasher->cancelled = 1;
+	pthread_mutex_unlock(&hasher->lock);
+
+	tpool_free(hasher->pool);
+
+	pthread_cond_destroy(&hasher->changed);
+	pthread_mutex_destroy(&hasher->lock);
+
+	for(i = 0; i < hasher->njobs; ++i)
+	{
+		free(hasher->jobs[i]);
+	}
+	free(hasher->jobs);
+	free(hasher);
+}
+
+/* Schedules hashing of the next file.  The path must outlive the hasher.  On
+ * error the hasher stops accepting jobs, so that indexes of jobs always match
+ * indexes of files and the rest of files is hashed on demand. */
+static void
+hasher_add(hasher_t *hasher, const char path[])
+{
+	hash_job_t *job;
+	void *ptr;
+
+	if(hasher == NULL || hasher->stopped)
+	{
+		return;
+	}
+
+	job = malloc(sizeof(*job));
+	ptr = reallocarray(hasher->jobs, hasher->njobs + 1, sizeof(*hasher->jobs));
+	if(ptr != NULL)
+	{
+		hasher->jobs = ptr;
+	}
+	if(job == NULL || ptr == NULL)
+	{
+		free(job);
+		hasher->stopped = 1;
+		return;
+	}
+
+	job->hasher = hasher;
+	job->path = path;
+	job->hash = 0U;
+	job->state = HS_PENDING;
+
+	if(tpool_push(hasher->pool, &hash_job, job, -1) != 0)
+	{
+		free(job);
+		hasher->stopped = 1;
+		return;
+	}
+
+	pthread_mutex_lock(&hasher->lock);
+	hasher->jobs[hasher->njobs++] = job;
+	pthread_mutex_unlock(&hasher->lock);
+}
+
+/* Computes hash of a single file.  Invoked on pool threads. */
+static void
+hash_job(void *arg)
+{
+	hash_job_t *const job = arg;
+	hasher_t *const hasher = job->hasher;
+	unsigned long long hash;
+	int cancelled;
+	int failed = 1;
+
+	pthread_mutex_lock(&hasher->lock);
+	cancelled = hasher->cancelled;
+	pthread_mutex_unlock(&hasher->lock);
+
+	if(!cancelled)
+	{
+		failed = hash_prefix(job->path, &hash);
+	}
+
+	pthread_mutex_lock(&hasher->lock);
+	if(!failed)
+	{
+		job->hash = hash;
+	}
+	job->state = failed ? HS_FAILED : HS_DONE;
+	pthread_cond_broadcast(&hasher->changed);
+	pthread_mutex_unlock(&hasher->lock);
+}
+
+/* Waits for hash of idx-th file checking for cancellation requests
+ * periodically.  Files that weren't scheduled are hashed right here.  Returns
+ * zero on success and sets *hash, otherwise non-zero is returned. */
+static int
+hasher_get(hasher_t *hasher, int idx, const char path[],
+		unsigned long long *hash)
+{
+	hash_job_t *job;
+	int failed;
+
+	/* Only this thread changes number of jobs. */
+	if(idx >= hasher->njobs)
+	{
+		return hash_prefix(path, hash);
+	}
+
+	pthread_mutex_lock(&hasher->lock);
+
+	job = hasher->jobs[idx];
+	while(job->state == HS_PENDING)
+	{
+		struct timespec deadline;
+
+		if(ui_cancellation_requested())
+		{
+			hasher->cancelled = 1;
+			pthread_mutex_unlock(&hasher->lock);
+			return 1;
+		}
+
+		tpool_deadline(HASH_POLL_PERIOD, &deadline);
+		(void)pthread_cond_timedwait(&hasher->changed, &hasher->lock, &deadline);
+	}
+
+	failed = (job->state != HS_DONE);
+	*hash = job->hash;
+
+	pthread_mutex_unlock(&hasher->lock);
+	return failed;
+}
+
 /* Retrieves file from the trie by its fingerprint.  Returns non-zero if it was
  * in the trie and sets *id, otherwise zero is returned. */
 static int
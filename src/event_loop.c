@@ -36,9 +36,11 @@
 #include "engine/mode.h"
 #include "modes/dialogs/msg_dialog.h"
 #include "modes/modes.h"
+#include "modes/view.h"
 #include "modes/wk.h"
 #include "ui/color_manager.h"
 #include "ui/fileview.h"
+#include "ui/quickview.h"
 #include "ui/statusbar.h"
 #include "ui/statusline.h"
 #include "ui/ui.h"
@@ -400,6 +402,8 @@ process_scheduled_updates(void)
 	int need_redraw = 0;
 
 	ui_stat_job_bar_check_for_updates();
+	qv_check_async();
+	view_check_for_output();
 
 	if(vle_mode_get_primary() != MENU_MODE)
 	{
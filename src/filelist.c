@@ -31,17 +31,20 @@
 #include <sys/stat.h> /* stat */
 
 #include <assert.h> /* assert() */
-#include <errno.h> /* errno */
+#include <errno.h> /* EIO errno */
 #include <stddef.h> /* NULL size_t */
 #include <stdint.h> /* intptr_t uint64_t */
 #include <stdio.h> /* snprintf() */
-#include <stdlib.h> /* calloc() free() */
-#include <string.h> /* memcmp() memcpy() memset() strcat() strcmp() strcpy()
-                       strdup() strlen() */
+#include <stdlib.h> /* calloc() free() malloc() */
+#include <string.h> /* memcmp() memcpy() memmove() memset() strcat() strcmp()
+                       strcpy() strdup() strlen() */
+#include <time.h> /* timespec */
 
 #include "cfg/config.h"
 #include "compat/fs_limits.h"
 #include "compat/os.h"
+#include "compat/pthread.h"
+#include "compat/reallocarray.h"
 #include "engine/autocmds.h"
 #include "engine/mode.h"
 #include "int/fuse.h"
@@ -64,6 +67,7 @@
 #include "utils/str.h"
 #include "utils/string_array.h"
 #include "utils/test_helpers.h"
+#include "utils/tpool.h"
 #include "utils/trie.h"
 #include "utils/utf8.h"
 #include "utils/utils.h"
@@ -78,6 +82,84 @@
 #include "status.h"
 #include "types.h"
 
+#ifndef _WIN32
+
+/* Minimal number of listed files to query their metadata in parallel. */
+#define PARALLEL_STAT_MIN 1024
+
+/* Number of entries processed by a single task of parallel metadata query. */
+#define STAT_CHUNK_SIZE 256
+
+/* Maximum number of threads querying metadata of files.  Their work is mostly
+ * waiting for file system, so this doesn't depend on number of CPUs. */
+#define MAX_STAT_THREADS 8
+
+/* Task of querying metadata of a range of view entries. */
+typedef struct
+{
+	FileView *view;    /* View which contains the entries. */
+	int from;          /* Index of the first entry to process. */
+	int to;            /* Index past the last entry to process. */
+	int resolve_links; /* Whether to query mode of symbolic link targets. */
+	int *errors;       /* Results of stat_dir_entry() for all view entries. */
+}
+stat_task_t;
+
+#endif
+
+/* Number of threads listing directories of a tree.  Their work is mostly
+ * waiting for file system, so this doesn't depend on number of CPUs. */
+#define TREE_THREADS 8
+
+/* Maximum number of directories of a tree waiting to be listed.  Directories
+ * that don't fit are listed by the thread that found them. */
+#define TREE_QUEUE 1024
+
+/* Directory of a tree that's being built. */
+typedef struct tree_dir_t tree_dir_t;
+
+/* State shared by all tasks that list directories of a tree.  Listing threads
+ * only query file system, everything that involves options, filters or other
+ * global state is done on the main thread. */
+typedef struct
+{
+	FileView *view;          /* View for which the tree is being built. */
+	trie_t *excluded_paths;  /* Paths that shouldn't be listed, can be NULL. */
+	tpool_t *pool;           /* Threads that list directories or NULL. */
+	int resolve_links;       /* Whether to query mode of symlink targets. */
+	int pending;             /* Number of directories not yet processed. */
+
+	pthread_mutex_t lock;    /* Protects the listed field. */
+	pthread_cond_t dir_done; /* Signaled when a directory is listed. */
+	tree_dir_t *listed;      /* Listed, but not processed directories. */
+}
+tree_build_t;
+
+/* Item of a directory of a tree that's being built. */
+typedef struct
+{
+	dir_entry_t entry; /* Visible file, name is NULL for hidden directories. */
+	tree_dir_t *dir;   /* Contents of a directory or NULL. */
+	int error;         /* Error code for complete_dir_entry(). */
+}
+tree_item_t;
+
+struct tree_dir_t
+{
+	tree_build_t *build;  /* State of the whole build. */
+	char *path;           /* Canonical path to the directory. */
+	int no_direct_parent; /* Whether the directory itself is hidden. */
+	int level;            /* Nesting level of entries of the directory. */
+	tree_item_t *items;   /* Visible files and hidden directories (dynarray). */
+	int nitems;           /* Number of elements in the items array. */
+	int nfiltered;        /* Number of files that were filtered out. */
+	int failed;           /* Whether listing of the directory has failed. */
+	tree_dir_t *next;     /* Next element of tree_build_t::listed list. */
+};
+
+/* Value of custom.folded_paths trie that marks folded directories. */
+static const char folded_mark = 'f';
+
 static void init_view(FileView *view);
 static void init_flist(FileView *view);
 static void reset_view(FileView *view);
@@ -88,13 +170,24 @@ static int navigate_to_file_in_custom_view(FileView *view, const char dir[],
 static int fill_dir_entry_by_path(dir_entry_t *entry, const char path[]);
 #ifndef _WIN32
 static int fill_dir_entry(dir_entry_t *entry, const char path[],
-		const struct dirent *d);
+		FileType type_hint);
+static int stat_dir_entry(dir_entry_t *entry, const char path[],
+		FileType type_hint, int resolve_link);
+static void resolve_link_mode(dir_entry_t *entry, const char path[]);
+static void log_stat_error(const char path[], int error);
+static int query_dir_entry_by_data(dir_entry_t *entry, const char path[],
+		const struct dirent *d, int resolve_link);
 static int data_is_dir_entry(const struct dirent *d);
 #else
 static int fill_dir_entry(dir_entry_t *entry, const char path[],
 		const WIN32_FIND_DATAW *ffd);
+static int query_dir_entry_by_data(dir_entry_t *entry, const char path[],
+		const WIN32_FIND_DATAW *ffd, int resolve_link);
 static int data_is_dir_entry(const WIN32_FIND_DATAW *ffd);
 #endif
+static int complete_dir_entry(dir_entry_t *entry, const char path[], int error,
+		int resolve_link);
+static int entry_targets_dir(const dir_entry_t *entry);
 static int flist_custom_finish_internal(FileView *view, CVType type, int reload,
 		const char dir[], int allow_empty);
 static void on_location_change(FileView *view, int force);
@@ -114,6 +207,7 @@ static void zap_compare_view(FileView *view, FileView *other, zap_filter filter,
 		void *arg);
 static int find_separator(FileView *view, int idx);
 static int update_dir_watcher(FileView *view);
+static void update_tree_watcher(FileView *view);
 static int custom_list_is_incomplete(const FileView *view);
 static int is_dead_or_filtered(FileView *view, const dir_entry_t *entry,
 		void *arg);
@@ -127,6 +221,10 @@ static void finish_dir_list_change(FileView *view, dir_entry_t *entries,
 		int len);
 static int add_file_entry_to_view(const char name[], const void *data,
 		void *param);
+#ifndef _WIN32
+static void load_entries_metadata(FileView *view);
+static void stat_task(void *arg);
+#endif
 static void sort_dir_list(int msg, FileView *view);
 static void merge_lists(FileView *view, dir_entry_t *entries, int len);
 static void add_to_trie(trie_t *trie, FileView *view, dir_entry_t *entry);
@@ -138,6 +236,10 @@ static int rescue_from_empty_filelist(FileView *view);
 static void init_dir_entry(FileView *view, dir_entry_t *entry,
 		const char name[]);
 static dir_entry_t * alloc_dir_entry(dir_entry_t **list, int list_size);
+static int update_changed_entries(FileView *view,
+		const fswatch_changes_t *changes);
+static int update_changed_entry(FileView *view, const char name[],
+		int created, dir_entry_t *entry);
 static int tree_has_changed(const dir_entry_t *entries, size_t nchildren);
 TSTATIC void pick_cd_path(FileView *view, const char base_dir[],
 		const char path[], int *updir, char buf[], size_t buf_size);
@@ -146,12 +248,26 @@ static void find_dir_in_cdpath(const char base_dir[], const char dst[],
 static int iter_entries(FileView *view, dir_entry_t **entry,
 		entry_predicate pred);
 static void clear_marking(FileView *view);
+static void reset_tree_folds(FileView *view);
 static int flist_load_tree_internal(FileView *view, const char path[],
 		int reload);
 static int make_tree(FileView *view, const char path[], int reload,
 		trie_t *excluded_paths);
-static int add_files_recursively(FileView *view, const char path[],
-		trie_t *excluded_paths, int parent_pos, int no_direct_parent);
+static int list_tree(FileView *view, const char path[],
+		trie_t *excluded_paths, int level);
+static tree_dir_t * start_tree_dir(tree_build_t *build, const char path[],
+		int no_direct_parent, int level);
+static void tree_dir_task(void *arg);
+static int add_tree_item(const char name[], const void *data, void *param);
+static tree_dir_t * take_listed_dirs(tree_build_t *build, int timeout_ms);
+static void process_tree_dir(tree_build_t *build, tree_dir_t *dir);
+static int add_tree_dir(FileView *view, tree_dir_t *dir, int parent_pos);
+static void free_tree_dir(FileView *view, tree_dir_t *dir);
+static int is_dir_folded(FileView *view, const char path[], int level);
+static void fold_tree_dir(FileView *view, int pos);
+static int unfold_tree_dir(FileView *view, int pos);
+static int get_tree_level(const FileView *view, int pos);
+static void update_tree_links(FileView *view, int pos, int delta);
 static int file_is_visible(FileView *view, const char filename[], int is_dir,
 		const void *data, int apply_local_filter);
 static int add_directory_leaf(FileView *view, const char path[],
@@ -821,6 +937,7 @@ change_directory(FileView *view, const char directory[])
 		{
 			enable_view_sorting(view);
 		}
+		reset_tree_folds(view);
 		if(cv_compare(view->custom.type))
 		{
 			FileView *const other = (view == curr_view) ? other_view : curr_view;
@@ -1007,33 +1124,75 @@ flist_custom_add_separator(FileView *view, int id)
 static int
 fill_dir_entry_by_path(dir_entry_t *entry, const char path[])
 {
-	return fill_dir_entry(entry, path, NULL);
+	return fill_dir_entry(entry, path, FT_UNK);
 }
 
 /* Fills fields of the entry from stat information of the file specified by its
- * path.  d is optional source of file type.  Returns zero on success, otherwise
- * non-zero is returned. */
+ * path.  type_hint is used when type can't be derived from file mode.  Returns
+ * zero on success, otherwise non-zero is returned. */
+static int
+fill_dir_entry(dir_entry_t *entry, const char path[], FileType type_hint)
+{
+	const int error = stat_dir_entry(entry, path, type_hint, 0);
+	return complete_dir_entry(entry, path, error, 0);
+}
+
+/* Fills directory entry with information about file specified by the path
+ * using data obtained while listing its parent.  Leaves part of the work to
+ * complete_dir_entry(), so can be invoked on any thread.  Returns error code
+ * to be passed to complete_dir_entry(). */
+static int
+query_dir_entry_by_data(dir_entry_t *entry, const char path[],
+		const struct dirent *d, int resolve_link)
+{
+	return stat_dir_entry(entry, path, type_from_dir_entry(d), resolve_link);
+}
+
+/* Finishes filling of the entry on the main thread after stat_dir_entry() or
+ * query_dir_entry_by_data() have returned the error code.  Returns non-zero if
+ * the entry should be dropped, otherwise zero is returned. */
+static int
+complete_dir_entry(dir_entry_t *entry, const char path[], int error,
+		int resolve_link)
+{
+	if(error != 0)
+	{
+		log_stat_error(path, error);
+		return 1;
+	}
+
+	if(!resolve_link && entry->type == FT_LINK)
+	{
+		resolve_link_mode(entry, path);
+	}
+	return 0;
+}
+
+/* Fills fields of the entry from stat information of the file specified by its
+ * path.  type_hint is used when type can't be derived from file mode.  Mode of
+ * symbolic link target is queried only if resolve_link is non-zero.  Doesn't
+ * log nor access any global state, so can be invoked on any thread.  Returns
+ * zero on success, errno of failed lstat() or -1 for a file of unknown type. */
 static int
-fill_dir_entry(dir_entry_t *entry, const char path[], const struct dirent *d)
+stat_dir_entry(dir_entry_t *entry, const char path[], FileType type_hint,
+		int resolve_link)
 {
 	struct stat s;
 
 	/* Load the inode information or leave blank values in the entry. */
 	if(os_lstat(path, &s) != 0)
 	{
-		LOG_SERROR_MSG(errno, "Can't lstat() \"%s\"", path);
-		return 1;
+		return (errno == 0 ? EIO : errno);
 	}
 
 	entry->type = get_type_from_mode(s.st_mode);
 	if(entry->type == FT_UNK)
 	{
-		entry->type = (d == NULL) ? FT_UNK : type_from_dir_entry(d);
+		entry->type = type_hint;
 	}
 	if(entry->type == FT_UNK)
 	{
-		LOG_ERROR_MSG("Can't determine type of \"%s\"", path);
-		return 1;
+		return -1;
 	}
 
 	entry->size = (uintmax_t)s.st_size;
@@ -1045,20 +1204,43 @@ fill_dir_entry(dir_entry_t *entry, const char path[], const struct dirent *d)
 	entry->ctime = s.st_ctime;
 	entry->nlinks = s.st_nlink;
 
-	if(entry->type == FT_LINK)
+	if(resolve_link && entry->type == FT_LINK && os_stat(path, &s) == 0)
 	{
-		/* Query mode of symbolic link target. */
+		entry->mode = s.st_mode;
+	}
 
-		struct stat s;
+	return 0;
+}
 
-		const SymLinkType symlink_type = get_symlink_type(entry->name);
-		if(symlink_type != SLT_SLOW && os_stat(entry->name, &s) == 0)
-		{
-			entry->mode = s.st_mode;
-		}
+/* Queries mode of symbolic link target.  Resolving the link completely would
+ * access its target twice, so only check that it's not at slow file system and
+ * only if there are any.  Mount points are looked up in a non-reentrant way,
+ * so this must be invoked on the main thread. */
+static void
+resolve_link_mode(dir_entry_t *entry, const char path[])
+{
+	struct stat s;
+
+	const int slow = !is_null_or_empty(cfg.slow_fs_list)
+	              && symlink_target_is_slow(path);
+	if(!slow && os_stat(path, &s) == 0)
+	{
+		entry->mode = s.st_mode;
 	}
+}
 
-	return 0;
+/* Logs failure reported by stat_dir_entry() for the path. */
+static void
+log_stat_error(const char path[], int error)
+{
+	if(error > 0)
+	{
+		LOG_SERROR_MSG(error, "Can't lstat() \"%s\"", path);
+	}
+	else
+	{
+		LOG_ERROR_MSG("Can't determine type of \"%s\"", path);
+	}
 }
 
 /* Checks whether file is a directory.  Returns non-zero if so, otherwise zero
@@ -1069,6 +1251,15 @@ data_is_dir_entry(const struct dirent *d)
 	return is_dirent_targets_dir(d);
 }
 
+/* Checks whether filled entry is a directory or a symbolic link to one.
+ * Returns non-zero if so, otherwise zero is returned. */
+static int
+entry_targets_dir(const dir_entry_t *entry)
+{
+	return entry->type == FT_DIR
+	    || (entry->type == FT_LINK && S_ISDIR(entry->mode));
+}
+
 #else
 
 /* Fills directory entry with information about file specified by the path.
@@ -1096,6 +1287,7 @@ fill_dir_entry_by_path(dir_entry_t *entry, const char path[])
 	return 0;
 }
 
+
 /* Fills fields of the entry from *ffd fields for the file specified by its
  * path.  type_hint is additional source of file type.  Returns zero on success,
  * Returns zero on success, otherwise non-zero is returned. */
@@ -1117,7 +1309,7 @@ fill_dir_entry(dir_entry_t *entry, const char path[],
 	else if(ffd->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
 	{
 		/* Windows doesn't like returning size of directories when it can. */
-		entry->size = get_file_size(entry->name);
+		entry->size = get_file_size(path);
 		entry->type = FT_DIR;
 	}
 	else if(is_win_executable(path))
@@ -1132,6 +1324,27 @@ fill_dir_entry(dir_entry_t *entry, const char path[],
 	return 0;
 }
 
+/* Fills directory entry with information about file specified by the path
+ * using data obtained while listing its parent.  Leaves part of the work to
+ * complete_dir_entry(), so can be invoked on any thread.  Returns error code
+ * to be passed to complete_dir_entry(). */
+static int
+query_dir_entry_by_data(dir_entry_t *entry, const char path[],
+		const WIN32_FIND_DATAW *ffd, int resolve_link)
+{
+	return fill_dir_entry(entry, path, ffd);
+}
+
+/* Finishes filling of the entry on the main thread after
+ * query_dir_entry_by_data() has returned the error code.  Returns non-zero if
+ * the entry should be dropped, otherwise zero is returned. */
+static int
+complete_dir_entry(dir_entry_t *entry, const char path[], int error,
+		int resolve_link)
+{
+	return (error != 0);
+}
+
 /* Checks whether file is a directory.  Returns non-zero if so, otherwise zero
  * is returned. */
 static int
@@ -1140,6 +1353,14 @@ data_is_dir_entry(const WIN32_FIND_DATAW *ffd)
 	return (ffd->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
 }
 
+/* Checks whether filled entry is a directory or a symbolic link to one.
+ * Returns non-zero if so, otherwise zero is returned. */
+static int
+entry_targets_dir(const dir_entry_t *entry)
+{
+	return (entry->attrs & FILE_ATTRIBUTE_DIRECTORY) != 0;
+}
+
 #endif
 
 int
@@ -1217,6 +1438,10 @@ flist_custom_finish_internal(FileView *view, CVType type, int reload,
 	/* Kind of custom view must be set to correct value before option loading and
 	 * sorting. */
 	view->custom.type = type;
+	if(type != CV_TREE)
+	{
+		reset_tree_folds(view);
+	}
 
 	if(cv_unsorted(type))
 	{
@@ -1425,6 +1650,7 @@ flist_custom_clone(FileView *to, const FileView *from)
 	to->custom.type = (ui_view_unsorted(from) || from_tree)
 	                ? CV_VERY
 	                : CV_REGULAR;
+	reset_tree_folds(to);
 
 	if(custom_list_is_incomplete(from))
 	{
@@ -1722,6 +1948,8 @@ load_dir_list_internal(FileView *view, int reload, int draw_only)
 static int
 populate_dir_list_internal(FileView *view, int reload)
 {
+	int watch_error;
+
 	view->filtered = 0;
 
 	if(flist_custom_active(view))
@@ -1749,6 +1977,10 @@ populate_dir_list_internal(FileView *view, int reload)
 		return 1;
 	}
 
+	/* Drop events that happened before the directory is read, they are about
+	 * changes that are already visible in the list. */
+	watch_error = update_dir_watcher(view);
+
 	if(update_dir_list(view, reload) != 0)
 	{
 		/* We don't have read access, only execute, or there were other problems. */
@@ -1784,7 +2016,7 @@ populate_dir_list_internal(FileView *view, int reload)
 
 	fview_list_updated(view);
 
-	if(update_dir_watcher(view) != 0 && !is_unc_root(view->curr_dir))
+	if(watch_error != 0 && !is_unc_root(view->curr_dir))
 	{
 		LOG_SERROR_MSG(errno, "Can't get directory mtime \"%s\"", view->curr_dir);
 		return 1;
@@ -1954,9 +2186,11 @@ update_dir_watcher(FileView *view)
 	int error;
 	const char *const curr_dir = flist_get_dir(view);
 
-	if(view->watch == NULL || stroscmp(view->watched_dir, curr_dir) != 0)
+	if(view->watch == NULL || view->watching_tree ||
+			stroscmp(view->watched_dir, curr_dir) != 0)
 	{
 		fswatch_free(view->watch);
+		view->watching_tree = 0;
 
 		view->watch = fswatch_create(curr_dir);
 		if(view->watch == NULL)
@@ -1974,6 +2208,54 @@ update_dir_watcher(FileView *view)
 	return error;
 }
 
+/* Replaces directory watcher of the view with the one that monitors every
+ * directory of the tree, so that the tree needs not to be traversed to detect
+ * changes.  Falls back to watching only the root if that's not possible. */
+static void
+update_tree_watcher(FileView *view)
+{
+	int i;
+	int error;
+	const char *const root = flist_get_dir(view);
+
+	fswatch_free(view->watch);
+	view->watching_tree = 0;
+
+	view->watch = fswatch_create(root);
+	if(view->watch == NULL)
+	{
+		return;
+	}
+	copy_str(view->watched_dir, sizeof(view->watched_dir), root);
+
+	for(i = 0; i < view->list_rows; ++i)
+	{
+		const dir_entry_t *const entry = &view->dir_entry[i];
+		char full_path[PATH_MAX];
+
+		if(entry->type != FT_DIR || is_parent_dir(entry->name))
+		{
+			continue;
+		}
+
+		get_full_path_of(entry, sizeof(full_path), full_path);
+		if(fswatch_add(view->watch, full_path) != 0)
+		{
+			/* Don't keep partially set up watcher around, subdirectories will be
+			 * checked by polling. */
+			fswatch_free(view->watch);
+			view->watch = fswatch_create(root);
+			break;
+		}
+	}
+	view->watching_tree = (view->watch != NULL && i == view->list_rows);
+
+	if(view->watch != NULL)
+	{
+		(void)fswatch_changed(view->watch, &error);
+	}
+}
+
 /* Checks whether currently loaded custom list of files is missing some files
  * compared to the original custom list.  Returns non-zero if so, otherwise zero
  * is returned. */
@@ -2213,6 +2495,10 @@ update_dir_list(FileView *view, int reload)
 		return 1;
 	}
 
+#ifndef _WIN32
+	load_entries_metadata(view);
+#endif
+
 	if(cfg_parent_dir_is_visible(is_root_dir(view->curr_dir)) ||
 			view->list_rows == 0)
 	{
@@ -2295,6 +2581,12 @@ add_file_entry_to_view(const char name[], const void *data, void *param)
 
 	init_dir_entry(view, entry, name);
 
+#ifndef _WIN32
+	/* Metadata is queried for all entries at once after the listing, for now
+	 * remember type reported by the listing as a hint. */
+	entry->type = type_from_dir_entry(data);
+	++view->list_rows;
+#else
 	if(fill_dir_entry(entry, entry->name, data) == 0)
 	{
 		++view->list_rows;
@@ -2303,10 +2595,128 @@ add_file_entry_to_view(const char name[], const void *data, void *param)
 	{
 		free_dir_entry(view, entry);
 	}
+#endif
 
 	return 0;
 }
 
+#ifndef _WIN32
+
+/* Queries metadata of entries of the view which were just listed dropping
+ * those for which it fails.  Big lists are processed by several threads to
+ * hide latency of network file systems. */
+static void
+load_entries_metadata(FileView *view)
+{
+	const int n = view->list_rows;
+	const int resolve_links = is_null_or_empty(cfg.slow_fs_list);
+	int *const errors = malloc(sizeof(*errors)*MAX(n, 1));
+	tpool_t *pool = NULL;
+	stat_task_t *tasks = NULL;
+	int ntasks = 0;
+	int i, j;
+
+	if(errors == NULL)
+	{
+		/* Fallback to doing everything on this thread. */
+		j = 0;
+		for(i = 0; i < n; ++i)
+		{
+			dir_entry_t *const entry = &view->dir_entry[i];
+			char full_path[PATH_MAX];
+
+			get_full_path_of(entry, sizeof(full_path), full_path);
+			if(fill_dir_entry(entry, full_path, entry->type) != 0)
+			{
+				free_dir_entry(view, entry);
+				continue;
+			}
+			view->dir_entry[j++] = *entry;
+		}
+		view->list_rows = j;
+		return;
+	}
+
+	if(n >= PARALLEL_STAT_MIN)
+	{
+		ntasks = DIV_ROUND_UP(n, STAT_CHUNK_SIZE);
+		tasks = malloc(sizeof(*tasks)*ntasks);
+	}
+	if(tasks != NULL)
+	{
+		pool = tpool_alloc(MIN(ntasks, MAX_STAT_THREADS), ntasks);
+	}
+
+	if(pool == NULL)
+	{
+		stat_task_t task = {
+			.view = view, .from = 0, .to = n,
+			.resolve_links = resolve_links, .errors = errors,
+		};
+		stat_task(&task);
+	}
+	else
+	{
+		for(i = 0; i < ntasks; ++i)
+		{
+			tasks[i].view = view;
+			tasks[i].from = i*STAT_CHUNK_SIZE;
+			tasks[i].to = MIN(n, (i + 1)*STAT_CHUNK_SIZE);
+			tasks[i].resolve_links = resolve_links;
+			tasks[i].errors = errors;
+			if(tpool_push(pool, &stat_task, &tasks[i], -1) != 0)
+			{
+				stat_task(&tasks[i]);
+			}
+		}
+
+		/* This waits for all tasks to finish. */
+		tpool_free(pool);
+	}
+	free(tasks);
+
+	/* Report and drop failed entries and finish what can't be done on other
+	 * threads. */
+	j = 0;
+	for(i = 0; i < n; ++i)
+	{
+		dir_entry_t *const entry = &view->dir_entry[i];
+		char full_path[PATH_MAX];
+
+		get_full_path_of(entry, sizeof(full_path), full_path);
+		if(complete_dir_entry(entry, full_path, errors[i], resolve_links) != 0)
+		{
+			free_dir_entry(view, entry);
+			continue;
+		}
+		view->dir_entry[j++] = *entry;
+	}
+	view->list_rows = j;
+
+	free(errors);
+}
+
+/* Queries metadata of a range of view entries by their absolute paths storing
+ * results in task->errors.  Can be invoked on a thread other than the main one,
+ * so shouldn't modify anything except for the entries and their results. */
+static void
+stat_task(void *arg)
+{
+	const stat_task_t *const task = arg;
+	int i;
+	for(i = task->from; i < task->to; ++i)
+	{
+		dir_entry_t *const entry = &task->view->dir_entry[i];
+		char full_path[PATH_MAX];
+
+		get_full_path_of(entry, sizeof(full_path), full_path);
+		task->errors[i] = stat_dir_entry(entry, full_path, entry->type,
+				task->resolve_links);
+	}
+}
+
+#endif
+
 void
 resort_dir_list(int msg, FileView *view)
 {
@@ -2547,6 +2957,7 @@ init_dir_entry(FileView *view, dir_entry_t *entry, const char name[])
 	entry->search_match = 0;
 	entry->marked = 0;
 	entry->temporary = 0;
+	entry->folded = 0;
 
 	entry->tag = -1;
 	entry->id = -1;
@@ -2672,6 +3083,7 @@ void
 check_if_filelist_have_changed(FileView *view)
 {
 	int failed, changed;
+	fswatch_changes_t changes = { .complete = 0 };
 	const char *const curr_dir = flist_get_dir(view);
 
 	if(view->on_slow_fs ||
@@ -2691,7 +3103,7 @@ check_if_filelist_have_changed(FileView *view)
 	}
 	else
 	{
-		changed = fswatch_changed(view->watch, &failed);
+		changed = fswatch_poll(view->watch, &failed, &changes);
 	}
 
 	/* Check if we still have permission to visit this directory. */
@@ -2699,6 +3111,8 @@ check_if_filelist_have_changed(FileView *view)
 
 	if(failed)
 	{
+		fswatch_changes_free(&changes);
+
 		LOG_SERROR_MSG(errno, "Can't stat() \"%s\"", curr_dir);
 		log_cwd();
 
@@ -2713,78 +3127,306 @@ check_if_filelist_have_changed(FileView *view)
 
 	if(changed)
 	{
-		ui_view_schedule_reload(view);
+		if(update_changed_entries(view, &changes) != 0)
+		{
+			ui_view_schedule_reload(view);
+		}
 	}
-	else if(flist_custom_active(view) && view->custom.type == CV_TREE)
+	else if(flist_custom_active(view) && view->custom.type == CV_TREE &&
+			!view->watching_tree)
 	{
 		if(tree_has_changed(view->dir_entry, view->list_rows))
 		{
 			ui_view_schedule_reload(view);
 		}
 	}
+
+	fswatch_changes_free(&changes);
 }
 
-/* Checks whether tree-view needs a reload (any of subdirectories were changed).
- * Returns non-zero if so, otherwise zero is returned. */
+/* Updates only entries of a regular directory that were reported as changed
+ * instead of rereading whole directory.  Returns non-zero if the list must be
+ * reloaded instead, otherwise zero is returned. */
 static int
-tree_has_changed(const dir_entry_t *entries, size_t nchildren)
+update_changed_entries(FileView *view, const fswatch_changes_t *changes)
 {
-	size_t pos = 0U;
-	while(pos < nchildren)
-	{
-		const dir_entry_t *const entry = &entries[pos];
-		if(entry->type == FT_DIR && !is_parent_dir(entry->name))
-		{
-			char full_path[PATH_MAX];
-			struct stat s;
-
-			get_full_path_of(entry, sizeof(full_path), full_path);
-			if(os_stat(full_path, &s) != 0 || entry->mtime != s.st_mtime)
-			{
-				return 1;
-			}
-
-			if(tree_has_changed(entry + 1, entry->child_count))
-			{
-				return 1;
-			}
-		}
+	int i, j;
+	int pos;
+	int nentries;
+	int failed;
+	char curr_name[NAME_MAX];
+	trie_t *changed;
+	dir_entry_t *entries;
+	int *positions;
 
-		pos += entry->child_count + 1;
+	if(!changes->complete || flist_custom_active(view) ||
+			curr_stats.load_stage < 2 || !vle_mode_is(NORMAL_MODE) ||
+			view->local_filter.in_progress ||
+			!filter_is_empty(&view->local_filter.filter))
+	{
+		return 1;
 	}
-	return 0;
-}
 
-int
-cd_is_possible(const char *path)
-{
-	if(!is_valid_dir(path))
+	/* ".." might be displayed only because there are no other files. */
+	if(view->list_rows == 1 && is_parent_dir(view->dir_entry[0].name) &&
+			!cfg_parent_dir_is_visible(is_root_dir(view->curr_dir)))
 	{
-		LOG_SERROR_MSG(errno, "Can't access \"%s\"", path);
-
-		show_error_msgf("Destination doesn't exist", "\"%s\"", path);
-		return 0;
+		return 1;
 	}
-	else if(!directory_accessible(path))
-	{
-		LOG_SERROR_MSG(errno, "Can't access(, X_OK) \"%s\"", path);
 
-		show_error_msgf("Permission denied", "\"%s\"", path);
-		return 0;
-	}
-	else
+	/* This is needed for lstat() of entries. */
+	if(vifm_chdir(view->curr_dir) != 0)
 	{
 		return 1;
 	}
-}
-
-void
-load_saving_pos(FileView *view, int reload)
-{
-	char full_path[PATH_MAX];
 
-	if(curr_stats.load_stage < 2)
-		return;
+	changed = trie_create();
+	entries = reallocarray(NULL, changes->count + 1U, sizeof(*entries));
+	positions = reallocarray(NULL, changes->count + 1U, sizeof(*positions));
+	if(changed == NULL || entries == NULL || positions == NULL)
+	{
+		trie_free(changed);
+		free(entries);
+		free(positions);
+		return 1;
+	}
+
+	/* Index names of changed files to look them up while traversing the list.
+	 * Entries that aren't in the list are marked by NULL names. */
+	for(i = 0; i < changes->count; ++i)
+	{
+		entries[i].name = NULL;
+		if(trie_set(changed, changes->names[i], &entries[i]) < 0)
+		{
+			trie_free(changed);
+			free(entries);
+			free(positions);
+			return 1;
+		}
+	}
+
+	copy_str(curr_name, sizeof(curr_name), get_current_file_name(view));
+
+	/* Take entries of changed files out of the list in a single pass. */
+	j = 0;
+	for(i = 0; i < view->list_rows; ++i)
+	{
+		void *data;
+		if(!is_parent_dir(view->dir_entry[i].name) &&
+				trie_get(changed, view->dir_entry[i].name, &data) == 0)
+		{
+			*(dir_entry_t *)data = view->dir_entry[i];
+			continue;
+		}
+		view->dir_entry[j++] = view->dir_entry[i];
+	}
+	view->list_rows = j;
+	trie_free(changed);
+
+	/* Update the entries and pack those that are to be inserted back. */
+	failed = 0;
+	nentries = 0;
+	for(i = 0; i < changes->count; ++i)
+	{
+		switch(update_changed_entry(view, changes->names[i], changes->created[i],
+					&entries[i]))
+		{
+			case 0:
+				break;
+			case 1:
+				entries[nentries++] = entries[i];
+				break;
+
+			default:
+				failed = 1;
+				break;
+		}
+	}
+
+	/* Positions found by binary search in the rest of the list don't decrease
+	 * for entries sorted in the same way. */
+	sort_entries(view, entries, nentries);
+	for(i = 0; i < nentries; ++i)
+	{
+		positions[i] = sort_find_position(view, &entries[i]);
+		if(i > 0 && positions[i] < positions[i - 1])
+		{
+			positions[i] = positions[i - 1];
+		}
+	}
+
+	if(nentries != 0)
+	{
+		dir_entry_t *const list = dynarray_extend(view->dir_entry,
+				nentries*sizeof(*view->dir_entry));
+		if(list == NULL)
+		{
+			for(i = 0; i < nentries; ++i)
+			{
+				free_dir_entry(view, &entries[i]);
+			}
+			nentries = 0;
+			failed = 1;
+		}
+		else
+		{
+			view->dir_entry = list;
+		}
+	}
+
+	/* Merge the entries in starting from the end, so that each of the old ones
+	 * is moved only once. */
+	j = view->list_rows;
+	for(i = nentries - 1; i >= 0; --i)
+	{
+		pos = positions[i];
+		memmove(&view->dir_entry[pos + i + 1], &view->dir_entry[pos],
+				sizeof(*view->dir_entry)*(j - pos));
+		view->dir_entry[pos + i] = entries[i];
+		j = pos;
+	}
+	view->list_rows += nentries;
+
+	free(entries);
+	free(positions);
+
+	if(failed || view->list_rows == 0)
+	{
+		return 1;
+	}
+
+	pos = flist_find_entry(view, curr_name, view->curr_dir);
+	view->list_pos = (pos >= 0) ? pos : MIN(view->list_pos, view->list_rows - 1);
+
+	view->column_count = calculate_columns_count(view);
+	fview_list_updated(view);
+	ui_view_schedule_redraw(view);
+	return 0;
+}
+
+/* Rereads information about single file of the view.  created specifies
+ * whether the file didn't exist when the list was loaded.  *entry is the entry
+ * taken out of the list or has NULL name if the file wasn't listed.  Returns
+ * positive number if the entry should be inserted back into the list, zero if
+ * it should be dropped (it's freed then) and negative number on error. */
+static int
+update_changed_entry(FileView *view, const char name[], int created,
+		dir_entry_t *entry)
+{
+	struct stat s;
+	FileType prev_type;
+	int exists, visible;
+	const int listed = (entry->name != NULL);
+
+	if(strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+	{
+		return 0;
+	}
+
+	/* Current directory is the one of the view, so names are valid paths. */
+	exists = (os_lstat(name, &s) == 0);
+	visible = exists && file_is_visible(view, name, is_dir(name), NULL, 1);
+
+	/* Files that existed, but aren't in the list, were counted as filtered. */
+	view->filtered += (exists && !visible) - (!created && !listed);
+	if(view->filtered < 0)
+	{
+		view->filtered = 0;
+	}
+
+	if(!listed)
+	{
+		if(!visible)
+		{
+			return 0;
+		}
+
+		init_dir_entry(view, entry, name);
+		if(entry->name == NULL)
+		{
+			return -1;
+		}
+	}
+
+	prev_type = entry->type;
+	if(!visible || fill_dir_entry_by_path(entry, entry->name) != 0)
+	{
+		view->selected_files -= entry->selected;
+		view->matches -= (entry->search_match != 0);
+		free_dir_entry(view, entry);
+		return 0;
+	}
+
+	if(entry->type != prev_type)
+	{
+		entry->hi_num = -1;
+		entry->name_dec_num = -1;
+	}
+
+	return 1;
+}
+
+/* Checks whether tree-view needs a reload (any of subdirectories were changed).
+ * Returns non-zero if so, otherwise zero is returned. */
+static int
+tree_has_changed(const dir_entry_t *entries, size_t nchildren)
+{
+	size_t pos = 0U;
+	while(pos < nchildren)
+	{
+		const dir_entry_t *const entry = &entries[pos];
+		if(entry->type == FT_DIR && !is_parent_dir(entry->name))
+		{
+			char full_path[PATH_MAX];
+			struct stat s;
+
+			get_full_path_of(entry, sizeof(full_path), full_path);
+			if(os_stat(full_path, &s) != 0 || entry->mtime != s.st_mtime)
+			{
+				return 1;
+			}
+
+			if(tree_has_changed(entry + 1, entry->child_count))
+			{
+				return 1;
+			}
+		}
+
+		pos += entry->child_count + 1;
+	}
+	return 0;
+}
+
+int
+cd_is_possible(const char *path)
+{
+	if(!is_valid_dir(path))
+	{
+		LOG_SERROR_MSG(errno, "Can't access \"%s\"", path);
+
+		show_error_msgf("Destination doesn't exist", "\"%s\"", path);
+		return 0;
+	}
+	else if(!directory_accessible(path))
+	{
+		LOG_SERROR_MSG(errno, "Can't access(, X_OK) \"%s\"", path);
+
+		show_error_msgf("Permission denied", "\"%s\"", path);
+		return 0;
+	}
+	else
+	{
+		return 1;
+	}
+}
+
+void
+load_saving_pos(FileView *view, int reload)
+{
+	char full_path[PATH_MAX];
+
+	if(curr_stats.load_stage < 2)
+		return;
 
 	if(!window_shows_dirlist(view))
 		return;
@@ -3389,11 +4031,28 @@ fentry_is_valid(const dir_entry_t *entry)
 int
 flist_load_tree(FileView *view, const char path[])
 {
+	return flist_load_tree_lazily(view, path, 0);
+}
+
+int
+flist_load_tree_lazily(FileView *view, const char path[], int depth)
+{
+	trie_t *const folded_paths = view->custom.folded_paths;
+	const int tree_depth = view->custom.tree_depth;
+
+	view->custom.folded_paths = trie_create();
+	view->custom.tree_depth = depth;
+
 	if(flist_load_tree_internal(view, path, 0) != 0)
 	{
+		/* Previous tree might still be displayed. */
+		trie_free(view->custom.folded_paths);
+		view->custom.folded_paths = folded_paths;
+		view->custom.tree_depth = tree_depth;
 		return 1;
 	}
 
+	trie_free(folded_paths);
 	ui_view_schedule_redraw(view);
 	return 0;
 }
@@ -3401,16 +4060,82 @@ flist_load_tree(FileView *view, const char path[])
 int
 flist_clone_tree(FileView *to, const FileView *from)
 {
+	trie_t *const folded_paths = to->custom.folded_paths;
+	const int tree_depth = to->custom.tree_depth;
+
+	to->custom.folded_paths = trie_clone(from->custom.folded_paths);
+	to->custom.tree_depth = from->custom.tree_depth;
+
 	if(make_tree(to, flist_get_dir(from), 0, from->custom.excluded_paths) != 0)
 	{
+		trie_free(to->custom.folded_paths);
+		to->custom.folded_paths = folded_paths;
+		to->custom.tree_depth = tree_depth;
 		return 1;
 	}
 
+	trie_free(folded_paths);
 	trie_free(to->custom.excluded_paths);
 	to->custom.excluded_paths = trie_clone(from->custom.excluded_paths);
 	return 0;
 }
 
+int
+flist_toggle_fold(FileView *view, int pos)
+{
+	char full_path[PATH_MAX];
+	dir_entry_t *const entry = &view->dir_entry[pos];
+	const int fold = !entry->folded;
+
+	if(!flist_custom_active(view) || view->custom.type != CV_TREE ||
+			entry->type != FT_DIR || is_parent_dir(entry->name))
+	{
+		return 1;
+	}
+
+	if(view->custom.folded_paths == NULL)
+	{
+		view->custom.folded_paths = trie_create();
+	}
+
+	get_full_path_of(entry, sizeof(full_path), full_path);
+	if(trie_set(view->custom.folded_paths, full_path,
+				fold ? &folded_mark : NULL) < 0)
+	{
+		return 1;
+	}
+
+	/* Local filter can hide directories and attach their files to other nodes,
+	 * so let reloading take care of it. */
+	if(!filter_is_empty(&view->local_filter.filter))
+	{
+		ui_view_schedule_reload(view);
+		return 0;
+	}
+
+	if(fold)
+	{
+		fold_tree_dir(view, pos);
+	}
+	else if(unfold_tree_dir(view, pos) != 0)
+	{
+		return 1;
+	}
+
+	ui_view_schedule_redraw(view);
+	return 0;
+}
+
+/* Forgets which directories of tree-view were folded or unfolded, so that this
+ * state doesn't outlive the tree. */
+static void
+reset_tree_folds(FileView *view)
+{
+	trie_free(view->custom.folded_paths);
+	view->custom.folded_paths = NULL;
+	view->custom.tree_depth = 0;
+}
+
 /* Implements tree view (re)loading.  Returns zero on success, otherwise
  * non-zero is returned. */
 static int
@@ -3443,9 +4168,12 @@ make_tree(FileView *view, const char path[], int reload, trie_t *excluded_paths)
 
 	show_progress("Building tree...", 0);
 
+	to_canonic_path(path, flist_get_dir(view), canonic_path,
+			sizeof(canonic_path));
+
 	ui_cancellation_reset();
 	ui_cancellation_enable();
-	nfiltered = add_files_recursively(view, path, excluded_paths, -1, 0);
+	nfiltered = list_tree(view, canonic_path, excluded_paths, 0);
 	ui_cancellation_disable();
 
 	ui_sb_quick_msg_clear();
@@ -3461,9 +4189,6 @@ make_tree(FileView *view, const char path[], int reload, trie_t *excluded_paths)
 		return 1;
 	}
 
-	to_canonic_path(path, flist_get_dir(view), canonic_path,
-			sizeof(canonic_path));
-
 	if(flist_custom_finish_internal(view, CV_TREE, reload, canonic_path, 1) != 0)
 	{
 		return 1;
@@ -3472,104 +4197,330 @@ make_tree(FileView *view, const char path[], int reload, trie_t *excluded_paths)
 
 	replace_string(&view->custom.orig_dir, canonic_path);
 
+	update_tree_watcher(view);
+
 	return 0;
 }
 
-/* Adds custom view entries corresponding to file system tree.  parent_pos is
- * expected to be negative for the outermost invocation.  Returns number of
+/* Lists file system tree at path in parallel and adds corresponding custom view
+ * entries.  Level is nesting level of entries of the path.  Returns number of
  * filtered out files on success or partial success and negative value on
  * serious error. */
 static int
-add_files_recursively(FileView *view, const char path[], trie_t *excluded_paths,
-		int parent_pos, int no_direct_parent)
+list_tree(FileView *view, const char path[], trie_t *excluded_paths,
+		int level)
+{
+	tree_build_t build = {
+		.view = view,
+		.excluded_paths = excluded_paths,
+		.resolve_links = is_null_or_empty(cfg.slow_fs_list),
+	};
+	tree_dir_t *root;
+	int nfiltered;
+
+	pthread_mutex_init(&build.lock, NULL);
+	pthread_cond_init(&build.dir_done, NULL);
+	build.pool = tpool_alloc(TREE_THREADS, TREE_QUEUE);
+
+	root = start_tree_dir(&build, path, 0, level);
+	while(build.pending != 0)
+	{
+		tree_dir_t *dir = take_listed_dirs(&build, 100);
+		if(dir == NULL)
+		{
+			show_progress("Building tree...", 1);
+		}
+
+		while(dir != NULL)
+		{
+			tree_dir_t *const next = dir->next;
+			--build.pending;
+			process_tree_dir(&build, dir);
+			dir = next;
+		}
+	}
+
+	tpool_free(build.pool);
+	pthread_cond_destroy(&build.dir_done);
+	pthread_mutex_destroy(&build.lock);
+
+	/* Entries are added only after all directories are listed, because tasks
+	 * finish in arbitrary order, while children must follow their parents. */
+	nfiltered = add_tree_dir(view, root, -1);
+	free_tree_dir(view, root);
+	return nfiltered;
+}
+
+/* Creates a directory of a tree and lists it on a pool thread if possible or on
+ * the current thread otherwise.  Must be invoked on the main thread.  Returns
+ * the directory or NULL on error. */
+static tree_dir_t *
+start_tree_dir(tree_build_t *build, const char path[], int no_direct_parent,
+		int level)
+{
+	tree_dir_t *const dir = calloc(1, sizeof(*dir));
+	if(dir == NULL)
+	{
+		return NULL;
+	}
+
+	dir->path = strdup(path);
+	if(dir->path == NULL)
+	{
+		free(dir);
+		return NULL;
+	}
+
+	dir->build = build;
+	dir->no_direct_parent = no_direct_parent;
+	dir->level = level;
+
+	++build->pending;
+
+	/* Don't block on full queue, main thread needs to keep processing listed
+	 * directories for the queue to move. */
+	if(build->pool == NULL ||
+			tpool_push(build->pool, &tree_dir_task, dir, 0) != 0)
+	{
+		tree_dir_task(dir);
+	}
+
+	return dir;
+}
+
+/* Lists a directory of a tree and passes it to the main thread.  Can be invoked
+ * on a thread other than the main one, so shouldn't modify anything except for
+ * the directory. */
+static void
+tree_dir_task(void *arg)
+{
+	tree_dir_t *const dir = arg;
+	tree_build_t *const build = dir->build;
+
+	if(enum_dir_content(dir->path, &add_tree_item, dir) != 0 ||
+			ui_cancellation_requested())
+	{
+		dir->failed = 1;
+	}
+
+	pthread_mutex_lock(&build->lock);
+	dir->next = build->listed;
+	build->listed = dir;
+	pthread_cond_signal(&build->dir_done);
+	pthread_mutex_unlock(&build->lock);
+}
+
+/* enum_dir_content() callback that adds file to a directory of a tree along
+ * with its metadata.  Can be invoked on any thread, the rest is done by
+ * process_tree_dir().  Returns zero on success or non-zero to indicate failure
+ * and stop enumeration. */
+static int
+add_tree_item(const char name[], const void *data, void *param)
 {
-	int i;
-	const int prev_count = view->custom.entry_count;
-	int nfiltered = 0;
+	tree_dir_t *const dir = param;
+	tree_build_t *const build = dir->build;
+	char full_path[PATH_MAX];
+	tree_item_t *item;
 
-	int len;
-	char **lst = list_all_files(path, &len);
-	if(len < 0)
+	/* Cancellation request is only read, so this is fine to do on any
+	 * thread. */
+	if(ui_cancellation_requested())
 	{
-		return -1;
+		return 1;
+	}
+
+	if(strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+	{
+		return 0;
+	}
+
+	item = dynarray_extend(dir->items, sizeof(*item));
+	if(item == NULL)
+	{
+		return 1;
 	}
+	dir->items = item;
+	item = &dir->items[dir->nitems];
 
-	for(i = 0; i < len && !ui_cancellation_requested(); ++i)
+	init_dir_entry(build->view, &item->entry, name);
+	item->entry.origin = strdup(dir->path);
+	if(item->entry.name == NULL || item->entry.origin == NULL)
 	{
-		int dir;
+		/* Keep going in case of error and load partial list. */
+		free_dir_entry(build->view, &item->entry);
+		return 0;
+	}
+
+	get_full_path_of(&item->entry, sizeof(full_path), full_path);
+	item->error = query_dir_entry_by_data(&item->entry, full_path, data,
+			build->resolve_links);
+	item->dir = NULL;
+
+	++dir->nitems;
+	return 0;
+}
+
+/* Waits for at most timeout_ms milliseconds for directories to be listed.
+ * Returns list of listed directories linked via their next field or NULL. */
+static tree_dir_t *
+take_listed_dirs(tree_build_t *build, int timeout_ms)
+{
+	tree_dir_t *listed;
+
+	pthread_mutex_lock(&build->lock);
+	if(build->listed == NULL)
+	{
+		struct timespec deadline;
+		tpool_deadline(timeout_ms, &deadline);
+
+		(void)pthread_cond_timedwait(&build->dir_done, &build->lock, &deadline);
+	}
+	listed = build->listed;
+	build->listed = NULL;
+	pthread_mutex_unlock(&build->lock);
+
+	return listed;
+}
+
+/* Filters items of a listed directory of a tree and starts listing of its
+ * subdirectories.  Must be invoked on the main thread. */
+static void
+process_tree_dir(tree_build_t *build, tree_dir_t *dir)
+{
+	FileView *const view = build->view;
+	int i, j;
+
+	j = 0;
+	for(i = 0; i < dir->nitems; ++i)
+	{
+		tree_item_t *const item = &dir->items[i];
+		dir_entry_t *const entry = &item->entry;
+		char full_path[PATH_MAX];
 		void *dummy;
-		dir_entry_t *entry;
-		char *const full_path = format_str("%s/%s", path, lst[i]);
+		int is_dir;
 
-		if(trie_get(excluded_paths, full_path, &dummy) == 0)
+		get_full_path_of(entry, sizeof(full_path), full_path);
+
+		if(dir->failed || trie_get(build->excluded_paths, full_path, &dummy) == 0 ||
+				complete_dir_entry(entry, full_path, item->error,
+					build->resolve_links) != 0)
 		{
-			free(full_path);
+			free_dir_entry(view, entry);
 			continue;
 		}
 
-		dir = is_dir(full_path);
-		if(!file_is_visible(view, lst[i], dir, NULL, 1))
+		is_dir = entry_targets_dir(entry);
+		if(!file_is_visible(view, entry->name, is_dir, NULL, 1))
 		{
+			++dir->nfiltered;
+
 			/* Traverse directory (but not symlink to it) even if we're skipping it,
 			 * because we might need files that are inside of it. */
-			if(dir && !is_symlink(full_path) &&
-					file_is_visible(view, lst[i], dir, NULL, 0))
+			if(entry->type == FT_DIR &&
+					file_is_visible(view, entry->name, is_dir, NULL, 0) &&
+					!is_dir_folded(view, full_path, dir->level))
+			{
+				free_dir_entry(view, entry);
+				item->dir = start_tree_dir(build, full_path, 1, dir->level);
+				dir->items[j++] = *item;
+				continue;
+			}
+
+			free_dir_entry(view, entry);
+			continue;
+		}
+
+		/* Not checking is_dir here, because it's set for symlinks to directories
+		 * as well. */
+		if(entry->type == FT_DIR)
+		{
+			if(is_dir_folded(view, full_path, dir->level))
+			{
+				entry->folded = 1;
+			}
+			else
 			{
-				nfiltered += add_files_recursively(view, full_path, excluded_paths,
-						parent_pos, 1);
+				item->dir = start_tree_dir(build, full_path, 0, dir->level + 1);
 			}
+		}
+
+		dir->items[j++] = *item;
+	}
+	dir->nitems = j;
+}
+
+/* Adds custom view entries corresponding to a listed directory of a tree.
+ * parent_pos is expected to be negative for the outermost invocation.  Returns
+ * number of filtered out files on success or partial success and negative value
+ * on serious error. */
+static int
+add_tree_dir(FileView *view, tree_dir_t *dir, int parent_pos)
+{
+	int i;
+	int nfiltered;
+	const int prev_count = view->custom.entry_count;
+
+	if(dir == NULL || dir->failed)
+	{
+		return -1;
+	}
 
-			free(full_path);
-			++nfiltered;
+	nfiltered = dir->nfiltered;
+	for(i = 0; i < dir->nitems; ++i)
+	{
+		tree_item_t *const item = &dir->items[i];
+		dir_entry_t *entry;
+		int idx;
+		int filtered;
+
+		if(item->entry.name == NULL)
+		{
+			/* Contents of hidden directory are attached to the closest visible
+			 * parent. */
+			filtered = add_tree_dir(view, item->dir, parent_pos);
+			nfiltered += MAX(filtered, 0);
 			continue;
 		}
 
-		entry = flist_custom_add(view, full_path);
+		entry = alloc_dir_entry(&view->custom.entries, view->custom.entry_count);
 		if(entry == NULL)
 		{
-			free(full_path);
-			free_string_array(lst, len);
 			return -1;
 		}
 
+		/* Move the entry into the view. */
+		*entry = item->entry;
+		item->entry.name = NULL;
+
+		idx = view->custom.entry_count++;
 		if(parent_pos >= 0)
 		{
-			entry->child_pos = (view->custom.entry_count - 1) - parent_pos;
+			entry->child_pos = idx - parent_pos;
 		}
 
-		/* Not using dir variable here, because it is set for symlinks to
-		 * directories as well. */
-		if(entry->type == FT_DIR)
+		if(item->dir == NULL)
 		{
-			const int idx = view->custom.entry_count - 1;
-			const int filtered = add_files_recursively(view, full_path,
-					excluded_paths, idx, 0);
-			/* Keep going in case of error and load partial list. */
-			if(filtered >= 0)
-			{
-				/* If one of recursive calls returned error, keep going and build
-				 * partial tree. */
-				view->custom.entries[idx].child_count = (view->custom.entry_count - 1)
-				                                      - idx;
-				nfiltered += filtered;
-			}
+			continue;
 		}
 
-		free(full_path);
-
-		show_progress("Building tree...", 10000);
+		filtered = add_tree_dir(view, item->dir, idx);
+		/* Keep going in case of error and load partial list. */
+		if(filtered >= 0)
+		{
+			view->custom.entries[idx].child_count = (view->custom.entry_count - 1)
+			                                      - idx;
+			nfiltered += filtered;
+		}
 	}
 
-	free_string_array(lst, len);
-
 	/* The prev_count != 0 check is to make sure that we won't create leaf instead
 	 * of the whole tree (this is handled in flist_custom_finish()). */
-	if(!no_direct_parent && prev_count != 0 &&
+	if(!dir->no_direct_parent && prev_count != 0 &&
 			view->custom.entry_count == prev_count)
 	{
 		/* To be able to perform operations inside directory (e.g., create files),
 		 * we need at least one element there. */
-		if(add_directory_leaf(view, path, parent_pos) != 0)
+		if(add_directory_leaf(view, dir->path, parent_pos) != 0)
 		{
 			return -1;
 		}
@@ -3578,6 +4529,214 @@ add_files_recursively(FileView *view, const char path[], trie_t *excluded_paths,
 	return nfiltered;
 }
 
+/* Frees directory of a tree along with its entries that weren't moved to the
+ * view and all nested directories.  dir can be NULL. */
+static void
+free_tree_dir(FileView *view, tree_dir_t *dir)
+{
+	int i;
+
+	if(dir == NULL)
+	{
+		return;
+	}
+
+	for(i = 0; i < dir->nitems; ++i)
+	{
+		if(dir->items[i].entry.name != NULL)
+		{
+			free_dir_entry(view, &dir->items[i].entry);
+		}
+		free_tree_dir(view, dir->items[i].dir);
+	}
+
+	dynarray_free(dir->items);
+	free(dir->path);
+	free(dir);
+}
+
+/* Checks whether directory of a tree should be left unlisted.  Level is nesting
+ * level of the directory itself.  Can be invoked on any thread.  Returns
+ * non-zero if so, otherwise zero is returned. */
+static int
+is_dir_folded(FileView *view, const char path[], int level)
+{
+	void *data;
+	if(trie_get(view->custom.folded_paths, path, &data) == 0)
+	{
+		return (data != NULL);
+	}
+	return (view->custom.tree_depth != 0 && level + 1 >= view->custom.tree_depth);
+}
+
+/* Removes children of directory node of a tree at specified position.  Files
+ * that were filtered out inside of it are still counted until next reload. */
+static void
+fold_tree_dir(FileView *view, int pos)
+{
+	int i;
+	dir_entry_t *const entries = view->dir_entry;
+	const int nchildren = entries[pos].child_count;
+	const int tail = pos + 1 + nchildren;
+
+	for(i = pos + 1; i < tail; ++i)
+	{
+		view->matches -= (entries[i].search_match != 0);
+		free_dir_entry(view, &entries[i]);
+	}
+
+	memmove(&entries[pos + 1], &entries[tail],
+			(view->list_rows - tail)*sizeof(*entries));
+	view->list_rows -= nchildren;
+
+	entries[pos].folded = 1;
+	update_tree_links(view, pos, -nchildren);
+
+	if(view->list_pos >= tail)
+	{
+		view->list_pos -= nchildren;
+	}
+	else if(view->list_pos > pos)
+	{
+		view->list_pos = pos;
+	}
+
+	flist_sel_recount(view);
+}
+
+/* Lists directory node of a tree at specified position and inserts its contents
+ * right after it.  Returns zero on success, otherwise non-zero is returned. */
+static int
+unfold_tree_dir(FileView *view, int pos)
+{
+	char full_path[PATH_MAX];
+	dir_entry_t *entries;
+	int failed;
+	int n;
+	int i;
+
+	get_full_path_at(view, pos, sizeof(full_path), full_path);
+
+	/* New entries are collected where custom view is normally composed, which is
+	 * unused after the tree is built. */
+	show_progress("Building tree...", 0);
+	ui_cancellation_reset();
+	ui_cancellation_enable();
+	failed = (list_tree(view, full_path, view->custom.excluded_paths,
+				get_tree_level(view, pos) + 1) < 0);
+	ui_cancellation_disable();
+	ui_sb_quick_msg_clear();
+
+	failed |= ui_cancellation_requested();
+	if(!failed && view->custom.entry_count == 0)
+	{
+		failed = (add_directory_leaf(view, full_path, -1) != 0);
+	}
+
+	n = view->custom.entry_count;
+	entries = failed
+	        ? NULL
+	        : dynarray_extend(view->dir_entry, n*sizeof(*entries));
+	if(entries == NULL)
+	{
+		free_dir_entries(view, &view->custom.entries, &view->custom.entry_count);
+		return 1;
+	}
+	view->dir_entry = entries;
+
+	memmove(&entries[pos + 1 + n], &entries[pos + 1],
+			(view->list_rows - (pos + 1))*sizeof(*entries));
+	memcpy(&entries[pos + 1], view->custom.entries, n*sizeof(*entries));
+	for(i = pos + 1; i <= pos + n; ++i)
+	{
+		if(entries[i].child_pos == 0)
+		{
+			entries[i].child_pos = i - pos;
+		}
+	}
+	dynarray_free(view->custom.entries);
+	view->custom.entries = NULL;
+	view->custom.entry_count = 0;
+	view->list_rows += n;
+
+	entries[pos].folded = 0;
+	update_tree_links(view, pos, n);
+
+	if(view->list_pos > pos)
+	{
+		view->list_pos += n;
+	}
+
+	/* The whole tree is sorted, but only the new slice is actually reordered, so
+	 * the node stays where it was. */
+	resort_dir_list(0, view);
+
+	if(view->watching_tree)
+	{
+		for(i = pos + 1; i <= pos + n; ++i)
+		{
+			const dir_entry_t *const entry = &view->dir_entry[i];
+			char path[PATH_MAX];
+
+			if(entry->type != FT_DIR || is_parent_dir(entry->name))
+			{
+				continue;
+			}
+
+			get_full_path_of(entry, sizeof(path), path);
+			if(fswatch_add(view->watch, path) != 0)
+			{
+				update_tree_watcher(view);
+				break;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/* Computes nesting level of a tree node at specified position.  Returns the
+ * level, which is zero for top-level nodes. */
+static int
+get_tree_level(const FileView *view, int pos)
+{
+	int level = 0;
+	const dir_entry_t *entry = &view->dir_entry[pos];
+	while(entry->child_pos != 0)
+	{
+		entry -= entry->child_pos;
+		++level;
+	}
+	return level;
+}
+
+/* Updates number of children and parent links of tree nodes after delta
+ * entries were added (positive) or removed (negative) as children of the node
+ * at specified position. */
+static void
+update_tree_links(FileView *view, int pos, int delta)
+{
+	dir_entry_t *const entries = view->dir_entry;
+	int parent = pos;
+	int i;
+
+	entries[pos].child_count += delta;
+	while(entries[parent].child_pos != 0)
+	{
+		parent -= entries[parent].child_pos;
+		entries[parent].child_count += delta;
+	}
+
+	/* Only links that cross the node point over changed entries. */
+	for(i = pos + 1 + entries[pos].child_count; i < view->list_rows; ++i)
+	{
+		if(entries[i].child_pos != 0 && (i - delta) - entries[i].child_pos <= pos)
+		{
+			entries[i].child_pos += delta;
+		}
+	}
+}
+
 /* Checks whether file is visible according to dot and filename filters.  is_dir
  * is used when data is NULL, otherwise data_is_dir_entry() called (this is an
  * optimization).  Returns non-zero if so, otherwise zero is returned. */
@@ -294,9 +294,16 @@ int fentry_is_valid(const dir_entry_t *entry);
 /* Loads directory tree specified by its path into the view.  Considers various
  * filters.  Returns zero on success, otherwise non-zero is returned. */
 int flist_load_tree(FileView *view, const char path[]);
+/* Same as flist_load_tree(), but directories deeper than depth levels are
+ * folded and aren't listed until they are unfolded.  Zero depth means no limit.
+ * Returns zero on success, otherwise non-zero is returned. */
+int flist_load_tree_lazily(FileView *view, const char path[], int depth);
 /* Makes to contain tree with the same root as from including copying list of
  * excluded files.  Returns zero on success, otherwise non-zero is returned. */
 int flist_clone_tree(FileView *to, const FileView *from);
+/* Folds or unfolds directory of a tree view at specified position, listing it
+ * if necessary.  Returns zero on success, otherwise non-zero is returned. */
+int flist_toggle_fold(FileView *view, int pos);
 
 TSTATIC_DEFS(
 	TSTATIC void pick_cd_path(FileView *view, const char base_dir[],
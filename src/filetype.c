@@ -91,6 +91,20 @@ ft_get_viewer(const char file[])
 	return find_existing_cmd(&fileviewers, file);
 }
 
+int
+ft_viewers_need_contents(void)
+{
+	int i;
+	for(i = 0; i < fileviewers.count; ++i)
+	{
+		if(!matchers_match_names_only(fileviewers.list[i].matchers))
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
 /* Finds first existing command which pattern matches given file.  Returns the
  * command (it's lifetime is managed by this unit) or NULL on failure. */
 static const char *
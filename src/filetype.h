@@ -109,6 +109,10 @@ const char * ft_get_viewer(const char file[]);
  * Caller should free the result by calling ft_assoc_records_free() on it. */
 assoc_records_t ft_get_all_viewers(const char file[]);
 
+/* Checks whether picking a viewer might require examining contents of files
+ * (their mime types).  Returns non-zero if so, otherwise zero is returned. */
+int ft_viewers_need_contents(void);
+
 /* Associates list of comma separated patterns with each item in the list of
  * comma separated viewers. */
 void ft_set_viewers(struct matchers_t *matchers, const char viewers[]);
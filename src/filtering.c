@@ -20,21 +20,46 @@
 #include "filtering.h"
 
 #include <assert.h> /* assert() */
-#include <string.h> /* strdup() */
+#include <regex.h> /* REG_ICASE */
+#include <stddef.h> /* NULL size_t */
+#include <stdlib.h> /* free() malloc() */
+#include <string.h> /* strcspn() strdup() */
 
 #include "cfg/config.h"
 #include "compat/reallocarray.h"
 #include "ui/ui.h"
 #include "utils/dynarray.h"
+#include "utils/macros.h"
 #include "utils/path.h"
 #include "utils/regexp.h"
 #include "utils/str.h"
+#include "utils/tpool.h"
 #include "utils/utils.h"
 #include "filelist.h"
 #include "flist_pos.h"
 #include "flist_sel.h"
 #include "opt_handlers.h"
 
+/* Minimal number of entries to match against local filter in parallel. */
+#define PARALLEL_FILTER_MIN 8192
+
+/* Maximum number of threads matching entries against local filter. */
+#define MAX_FILTER_THREADS 8
+
+/* Task of matching a range of entries against local filter. */
+typedef struct
+{
+	FileView *view;        /* View whose unfiltered entries are matched. */
+	filter_t *filter;      /* Filter to match against. */
+	filter_t copy;         /* Copy of local filter used by this task only. */
+	int has_copy;          /* Whether copy field is initialized. */
+	const int *positions;  /* Positions of entries or NULL for all of them. */
+	char *matches;         /* Results of matching. */
+	size_t from;           /* Index of the first entry to process. */
+	size_t to;             /* Index past the last entry to process. */
+}
+filter_task_t;
+
 static void reset_filter(filter_t *filter);
 static int is_newly_filtered(FileView *view, const dir_entry_t *entry,
 		void *arg);
@@ -44,7 +69,13 @@ static int get_unfiltered_pos(const FileView *const view, int pos);
 static int load_unfiltered_list(FileView *const view);
 static int list_is_incomplete(FileView *const view);
 static void store_local_filter_position(FileView *const view, int pos);
+static int narrows_local_filter(const filter_t *filter, const char value[]);
+static void drop_filter_candidates(FileView *view);
 static int update_filtering_lists(FileView *view, int add, int clear);
+static char * match_unfiltered(FileView *view, const int positions[],
+		size_t count);
+static void filter_task(void *arg);
+static int matches_local_filter(filter_t *filter, const dir_entry_t *entry);
 static void reparent_tree_node(dir_entry_t *original, dir_entry_t *filtered);
 static void ensure_filtered_list_not_empty(FileView *view,
 		dir_entry_t *parent_entry);
@@ -71,6 +102,8 @@ filters_view_reset(FileView *view)
 	view->local_filter.saved = NULL;
 	view->local_filter.poshist = NULL;
 	view->local_filter.poshist_len = 0U;
+	view->local_filter.candidates = NULL;
+	view->local_filter.candidate_count = 0U;
 }
 
 /* Resets filter to empty state (either initializes or clears it). */
@@ -364,6 +397,8 @@ int
 local_filter_set(FileView *view, const char filter[])
 {
 	int result;
+	const int narrows = view->local_filter.in_progress
+	                 && narrows_local_filter(&view->local_filter.filter, filter);
 	const int current_file_pos = view->local_filter.in_progress
 	                           ? get_unfiltered_pos(view, view->list_pos)
 	                           : load_unfiltered_list(view);
@@ -373,6 +408,11 @@ local_filter_set(FileView *view, const char filter[])
 		store_local_filter_position(view, current_file_pos);
 	}
 
+	if(!narrows)
+	{
+		drop_filter_candidates(view);
+	}
+
 	result = (filter_change(&view->local_filter.filter, filter,
 			!regexp_should_ignore_case(filter)) ? -1 : 0);
 
@@ -383,6 +423,33 @@ local_filter_set(FileView *view, const char filter[])
 	return result;
 }
 
+/* Checks whether everything matched by the new value of the filter is also
+ * matched by its current value, which is the case when a literal pattern is
+ * being typed in.  Returns non-zero if so, otherwise zero is returned. */
+static int
+narrows_local_filter(const filter_t *filter, const char value[])
+{
+	/* Characters that make a pattern something more than a substring. */
+	static const char REGEX_CHARS[] = "\\^$.[]|()*+?{}";
+
+	/* Switching from case-insensitive to case-sensitive matching (by typing an
+	 * upper case letter) narrows results as well, so candidates are kept in this
+	 * case.  Only switching in the opposite direction requires a full pass. */
+	return filter->is_regex_valid
+	    && starts_with(value, filter->raw)
+	    && value[strcspn(value, REGEX_CHARS)] == '\0'
+	    && (!regexp_should_ignore_case(value) || (filter->cflags & REG_ICASE));
+}
+
+/* Makes next update of filtering lists check all of the entries. */
+static void
+drop_filter_candidates(FileView *view)
+{
+	free(view->local_filter.candidates);
+	view->local_filter.candidates = NULL;
+	view->local_filter.candidate_count = 0U;
+}
+
 /* Gets position of an item in dir_entry list at position pos in the unfiltered
  * list.  Returns index on success, otherwise -1 is returned. */
 static int
@@ -507,22 +574,43 @@ update_filtering_lists(FileView *view, int add, int clear)
 {
 	/* filter_temporary_nodes() is similar function. */
 
-	size_t i;
+	size_t k;
 	size_t list_size = 0U;
 	dir_entry_t *parent_entry = NULL;
 	int parent_added = 0;
 
-	for(i = 0; i < view->local_filter.unfiltered_count; ++i)
+	/* Candidates are used and updated only while filter is being edited. */
+	const int *const positions = (add && !clear)
+	                           ? view->local_filter.candidates
+	                           : NULL;
+	const size_t count = (positions != NULL)
+	                   ? view->local_filter.candidate_count
+	                   : view->local_filter.unfiltered_count;
+	char *const matches = match_unfiltered(view, positions, count);
+	int *candidates = NULL;
+	size_t ncandidates = 0U;
+
+	if(add && !clear)
 	{
-		/* FIXME: some very long file names won't be matched against some
-		 * regexps. */
-		char name_with_slash[NAME_MAX + 1 + 1];
+		/* One extra element for the entry that might be added below. */
+		candidates = reallocarray(NULL, count + 1U, sizeof(*candidates));
+	}
 
+	for(k = 0U; k < count; ++k)
+	{
+		const size_t i = (positions != NULL) ? (size_t)positions[k] : k;
 		dir_entry_t *const entry = &view->local_filter.unfiltered[i];
 		const char *name = entry->name;
+		int matched;
 
 		if(is_parent_dir(name))
 		{
+			/* Parent entries aren't matched against filter, so keep all of them. */
+			if(candidates != NULL)
+			{
+				candidates[ncandidates++] = i;
+			}
+
 			if(entry->child_pos == 0)
 			{
 				parent_entry = entry;
@@ -544,17 +632,20 @@ update_filtering_lists(FileView *view, int add, int clear)
 			}
 		}
 
-		if(is_directory_entry(entry))
-		{
-			append_slash(name, name_with_slash, sizeof(name_with_slash));
-			name = name_with_slash;
-		}
+		matched = (matches != NULL) ? matches[k]
+		                            : matches_local_filter(
+		                                  &view->local_filter.filter, entry);
 
 		/* tag links to position of nodes passed through filter in list of visible
 		 * files.  Nodes that didn't pass have -1. */
 		entry->tag = -1;
-		if(filter_matches(&view->local_filter.filter, name) != 0)
+		if(matched)
 		{
+			if(candidates != NULL)
+			{
+				candidates[ncandidates++] = i;
+			}
+
 			if(add)
 			{
 				dir_entry_t *e = add_dir_entry(&view->dir_entry, &list_size, entry);
@@ -586,12 +677,34 @@ update_filtering_lists(FileView *view, int add, int clear)
 			free_dir_entry(view, parent_entry);
 		}
 	}
+	free(matches);
+
 	if(add)
 	{
+		const size_t unfiltered_count = view->local_filter.unfiltered_count;
+
 		view->list_rows = list_size;
 		view->filtered = view->local_filter.prefiltered_count
 		               + view->local_filter.unfiltered_count - list_size;
 		ensure_filtered_list_not_empty(view, parent_entry);
+
+		if(candidates != NULL &&
+				view->local_filter.unfiltered_count != unfiltered_count)
+		{
+			/* Newly added parent entry must be found next time. */
+			candidates[ncandidates++] = unfiltered_count;
+		}
+	}
+
+	if(add && !clear)
+	{
+		free(view->local_filter.candidates);
+		view->local_filter.candidates = candidates;
+		view->local_filter.candidate_count = ncandidates;
+	}
+
+	if(add)
+	{
 		return list_size == 0U
 		    || (list_size == 1U && parent_added &&
 						(filter_matches(&view->local_filter.filter, "../") == 0));
@@ -599,6 +712,115 @@ update_filtering_lists(FileView *view, int add, int clear)
 	return 0;
 }
 
+/* Matches entries of unfiltered list against local filter.  Entries are picked
+ * by the positions array or all of them are taken if it's NULL.  Big lists are
+ * split between several threads.  Returns array of results or NULL if matching
+ * should be done by the caller. */
+static char *
+match_unfiltered(FileView *view, const int positions[], size_t count)
+{
+	size_t ntasks, chunk_size;
+	filter_task_t *tasks;
+	char *matches;
+	tpool_t *pool;
+	size_t i;
+
+	if(count < PARALLEL_FILTER_MIN)
+	{
+		return NULL;
+	}
+
+	/* A task per thread, because each task compiles its own regexp. */
+	ntasks = MIN(get_cpu_count(), MAX_FILTER_THREADS);
+	chunk_size = DIV_ROUND_UP(count, ntasks);
+	matches = malloc(count);
+	tasks = reallocarray(NULL, ntasks, sizeof(*tasks));
+	pool = (matches != NULL && tasks != NULL) ? tpool_alloc(ntasks, ntasks)
+	                                          : NULL;
+	if(pool == NULL)
+	{
+		free(tasks);
+		free(matches);
+		return NULL;
+	}
+
+	for(i = 0U; i < ntasks; ++i)
+	{
+		filter_task_t *const task = &tasks[i];
+		task->view = view;
+		task->positions = positions;
+		task->matches = matches;
+		task->from = MIN(count, i*chunk_size);
+		task->to = MIN(count, (i + 1U)*chunk_size);
+
+		/* Compiled regular expression can't be used by several threads at the same
+		 * time. */
+		task->filter = &view->local_filter.filter;
+		task->has_copy = (filter_init(&task->copy, 1) == 0);
+		if(task->has_copy && filter_assign(&task->copy, task->filter) == 0)
+		{
+			task->filter = &task->copy;
+		}
+
+		/* Filter of the view is used only on this thread. */
+		if(task->filter != &task->copy ||
+				tpool_push(pool, &filter_task, task, -1) != 0)
+		{
+			filter_task(task);
+		}
+	}
+
+	/* This waits for all tasks to finish. */
+	tpool_free(pool);
+
+	for(i = 0U; i < ntasks; ++i)
+	{
+		if(tasks[i].has_copy)
+		{
+			filter_dispose(&tasks[i].copy);
+		}
+	}
+	free(tasks);
+	return matches;
+}
+
+/* Matches a range of unfiltered entries against filter of the task.  Can be
+ * invoked on a thread other than the main one, so shouldn't modify anything
+ * except for its part of results. */
+static void
+filter_task(void *arg)
+{
+	const filter_task_t *const task = arg;
+	size_t i;
+	for(i = task->from; i < task->to; ++i)
+	{
+		const size_t pos = (task->positions != NULL) ? task->positions[i] : i;
+		dir_entry_t *const entry = &task->view->local_filter.unfiltered[pos];
+		/* Parent directories are handled separately. */
+		task->matches[i] = !is_parent_dir(entry->name)
+		                && matches_local_filter(task->filter, entry);
+	}
+}
+
+/* Checks whether entry passes the filter.  Returns non-zero if so, otherwise
+ * zero is returned. */
+static int
+matches_local_filter(filter_t *filter, const dir_entry_t *entry)
+{
+	/* FIXME: some very long file names won't be matched against some
+	 * regexps. */
+	char name_with_slash[NAME_MAX + 1 + 1];
+	const char *name = entry->name;
+
+	if(is_directory_entry(entry))
+	{
+		append_slash(name, name_with_slash, sizeof(name_with_slash));
+		name = name_with_slash;
+	}
+
+	return filter_matches(filter, name) != 0;
+}
+
 /* Reparents *filtered node by attaching it to the closes ancestor of *original
  * mapped onto the list of filtered nodes.  tag field of entries is used to
  * perform the mapping. */
@@ -805,6 +1027,7 @@ local_filter_finish(FileView *view)
 	dynarray_free(view->local_filter.unfiltered);
 	free(view->local_filter.saved);
 	view->local_filter.in_progress = 0;
+	drop_filter_candidates(view);
 
 	free(view->local_filter.poshist);
 	view->local_filter.poshist = NULL;
@@ -32,14 +32,16 @@
 #include <assert.h> /* assert() */
 #include <errno.h> /* errno */
 #include <stddef.h> /* NULL size_t */
-#include <stdint.h> /* uint64_t */
+#include <stdint.h> /* uint64_t uintmax_t */
 #include <stdio.h> /* snprintf() */
-#include <stdlib.h> /* calloc() free() malloc() realloc() strtol() */
-#include <string.h> /* memcmp() strcmp() strdup() strlen() */
+#include <stdlib.h> /* calloc() free() malloc() qsort() realloc() strtol() */
+#include <string.h> /* memcmp() memcpy() strcmp() strdup() strlen() */
+#include <time.h> /* timespec */
 
 #include "cfg/config.h"
 #include "compat/fs_limits.h"
 #include "compat/os.h"
+#include "compat/pthread.h"
 #include "int/vim.h"
 #include "io/ioeta.h"
 #include "io/ionotif.h"
@@ -50,6 +52,7 @@
 #include "ui/statusbar.h"
 #include "ui/ui.h"
 #include "utils/cancellation.h"
+#include "utils/dynarray.h"
 #ifdef _WIN32
 #include "utils/env.h"
 #endif
@@ -59,6 +62,7 @@
 #include "utils/path.h"
 #include "utils/str.h"
 #include "utils/string_array.h"
+#include "utils/tpool.h"
 #include "utils/utils.h"
 #include "background.h"
 #include "filelist.h"
@@ -78,6 +82,18 @@
 /* Key used to switch to progress dialog. */
 #define IO_DETAILS_KEY 'i'
 
+/* Number of threads that calculate sizes of directories.  Their work is mostly
+ * waiting for file system, so this doesn't depend on number of CPUs. */
+#define DIR_SIZE_THREADS 8
+
+/* Maximum number of directories waiting for a thread to calculate their size.
+ * Directories that don't fit are processed by threads that discover them. */
+#define DIR_SIZE_QUEUE 1024
+
+/* Period of invoking progress callback of directory size calculation in
+ * milliseconds. */
+#define DIR_SIZE_PROGRESS_PERIOD 500
+
 /* Object for auxiliary information related to progress of operations in
  * io_progress_changed() handler. */
 typedef struct
@@ -99,6 +115,49 @@ typedef struct
 }
 progress_data_t;
 
+/* State of a single calculation of directory size shared among directories of
+ * the tree. */
+typedef struct
+{
+	pthread_mutex_t lock;    /* Protects this structure and all its nodes. */
+	pthread_cond_t finished; /* Signaled when calculation is done. */
+	int done;                /* Whether size of the root is known. */
+	int cancelled;           /* Whether calculation was cancelled. */
+	uint64_t size;           /* Size of the root once calculation is done. */
+
+	int force;     /* Whether cached sizes of subdirectories are ignored. */
+	int allocated; /* Whether allocated space is counted instead of sizes. */
+	const cancellation_t *cancellation; /* Cancellation state. */
+}
+size_calc_t;
+
+/* File with several hard links that was counted in a subtree. */
+typedef struct
+{
+	uintmax_t dev;  /* Device number. */
+	uintmax_t ino;  /* Inode number. */
+	uint64_t size;  /* Size that was added for the file. */
+}
+linked_file_t;
+
+/* Directory of a tree whose size is being calculated. */
+typedef struct size_node_t
+{
+	size_calc_t *calc;          /* Calculation this directory is part of. */
+	struct size_node_t *parent; /* Parent directory or NULL for the root. */
+	char *path;                 /* Full path to the directory. */
+	uint64_t size;              /* Size accumulated so far. */
+	int failed;                 /* Whether directory couldn't be listed. */
+	/* Files with several hard links counted in the subtree (dynarray), might
+	 * contain duplicates until the directory is finished. */
+	linked_file_t *linked;
+	int nlinked;                /* Number of elements in the linked array. */
+	/* Number of subdirectories whose size isn't known yet plus one until
+	 * directory listing is processed. */
+	int pending;
+}
+size_node_t;
+
 static void io_progress_changed(const io_progress_t *const state);
 static int calc_io_progress(const io_progress_t *const state, int *skip);
 static void io_progress_fg(const io_progress_t *const state, int progress);
@@ -111,6 +170,21 @@ static int is_file_name_changed(const char old[], const char new[]);
 static int ui_cancellation_hook(void *arg);
 static int edit_file(const char filepath[], int force_changed);
 static progress_data_t * alloc_progress_data(int bg, void *info);
+static void init_dir_size_pool(void);
+static size_node_t * alloc_size_node(size_calc_t *calc, size_node_t *parent,
+		const char path[]);
+static void dir_size_task(void *arg);
+static uint64_t get_subdir_size(size_node_t *parent, const char path[]);
+static uint64_t get_counted_size(size_calc_t *calc, const char path[],
+		linked_file_t **linked, int *nlinked);
+static int add_linked_files(linked_file_t **linked, int *nlinked,
+		const linked_file_t files[], int count);
+static void finish_size_node(size_node_t *node);
+static uint64_t drop_duplicate_files(size_node_t *node);
+static int linked_file_cmp(const void *a, const void *b);
+
+/* Pool of threads shared by all directory size calculations. */
+static tpool_t *dir_size_pool;
 
 line_prompt_func fops_line_prompt;
 options_prompt_func fops_options_prompt;
@@ -1022,63 +1096,356 @@ fops_is_dir_writable(DirRole dir_role, const char path[])
 }
 
 uint64_t
-fops_dir_size(const char path[], int force_update,
-		const struct cancellation_t *cancellation)
+fops_dir_size(const char path[], int force, int allocated,
+		const cancellation_t *cancellation, dir_size_progress_func progress,
+		void *arg)
+{
+	static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+	size_calc_t calc = {
+		.force = force,
+		.allocated = allocated,
+		.cancellation = cancellation,
+	};
+	size_node_t *root;
+
+	pthread_once(&once, &init_dir_size_pool);
+
+	root = alloc_size_node(&calc, NULL, path);
+	if(root == NULL)
+	{
+		return 0U;
+	}
+
+	pthread_mutex_init(&calc.lock, NULL);
+	pthread_cond_init(&calc.finished, NULL);
+
+	/* Subdirectories are handed over to the pool while this thread lists the
+	 * root. */
+	dir_size_task(root);
+
+	pthread_mutex_lock(&calc.lock);
+	while(!calc.done)
+	{
+		struct timespec deadline;
+		tpool_deadline(DIR_SIZE_PROGRESS_PERIOD, &deadline);
+
+		(void)pthread_cond_timedwait(&calc.finished, &calc.lock, &deadline);
+
+		if(!calc.done && progress != NULL)
+		{
+			pthread_mutex_unlock(&calc.lock);
+			progress(arg);
+			pthread_mutex_lock(&calc.lock);
+		}
+	}
+	pthread_mutex_unlock(&calc.lock);
+
+	pthread_cond_destroy(&calc.finished);
+	pthread_mutex_destroy(&calc.lock);
+
+	return calc.cancelled ? 0U : calc.size;
+}
+
+/* Creates pool of threads for calculating directory sizes.  On failure
+ * directories are processed by threads that discover them. */
+static void
+init_dir_size_pool(void)
+{
+	dir_size_pool = tpool_alloc(DIR_SIZE_THREADS, DIR_SIZE_QUEUE);
+}
+
+/* Allocates node of directory tree whose size is being calculated.  Returns
+ * the node or NULL on error. */
+static size_node_t *
+alloc_size_node(size_calc_t *calc, size_node_t *parent, const char path[])
+{
+	size_node_t *const node = malloc(sizeof(*node));
+	if(node == NULL)
+	{
+		return NULL;
+	}
+
+	node->path = strdup(path);
+	if(node->path == NULL)
+	{
+		free(node);
+		return NULL;
+	}
+
+	node->calc = calc;
+	node->parent = parent;
+	node->size = 0U;
+	node->failed = 0;
+	node->linked = NULL;
+	node->nlinked = 0;
+	node->pending = 1;
+	return node;
+}
+
+/* Lists directory accumulating sizes of its files and scheduling its
+ * subdirectories.  Runs either on a pool thread or on a thread that discovered
+ * the directory. */
+static void
+dir_size_task(void *arg)
+{
+	size_node_t *const node = arg;
+	size_calc_t *const calc = node->calc;
+	const char *const slash = ends_with_slash(node->path) ? "" : "/";
+	uint64_t size = 0U;
+	int cancelled = 0;
+	linked_file_t *linked = NULL;
+	int nlinked = 0;
+	DIR *dir;
+	struct dirent *dentry;
+
+	dir = os_opendir(node->path);
+	if(dir != NULL)
+	{
+		while((dentry = os_readdir(dir)) != NULL)
+		{
+			char full_path[PATH_MAX];
+
+			if(is_builtin_dir(dentry->d_name))
+			{
+				continue;
+			}
+
+			snprintf(full_path, sizeof(full_path), "%s%s%s", node->path, slash,
+					dentry->d_name);
+			if(fops_is_dir_entry(full_path, dentry))
+			{
+				size += get_subdir_size(node, full_path);
+			}
+			else
+			{
+				size += get_counted_size(calc, full_path, &linked, &nlinked);
+			}
+
+			if(cancellation_requested(calc->cancellation))
+			{
+				cancelled = 1;
+				break;
+			}
+		}
+		os_closedir(dir);
+	}
+
+	pthread_mutex_lock(&calc->lock);
+	calc->cancelled |= cancelled;
+	node->failed = (dir == NULL);
+	node->size += size;
+	if(add_linked_files(&node->linked, &node->nlinked, linked, nlinked) != 0)
+	{
+		/* Can't deduplicate these files in parents, so at least don't cache
+		 * anything that might be wrong. */
+		calc->cancelled = 1;
+	}
+	finish_size_node(node);
+	pthread_mutex_unlock(&calc->lock);
+
+	dynarray_free(linked);
+}
+
+/* Obtains size of subdirectory from cache or schedules its calculation.  Hard
+ * links of subdirectory whose size is taken from the cache aren't known, so
+ * they can't be deduplicated against the rest of the tree.  Returns size that
+ * is known at the moment. */
+static uint64_t
+get_subdir_size(size_node_t *parent, const char path[])
 {
-	DIR* dir;
-	struct dirent* dentry;
-	const char* slash = "";
+	size_calc_t *const calc = parent->calc;
+	size_node_t *node;
+
+	if(!calc->force)
+	{
+		uint64_t size;
+		dcache_get_at(path, &size, NULL);
+		if(size != DCACHE_UNKNOWN)
+		{
+			return size;
+		}
+	}
+
+	node = alloc_size_node(calc, parent, path);
+	if(node == NULL)
+	{
+		/* Don't let size without the subdirectory pass for a complete one. */
+		pthread_mutex_lock(&calc->lock);
+		calc->cancelled = 1;
+		pthread_mutex_unlock(&calc->lock);
+		return 0U;
+	}
+
+	pthread_mutex_lock(&calc->lock);
+	++parent->pending;
+	pthread_mutex_unlock(&calc->lock);
+
+	if(dir_size_pool == NULL ||
+			tpool_push(dir_size_pool, &dir_size_task, node, 0) != 0)
+	{
+		dir_size_task(node);
+	}
+	return 0U;
+}
+
+/* Retrieves amount of space a file adds to the size of a directory.  Files with
+ * several hard links are recorded in the *linked array of *nlinked elements to
+ * be counted once per subtree later.  Returns the size. */
+static uint64_t
+get_counted_size(size_calc_t *calc, const char path[], linked_file_t **linked,
+		int *nlinked)
+{
+#ifndef _WIN32
+	struct stat s;
 	uint64_t size;
 
-	dir = os_opendir(path);
-	if(dir == NULL)
+	if(os_lstat(path, &s) != 0)
 	{
 		return 0U;
 	}
 
-	if(!ends_with_slash(path))
+	size = calc->allocated ? (uint64_t)s.st_blocks*512U : (uint64_t)s.st_size;
+
+	if(s.st_nlink > 1)
+	{
+		const linked_file_t file = {
+			.dev = (uintmax_t)s.st_dev,
+			.ino = (uintmax_t)s.st_ino,
+			.size = size,
+		};
+		if(add_linked_files(linked, nlinked, &file, 1) != 0)
+		{
+			/* Cancel the calculation instead of counting the file twice. */
+			pthread_mutex_lock(&calc->lock);
+			calc->cancelled = 1;
+			pthread_mutex_unlock(&calc->lock);
+		}
+	}
+
+	return size;
+#else
+	return get_file_size(path);
+#endif
+}
+
+/* Appends count elements of the files array to the *linked array of *nlinked
+ * elements.  Returns zero on success, otherwise non-zero is returned. */
+static int
+add_linked_files(linked_file_t **linked, int *nlinked,
+		const linked_file_t files[], int count)
+{
+	linked_file_t *extended;
+
+	if(count == 0)
 	{
-		slash = "/";
+		return 0;
 	}
 
-	size = 0;
-	while((dentry = os_readdir(dir)) != NULL)
+	extended = dynarray_extend(*linked, sizeof(*files)*count);
+	if(extended == NULL)
 	{
-		char full_path[PATH_MAX];
+		return 1;
+	}
 
-		if(is_builtin_dir(dentry->d_name))
+	memcpy(&extended[*nlinked], files, sizeof(*files)*count);
+	*linked = extended;
+	*nlinked += count;
+	return 0;
+}
+
+/* Marks one pending part of the node as done and propagates sizes of completed
+ * directories up the tree making them available in the cache.  Should be
+ * called with the lock of calculation held. */
+static void
+finish_size_node(size_node_t *node)
+{
+	while(node != NULL && --node->pending == 0)
+	{
+		size_calc_t *const calc = node->calc;
+		size_node_t *const parent = node->parent;
+
+		/* Size of the subtree doesn't depend on what was counted outside of it
+		 * and on the order in which its parts were processed. */
+		node->size -= drop_duplicate_files(node);
+
+		if(!calc->cancelled && !node->failed)
 		{
-			continue;
+			(void)dcache_set_at(node->path, node->size, DCACHE_UNKNOWN);
 		}
 
-		snprintf(full_path, sizeof(full_path), "%s%s%s", path, slash,
-				dentry->d_name);
-		if(fops_is_dir_entry(full_path, dentry))
+		if(parent == NULL)
 		{
-			uint64_t dir_size;
-			dcache_get_at(full_path, &dir_size, NULL);
-			if(dir_size == DCACHE_UNKNOWN || force_update)
-			{
-				dir_size = fops_dir_size(full_path, force_update, cancellation);
-			}
-			size += dir_size;
+			calc->size = node->size;
+			calc->done = 1;
+			pthread_cond_signal(&calc->finished);
 		}
 		else
 		{
-			size += get_file_size(full_path);
+			parent->size += node->size;
+			if(add_linked_files(&parent->linked, &parent->nlinked, node->linked,
+						node->nlinked) != 0)
+			{
+				calc->cancelled = 1;
+			}
 		}
 
-		if(cancellation_requested(cancellation))
+		dynarray_free(node->linked);
+		free(node->path);
+		free(node);
+		node = parent;
+	}
+}
+
+/* Leaves single instance of every file with several hard links in the
+ * subtree of the node.  Returns total size of removed duplicates. */
+static uint64_t
+drop_duplicate_files(size_node_t *node)
+{
+	uint64_t duplicated = 0U;
+	int i, j;
+
+	if(node->nlinked < 2)
+	{
+		return 0U;
+	}
+
+	qsort(node->linked, node->nlinked, sizeof(*node->linked), &linked_file_cmp);
+
+	j = 0;
+	for(i = 1; i < node->nlinked; ++i)
+	{
+		if(linked_file_cmp(&node->linked[j], &node->linked[i]) == 0)
 		{
-			os_closedir(dir);
-			return 0U;
+			duplicated += node->linked[i].size;
+		}
+		else
+		{
+			node->linked[++j] = node->linked[i];
 		}
 	}
+	node->nlinked = j + 1;
+
+	return duplicated;
+}
 
-	os_closedir(dir);
+/* qsort() comparer that orders files with several hard links by their device
+ * and inode numbers.  Returns standard -1, 0, 1 for comparisons. */
+static int
+linked_file_cmp(const void *a, const void *b)
+{
+	const linked_file_t *const x = a;
+	const linked_file_t *const y = b;
 
-	(void)dcache_set_at(path, size, DCACHE_UNKNOWN);
-	return size;
+	if(x->dev != y->dev)
+	{
+		return (x->dev < y->dev) ? -1 : 1;
+	}
+	if(x->ino != y->ino)
+	{
+		return (x->ino < y->ino) ? -1 : 1;
+	}
+	return 0;
 }
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
@@ -209,11 +209,21 @@ int fops_is_dir_writable(DirRole dir_role, const char path[]);
 
 struct cancellation_t;
 
+/* Callback invoked periodically while size of a directory is calculated. */
+typedef void (*dir_size_progress_func)(void *arg);
+
 /* Calculates size of a directory specified by path possibly using cache of
- * known sizes.  Forcing disables using previously cached values.  Returns size
- * of a directory or zero on error. */
-uint64_t fops_dir_size(const char path[], int force,
-		const struct cancellation_t *cancellation);
+ * known sizes.  Forcing disables using previously cached values.  When
+ * allocated is non-zero, space allocated for files is counted instead of their
+ * sizes.  Files with several hard links are counted once per subtree, but
+ * cached sizes of subdirectories carry no information to deduplicate them
+ * against the rest of the tree, so such files can be counted several times
+ * unless forced.  Subdirectories are processed in parallel and their sizes are
+ * cached as soon as they are known.  progress can be NULL.  Returns size of a
+ * directory or zero on error. */
+uint64_t fops_dir_size(const char path[], int force, int allocated,
+		const struct cancellation_t *cancellation, dir_size_progress_func progress,
+		void *arg);
 
 #endif /* VIFM__FOPS_COMMON_H__ */
 
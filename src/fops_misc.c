@@ -49,8 +49,9 @@
 /* Arguments pack for dir_size_bg() background function. */
 typedef struct
 {
-	char *path; /* Full path to directory to process, will be freed. */
-	int force;  /* Whether cached values should be ignored. */
+	char *path;    /* Full path to directory to process, will be freed. */
+	int force;     /* Whether cached values should be ignored. */
+	int allocated; /* Whether allocated space should be counted. */
 }
 dir_size_args_t;
 
@@ -69,8 +70,10 @@ static void go_to_first_file(FileView *view, char *names[], int count);
 static void update_dir_entry_size(const FileView *view, int index, int force);
 static void start_dir_size_calc(const char path[], int force);
 static void dir_size_bg(bg_op_t *bg_op, void *arg);
-static void dir_size(bg_op_t *bg_op, char path[], int force);
+static void dir_size(bg_op_t *bg_op, const char path[], int force,
+		int allocated);
 static int bg_cancellation_hook(void *arg);
+static void dir_size_progress(void *arg);
 static void redraw_after_path_change(FileView *view, const char path[]);
 #ifndef _WIN32
 static void change_owner_cb(const char new_owner[]);
@@ -1037,6 +1040,7 @@ start_dir_size_calc(const char path[], int force)
 	args = malloc(sizeof(*args));
 	args->path = strdup(path);
 	args->force = force;
+	args->allocated = cfg.disk_usage;
 
 	snprintf(task_desc, sizeof(task_desc), "Calculating size: %s", path);
 
@@ -1057,28 +1061,30 @@ dir_size_bg(bg_op_t *bg_op, void *arg)
 {
 	dir_size_args_t *const args = arg;
 
-	dir_size(bg_op, args->path, args->force);
+	dir_size(bg_op, args->path, args->force, args->allocated);
 
 	free(args->path);
 	free(args);
 }
 
-/* Calculates directory size and triggers view updates if necessary.  Changes
- * path. */
+/* Calculates directory size and triggers view updates while sizes of its
+ * subdirectories become known and at the end. */
 static void
-dir_size(bg_op_t *bg_op, char path[], int force)
+dir_size(bg_op_t *bg_op, const char path[], int force, int allocated)
 {
 	const cancellation_t bg_cancellation_info = {
 		.arg = bg_op,
 		.hook = &bg_cancellation_hook,
 	};
 
-	(void)fops_dir_size(path, force, &bg_cancellation_info);
+	char parent[PATH_MAX];
+	copy_str(parent, sizeof(parent), path);
+	remove_last_path_component(parent);
 
-	remove_last_path_component(path);
+	(void)fops_dir_size(path, force, allocated, &bg_cancellation_info,
+			&dir_size_progress, parent);
 
-	redraw_after_path_change(&lwin, path);
-	redraw_after_path_change(&rwin, path);
+	dir_size_progress(parent);
 }
 
 /* Implementation of cancellation hook for background tasks. */
@@ -1088,6 +1094,16 @@ bg_cancellation_hook(void *arg)
 	return bg_op_cancelled(arg);
 }
 
+/* Schedules redraw of views that might display sizes of directories under the
+ * path passed in as an argument. */
+static void
+dir_size_progress(void *arg)
+{
+	const char *const path = arg;
+	redraw_after_path_change(&lwin, path);
+	redraw_after_path_change(&rwin, path);
+}
+
 /* Schedules view redraw in case path change might have affected it. */
 static void
 redraw_after_path_change(FileView *view, const char path[])
@@ -28,21 +28,72 @@
 #include <magic.h>
 #endif
 
-#include <stddef.h> /* size_t */
+#include <sys/stat.h> /* stat */
+#include <sys/types.h> /* dev_t ino_t off_t */
+#include <unistd.h> /* read() */
+
+#include <stddef.h> /* NULL size_t */
+#include <stdint.h> /* uint64_t */
 #include <stdlib.h> /* free() */
 #include <stdio.h> /* popen() */
-#include <unistd.h> /* read() */
+#include <string.h> /* strdup() */
+#include <time.h> /* time_t */
 
+#include "../compat/os.h"
+#include "../compat/pthread.h"
+#include "../ui/ui.h"
+#include "../utils/macros.h"
 #include "../utils/path.h"
 #include "../utils/str.h"
+#include "../utils/string_array.h"
 #include "../filetype.h"
 #include "../status.h"
 #include "desktop.h"
 
-static assoc_records_t handlers;
+/* Number of slots in the cache of mime types, must be a power of two. */
+#define MIME_CACHE_SLOTS 8192
+
+/* Number of cached mime types at which the cache is emptied to bound its
+ * size and keep probing short. */
+#define MIME_CACHE_LIMIT (MIME_CACHE_SLOTS/2)
+
+/* Number of files classified in background before views are redrawn. */
+#define MIME_BATCH_SIZE 32
+
+/* Maximum number of files waiting for background classification. */
+#define MIME_MAX_PENDING 512
+
+/* Identifies state of a file, mime type of which is cached. */
+typedef struct
+{
+	dev_t dev;    /* Device of the file. */
+	ino_t ino;    /* Inode of the file. */
+	time_t mtime; /* Modification time of the file. */
+	off_t size;   /* Size of the file. */
+}
+mime_key_t;
 
+/* Slot of mime type cache. */
+typedef struct
+{
+	mime_key_t key; /* State of the file. */
+	char *type;     /* NULL for unused slots, empty string if type is unknown. */
+	int deferred;   /* Type has to be determined on the main thread. */
+}
+mime_slot_t;
+
+static const char * classify_file(const char file[], int in_background,
+		char buf[], size_t buf_sz);
+static int make_mime_key(const char file[], mime_key_t *key);
+static int cache_lookup(const mime_key_t *key, char buf[], size_t buf_sz);
+static void cache_store(const mime_key_t *key, const char type[],
+		int deferred);
+static mime_slot_t * find_slot(const mime_key_t *key);
+static void * classifier(void *arg);
 static int get_gtk_mimetype(const char filename[], char buf[], size_t buf_sz);
-static int get_magic_mimetype(const char filename[], char buf[], size_t buf_sz);
+static int get_magic_mimetype(const char filename[], int in_background,
+		char buf[], size_t buf_sz);
+static int query_magic(const char filename[], char buf[], size_t buf_sz);
 static int get_file_mimetype(const char filename[], char buf[], size_t buf_sz);
 static assoc_records_t get_handlers(const char mime_type[]);
 #if !defined(_WIN32) && defined(ENABLE_DESKTOP_FILES)
@@ -50,6 +101,21 @@ static void parse_app_dir(const char directory[], const char mime_type[],
 		assoc_records_t *result);
 #endif
 
+static assoc_records_t handlers;
+
+/* Protects mime type cache and list of pending files. */
+static pthread_mutex_t mime_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Open-addressing hash table of mime types of files. */
+static mime_slot_t mime_cache[MIME_CACHE_SLOTS];
+/* Number of used slots of mime_cache. */
+static int mime_cache_count;
+/* Paths of files waiting for background classification. */
+static char **pending;
+/* Number of elements in the pending array. */
+static int npending;
+/* Whether thread that classifies pending files is running. */
+static int classifier_running;
+
 assoc_records_t
 get_magic_handlers(const char file[])
 {
@@ -60,19 +126,247 @@ const char *
 get_mimetype(const char file[])
 {
 	static char mimetype[128];
+	const char *type;
+	mime_key_t key;
+
+	if(make_mime_key(file, &key) != 0)
+	{
+		return classify_file(file, 0, mimetype, sizeof(mimetype));
+	}
+
+	if(cache_lookup(&key, mimetype, sizeof(mimetype)) == 0)
+	{
+		return (mimetype[0] == '\0') ? NULL : mimetype;
+	}
+
+	type = classify_file(file, 0, mimetype, sizeof(mimetype));
+	cache_store(&key, (type == NULL) ? "" : type, 0);
+	return type;
+}
+
+int
+mimetype_is_known(const char file[])
+{
+	char type[128];
+	mime_key_t key;
+
+	/* There is nothing to wait for if the cache can't be used or if the type
+	 * can't be determined in background. */
+	return make_mime_key(file, &key) != 0
+	    || cache_lookup(&key, type, sizeof(type)) <= 0;
+}
+
+void
+mimetype_request(const char file[])
+{
+	pthread_t id;
+	pthread_attr_t attr;
 
-	if(get_gtk_mimetype(file, mimetype, sizeof(mimetype)) == -1)
+	pthread_mutex_lock(&mime_lock);
+
+	if(npending >= MIME_MAX_PENDING ||
+			is_in_string_array(pending, npending, file))
 	{
-		if(get_magic_mimetype(file, mimetype, sizeof(mimetype)) == -1)
+		pthread_mutex_unlock(&mime_lock);
+		return;
+	}
+
+	npending = add_to_string_array(&pending, npending, 1, file);
+
+	if(!classifier_running && pthread_attr_init(&attr) == 0)
+	{
+		if(pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) == 0 &&
+				pthread_create(&id, &attr, &classifier, NULL) == 0)
 		{
-			if(get_file_mimetype(file, mimetype, sizeof(mimetype)) == -1)
+			classifier_running = 1;
+		}
+		(void)pthread_attr_destroy(&attr);
+	}
+
+	pthread_mutex_unlock(&mime_lock);
+}
+
+/* Determines mime type of a file.  Methods that fork are skipped in
+ * background, because processes are reaped by SIGCHLD handler and forking
+ * threaded process isn't safe for code that allocates memory in the child.
+ * Returns pointer to the buf or NULL if type is unknown. */
+static const char *
+classify_file(const char file[], int in_background, char buf[], size_t buf_sz)
+{
+	if(get_gtk_mimetype(file, buf, buf_sz) == -1)
+	{
+		if(get_magic_mimetype(file, in_background, buf, buf_sz) == -1)
+		{
+			if(in_background || get_file_mimetype(file, buf, buf_sz) == -1)
 			{
 				return NULL;
 			}
 		}
 	}
+	return buf;
+}
+
+/* Fills key of mime type cache for the file.  Returns zero on success,
+ * otherwise non-zero is returned. */
+static int
+make_mime_key(const char file[], mime_key_t *key)
+{
+#ifndef _WIN32
+	struct stat st;
+	if(os_lstat(file, &st) != 0)
+	{
+		return 1;
+	}
 
-	return mimetype;
+	key->dev = st.st_dev;
+	key->ino = st.st_ino;
+	key->mtime = st.st_mtime;
+	key->size = st.st_size;
+	return 0;
+#else
+	/* Inode numbers aren't available, so files can't be identified reliably. */
+	(void)file;
+	(void)key;
+	return 1;
+#endif
+}
+
+/* Looks up mime type in the cache and copies it to the buffer.  Empty string
+ * means that type is unknown.  Returns zero if found, negative number if type
+ * has to be determined on the main thread and positive number if it's not in
+ * the cache. */
+static int
+cache_lookup(const mime_key_t *key, char buf[], size_t buf_sz)
+{
+	mime_slot_t *slot;
+	int result = 1;
+
+	pthread_mutex_lock(&mime_lock);
+	slot = find_slot(key);
+	if(slot->type != NULL)
+	{
+		copy_str(buf, buf_sz, slot->type);
+		result = (slot->deferred ? -1 : 0);
+	}
+	pthread_mutex_unlock(&mime_lock);
+
+	return result;
+}
+
+/* Puts mime type into the cache.  Empty string means that type is unknown.
+ * Non-zero deferred means that the type couldn't be determined in background
+ * and should be determined on the main thread. */
+static void
+cache_store(const mime_key_t *key, const char type[], int deferred)
+{
+	mime_slot_t *slot;
+	char *const copy = strdup(type);
+	if(copy == NULL)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&mime_lock);
+
+	if(mime_cache_count >= MIME_CACHE_LIMIT)
+	{
+		size_t i;
+		for(i = 0U; i < ARRAY_LEN(mime_cache); ++i)
+		{
+			free(mime_cache[i].type);
+			mime_cache[i].type = NULL;
+		}
+		mime_cache_count = 0;
+	}
+
+	slot = find_slot(key);
+	if(slot->type == NULL)
+	{
+		++mime_cache_count;
+	}
+	free(slot->type);
+	slot->key = *key;
+	slot->type = copy;
+	slot->deferred = deferred;
+
+	pthread_mutex_unlock(&mime_lock);
+}
+
+/* Finds slot of the cache that holds the key or an unused slot where it should
+ * be placed.  Must be called with mime_lock held.  Returns the slot. */
+static mime_slot_t *
+find_slot(const mime_key_t *key)
+{
+	uint64_t hash = (uint64_t)key->ino*0x9e3779b97f4a7c15ULL;
+	hash ^= (uint64_t)key->dev + (uint64_t)key->mtime + (uint64_t)key->size;
+
+	while(1)
+	{
+		mime_slot_t *const slot = &mime_cache[hash & (MIME_CACHE_SLOTS - 1)];
+		if(slot->type == NULL || (slot->key.ino == key->ino &&
+					slot->key.dev == key->dev && slot->key.mtime == key->mtime &&
+					slot->key.size == key->size))
+		{
+			return slot;
+		}
+		++hash;
+	}
+}
+
+/* Entry point of a thread that classifies pending files in batches and makes
+ * views redraw to reflect new information.  Returns NULL. */
+static void *
+classifier(void *arg)
+{
+	while(1)
+	{
+		char *batch[MIME_BATCH_SIZE];
+		int count;
+		int i;
+
+		pthread_mutex_lock(&mime_lock);
+		count = MIN(npending, MIME_BATCH_SIZE);
+		if(count == 0)
+		{
+			free(pending);
+			pending = NULL;
+			classifier_running = 0;
+			pthread_mutex_unlock(&mime_lock);
+			break;
+		}
+		/* Take files from the end as they were requested most recently. */
+		npending -= count;
+		for(i = 0; i < count; ++i)
+		{
+			batch[i] = pending[npending + i];
+		}
+		pthread_mutex_unlock(&mime_lock);
+
+		for(i = 0; i < count; ++i)
+		{
+			char type[128];
+			mime_key_t key;
+			if(make_mime_key(batch[i], &key) == 0 &&
+					cache_lookup(&key, type, sizeof(type)) > 0)
+			{
+				const char *const result =
+					classify_file(batch[i], 1, type, sizeof(type));
+#ifdef HAVE_FILE_PROG
+				/* Running file program is left to the main thread. */
+				const int deferred = (result == NULL);
+#else
+				const int deferred = 0;
+#endif
+				cache_store(&key, (result == NULL) ? "" : result, deferred);
+			}
+			free(batch[i]);
+		}
+
+		ui_view_schedule_redraw(&lwin);
+		ui_view_schedule_redraw(&rwin);
+	}
+
+	return NULL;
 }
 
 static int
@@ -106,15 +400,18 @@ get_gtk_mimetype(const char filename[], char buf[], size_t buf_sz)
 }
 
 static int
-get_magic_mimetype(const char filename[], char buf[], size_t buf_sz)
+get_magic_mimetype(const char filename[], int in_background, char buf[],
+		size_t buf_sz)
 {
 #ifdef HAVE_LIBMAGIC
-	magic_t magic;
-	const char *descr;
 	pid_t pid;
 	int pipes[2];
 	ssize_t r;
 
+	/* Library is used directly in background to not fork threaded process. */
+	if(in_background)
+		return query_magic(filename, buf, buf_sz);
+
 	if (pipe(pipes) == -1)
 		return -1;
 
@@ -123,32 +420,11 @@ get_magic_mimetype(const char filename[], char buf[], size_t buf_sz)
 			return -1;
 		case 0:
 			close(pipes[0]);
-
-#if HAVE_DECL_MAGIC_MIME_TYPE
-			magic = magic_open(MAGIC_MIME_TYPE);
-#else
-			magic = magic_open(MAGIC_MIME);
-#endif
-			if (magic == NULL)
-				_exit(-1);
-
-			if (magic_load(magic, NULL) == -1) {
-				magic_close(magic);
-				_exit(-1);
-			}
-
-			if((descr = magic_file(magic, filename)) == NULL) {
-				magic_close(magic);
+			if (query_magic(filename, buf, buf_sz) != 0)
 				_exit(-1);
-			}
-
-#if !HAVE_DECL_MAGIC_MIME_TYPE
-			break_atr(descr, ';');
-#endif
-			if (write(pipes[1], descr, strlen(descr)) == -1)
+			if (write(pipes[1], buf, strlen(buf)) == -1)
 				_exit(-1);
 			close(pipes[1]);
-			magic_close(magic);
 			_exit(0);
 		default:
 			close(pipes[1]);
@@ -163,6 +439,40 @@ get_magic_mimetype(const char filename[], char buf[], size_t buf_sz)
 #endif /* #ifdef HAVE_LIBMAGIC */
 }
 
+/* Determines mime type of a file by means of libmagic in current process.
+ * Returns zero on success, otherwise -1 is returned. */
+static int
+query_magic(const char filename[], char buf[], size_t buf_sz)
+{
+#ifdef HAVE_LIBMAGIC
+	magic_t magic;
+	const char *descr;
+
+#if HAVE_DECL_MAGIC_MIME_TYPE
+	magic = magic_open(MAGIC_MIME_TYPE);
+#else
+	magic = magic_open(MAGIC_MIME);
+#endif
+	if (magic == NULL)
+		return -1;
+
+	if (magic_load(magic, NULL) == -1 ||
+			(descr = magic_file(magic, filename)) == NULL) {
+		magic_close(magic);
+		return -1;
+	}
+
+	copy_str(buf, buf_sz, descr);
+#if !HAVE_DECL_MAGIC_MIME_TYPE
+	break_atr(buf, ';');
+#endif
+	magic_close(magic);
+	return (buf[0] == '\0') ? -1 : 0;
+#else /* #ifdef HAVE_LIBMAGIC */
+	return -1;
+#endif /* #ifdef HAVE_LIBMAGIC */
+}
+
 static int
 get_file_mimetype(const char filename[], char buf[], size_t buf_sz)
 {
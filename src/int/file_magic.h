@@ -25,6 +25,15 @@
  * statically allocated buffer. */
 const char * get_mimetype(const char file[]);
 
+/* Checks whether there is no point in waiting for mime type of the file to be
+ * determined in background, i.e. it's known or can be determined only by
+ * get_mimetype().  Returns non-zero if so, otherwise zero is returned. */
+int mimetype_is_known(const char file[]);
+
+/* Schedules determining mime type of the file in background.  Views are
+ * redrawn as batches of files get classified. */
+void mimetype_request(const char file[]);
+
 /* Retrieves system-wide desktop file associations.  Caller shouldn't free
  * anything. */
 assoc_records_t get_magic_handlers(const char file[]);
@@ -114,6 +114,14 @@ struct io_args_t
 	}
 	arg4;
 
+	union
+	{
+		/* Maximum number of files copied simultaneously (values less than two
+		 * disable parallel copying). */
+		int max_parallel;
+	}
+	arg5;
+
 	/* Provides means for cancellation checking. */
 	io_cancellation_t cancellation;
 
@@ -26,6 +26,14 @@
 
 /* ioeta - Input/Output estimation */
 
+struct ioeta_estim_t;
+
+/* Type of hook that collects progress of an estimation instead of reporting it
+ * via ionotif module.  The bytes parameter holds number of bytes processed
+ * since previous invocation. */
+typedef void (*ioeta_progress_hook)(struct ioeta_estim_t *estim,
+		uint64_t bytes);
+
 /* Set of data describing estimation process and state.  Managed by ioeta_*
  * functions. */
 typedef struct ioeta_estim_t
@@ -68,6 +76,10 @@ typedef struct ioeta_estim_t
 
 	/* Provides means for cancellation checking. */
 	io_cancellation_t cancellation;
+
+	/* When not NULL, progress is passed to this hook instead of notifying about
+	 * it (used for items processed in parallel with their own estimations). */
+	ioeta_progress_hook progress_hook;
 }
 ioeta_estim_t;
 
@@ -27,15 +27,20 @@
 #ifndef _WIN32
 #include <sys/ioctl.h> /* ioctl() */
 #endif
+#ifdef __linux__
+#include <sys/sendfile.h> /* sendfile() */
+#include <sys/syscall.h> /* SYS_copy_file_range syscall() */
+#endif
 #include <sys/stat.h> /* stat */
 #include <sys/types.h> /* mode_t */
-#include <unistd.h> /* rmdir() symlink() unlink() */
+#include <fcntl.h> /* F_GETFL F_SETFL O_APPEND fcntl() */
+#include <unistd.h> /* lseek() rmdir() symlink() unlink() */
 
 #include <assert.h> /* assert() */
 #include <errno.h> /* EEXIST ENOENT EISDIR errno */
 #include <stddef.h> /* NULL size_t */
-#include <stdio.h> /* FILE fpos_t fclose() fgetpos() fread() fseek() fsetpos()
-                      fwrite() snprintf() */
+#include <stdio.h> /* FILE fpos_t fclose() fgetpos() fileno() fread() fseek()
+                      fseeko() fsetpos() ftello() fwrite() snprintf() */
 #include <stdlib.h> /* free() */
 #include <string.h> /* strchr() */
 
@@ -56,7 +61,13 @@
 /* Amount of data to transfer at once. */
 #define BLOCK_SIZE 32*1024
 
+/* Amount of data to transfer at once when copying is done by the kernel.  It's
+ * larger as data doesn't pass through our buffer, but still limited to keep
+ * progress reporting and cancellation responsive. */
+#define KERNEL_BLOCK_SIZE 8*1024*1024
+
 static int clone_file(int dst_fd, int src_fd);
+static int kernel_copy(io_args_t *args, FILE *in, FILE *out);
 #ifdef _WIN32
 static DWORD CALLBACK win_progress_cb(LARGE_INTEGER total,
 		LARGE_INTEGER transferred, LARGE_INTEGER stream_size,
@@ -528,9 +539,15 @@ iop_cp(io_args_t *const args)
 		}
 	}
 
-	/* TODO: use sendfile() if platform supports it. */
+	/* Let the kernel move as much data as it can, buffered copying below
+	 * completes the job or takes over if no fast method is available. */
+	if(!error && !cloned && S_ISREG(st.st_mode) && st.st_size > 0)
+	{
+		error = kernel_copy(args, in, out);
+	}
 
-	while(!cloned && (nread = fread(&block, 1, sizeof(block), in)) != 0U)
+	while(!error && !cloned &&
+			(nread = fread(&block, 1, sizeof(block), in)) != 0U)
 	{
 		if(io_cancelled(args))
 		{
@@ -585,17 +602,18 @@ iop_cp(io_args_t *const args)
 	return error;
 }
 
-/* Try to clone file fast on btrfs.  Returns 0 on success, otherwise non-zero is
- * returned. */
+/* Try to clone file fast on file systems that support reflinks (btrfs, XFS,
+ * OCFS2, etc.).  Returns 0 on success, otherwise non-zero is returned. */
 static int
 clone_file(int dst_fd, int src_fd)
 {
 #ifdef __linux__
-#undef BTRFS_IOCTL_MAGIC
-#define BTRFS_IOCTL_MAGIC 0x94
-#undef BTRFS_IOC_CLONE
-#define BTRFS_IOC_CLONE _IOW(BTRFS_IOCTL_MAGIC, 9, int)
-	return ioctl(dst_fd, BTRFS_IOC_CLONE, src_fd);
+	/* Generic version of ioctl that originated as BTRFS_IOC_CLONE, hence the
+	 * magic number. */
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+	return ioctl(dst_fd, FICLONE, src_fd);
 #else
 	(void)dst_fd;
 	(void)src_fd;
@@ -603,6 +621,111 @@ clone_file(int dst_fd, int src_fd)
 #endif
 }
 
+/* Copies data from current position of the in file to current position of the
+ * out file without passing it through user space.  Tries copy_file_range()
+ * first (might be done server-side or by sharing extents) and then sendfile().
+ * Copying stops at end of file or at the first failure, positions of both
+ * streams are updated to point after the copied data, so caller should finish
+ * the job by regular means.  Returns zero on success or when fast copying isn't
+ * possible and non-zero on cancellation. */
+static int
+kernel_copy(io_args_t *const args, FILE *in, FILE *out)
+{
+#ifdef __linux__
+	enum { USE_COPY_FILE_RANGE, USE_SENDFILE, USE_NOTHING } method;
+
+	const int in_fd = fileno(in);
+	const int out_fd = fileno(out);
+	const int out_flags = fcntl(out_fd, F_GETFL);
+	off_t in_pos = ftello(in);
+	off_t out_pos;
+	int cancelled = 0;
+
+	if(in_pos < 0 || out_flags == -1)
+	{
+		return 0;
+	}
+
+	/* Kernel refuses to write to files in append mode, but when appending the
+	 * stream is already positioned at the end and nobody else is expected to
+	 * write to the file, so writing at current position is equivalent. */
+	if((out_flags & O_APPEND) && fcntl(out_fd, F_SETFL, out_flags & ~O_APPEND))
+	{
+		return 0;
+	}
+
+#ifdef SYS_copy_file_range
+	method = USE_COPY_FILE_RANGE;
+#else
+	method = USE_SENDFILE;
+#endif
+
+	while(method != USE_NOTHING)
+	{
+		ssize_t ncopied;
+
+		if(io_cancelled(args))
+		{
+			cancelled = 1;
+			break;
+		}
+
+#ifdef SYS_copy_file_range
+		if(method == USE_COPY_FILE_RANGE)
+		{
+			ncopied = syscall(SYS_copy_file_range, in_fd, &in_pos, out_fd, NULL,
+					(size_t)KERNEL_BLOCK_SIZE, 0U);
+		}
+		else
+#endif
+		{
+			ncopied = sendfile(out_fd, in_fd, &in_pos, KERNEL_BLOCK_SIZE);
+		}
+
+		if(ncopied < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if(ncopied == 0)
+		{
+			/* Either end of file or a pseudo-file the kernel can't handle, let
+			 * buffered copying figure it out. */
+			break;
+		}
+
+		if(ncopied < 0)
+		{
+			/* Unsupported combination of file systems/files or an actual error, try
+			 * the next method.  Buffered copying will report persistent errors. */
+			method = (method == USE_COPY_FILE_RANGE) ? USE_SENDFILE : USE_NOTHING;
+			continue;
+		}
+
+		ioeta_update(args->estim, NULL, NULL, 0, ncopied);
+	}
+
+	/* Synchronize streams with new positions of the descriptors.  Data was
+	 * read by an explicit offset, but written at current position of the
+	 * output descriptor. */
+	out_pos = lseek(out_fd, 0, SEEK_CUR);
+	if(fseeko(in, in_pos, SEEK_SET) != 0 || out_pos < 0 ||
+			fseeko(out, out_pos, SEEK_SET) != 0)
+	{
+		(void)ioe_errlst_append(&args->result.errors, args->arg2.dst, errno,
+				"Failed to reposition file streams");
+		return 1;
+	}
+
+	return cancelled;
+#else
+	(void)args;
+	(void)in;
+	(void)out;
+	return 0;
+#endif
+}
+
 #ifdef _WIN32
 
 static DWORD CALLBACK win_progress_cb(LARGE_INTEGER total,
@@ -23,16 +23,20 @@
 
 #include <errno.h> /* EEXIST EISDIR ENOTEMPTY EXDEV errno */
 #include <stddef.h> /* NULL */
+#include <stdint.h> /* uint64_t */
 #include <stdio.h> /* remove() snprintf() */
-#include <stdlib.h> /* free() */
-#include <string.h> /* strlen() */
+#include <stdlib.h> /* calloc() free() */
+#include <string.h> /* strdup() strlen() */
 
 #include "../compat/fs_limits.h"
 #include "../compat/os.h"
+#include "../compat/pthread.h"
 #include "../utils/fs.h"
 #include "../utils/log.h"
 #include "../utils/path.h"
 #include "../utils/str.h"
+#include "../utils/string_array.h"
+#include "../utils/tpool.h"
 #include "../utils/utils.h"
 #include "../background.h"
 #include "private/ioc.h"
@@ -42,10 +46,55 @@
 #include "ioc.h"
 #include "iop.h"
 
+/* Period of progress reporting and cancellation checks while waiting for
+ * parallel copying, in milliseconds. */
+#define PARALLEL_POLL_PERIOD 100
+
+/* Copying of a single file performed by a pool thread. */
+typedef struct cp_task_t
+{
+	struct cp_state_t *state; /* State of parallel copying. */
+	char *src;                /* Source path. */
+	char *dst;                /* Destination path. */
+	ioe_errlst_t errors;      /* Errors of this task. */
+	int failed;               /* Whether copying has failed. */
+	struct cp_task_t *next;   /* Next finished task. */
+}
+cp_task_t;
+
+/* State of parallel copying of a directory. */
+typedef struct cp_state_t
+{
+	io_args_t *args; /* Arguments of the operation. */
+	tpool_t *pool;   /* Threads that copy files. */
+	char *last_src;  /* Source path of the last scheduled file. */
+	char *last_dst;  /* Destination path of the last scheduled file. */
+	int failed;      /* Whether copying of any of the files has failed. */
+
+	/* List of directories whose attributes are to be set when all files are in
+	 * place, from children to parents. */
+	char **dirs;
+	int ndirs;
+
+	pthread_mutex_t lock; /* Protects fields below. */
+	uint64_t bytes;       /* Number of bytes processed since last report. */
+	cp_task_t *finished;  /* Tasks that were completed. */
+	int cancelled;        /* Whether pool threads should stop. */
+}
+cp_state_t;
+
 static VisitResult rm_visitor(const char full_path[], VisitAction action,
 		void *param);
 static VisitResult cp_visitor(const char full_path[], VisitAction action,
 		void *param);
+static int cp_parallel(io_args_t *args);
+static VisitResult cp_parallel_visitor(const char full_path[],
+		VisitAction action, void *param);
+static void cp_task(void *arg);
+static int cp_task_cancelled(void *arg);
+static void cp_task_progress(ioeta_estim_t *estim, uint64_t bytes);
+static int sync_parallel_state(cp_state_t *state);
+static cp_task_t * reverse_task_list(cp_task_t *head);
 static int is_file(const char path[]);
 static VisitResult mv_visitor(const char full_path[], VisitAction action,
 		void *param);
@@ -150,6 +199,11 @@ ior_cp(io_args_t *const args)
 		}
 	}
 
+	if(args->arg5.max_parallel > 1 && !is_symlink(src) && is_dir(src))
+	{
+		return cp_parallel(args);
+	}
+
 	return traverse(src, &cp_visitor, args);
 }
 
@@ -161,6 +215,264 @@ cp_visitor(const char full_path[], VisitAction action, void *param)
 	return cp_mv_visitor(full_path, action, param, 1);
 }
 
+/* Copies directory by copying up to args->arg5.max_parallel files at the same
+ * time.  Directories are created before any of their files are copied, while
+ * their attributes are set after all files are processed.  Returns 0 on
+ * success, otherwise non-zero is returned. */
+static int
+cp_parallel(io_args_t *args)
+{
+	const int nthreads = args->arg5.max_parallel;
+	cp_state_t state = { .args = args };
+	int result;
+	int i;
+
+	/* Keep queue short to be able to stop quickly on errors and cancellation. */
+	state.pool = tpool_alloc(nthreads, nthreads);
+	if(state.pool == NULL)
+	{
+		return traverse(args->arg1.src, &cp_visitor, args);
+	}
+
+	pthread_mutex_init(&state.lock, NULL);
+
+	result = traverse(args->arg1.src, &cp_parallel_visitor, &state);
+
+	while(tpool_wait(state.pool, PARALLEL_POLL_PERIOD) != 0)
+	{
+		(void)sync_parallel_state(&state);
+	}
+	tpool_free(state.pool);
+
+	if(sync_parallel_state(&state) != 0 && result == 0)
+	{
+		result = state.failed ? VR_ERROR : VR_CANCELLED;
+	}
+
+	for(i = 0; i < state.ndirs && result == 0; ++i)
+	{
+		result = cp_mv_visitor(state.dirs[i], VA_DIR_LEAVE, args, 1);
+	}
+
+	free_string_array(state.dirs, state.ndirs);
+	free(state.last_src);
+	free(state.last_dst);
+	pthread_mutex_destroy(&state.lock);
+
+	return result;
+}
+
+/* Implementation of traverse() visitor for parallel subtree copying.  Returns 0
+ * on success, otherwise non-zero is returned. */
+static VisitResult
+cp_parallel_visitor(const char full_path[], VisitAction action, void *param)
+{
+	cp_state_t *const state = param;
+	io_args_t *const args = state->args;
+	const char *const rel_part = full_path + strlen(args->arg1.src);
+	cp_task_t *task;
+	int pushed;
+
+	if(sync_parallel_state(state) != 0)
+	{
+		return state->failed ? VR_ERROR : VR_CANCELLED;
+	}
+
+	if(action == VA_DIR_ENTER)
+	{
+		return cp_mv_visitor(full_path, action, args, 1);
+	}
+
+	if(action == VA_DIR_LEAVE)
+	{
+		/* Files of the directory might still be in progress. */
+		state->ndirs = add_to_string_array(&state->dirs, state->ndirs, 1,
+				full_path);
+		return VR_OK;
+	}
+
+	task = calloc(1, sizeof(*task));
+	if(task == NULL)
+	{
+		return cp_mv_visitor(full_path, action, args, 1);
+	}
+
+	task->state = state;
+	task->src = strdup(full_path);
+	task->dst = (rel_part[0] == '\0')
+	          ? strdup(args->arg2.dst)
+	          : format_str("%s/%s", args->arg2.dst, rel_part);
+	ioe_errlst_init(&task->errors);
+	task->errors.active = args->result.errors.active;
+
+	/* Confirmation is an interactive thing and must be done on this thread. */
+	if(task->src == NULL || task->dst == NULL ||
+			(args->confirm != NULL && path_exists(task->dst, NODEREF)))
+	{
+		free(task->src);
+		free(task->dst);
+		free(task);
+		return cp_mv_visitor(full_path, action, args, 1);
+	}
+
+	(void)replace_string(&state->last_src, task->src);
+	(void)replace_string(&state->last_dst, task->dst);
+	ioeta_update(args->estim, task->src, task->dst, 0, 0);
+
+	while((pushed = tpool_push(state->pool, &cp_task, task,
+					PARALLEL_POLL_PERIOD)) > 0)
+	{
+		if(sync_parallel_state(state) != 0)
+		{
+			free(task->src);
+			free(task->dst);
+			free(task);
+			return state->failed ? VR_ERROR : VR_CANCELLED;
+		}
+	}
+
+	if(pushed < 0)
+	{
+		/* Out of memory, so waiting won't help and the file is copied here. */
+		free(task->src);
+		free(task->dst);
+		free(task);
+		return cp_mv_visitor(full_path, action, args, 1);
+	}
+
+	return VR_OK;
+}
+
+/* Copies single file on one of pool threads. */
+static void
+cp_task(void *arg)
+{
+	cp_task_t *const task = arg;
+	cp_state_t *const state = task->state;
+	ioeta_estim_t *estim = NULL;
+
+	io_args_t args = {
+		.arg1.src = task->src,
+		.arg2.dst = task->dst,
+		.arg3.crs = state->args->arg3.crs,
+		.arg4.fast_file_cloning = state->args->arg4.fast_file_cloning,
+
+		.cancellation.hook = &cp_task_cancelled,
+		.cancellation.arg = state,
+
+		.result.errors = task->errors,
+	};
+
+	/* Estimation of the operation is updated by the main thread, so use private
+	 * one that forwards progress. */
+	if(state->args->estim != NULL)
+	{
+		estim = ioeta_alloc(state, args.cancellation);
+		if(estim != NULL)
+		{
+			estim->progress_hook = &cp_task_progress;
+		}
+	}
+	args.estim = estim;
+
+	task->failed = (iop_cp(&args) != 0);
+	task->errors = args.result.errors;
+
+	ioeta_free(estim);
+
+	pthread_mutex_lock(&state->lock);
+	task->next = state->finished;
+	state->finished = task;
+	pthread_mutex_unlock(&state->lock);
+}
+
+/* Cancellation hook for pool threads.  Returns non-zero if copying should be
+ * stopped. */
+static int
+cp_task_cancelled(void *arg)
+{
+	cp_state_t *const state = arg;
+	int cancelled;
+
+	pthread_mutex_lock(&state->lock);
+	cancelled = state->cancelled;
+	pthread_mutex_unlock(&state->lock);
+
+	return cancelled;
+}
+
+/* Accumulates progress of a pool thread to be reported by the main thread. */
+static void
+cp_task_progress(ioeta_estim_t *estim, uint64_t bytes)
+{
+	cp_state_t *const state = estim->param;
+
+	pthread_mutex_lock(&state->lock);
+	state->bytes += bytes;
+	pthread_mutex_unlock(&state->lock);
+}
+
+/* Reports progress and errors of pool threads and propagates cancellation
+ * request to them.  Returns non-zero if the operation should be stopped. */
+static int
+sync_parallel_state(cp_state_t *state)
+{
+	io_args_t *const args = state->args;
+	cp_task_t *finished;
+	uint64_t bytes;
+	const int cancelled = io_cancelled(args);
+
+	pthread_mutex_lock(&state->lock);
+	bytes = state->bytes;
+	state->bytes = 0U;
+	finished = state->finished;
+	state->finished = NULL;
+	state->cancelled |= cancelled;
+	pthread_mutex_unlock(&state->lock);
+
+	if(bytes != 0U)
+	{
+		ioeta_update(args->estim, state->last_src, state->last_dst, 0, bytes);
+	}
+
+	/* Tasks are in reverse order of their completion. */
+	finished = reverse_task_list(finished);
+	while(finished != NULL)
+	{
+		cp_task_t *const next = finished->next;
+
+		(void)ioe_errlst_splice(&args->result.errors, &finished->errors);
+		ioe_errlst_free(&finished->errors);
+		state->failed |= finished->failed;
+
+		ioeta_update(args->estim, NULL, NULL, 1, 0);
+
+		free(finished->src);
+		free(finished->dst);
+		free(finished);
+		finished = next;
+	}
+
+	/* On errors files that are being copied are finished, but no new ones are
+	 * started just like in sequential copying. */
+	return state->failed || cancelled;
+}
+
+/* Reverses singly-linked list of tasks.  Returns new head of the list. */
+static cp_task_t *
+reverse_task_list(cp_task_t *head)
+{
+	cp_task_t *reversed = NULL;
+	while(head != NULL)
+	{
+		cp_task_t *const next = head->next;
+		head->next = reversed;
+		reversed = head;
+		head = next;
+	}
+	return reversed;
+}
+
 int
 ior_mv(io_args_t *const args)
 {
@@ -21,7 +21,7 @@
 #include <assert.h> /* assert() */
 #include <stddef.h> /* NULL size_t */
 #include <stdlib.h> /* free() */
-#include <string.h> /* strdup() */
+#include <string.h> /* memcpy() strdup() */
 
 #include "../../compat/reallocarray.h"
 #include "../ioe.h"
@@ -66,6 +66,41 @@ ioe_errlst_append(ioe_errlst_t *elist, const char path[], int error_code,
 	return 0;
 }
 
+int
+ioe_errlst_splice(ioe_errlst_t *elist, ioe_errlst_t *from)
+{
+	void *p;
+
+	if(from->error_count == 0U)
+	{
+		return 0;
+	}
+
+	if(!elist->active)
+	{
+		ioe_errlst_free(from);
+		ioe_errlst_init(from);
+		return 0;
+	}
+
+	p = reallocarray(elist->errors, elist->error_count + from->error_count,
+			sizeof(*elist->errors));
+	if(p == NULL)
+	{
+		return 1;
+	}
+	elist->errors = p;
+
+	memcpy(&elist->errors[elist->error_count], from->errors,
+			sizeof(*from->errors)*from->error_count);
+	elist->error_count += from->error_count;
+
+	free(from->errors);
+	from->errors = NULL;
+	from->error_count = 0U;
+	return 0;
+}
+
 void
 ioe_err_free(ioe_err_t *err)
 {
@@ -29,6 +29,10 @@
 int ioe_errlst_append(ioe_errlst_t *elist, const char path[], int error_code,
 		const char msg[]);
 
+/* Moves all entries of the from list to the end of the elist leaving the from
+ * list empty.  Returns non-zero on error, otherwise zero is returned. */
+int ioe_errlst_splice(ioe_errlst_t *elist, ioe_errlst_t *from);
+
 /* Frees single error.  err can't be NULL. */
 void ioe_err_free(ioe_err_t *err);
 
@@ -99,6 +99,12 @@ ioeta_update(ioeta_estim_t *estim, const char path[], const char target[],
 		replace_string(&estim->target, target);
 	}
 
+	if(estim->progress_hook != NULL)
+	{
+		estim->progress_hook(estim, bytes);
+		return;
+	}
+
 	ionotif_notify(IO_PS_IN_PROGRESS, estim);
 }
 
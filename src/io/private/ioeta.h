@@ -40,7 +40,8 @@ void ioeta_add_dir(ioeta_estim_t *estim, const char path[]);
  * processed.
  * Might calculate speed, time, etc.  When estim is NULL, the function just
  * returns.  The path or src can be NULL to indicate that file name didn't
- * change.  Calls progress changed notification handler. */
+ * change.  Calls progress changed notification handler or progress hook of the
+ * estimation if it's set. */
 void ioeta_update(ioeta_estim_t *estim, const char path[], const char target[],
 		int finished, uint64_t bytes);
 
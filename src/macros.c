@@ -55,8 +55,11 @@ typedef char (*macro_filter_func)(int *quoted, char c, char data);
 static char filter_all(int *quoted, char c, char data);
 static char filter_single(int *quoted, char c, char data);
 static char * expand_macros_i(const char command[], const char args[],
-		MacroFlags *flags, int for_shell, macro_filter_func filter);
+		MacroFlags *flags, int for_shell, macro_filter_func filter,
+		dir_entry_t *curr);
 static void set_flags(MacroFlags *flags, MacroFlags value);
+static char * append_curr_files(dir_entry_t *curr, char expanded[],
+		int under_cursor, int quotes, const char mod[], int for_shell);
 TSTATIC char * append_selected_files(FileView *view, char expanded[],
 		int under_cursor, int quotes, const char mod[], int for_shell);
 static char * append_entry(FileView *view, char expanded[], PathType type,
@@ -77,7 +80,13 @@ char *
 expand_macros(const char command[], const char args[], MacroFlags *flags,
 		int for_shell)
 {
-	return expand_macros_i(command, args, flags, for_shell, &filter_all);
+	return expand_macros_i(command, args, flags, for_shell, &filter_all, NULL);
+}
+
+char *
+ma_expand_for_entry(const char command[], dir_entry_t *entry)
+{
+	return expand_macros_i(command, NULL, NULL, 1, &filter_all, entry);
 }
 
 /* macro_filter_func instantiation that allows all macros.  Returns the
@@ -91,7 +100,8 @@ filter_all(int *quoted, char c, char data)
 char *
 ma_expand_single(const char command[])
 {
-	char *const res = expand_macros_i(command, NULL, NULL, 0, &filter_single);
+	char *const res = expand_macros_i(command, NULL, NULL, 0, &filter_single,
+			NULL);
 	unescape(res, 0);
 	return res;
 }
@@ -134,7 +144,7 @@ filter_single(int *quoted, char c, char data)
  * values. */
 static char *
 expand_macros_i(const char command[], const char args[], MacroFlags *flags,
-		int for_shell, macro_filter_func filter)
+		int for_shell, macro_filter_func filter, dir_entry_t *curr)
 {
 	/* TODO: refactor this function expand_macros() */
 	/* FIXME: repetitive len = strlen(expanded) could be optimized. */
@@ -189,7 +199,7 @@ expand_macros_i(const char command[], const char args[], MacroFlags *flags,
 				}
 				break;
 			case 'b': /* selected files of both dirs */
-				expanded = append_selected_files(curr_view, expanded, 0, quotes,
+				expanded = append_curr_files(curr, expanded, 0, quotes,
 						command + x + 1, for_shell);
 				expanded = append_to_expanded(expanded, " ");
 				expanded = append_selected_files(other_view, expanded, 0, quotes,
@@ -197,7 +207,7 @@ expand_macros_i(const char command[], const char args[], MacroFlags *flags,
 				len = strlen(expanded);
 				break;
 			case 'c': /* current dir file under the cursor */
-				expanded = append_selected_files(curr_view, expanded, 1, quotes,
+				expanded = append_curr_files(curr, expanded, 1, quotes,
 						command + x + 1, for_shell);
 				len = strlen(expanded);
 				break;
@@ -207,7 +217,7 @@ expand_macros_i(const char command[], const char args[], MacroFlags *flags,
 				len = strlen(expanded);
 				break;
 			case 'f': /* current dir selected files */
-				expanded = append_selected_files(curr_view, expanded, 0, quotes,
+				expanded = append_curr_files(curr, expanded, 0, quotes,
 						command + x + 1, for_shell);
 				len = strlen(expanded);
 				break;
@@ -354,6 +364,37 @@ set_flags(MacroFlags *flags, MacroFlags value)
 	}
 }
 
+/* Appends files of the current view to the expanded string.  curr replaces file
+ * under cursor and selection unless it's NULL.  Returns new value of expanded
+ * string. */
+static char *
+append_curr_files(dir_entry_t *curr, char expanded[], int under_cursor,
+		int quotes, const char mod[], int for_shell)
+{
+	const PathType type = flist_custom_active(curr_view) ? PT_REL : PT_NAME;
+#ifdef _WIN32
+	size_t old_len = strlen(expanded);
+#endif
+
+	if(curr == NULL)
+	{
+		return append_selected_files(curr_view, expanded, under_cursor, quotes,
+				mod, for_shell);
+	}
+
+	expanded = append_entry(curr_view, expanded, type, curr, quotes, mod,
+			for_shell);
+
+#ifdef _WIN32
+	if(for_shell && curr_stats.shell_type == ST_CMD)
+	{
+		to_back_slash(expanded + old_len);
+	}
+#endif
+
+	return expanded;
+}
+
 TSTATIC char *
 append_selected_files(FileView *view, char expanded[], int under_cursor,
 		int quotes, const char mod[], int for_shell)
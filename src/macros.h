@@ -66,6 +66,10 @@ custom_macro_t;
 char * expand_macros(const char command[], const char args[], MacroFlags *flags,
 		int for_shell);
 
+/* Like expand_macros() for a shell command, but the entry of the current view
+ * is used in place of both file under cursor and selection. */
+char * ma_expand_for_entry(const char command[], dir_entry_t *entry);
+
 /* Like expand_macros(), but expands only single element macros and aims for
  * single string, so escaping is disabled. */
 char * ma_expand_single(const char command[]);
@@ -21,6 +21,7 @@
 #include <stdint.h> /* uint64_t */
 #include <string.h> /* strchr() strdup() */
 
+#include "../cfg/config.h"
 #include "../ui/ui.h"
 #include "../utils/cancellation.h"
 #include "../utils/str.h"
@@ -80,7 +81,8 @@ format_item(const char trash_dir[], int calc_size)
 	snprintf(msg, sizeof(msg), "Calculating size of %s...", trash_dir);
 	show_progress(msg, 1);
 
-	size = fops_dir_size(trash_dir, 1, &no_cancellation);
+	size = fops_dir_size(trash_dir, 1, cfg.disk_usage, &no_cancellation, NULL,
+			NULL);
 
 	size_str[0] = '\0';
 	friendly_size_notation(size, sizeof(size_str), size_str);
@@ -210,6 +210,7 @@ static void cmd_zO(key_info_t key_info, keys_info_t *keys_info);
 static void cmd_zR(key_info_t key_info, keys_info_t *keys_info);
 static void cmd_za(key_info_t key_info, keys_info_t *keys_info);
 static void cmd_zd(key_info_t key_info, keys_info_t *keys_info);
+static void cmd_zx(key_info_t key_info, keys_info_t *keys_info);
 static void cmd_zf(key_info_t key_info, keys_info_t *keys_info);
 static void cmd_zm(key_info_t key_info, keys_info_t *keys_info);
 static void cmd_zo(key_info_t key_info, keys_info_t *keys_info);
@@ -372,6 +373,7 @@ static keys_add_info_t builtin_cmds[] = {
 	{WK_z WK_o,        {{&cmd_zo}, .descr = "show dot files"}},
 	{WK_z WK_r,        {{&cmd_zr}, .descr = "clear local filter"}},
 	{WK_z WK_t,        {{&normal_cmd_zt},   .descr = "push cursor to the top"}},
+	{WK_z WK_x,        {{&cmd_zx}, .descr = "toggle folding of tree directory"}},
 	{WK_z WK_z,        {{&normal_cmd_zz},   .descr = "center cursor position"}},
 	{WK_LP,            {{&cmd_left_paren},  .descr = "go to previous group of files"}},
 	{WK_RP,            {{&cmd_right_paren}, .descr = "go to next group of files"}},
@@ -1951,6 +1953,13 @@ cmd_zd(key_info_t key_info, keys_info_t *keys_info)
 	flist_custom_exclude(curr_view, key_info.count == 1);
 }
 
+/* Folds or unfolds directory of tree view. */
+static void
+cmd_zx(key_info_t key_info, keys_info_t *keys_info)
+{
+	(void)flist_toggle_fold(curr_view, curr_view->list_pos);
+}
+
 /* Redraw with file in bottom of list. */
 void
 normal_cmd_zb(key_info_t key_info, keys_info_t *keys_info)
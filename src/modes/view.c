@@ -21,13 +21,21 @@
 #include <curses.h>
 
 #include <regex.h>
-#include <unistd.h> /* usleep() */
+#ifndef _WIN32
+#include <sys/select.h> /* FD_* select() */
+#include <sys/time.h> /* timeval */
+#endif
+#include <sys/stat.h> /* stat */
+#include <sys/types.h> /* pid_t */
+#include <unistd.h> /* close() read() usleep() */
 
 #include <assert.h> /* assert() */
+#include <errno.h> /* EAGAIN EINTR errno */
+#include <limits.h> /* INT_MAX */
 #include <stddef.h> /* ptrdiff_t size_t */
-#include <string.h> /* memset() strdup() */
+#include <string.h> /* memchr() memcpy() memset() strdup() */
 #include <stdio.h>  /* fclose() snprintf() */
-#include <stdlib.h> /* free() */
+#include <stdlib.h> /* free() realloc() */
 
 #include "../cfg/config.h"
 #include "../compat/fs_limits.h"
@@ -47,6 +55,7 @@
 #include "../ui/ui.h"
 #include "../utils/filemon.h"
 #include "../utils/fs.h"
+#include "../utils/line_index.h"
 #include "../utils/macros.h"
 #include "../utils/path.h"
 #include "../utils/regexp.h"
@@ -64,6 +73,25 @@
 #include "normal.h"
 #include "wk.h"
 
+/* Files of this size and larger are mapped into memory instead of being read
+ * in whole. */
+#define MAPPED_FILE_MIN_SIZE (8*1024*1024)
+
+/* Maximum number of bytes of viewer output processed per check for it, so that
+ * huge output doesn't make UI unresponsive. */
+#define OUTPUT_READ_LIMIT (4*1024*1024)
+
+/* Size of a single piece of viewer output read at once. */
+#define OUTPUT_PIECE_LEN (64*1024)
+
+/* Delay in microseconds for which output of a viewer is awaited until the
+ * first screen is filled. */
+#define OUTPUT_FILL_DELAY 10000
+
+/* Period in milliseconds of checking for cancellation while waiting for more
+ * lines. */
+#define WAIT_POLL_PERIOD 100
+
 /* Named boolean values of "silent" parameter for better readability. */
 enum
 {
@@ -82,6 +110,16 @@ typedef struct
 	int line;         /* Current real line number. */
 	int linev;        /* Current virtual line number. */
 
+	/* Data of the view for files mapped into memory (lines is NULL then). */
+	line_index_t *index; /* Lines of the file, nlines of them are seen. */
+	char *line_buf;      /* Null-terminated copy of a line of the file. */
+	size_t line_buf_len; /* Size of the line_buf. */
+
+	/* Output of a viewer which is still running (fd is -1 otherwise). */
+	int fd;            /* Non-blocking pipe connected to output of the viewer. */
+	pid_t pid;         /* Process group of the viewer. */
+	view_output_t out; /* Output that isn't split into lines yet. */
+
 	/* Dimensions, units of actions. */
 	int win_size; /* Scroll window size. */
 	int half_win; /* Height of a "page" (can be changed). */
@@ -125,6 +163,18 @@ static void redraw(void);
 static void calc_vlines(void);
 static void calc_vlines_wrapped(view_info_t *vi);
 static void calc_vlines_non_wrapped(view_info_t *vi);
+static int measure_line(const char line[], size_t len);
+static size_t measure_part(const char line[], size_t len, size_t max_width,
+		size_t *width);
+static int get_line_width(view_info_t *vi, int line);
+static const char * get_line(view_info_t *vi, int line, int rows);
+static int get_line_rows(view_info_t *vi, int line);
+static int pull_lines(view_info_t *vi);
+static int read_output(view_info_t *vi, int nlines);
+TSTATIC int split_output(view_output_t *out, char ***lines, int nlines,
+		int eof);
+static int wait_for_lines(view_info_t *vi, int all);
+static int follow_lines(view_info_t *vi);
 static void draw(void);
 static int get_part(const char line[], int offset, size_t max_len, char part[]);
 static void display_error(const char error_msg[]);
@@ -161,6 +211,9 @@ static void cmd_R(key_info_t key_info, keys_info_t *keys_info);
 static int load_view_data(view_info_t *vi, const char action[],
 		const char file_to_view[], int silent);
 static int get_view_data(view_info_t *vi, const char file_to_view[]);
+static int map_file(view_info_t *vi, const char path[]);
+static int start_output(view_info_t *vi, const char cmd[]);
+static void close_output(view_info_t *vi);
 static void replace_vi(view_info_t *const orig, view_info_t *const new);
 static void cmd_b(key_info_t key_info, keys_info_t *keys_info);
 static void cmd_d(key_info_t key_info, keys_info_t *keys_info);
@@ -441,7 +494,8 @@ view_post(void)
 void
 view_ruler_update(void)
 {
-	char buf[POS_WIN_MIN_WIDTH + 1];
+	/* Line numbers of mapped files can be longer than the minimal width. */
+	char buf[64];
 	snprintf(buf, sizeof(buf), "%d-%d ", vi->line + 1, vi->nlines);
 
 	ui_ruler_set(buf);
@@ -538,6 +592,10 @@ init_view_info(view_info_t *vi)
 	vi->nlines = 0;
 	vi->lines = NULL;
 	vi->widths = NULL;
+	vi->index = NULL;
+	vi->line_buf = NULL;
+	vi->fd = -1;
+	vi->pid = (pid_t)-1;
 	vi->filename = NULL;
 	vi->viewer = NULL;
 }
@@ -546,8 +604,11 @@ init_view_info(view_info_t *vi)
 static void
 free_view_info(view_info_t *vi)
 {
+	close_output(vi);
 	free_string_array(vi->lines, vi->nlines);
 	free(vi->widths);
+	li_close(vi->index);
+	free(vi->line_buf);
 	if(vi->last_search_backward != -1)
 	{
 		regfree(&vi->re);
@@ -597,8 +658,7 @@ calc_vlines_wrapped(view_info_t *vi)
 	for(i = 0; i < vi->nlines; i++)
 	{
 		vi->widths[i][0] = vi->nlinesv++;
-		vi->widths[i][1] = utf8_strsw_with_tabs(vi->lines[i], cfg.tab_stop) -
-			esc_str_overhead(vi->lines[i]);
+		vi->widths[i][1] = get_line_width(vi, i);
 		vi->nlinesv += vi->widths[i][1]/vi->width;
 	}
 }
@@ -616,6 +676,433 @@ calc_vlines_non_wrapped(view_info_t *vi)
 	}
 }
 
+/* Computes screen width of a line of mapped file, which is len bytes long and
+ * isn't null-terminated.  Unlike width of lines that are read in whole, this
+ * one accounts for backspaces and doesn't count escape sequences in tab stops,
+ * which is cheaper to compute in place.  Invoked on indexing thread.  Returns
+ * the width. */
+static int
+measure_line(const char line[], size_t len)
+{
+	size_t width;
+	(void)measure_part(line, len, (size_t)-1, &width);
+	return MIN(width, (size_t)INT_MAX);
+}
+
+/* Finds how many leading bytes out of len bytes of the line fit into max_width
+ * screen columns.  The line doesn't need to be null-terminated.  Escape
+ * sequences take no space and tabulation is expanded.  Sets *width to screen
+ * width of the part.  Returns length of the part. */
+static size_t
+measure_part(const char line[], size_t len, size_t max_width, size_t *width)
+{
+	const char *p = line;
+	const char *const end = line + len;
+	size_t w = 0U;
+
+	while(p < end)
+	{
+		size_t char_width;
+		size_t char_screen_width;
+
+		if(*p == '\033')
+		{
+			const char *const m = memchr(p, 'm', end - p);
+			p = (m == NULL) ? end : m + 1;
+			continue;
+		}
+
+		/* Backspace moves back like it does on drawing. */
+		if(*p == '\b')
+		{
+			w -= (w > 0U);
+			++p;
+			continue;
+		}
+
+		if((unsigned char)*p < 0x80)
+		{
+			char_width = 1U;
+			char_screen_width = (*p == '\t') ? cfg.tab_stop - w%cfg.tab_stop : 1U;
+		}
+		else
+		{
+			char tail[5] = "";
+			const char *c = p;
+			/* Don't let decoding of truncated character look past the end. */
+			if(end - p < 4)
+			{
+				memcpy(tail, p, end - p);
+				c = tail;
+			}
+			char_width = utf8_chrw(c);
+			char_screen_width = utf8_chrsw(c);
+		}
+
+		if(w + char_screen_width > max_width)
+		{
+			break;
+		}
+
+		w += char_screen_width;
+		p += char_width;
+	}
+
+	*width = w;
+	return p - line;
+}
+
+/* Retrieves screen width of real line of the view.  Returns the width. */
+static int
+get_line_width(view_info_t *vi, int line)
+{
+	const char *text;
+
+	if(vi->index != NULL)
+	{
+		return li_measure(vi->index, line);
+	}
+
+	text = vi->lines[line];
+	return utf8_strsw_with_tabs(text, cfg.tab_stop) - esc_str_overhead(text);
+}
+
+/* Retrieves real line of the view.  For mapped files only leading part of the
+ * line that is enough to fill rows screen lines is retrieved.  Returns the
+ * line, which for mapped files remains valid only until the next call. */
+static const char *
+get_line(view_info_t *vi, int line, int rows)
+{
+	/* Tabulation might be expanded differently at the beginning of a screen
+	 * line, hence the extra columns. */
+	const size_t max_width =
+		(size_t)MAX(rows, 1)*(ui_qv_width(vi->view) + cfg.tab_stop);
+	/* Enough for a line of plain text, lines with escape sequences or wide
+	 * characters might need more. */
+	size_t max_len = max_width;
+
+	if(vi->index == NULL)
+	{
+		return vi->lines[line];
+	}
+
+	while(1)
+	{
+		size_t len;
+		size_t width;
+		size_t part_len;
+
+		if(max_len + 1U > vi->line_buf_len)
+		{
+			char *const buf = realloc(vi->line_buf, max_len + 1U);
+			if(buf == NULL)
+			{
+				return "";
+			}
+			vi->line_buf = buf;
+			vi->line_buf_len = max_len + 1U;
+		}
+
+		len = li_get(vi->index, line, vi->line_buf, max_len);
+		part_len = measure_part(vi->line_buf, len, max_width, &width);
+		if(part_len < len || len < max_len || max_len > (size_t)-1/2U)
+		{
+			vi->line_buf[part_len] = '\0';
+			return vi->line_buf;
+		}
+		max_len *= 2U;
+	}
+}
+
+/* Computes number of screen lines taken by real line of the view.  Returns the
+ * number. */
+static int
+get_line_rows(view_info_t *vi, int line)
+{
+	return (vi->wrap && vi->width > 0) ? vi->widths[line][1]/vi->width + 1 : 1;
+}
+
+/* Appends lines of mapped file that were indexed or lines of viewer output
+ * that were read since the last call.  Returns non-zero if part of the view on
+ * the screen might have changed, otherwise zero is returned. */
+static int
+pull_lines(view_info_t *vi)
+{
+	int i;
+	int nlines;
+	int (*widths)[2];
+
+	if(vi->index != NULL)
+	{
+		int complete;
+		nlines = li_count(vi->index, &complete);
+	}
+	else if(vi->fd != -1)
+	{
+		nlines = read_output(vi, vi->nlines);
+	}
+	else
+	{
+		return 0;
+	}
+
+	if(nlines <= vi->nlines)
+	{
+		return 0;
+	}
+
+	widths = reallocarray(vi->widths, nlines, sizeof(*vi->widths));
+	if(widths == NULL)
+	{
+		if(vi->index == NULL)
+		{
+			/* Drop lines that can't be displayed. */
+			for(i = vi->nlines; i < nlines; ++i)
+			{
+				free(vi->lines[i]);
+			}
+		}
+		return 0;
+	}
+	vi->widths = widths;
+
+	/* If virtual lines weren't computed yet, calc_vlines() will do it. */
+	for(i = vi->nlines; i < nlines && vi->width > 0; ++i)
+	{
+		if(vi->wrap)
+		{
+			vi->widths[i][0] = vi->nlinesv++;
+			vi->widths[i][1] = get_line_width(vi, i);
+			vi->nlinesv += vi->widths[i][1]/vi->width;
+		}
+		else
+		{
+			vi->widths[i][0] = vi->nlinesv++;
+			vi->widths[i][1] = vi->width;
+		}
+	}
+
+	i = vi->nlines;
+	vi->nlines = nlines;
+	return (vi->view != NULL && i < vi->line + ui_qv_height(vi->view));
+}
+
+/* Reads output of the viewer that is available at the moment and appends its
+ * complete lines to the first nlines lines of the view.  Stops reading on end
+ * of the output or when out of memory.  Returns new number of lines. */
+static int
+read_output(view_info_t *vi, int nlines)
+{
+	size_t total = 0U;
+	int eof = 0;
+
+#ifndef _WIN32
+	while(total < OUTPUT_READ_LIMIT)
+	{
+		ssize_t n;
+
+		if(vi->out.len + OUTPUT_PIECE_LEN > vi->out.size)
+		{
+			const size_t size = vi->out.len + OUTPUT_PIECE_LEN;
+			char *const buf = realloc(vi->out.buf, size);
+			if(buf == NULL)
+			{
+				/* Can't read more, so keep what we have and stop waiting for output
+				 * that can't be consumed. */
+				eof = 1;
+				break;
+			}
+			vi->out.buf = buf;
+			vi->out.size = size;
+		}
+
+		n = read(vi->fd, vi->out.buf + vi->out.len, OUTPUT_PIECE_LEN);
+		if(n > 0)
+		{
+			vi->out.len += n;
+			total += n;
+			continue;
+		}
+
+		if(n == -1 && errno == EINTR)
+		{
+			continue;
+		}
+
+		eof = (n == 0 || errno != EAGAIN);
+		break;
+	}
+#else
+	eof = 1;
+#endif
+
+	nlines = split_output(&vi->out, &vi->lines, nlines, eof);
+	if(eof)
+	{
+		close_output(vi);
+	}
+	return nlines;
+}
+
+/* Breaks output of the viewer into lines in the same way as read_file_lines()
+ * does it and appends complete lines to the first nlines lines of the *lines
+ * array.  Incomplete last line is kept in the buffer unless eof is non-zero.
+ * Returns new number of lines. */
+TSTATIC int
+split_output(view_output_t *out, char ***lines, int nlines, int eof)
+{
+	const char *p = out->buf;
+	const char *const end = out->buf + out->len;
+
+	if(!out->bom_checked)
+	{
+		if(out->len < 3U && !eof)
+		{
+			return nlines;
+		}
+		if(out->len >= 3U && memcmp(p, "\xef\xbb\xbf", 3U) == 0)
+		{
+			p += 3;
+		}
+		out->bom_checked = 1;
+	}
+
+	while(p < end)
+	{
+		const char *eol;
+		char *line;
+
+		/* Skip the rest of line separator of the previous line. */
+		if(out->after_cr)
+		{
+			out->after_cr = 0;
+			if(*p == '\n')
+			{
+				++p;
+				continue;
+			}
+		}
+		if(out->after_nul)
+		{
+			if(*p == '\0')
+			{
+				++p;
+				continue;
+			}
+			out->after_nul = 0;
+		}
+
+		eol = li_find_eol(p, end);
+		if(eol == end && !eof)
+		{
+			break;
+		}
+
+		line = malloc(eol - p + 1);
+		if(line == NULL)
+		{
+			break;
+		}
+		memcpy(line, p, eol - p);
+		line[eol - p] = '\0';
+		if(put_into_string_array(lines, nlines, line) == nlines)
+		{
+			free(line);
+			break;
+		}
+		++nlines;
+
+		if(eol == end)
+		{
+			p = end;
+			break;
+		}
+
+		out->after_cr = (*eol == '\r');
+		out->after_nul = (*eol == '\0');
+		p = eol + 1;
+	}
+
+	out->len = end - p;
+	memmove(out->buf, p, out->len);
+	return nlines;
+}
+
+/* Waits until more lines of mapped file are indexed or viewer prints more
+ * lines, or until all of them are available if all is non-zero.  Returns
+ * non-zero if number of lines has changed, otherwise zero is returned. */
+static int
+wait_for_lines(view_info_t *vi, int all)
+{
+	const int nlines = vi->nlines;
+
+	if(vi->index != NULL)
+	{
+		int complete;
+		ui_cancellation_reset();
+		ui_cancellation_enable();
+		do
+		{
+			(void)li_wait(vi->index, vi->nlines, WAIT_POLL_PERIOD);
+			(void)pull_lines(vi);
+			(void)li_count(vi->index, &complete);
+		}
+		while(!complete && !ui_cancellation_requested() &&
+				(all || vi->nlines == nlines));
+		ui_cancellation_disable();
+	}
+#ifndef _WIN32
+	else if(vi->fd != -1)
+	{
+		ui_cancellation_reset();
+		ui_cancellation_enable();
+		do
+		{
+			fd_set read_ready;
+			struct timeval ts = { .tv_usec = WAIT_POLL_PERIOD*1000 };
+
+			FD_ZERO(&read_ready);
+			FD_SET(vi->fd, &read_ready);
+			if(select(vi->fd + 1, &read_ready, NULL, NULL, &ts) > 0)
+			{
+				(void)pull_lines(vi);
+			}
+		}
+		while(vi->fd != -1 && !ui_cancellation_requested() &&
+				(all || vi->nlines == nlines));
+
+		/* Viewer might never finish on its own (e.g., "tail -f"), so stop the
+		 * whole process group and take what it has printed so far. */
+		if(vi->fd != -1 && ui_cancellation_requested())
+		{
+			kill_process_group(vi->pid);
+			(void)pull_lines(vi);
+			close_output(vi);
+		}
+		ui_cancellation_disable();
+	}
+#endif
+
+	return (vi->nlines != nlines);
+}
+
+/* Appends new lines to the view and keeps it scrolled to the bottom in auto
+ * forwarding mode.  Returns non-zero if the view needs to be redrawn,
+ * otherwise zero is returned. */
+static int
+follow_lines(view_info_t *vi)
+{
+	const int nlines = vi->nlines;
+	int need_redraw = pull_lines(vi);
+
+	if(vi->auto_forward && vi->nlines != nlines)
+	{
+		need_redraw += scroll_to_bottom(vi);
+	}
+
+	return need_redraw;
+}
+
 static void
 draw(void)
 {
@@ -646,8 +1133,11 @@ draw(void)
 	{
 		int offset = 0;
 		int processed = 0;
-		char *const line = vi->lines[l];
-		char *p = searched ? esc_highlight_pattern(line, &vi->re) : line;
+		const int skipped = (l == vi->line) ? vi->linev - vi->widths[l][0] : 0;
+		const char *const line = get_line(vi, l,
+				vi->wrap ? skipped + height - vl : 1);
+		char *const hi = searched ? esc_highlight_pattern(line, &vi->re) : NULL;
+		const char *const p = searched ? hi : line;
 		do
 		{
 			int printed;
@@ -659,10 +1149,7 @@ draw(void)
 			++processed;
 		}
 		while(vi->wrap && p[offset] != '\0' && vl < height);
-		if(searched)
-		{
-			free(p);
-		}
+		free(hi);
 	}
 	refresh_view_win(vi->view);
 }
@@ -925,6 +1412,8 @@ cmd_percent(key_info_t key_info, keys_info_t *keys_info)
 	if(key_info.count > 100)
 		key_info.count = 100;
 
+	(void)wait_for_lines(vi, 1);
+
 	vi->line = (key_info.count*vi->nlinesv)/100;
 	if(vi->line >= vi->nlines)
 		vi->line = vi->nlines - 1;
@@ -999,6 +1488,7 @@ cmd_G(key_info_t key_info, keys_info_t *keys_info)
 		return;
 	}
 
+	(void)wait_for_lines(vi, 1);
 	if(scroll_to_bottom(vi))
 	{
 		draw();
@@ -1052,7 +1542,9 @@ load_view_data(view_info_t *vi, const char action[], const char file_to_view[],
 			return 1;
 	}
 
-	vi->widths = reallocarray(NULL, vi->nlines, sizeof(*vi->widths));
+	/* Mapped file or output of a viewer might already have some widths
+	 * allocated. */
+	vi->widths = reallocarray(vi->widths, vi->nlines, sizeof(*vi->widths));
 	if(vi->widths == NULL)
 	{
 		free_string_array(vi->lines, vi->nlines);
@@ -1082,6 +1574,10 @@ get_view_data(view_info_t *vi, const char file_to_view[])
 			fp = qv_view_dir(file_to_view);
 			ui_cancellation_disable();
 		}
+		else if(map_file(vi, file_to_view) == 0)
+		{
+			return (vi->nlines == 0) ? 4 : 0;
+		}
 		else
 		{
 			fp = os_fopen(file_to_view, "rb");
@@ -1099,6 +1595,7 @@ get_view_data(view_info_t *vi, const char file_to_view[])
 		const char *const v = (vi->viewer != NULL) ? vi->viewer : viewer;
 		const int graphics = is_graphics_viewer(v);
 		FileView *const curr = curr_view;
+		char *cmd;
 		curr_view = curr_stats.view ? curr_view
 		          : (vi->view != NULL) ? vi->view : curr_view;
 		curr_stats.preview_hint = vi->view;
@@ -1111,19 +1608,31 @@ get_view_data(view_info_t *vi, const char file_to_view[])
 		}
 		if(vi->viewer == NULL)
 		{
-			fp = qv_execute_viewer(viewer);
+			cmd = qv_expand_viewer(viewer);
 		}
 		else
 		{
 			/* Don't add implicit %c to a command with %e macro. */
-			char *const cmd = expand_macros(vi->viewer, NULL, NULL, 1);
-			fp = read_cmd_output(cmd);
-			free(cmd);
+			cmd = expand_macros(vi->viewer, NULL, NULL, 1);
 		}
 
 		curr_view = curr;
 		curr_stats.preview_hint = NULL;
 
+#ifndef _WIN32
+		/* Output of graphics viewers is read in whole, because it's the terminal
+		 * that displays it. */
+		if(!graphics)
+		{
+			const int error = start_output(vi, cmd);
+			free(cmd);
+			return error;
+		}
+#endif
+
+		fp = read_cmd_output(cmd);
+		free(cmd);
+
 		if(fp == NULL)
 		{
 			return 3;
@@ -1150,6 +1659,100 @@ get_view_data(view_info_t *vi, const char file_to_view[])
 	return 0;
 }
 
+/* Maps large file into memory and waits for the first lines to be indexed.
+ * Returns zero if file is mapped, otherwise non-zero is returned. */
+static int
+map_file(view_info_t *vi, const char path[])
+{
+	struct stat st;
+
+	/* Mapping isn't worth it for small files and is less robust against
+	 * truncation of the file while it's being viewed. */
+	if(os_stat(path, &st) != 0 || st.st_size < MAPPED_FILE_MIN_SIZE)
+	{
+		return 1;
+	}
+
+	vi->index = li_open(path, &measure_line);
+	if(vi->index == NULL)
+	{
+		return 1;
+	}
+
+	vi->nlines = 0;
+	(void)wait_for_lines(vi, 0);
+	if(vi->nlines == 0)
+	{
+		li_close(vi->index);
+		vi->index = NULL;
+	}
+	return 0;
+}
+
+/* Starts viewer in background and reads its output until the first screen is
+ * filled, the rest of it is read as it arrives.  Returns zero on success, 3 on
+ * issues with viewer or 4 on empty output. */
+static int
+start_output(view_info_t *vi, const char cmd[])
+{
+#ifndef _WIN32
+	vi->fd = read_cmd_output_async(cmd, &vi->pid);
+	if(vi->fd == -1)
+	{
+		return 3;
+	}
+
+	vi->nlines = 0;
+	(void)wait_for_lines(vi, 0);
+
+	/* Keep reading while output arrives fast enough to fill the screen. */
+	while(vi->fd != -1 && vi->nlines < ui_qv_height(vi->view))
+	{
+		const int nlines = vi->nlines;
+		usleep(OUTPUT_FILL_DELAY);
+		(void)pull_lines(vi);
+		if(vi->nlines == nlines)
+		{
+			break;
+		}
+	}
+
+	if(vi->nlines == 0)
+	{
+		close_output(vi);
+		return 4;
+	}
+
+	return 0;
+#else
+	(void)vi;
+	(void)cmd;
+	return 3;
+#endif
+}
+
+/* Stops reading output of the viewer killing it if it's still running. */
+static void
+close_output(view_info_t *vi)
+{
+#ifndef _WIN32
+	if(vi->fd == -1)
+	{
+		return;
+	}
+
+	close(vi->fd);
+	kill_process_group(vi->pid);
+	vi->fd = -1;
+	vi->pid = (pid_t)-1;
+
+	free(vi->out.buf);
+	memset(&vi->out, '\0', sizeof(vi->out));
+#else
+	(void)vi;
+#endif
+}
+
 /* Replaces view_info_t structure with another one preserving as much as
  * possible. */
 static void
@@ -1217,6 +1820,9 @@ cmd_g(key_info_t key_info, keys_info_t *keys_info)
 	if(key_info.count == NO_COUNT_GIVEN)
 		key_info.count = 1;
 
+	/* The line might be in a part of mapped file that isn't indexed yet. */
+	while(key_info.count > vi->nlines && wait_for_lines(vi, 0));
+
 	key_info.count = MIN(vi->nlinesv - ui_qv_height(vi->view), key_info.count);
 	key_info.count = MAX(1, key_info.count);
 
@@ -1230,6 +1836,8 @@ cmd_g(key_info_t key_info, keys_info_t *keys_info)
 static void
 cmd_j(key_info_t key_info, keys_info_t *keys_info)
 {
+	(void)pull_lines(vi);
+
 	if(key_info.reg == NO_REG_GIVEN)
 	{
 		if((vi->linev + 1) + ui_qv_height(vi->view) > vi->nlinesv)
@@ -1339,7 +1947,8 @@ find_previous(int vline_offset)
 		l--;
 
 	for(i = 0; i <= vl - vi->widths[l][0]; i++)
-		offset = get_part(vi->lines[l], offset, ui_qv_width(vi->view), buf);
+		offset = get_part(get_line(vi, l, get_line_rows(vi, l)), offset,
+				ui_qv_width(vi->view), buf);
 
 	/* Don't stop until we go above first virtual line of the first line. */
 	while(l >= 0 && vl >= 0)
@@ -1355,10 +1964,12 @@ find_previous(int vline_offset)
 			l--;
 			offset = 0;
 			for(i = 0; i <= vl - 1 - vi->widths[l][0]; i++)
-				offset = get_part(vi->lines[l], offset, ui_qv_width(vi->view), buf);
+				offset = get_part(get_line(vi, l, get_line_rows(vi, l)), offset,
+						ui_qv_width(vi->view), buf);
 		}
 		else
-			offset = get_part(vi->lines[l], offset, ui_qv_width(vi->view), buf);
+			offset = get_part(get_line(vi, l, get_line_rows(vi, l)), offset,
+					ui_qv_width(vi->view), buf);
 		vl--;
 	}
 	draw();
@@ -1383,7 +1994,8 @@ find_next(void)
 		l++;
 
 	for(i = 0; i <= vl - vi->widths[l][0]; i++)
-		offset = get_part(vi->lines[l], offset, ui_qv_width(vi->view), buf);
+		offset = get_part(get_line(vi, l, get_line_rows(vi, l)), offset,
+				ui_qv_width(vi->view), buf);
 
 	while(l < vi->nlines)
 	{
@@ -1393,6 +2005,9 @@ find_next(void)
 			vi->line = l;
 			break;
 		}
+		/* Rest of mapped file might be still being indexed. */
+		if(l == vi->nlines - 1)
+			(void)wait_for_lines(vi, 0);
 		if(l < vi->nlines && (l == vi->nlines - 1 ||
 				vl + 1 >= vi->widths[l + 1][0]))
 		{
@@ -1401,7 +2016,8 @@ find_next(void)
 			l++;
 			offset = 0;
 		}
-		offset = get_part(vi->lines[l], offset, ui_qv_width(vi->view), buf);
+		offset = get_part(get_line(vi, l, get_line_rows(vi, l)), offset,
+				ui_qv_width(vi->view), buf);
 		vl++;
 	}
 	draw();
@@ -1603,6 +2219,28 @@ view_check_for_updates(void)
 	}
 }
 
+void
+view_check_for_output(void)
+{
+	const int nlines = vi->nlines;
+	int need_redraw = 0;
+
+	need_redraw += follow_lines(&view_info[VI_QV]);
+	need_redraw += follow_lines(&view_info[VI_LWIN]);
+	need_redraw += follow_lines(&view_info[VI_RWIN]);
+
+	if(vle_mode_is(VIEW_MODE) && vi->nlines != nlines)
+	{
+		view_ruler_update();
+		doupdate();
+	}
+
+	if(need_redraw)
+	{
+		schedule_redraw();
+	}
+}
+
 /* Forwards the view if underlying file changed.  Returns non-zero if reload
  * occurred, otherwise zero is returned. */
 static int
@@ -1625,6 +2263,13 @@ forward_if_changed(view_info_t *vi)
 		return 0;
 	}
 
+	/* Output of running viewer is followed by view_check_for_output(). */
+	if(vi->fd != -1)
+	{
+		filemon_assign(&vi->file_mon, &mon);
+		return 0;
+	}
+
 	filemon_assign(&vi->file_mon, &mon);
 	reload_view(vi, SILENT);
 	return scroll_to_bottom(vi);
@@ -19,7 +19,22 @@
 #ifndef VIFM__MODES__VIEW_H__
 #define VIFM__MODES__VIEW_H__
 
+#include <stddef.h> /* size_t */
+
 #include "../ui/ui.h"
+#include "../utils/test_helpers.h"
+
+/* Output of a viewer that isn't broken into lines yet. */
+typedef struct
+{
+	char *buf;       /* Output that isn't split into lines yet. */
+	size_t len;      /* Length of the output in buf. */
+	size_t size;     /* Size of the buf. */
+	int bom_checked; /* Whether leading UTF-8 BOM was looked for. */
+	int after_cr;    /* Whether last line ended with '\r'. */
+	int after_nul;   /* Whether last line ended with '\0'. */
+}
+view_output_t;
 
 /* Initializes view mode. */
 void init_view_mode(void);
@@ -64,6 +79,14 @@ int draw_abandoned_view_mode(void);
 /* Checks whether contents of either view should be updated. */
 void view_check_for_updates(void);
 
+/* Appends lines that became available to views which read them in background
+ * and follows them in auto forwarding mode. */
+void view_check_for_output(void);
+
+TSTATIC_DEFS(
+	int split_output(view_output_t *out, char ***lines, int nlines, int eof);
+)
+
 #endif /* VIFM__MODES__VIEW_H__ */
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
@@ -178,6 +178,7 @@ ops_alloc(OPS main_op, int bg, const char descr[], const char base_dir[],
 	update_string(&ops->delete_prg, cfg.delete_prg);
 	ops->use_system_calls = cfg.use_system_calls;
 	ops->fast_file_cloning = cfg.fast_file_cloning;
+	ops->io_threads = cfg.io_threads;
 	ops->base_dir = strdup(base_dir);
 	ops->target_dir = strdup(target_dir);
 	ops->bg = bg;
@@ -436,6 +437,7 @@ op_cp(ops_t *ops, void *data, const char src[], const char dst[],
 	const int fast_file_cloning = (ops == NULL)
 	                             ? cfg.fast_file_cloning
 	                             : ops->fast_file_cloning;
+	const int io_threads = (ops == NULL) ? cfg.io_threads : ops->io_threads;
 
 	if(!ops_uses_syscalls(ops))
 	{
@@ -501,6 +503,7 @@ op_cp(ops_t *ops, void *data, const char src[], const char dst[],
 		.arg2.dst = dst,
 		.arg3.crs = ca_to_crs(conflict_action),
 		.arg4.fast_file_cloning = fast_file_cloning,
+		.arg5.max_parallel = io_threads,
 	};
 	return exec_io_op(ops, &ior_cp, &args, data == NULL);
 }
@@ -602,6 +605,7 @@ op_mv(ops_t *ops, void *data, const char src[], const char dst[],
 			.arg3.crs = ca_to_crs(conflict_action),
 			/* It's safe to always use fast file cloning on moving files. */
 			.arg4.fast_file_cloning = 1,
+			.arg5.max_parallel = (ops == NULL) ? cfg.io_threads : ops->io_threads,
 		};
 		result = exec_io_op(ops, &ior_mv, &args, data == NULL);
 	}
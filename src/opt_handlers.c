@@ -116,6 +116,7 @@ static void cpoptions_handler(OPT_OP op, optval_t val);
 static void cvoptions_handler(OPT_OP op, optval_t val);
 static void deleteprg_handler(OPT_OP op, optval_t val);
 static void dirsize_handler(OPT_OP op, optval_t val);
+static void diskusage_handler(OPT_OP op, optval_t val);
 static void dotdirs_handler(OPT_OP op, optval_t val);
 static void fastrun_handler(OPT_OP op, optval_t val);
 static void fillchars_handler(OPT_OP op, optval_t val);
@@ -131,6 +132,7 @@ static void iec_handler(OPT_OP op, optval_t val);
 static void ignorecase_handler(OPT_OP op, optval_t val);
 static void incsearch_handler(OPT_OP op, optval_t val);
 static void iooptions_handler(OPT_OP op, optval_t val);
+static void iothreads_handler(OPT_OP op, optval_t val);
 static int parse_range(const char range[], int *from, int *to);
 static int parse_endpoint(const char **str, int *endpoint);
 static void laststatus_handler(OPT_OP op, optval_t val);
@@ -420,6 +422,7 @@ static const char *vifminfo_set[][2] = {
 	{ "registers", "contents of registers" },
 	{ "phistory",  "prompt history" },
 	{ "fhistory",  "local filter history" },
+	{ "dirsizes",  "calculated directory sizes" },
 };
 
 /* Possible values of 'wildstyle'. */
@@ -495,6 +498,10 @@ options[] = {
 	  OPT_ENUM, ARRAY_LEN(dirsize_enum), dirsize_enum, &dirsize_handler, NULL,
 	  { .init = &init_dirsize },
 	},
+	{ "diskusage", "", "count allocated space in directory sizes",
+	  OPT_BOOL, 0, NULL, &diskusage_handler, NULL,
+	  { .ref.bool_val = &cfg.disk_usage },
+	},
 	{ "dotdirs", "", "which dot directories to show",
 	  OPT_SET, ARRAY_LEN(dotdirs_vals), dotdirs_vals, &dotdirs_handler, NULL,
 	  { .ref.set_items = &cfg.dot_dirs },
@@ -553,6 +560,10 @@ options[] = {
 		NULL,
 	  { .init = &init_iooptions },
 	},
+	{ "iothreads", "", "number of files copied in parallel",
+	  OPT_INT, 0, NULL, &iothreads_handler, NULL,
+	  { .ref.int_val = &cfg.io_threads },
+	},
 	{ "laststatus", "ls", "visibility of status bar",
 	  OPT_BOOL, 0, NULL, &laststatus_handler, NULL,
 	  { .ref.bool_val = &cfg.display_statusline },
@@ -1638,6 +1649,13 @@ dirsize_handler(OPT_OP op, optval_t val)
 	update_screen(UT_REDRAW);
 }
 
+/* Handles changes of 'diskusage'.  Affects only sizes calculated afterwards. */
+static void
+diskusage_handler(OPT_OP op, optval_t val)
+{
+	cfg.disk_usage = val.bool_val;
+}
+
 static void
 dotdirs_handler(OPT_OP op, optval_t val)
 {
@@ -1786,6 +1804,22 @@ iooptions_handler(OPT_OP op, optval_t val)
 	cfg.fast_file_cloning = ((val.set_items & 1) != 0);
 }
 
+/* Handles changes of 'iothreads'.  Value must be positive. */
+static void
+iothreads_handler(OPT_OP op, optval_t val)
+{
+	if(val.int_val <= 0)
+	{
+		vle_tb_append_linef(vle_err, "Argument must be > 0: %d", val.int_val);
+		error = 1;
+		val.int_val = cfg.io_threads;
+		set_option("iothreads", val, OPT_GLOBAL);
+		return;
+	}
+
+	cfg.io_threads = val.int_val;
+}
+
 /* Parses range, which can be shortened to single endpoint if first element
  * matches last one.  Returns non-zero on error, otherwise zero is returned. */
 static int
@@ -2276,6 +2310,7 @@ set_sortgroups(FileView *view, char **opt, char value[])
 		{
 			regfree(&view->primary_group);
 			(void)regcomp(&view->primary_group, first, REG_EXTENDED | REG_ICASE);
+			sort_reset_groups_cache(view);
 		}
 		free(first);
 	}
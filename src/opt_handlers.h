@@ -39,6 +39,7 @@ enum
 	VIFMINFO_REGISTERS = 1 << 13,
 	VIFMINFO_PHISTORY  = 1 << 14,
 	VIFMINFO_FHISTORY  = 1 << 15,
+	VIFMINFO_DIRSIZES  = 1 << 16,
 };
 
 void init_option_handlers(void);
@@ -19,15 +19,17 @@
 
 #include "sort.h"
 
-#include <regex.h> /* regex_t regcomp() regexec() regfree() */
+#include <regex.h> /* regex_t regmatch_t regcomp() regfree() */
 
 #include <assert.h> /* assert() */
 #include <ctype.h>
-#include <stdlib.h> /* abs() qsort() */
-#include <string.h> /* strcmp() strrchr() */
+#include <stdint.h> /* int64_t uint64_t */
+#include <stdlib.h> /* abs() free() qsort() */
+#include <string.h> /* memcpy() strcmp() strdup() strrchr() */
 
 #include "cfg/config.h"
 #include "compat/fs_limits.h"
+#include "compat/reallocarray.h"
 #include "ui/ui.h"
 #include "utils/dynarray.h"
 #include "utils/fs.h"
@@ -43,41 +45,92 @@
 #include "status.h"
 #include "types.h"
 
+/* Sorting key prepared for sorting. */
+typedef struct
+{
+	SortingKey key;       /* Property of entries to compare. */
+	int descending;       /* Whether order is reversed. */
+	const regex_t *regex; /* Grouping regular expression for SK_BY_GROUPS. */
+}
+sort_key_t;
+
+/* Collation key of a file name.  Memory is allocated only when the name needs
+ * to be copied or its normalized version differs from it. */
+typedef struct
+{
+	const char *name; /* Name or short path of the entry, NULL on error. */
+	const char *key;  /* Normalized name, which is compared first. */
+	char *buf;        /* Storage for name and/or key or NULL. */
+}
+name_key_t;
+
+/* Value of a sorting key for an entry, which is computed once per sorting. */
+typedef union
+{
+	uint64_t num;     /* Numeric value (size, ids, rank of group match, etc.). */
+	int64_t time;     /* Timestamp. */
+	char *str;        /* String value (link target, permissions, etc.). */
+	name_key_t name;  /* Name of the entry. */
+}
+sort_value_t;
+
+/* Entry of a sequence prepared for sorting. */
+typedef struct
+{
+	const dir_entry_t *entry; /* The entry itself. */
+	sort_value_t *values;     /* Values of sorting keys. */
+	int idx;                  /* Original position, makes sorting stable. */
+	int is_dir;               /* Whether the entry is a directory. */
+	int is_parent;            /* Whether the entry is "..". */
+}
+sort_item_t;
+
 static void sort_tree_slice(dir_entry_t *entries, const dir_entry_t *children,
 		size_t nchildren, int root);
+static void prepare_keys(FileView *v);
+static void add_group_keys(FileView *v, int descending);
+static void compile_groups(FileView *v);
+static void add_key(SortingKey key, int descending, const regex_t *regex);
+static void free_keys(void);
 static void sort_sequence(dir_entry_t *entries, size_t nentries);
-static void sort_by_groups(dir_entry_t *entries, size_t nentries);
-static void sort_by_key(dir_entry_t *entries, size_t nentries, char key,
-		void *data);
-static int sort_dir_list(const void *one, const void *two);
+static void init_item(sort_item_t *item, const dir_entry_t *entry, int idx,
+		sort_value_t values[]);
+static void free_item(sort_item_t *item);
+static void rank_group_matches(sort_item_t items[], size_t nitems, int k);
+static int compare_group_matches(const void *one, const void *two);
+static int compare_matches(const char a[], const char b[]);
+static sort_value_t get_value(const sort_key_t *key, const dir_entry_t *entry,
+		int is_dir);
+static void free_value(const sort_key_t *key, sort_value_t *value);
+static int compare_items(const void *one, const void *two);
+static int compare_values(const sort_key_t *key, const sort_item_t *a,
+		const sort_item_t *b, int k);
+static int compare_extensions(const dir_entry_t *f, int fdir,
+		const dir_entry_t *s, int sdir, int dirs_first);
+static name_key_t make_name_key(const char name[], int copy,
+		int ignore_case);
+static int compare_name_keys(const name_key_t *a, const name_key_t *b,
+		int ignore_case);
 TSTATIC int strnumcmp(const char s[], const char t[]);
 #if !defined(HAVE_STRVERSCMP_FUNC) || !HAVE_STRVERSCMP_FUNC
 static int vercmp(const char s[], const char t[]);
 #else
 static char * skip_leading_zeros(const char str[]);
 #endif
-static int compare_entry_names(const dir_entry_t *a, const dir_entry_t *b,
-		int ignore_case);
-static int compare_full_file_names(const char s[], const char t[],
-		int ignore_case);
 static int compare_file_names(const char s[], const char t[], int ignore_case);
-static int compare_file_sizes(const dir_entry_t *f, int fdir,
-		const dir_entry_t *s, int sdir);
-static int compare_item_count(const dir_entry_t *f, int fdir,
-		const dir_entry_t *s, int sdir);
-static int compare_group(const char f[], const char s[], regex_t *regex);
-static int compare_targets(const dir_entry_t *f, const dir_entry_t *s);
 
 /* View which is being sorted. */
 static FileView* view;
 /* Whether the view displays custom file list. */
 static int custom_view;
-/* Whether it's descending sort. */
-static int sort_descending;
-/* Key used to sort entries in current sorting round. */
-static SortingKey sort_type;
-/* Sorting key specific data. */
-static void *sort_data;
+/* Keys to sort by in order of their significance. */
+static sort_key_t *keys;
+/* Number of elements in the keys array. */
+static int nkeys;
+/* Index of a key whose group matches are being ranked. */
+static int rank_key;
+/* Whether values of group keys are ranks rather than matched strings. */
+static int groups_ranked;
 
 void
 sort_view(FileView *v)
@@ -92,12 +145,14 @@ sort_view(FileView *v)
 
 	view = v;
 	custom_view = flist_custom_active(v);
+	prepare_keys(v);
 
 	if(!custom_view || v->custom.type != CV_TREE)
 	{
 		/* Tree sorting works fine for flat list, but requires a bit more
 		 * resources, so skip it. */
 		sort_sequence(&v->dir_entry[0], v->list_rows);
+		free_keys();
 		return;
 	}
 
@@ -122,6 +177,75 @@ sort_view(FileView *v)
 	{
 		filter_temporary_nodes(v, unsorted_list);
 	}
+
+	free_keys();
+}
+
+void
+sort_entries(FileView *v, dir_entry_t entries[], size_t nentries)
+{
+	if(v->sort[0] > SK_LAST)
+	{
+		return;
+	}
+
+	view = v;
+	custom_view = flist_custom_active(v);
+	prepare_keys(v);
+	sort_sequence(entries, nentries);
+	free_keys();
+}
+
+int
+sort_find_position(FileView *v, const dir_entry_t *entry)
+{
+	int lo = 0, hi = v->list_rows;
+	sort_item_t item;
+	sort_value_t *values;
+
+	if(v->sort[0] > SK_LAST)
+	{
+		return v->list_rows;
+	}
+
+	view = v;
+	custom_view = flist_custom_active(v);
+	prepare_keys(v);
+
+	values = reallocarray(NULL, nkeys*2 + 1U, sizeof(*values));
+	if(values == NULL)
+	{
+		free_keys();
+		return v->list_rows;
+	}
+
+	/* Index past the end puts the entry after all its equals. */
+	init_item(&item, entry, v->list_rows, &values[0]);
+
+	while(lo < hi)
+	{
+		const int mid = lo + (hi - lo)/2;
+		sort_item_t probe;
+		int result;
+
+		init_item(&probe, &v->dir_entry[mid], mid, &values[nkeys]);
+		result = compare_items(&probe, &item);
+		free_item(&probe);
+
+		if(result < 0)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	free_item(&item);
+	free(values);
+	free_keys();
+	return lo;
 }
 
 /* Sorts one level of a tree per invocation, recurring to sort all nested
@@ -161,433 +285,707 @@ sort_tree_slice(dir_entry_t *entries, const dir_entry_t *children,
 	}
 }
 
-/* Sorts sequence of file entries (plain list, not tree). */
+/* Fills list of sorting keys for the view.  Stable sorting by each of keys of
+ * the view in reverse order is equivalent to single sorting that compares keys
+ * one by one, so that's what the list describes. */
 static void
-sort_sequence(dir_entry_t *entries, size_t nentries)
+prepare_keys(FileView *v)
 {
-	int i = SK_COUNT;
-	while(--i >= 0)
+	int i;
+
+	if(!ui_view_sort_list_contains(v->sort, SK_BY_DIR))
+	{
+		add_key(SK_BY_DIR, 0, NULL);
+	}
+
+	/* Don't keep compiled groups around after the view stops using them. */
+	if(!ui_view_sort_list_contains(v->sort, SK_BY_GROUPS))
 	{
-		const char sorting_key = view->sort[i];
+		sort_reset_groups_cache(v);
+	}
+
+	for(i = 0; i < SK_COUNT; ++i)
+	{
+		const char sorting_key = v->sort[i];
 
 		if(abs(sorting_key) > SK_LAST)
 		{
 			continue;
 		}
 
-		if(sorting_key == SK_BY_GROUPS)
+		if(abs(sorting_key) == SK_BY_GROUPS)
 		{
-			sort_by_groups(entries, nentries);
+			add_group_keys(v, sorting_key < 0);
 			continue;
 		}
 
-		sort_by_key(entries, nentries, sorting_key, NULL);
+		add_key(abs(sorting_key), sorting_key < 0, NULL);
+	}
+}
+
+/* Adds one key per sorting group to the list of keys. */
+static void
+add_group_keys(FileView *v, int descending)
+{
+	int i;
+
+	if(v->sort_groups_cache.src == NULL ||
+			strcmp(v->sort_groups_cache.src, v->sort_groups) != 0)
+	{
+		compile_groups(v);
 	}
 
-	if(!ui_view_sort_list_contains(view->sort, SK_BY_DIR))
+	if(v->sort_groups_cache.ngroups != 0)
 	{
-		sort_by_key(entries, nentries, SK_BY_DIR, NULL);
+		add_key(SK_BY_GROUPS, descending, &v->primary_group);
+	}
+
+	for(i = 0; i < v->sort_groups_cache.nregexes; ++i)
+	{
+		add_key(SK_BY_GROUPS, descending, &v->sort_groups_cache.regexes[i]);
 	}
 }
 
-/* Sorts specified range of entries according to sorting groups option. */
+/* Fills cache of compiled secondary sorting groups of the view.  The primary
+ * group is compiled by option handler.  On error the cache is left empty, which
+ * disables sorting by groups. */
 static void
-sort_by_groups(dir_entry_t *entries, size_t nentries)
+compile_groups(FileView *v)
 {
 	char **groups = NULL;
 	int ngroups = 0;
 	int i;
+	char *copy;
+	char *group, *state = NULL;
+
+	sort_reset_groups_cache(v);
+
+	copy = strdup(v->sort_groups);
+	if(copy == NULL)
+	{
+		return;
+	}
 
-	char *const copy = strdup(view->sort_groups);
-	char *group = copy, *state = NULL;
+	group = copy;
 	while((group = split_and_get(group, ',', &state)) != NULL)
 	{
 		ngroups = add_to_string_array(&groups, ngroups, 1, group);
 	}
 	free(copy);
 
-	for(i = ngroups - 1; i >= 1; --i)
+	v->sort_groups_cache.src = strdup(v->sort_groups);
+	v->sort_groups_cache.regexes = reallocarray(NULL, ngroups,
+			sizeof(*v->sort_groups_cache.regexes));
+	if(v->sort_groups_cache.src == NULL || v->sort_groups_cache.regexes == NULL)
 	{
-		regex_t regex;
-		(void)regcomp(&regex, groups[i], REG_EXTENDED | REG_ICASE);
-		sort_by_key(entries, nentries, SK_BY_GROUPS, &regex);
-		regfree(&regex);
+		free_string_array(groups, ngroups);
+		sort_reset_groups_cache(v);
+		return;
 	}
-	if(ngroups != 0)
+
+	v->sort_groups_cache.ngroups = ngroups;
+	for(i = 1; i < ngroups; ++i)
 	{
-		sort_by_key(entries, nentries, SK_BY_GROUPS, &view->primary_group);
+		regex_t *const regex =
+			&v->sort_groups_cache.regexes[v->sort_groups_cache.nregexes];
+		if(regcomp(regex, groups[i], REG_EXTENDED | REG_ICASE) == 0)
+		{
+			++v->sort_groups_cache.nregexes;
+		}
 	}
 
 	free_string_array(groups, ngroups);
 }
 
-/* Sorts specified range of entries by the key in a stable way. */
-static void
-sort_by_key(dir_entry_t *entries, size_t nentries, char key, void *data)
+void
+sort_reset_groups_cache(FileView *view)
 {
-	unsigned int i;
-
-	if(nentries == 0U)
+	int i;
+	for(i = 0; i < view->sort_groups_cache.nregexes; ++i)
 	{
-		return;
+		regfree(&view->sort_groups_cache.regexes[i]);
 	}
+	free(view->sort_groups_cache.regexes);
+	view->sort_groups_cache.regexes = NULL;
+	view->sort_groups_cache.nregexes = 0;
+	view->sort_groups_cache.ngroups = 0;
+	update_string(&view->sort_groups_cache.src, NULL);
+}
 
-	sort_descending = (key < 0);
-	sort_type = (SortingKey)abs(key);
-	sort_data = data;
-
-	for(i = 0U; i < nentries; ++i)
+/* Appends a key to the list of sorting keys. */
+static void
+add_key(SortingKey key, int descending, const regex_t *regex)
+{
+	void *const ptr = reallocarray(keys, nkeys + 1, sizeof(*keys));
+	if(ptr == NULL)
 	{
-		entries[i].tag = i;
+		return;
 	}
 
-	qsort(entries, nentries, sizeof(*entries), &sort_dir_list);
+	keys = ptr;
+	keys[nkeys].key = key;
+	keys[nkeys].descending = descending;
+	keys[nkeys].regex = regex;
+	++nkeys;
 }
 
-/* Compares file names containing numbers correctly. */
-TSTATIC int
-strnumcmp(const char s[], const char t[])
+/* Frees list of sorting keys. */
+static void
+free_keys(void)
 {
-#if !defined(HAVE_STRVERSCMP_FUNC) || !HAVE_STRVERSCMP_FUNC
-	return vercmp(s, t);
-#else
-	const char *new_s = skip_leading_zeros(s);
-	const char *new_t = skip_leading_zeros(t);
-	return strverscmp(new_s, new_t);
-#endif
+	free(keys);
+	keys = NULL;
+	nkeys = 0;
 }
 
-#if !defined(HAVE_STRVERSCMP_FUNC) || !HAVE_STRVERSCMP_FUNC
-static int
-vercmp(const char s[], const char t[])
+/* Sorts sequence of file entries (plain list, not tree).  Values of all keys
+ * are computed once per entry, compact array of them is sorted and then
+ * entries are permuted accordingly. */
+static void
+sort_sequence(dir_entry_t *entries, size_t nentries)
 {
-	while(*s != '\0' && *t != '\0')
+	size_t i;
+	int k;
+	sort_item_t *items;
+	sort_value_t *values;
+	dir_entry_t *sorted;
+
+	if(nentries == 0U)
 	{
-		if(isdigit(*s) && isdigit(*t))
-		{
-			int num_a, num_b;
-			const char *os = s, *ot = t;
-			char *p;
+		return;
+	}
 
-			num_a = strtol(s, &p, 10);
-			s = p;
+	items = reallocarray(NULL, nentries, sizeof(*items));
+	values = reallocarray(NULL, nentries*nkeys + 1U, sizeof(*values));
+	sorted = reallocarray(NULL, nentries, sizeof(*sorted));
+	if(items == NULL || values == NULL || sorted == NULL)
+	{
+		free(items);
+		free(values);
+		free(sorted);
+		return;
+	}
 
-			num_b = strtol(t, &p, 10);
-			t = p;
+	for(i = 0U; i < nentries; ++i)
+	{
+		init_item(&items[i], &entries[i], i, &values[i*nkeys]);
+	}
 
-			if(num_a != num_b)
-				return num_a - num_b;
-			else if(*os != *ot)
-				return *os - *ot;
-		}
-		else if(*s == *t)
+	for(k = 0; k < nkeys; ++k)
+	{
+		if(keys[k].key == SK_BY_GROUPS)
 		{
-			s++;
-			t++;
+			rank_group_matches(items, nentries, k);
 		}
-		else
-			break;
 	}
+	groups_ranked = 1;
 
-	return *s - *t;
+	qsort(items, nentries, sizeof(*items), &compare_items);
+
+	for(i = 0U; i < nentries; ++i)
+	{
+		sorted[i] = *items[i].entry;
+	}
+	memcpy(entries, sorted, nentries*sizeof(*entries));
+
+	for(i = 0U; i < nentries*nkeys; ++i)
+	{
+		free_value(&keys[i%nkeys], &values[i]);
+	}
+	groups_ranked = 0;
+
+	free(items);
+	free(values);
+	free(sorted);
 }
-#else
-/* Skips all zeros in front of numbers (correctly handles zero).  Returns str, a
- * pointer to '0' or a pointer to non-zero digit. */
-static char *
-skip_leading_zeros(const char str[])
+
+/* Prepares item for comparison by computing values of all keys for the
+ * entry. */
+static void
+init_item(sort_item_t *item, const dir_entry_t *entry, int idx,
+		sort_value_t values[])
 {
-	while(str[0] == '0' && isdigit(str[1]))
+	int k;
+
+	item->entry = entry;
+	item->values = values;
+	item->idx = idx;
+	item->is_dir = is_directory_entry(entry);
+	item->is_parent = item->is_dir && is_parent_dir(entry->name);
+
+	for(k = 0; k < nkeys; ++k)
 	{
-		str++;
+		item->values[k] = get_value(&keys[k], entry, item->is_dir);
 	}
-	return (char *)str;
 }
-#endif
 
-static int
-sort_dir_list(const void *one, const void *two)
+/* Frees values computed by init_item(). */
+static void
+free_item(sort_item_t *item)
 {
-	/* TODO: refactor this function sort_dir_list(). */
+	int k;
+	for(k = 0; k < nkeys; ++k)
+	{
+		free_value(&keys[k], &item->values[k]);
+	}
+}
 
-	int retval;
-	const dir_entry_t *const first = one;
-	const dir_entry_t *const second = two;
+/* Replaces matches of k-th key (a sorting group) with their ranks among all
+ * matches, so that they are compared as numbers.  Reorders items. */
+static void
+rank_group_matches(sort_item_t items[], size_t nitems, int k)
+{
+	size_t i;
+	uint64_t rank = 0U;
+	char *prev = NULL;
 
-	const int first_is_dir = is_directory_entry(first);
-	const int second_is_dir = is_directory_entry(second);
+	rank_key = k;
+	qsort(items, nitems, sizeof(*items), &compare_group_matches);
 
-	if(first_is_dir && is_parent_dir(first->name))
+	for(i = 0U; i < nitems; ++i)
 	{
-		return -1;
+		char *const match = items[i].values[k].str;
+		if(i != 0U && compare_matches(prev, match) != 0)
+		{
+			++rank;
+		}
+
+		free(prev);
+		prev = match;
+		items[i].values[k].num = rank;
 	}
-	if(second_is_dir && is_parent_dir(second->name))
+	free(prev);
+}
+
+/* qsort() comparer that sorts items by group match of a key.  Returns standard
+ * -1, 0, 1 for comparisons. */
+static int
+compare_group_matches(const void *one, const void *two)
+{
+	const sort_item_t *const a = one;
+	const sort_item_t *const b = two;
+	return compare_matches(a->values[rank_key].str, b->values[rank_key].str);
+}
+
+/* Compares two group matches, which are NULL if they couldn't be copied.
+ * Returns standard -1, 0, 1 for comparisons. */
+static int
+compare_matches(const char a[], const char b[])
+{
+	if(a == NULL || b == NULL)
 	{
-		return 1;
+		return (b == NULL) - (a == NULL);
 	}
+	return strcmp(a, b);
+}
+
+/* Computes value of the key for the entry.  Returns the value. */
+static sort_value_t
+get_value(const sort_key_t *key, const dir_entry_t *entry, int is_dir)
+{
+	sort_value_t value = { .str = NULL };
 
-	retval = 0;
-	switch(sort_type)
+	switch(key->key)
 	{
-		char *pfirst, *psecond;
+		char buf[PATH_MAX];
+		regmatch_t match;
 
 		case SK_BY_NAME:
 		case SK_BY_INAME:
 			if(custom_view)
 			{
-				retval = compare_entry_names(first, second, sort_type == SK_BY_INAME);
+				get_short_path_of(view, entry, 0, sizeof(buf), buf);
+				value.name = make_name_key(buf, 1, key->key == SK_BY_INAME);
 			}
 			else
 			{
-				retval = compare_full_file_names(first->name, second->name,
-						sort_type == SK_BY_INAME);
+				value.name = make_name_key(entry->name, 0, key->key == SK_BY_INAME);
 			}
 			break;
 
 		case SK_BY_DIR:
-			if(first_is_dir != second_is_dir)
-			{
-				retval = first_is_dir ? -1 : 1;
-			}
+			value.num = !is_dir;
 			break;
 
 		case SK_BY_TYPE:
-			retval = strcmp(get_type_str(first->type), get_type_str(second->type));
+			value.str = (char *)get_type_str(entry->type);
 			break;
 
 		case SK_BY_FILEEXT:
 		case SK_BY_EXTENSION:
-			pfirst = strrchr(first->name,  '.');
-			psecond = strrchr(second->name, '.');
+			/* Compared by entries. */
+			break;
 
-			if(first_is_dir && second_is_dir && sort_type == SK_BY_FILEEXT)
-			{
-				retval = compare_file_names(first->name, second->name, 0);
-			}
-			else if(first_is_dir != second_is_dir && sort_type == SK_BY_FILEEXT)
-			{
-				retval = first_is_dir ? -1 : 1;
-			}
-			else if(pfirst && psecond)
+		case SK_BY_SIZE:
+			value.num = entry->size;
+			if(is_dir)
 			{
-				if(pfirst == first->name && psecond != second->name)
+				uint64_t size;
+				dcache_get_of(entry, &size, NULL);
+				if(size != DCACHE_UNKNOWN)
 				{
-					retval = -1;
-				}
-				else if(pfirst != first->name && psecond == second->name)
-				{
-					retval = 1;
-				}
-				else
-				{
-					retval = compare_file_names(++pfirst, ++psecond, 0);
+					value.num = size;
 				}
 			}
-			else if(pfirst || psecond)
-				retval = pfirst ? -1 : 1;
-			else
-				retval = compare_file_names(first->name, second->name, 0);
-			break;
-
-		case SK_BY_SIZE:
-			retval = compare_file_sizes(first, first_is_dir, second, second_is_dir);
 			break;
 
 		case SK_BY_NITEMS:
-			retval = compare_item_count(first, first_is_dir, second, second_is_dir);
+			/* We don't want to call entry_get_nitems() for files as sorting huge
+			 * lists of files can call this function a lot of times, thus even small
+			 * extra performance overhead is not desirable. */
+			value.num = is_dir ? entry_get_nitems(view, entry) : 0U;
 			break;
 
 		case SK_BY_GROUPS:
-			retval = compare_group(first->name, second->name, sort_data);
+			match = get_group_match(key->regex, entry->name);
+			copy_str(buf, MIN(NAME_MAX, match.rm_eo - match.rm_so + 1U),
+					entry->name + match.rm_so);
+			value.str = strdup(buf);
 			break;
 
 		case SK_BY_TARGET:
-			retval = compare_targets(first, second);
+			if(entry->type == FT_LINK)
+			{
+				char full_path[PATH_MAX];
+				get_full_path_of(entry, sizeof(full_path), full_path);
+				if(get_link_target(full_path, buf, sizeof(buf)) == 0)
+				{
+					value.str = strdup(buf);
+				}
+			}
 			break;
 
 		case SK_BY_TIME_MODIFIED:
-			retval = first->mtime - second->mtime;
+			value.time = entry->mtime;
 			break;
 
 		case SK_BY_TIME_ACCESSED:
-			retval = first->atime - second->atime;
+			value.time = entry->atime;
 			break;
 
 		case SK_BY_TIME_CHANGED:
-			retval = first->ctime - second->ctime;
+			value.time = entry->ctime;
 			break;
 
 #ifndef _WIN32
 		case SK_BY_MODE:
-			retval = first->mode - second->mode;
+			value.num = entry->mode;
 			break;
 
 		case SK_BY_OWNER_NAME: /* FIXME */
 		case SK_BY_OWNER_ID:
-			retval = first->uid - second->uid;
+			value.num = entry->uid;
 			break;
 
 		case SK_BY_GROUP_NAME: /* FIXME */
 		case SK_BY_GROUP_ID:
-			retval = first->gid - second->gid;
+			value.num = entry->gid;
 			break;
 
 		case SK_BY_PERMISSIONS:
-			{
-				char first_perm[11], second_perm[11];
-				get_perm_string(first_perm, sizeof(first_perm), first->mode);
-				get_perm_string(second_perm, sizeof(second_perm), second->mode);
-				retval = strcmp(first_perm, second_perm);
-			}
+			get_perm_string(buf, 11, entry->mode);
+			value.str = strdup(buf);
 			break;
 
 		case SK_BY_NLINKS:
-			retval = first->nlinks - second->nlinks;
+			value.num = entry->nlinks;
 			break;
 #endif
 	}
 
-	if(retval == 0)
+	return value;
+}
+
+/* Frees value of the key if it was allocated by get_value(). */
+static void
+free_value(const sort_key_t *key, sort_value_t *value)
+{
+	switch(key->key)
 	{
-		retval = first->tag - second->tag;
+		case SK_BY_NAME:
+		case SK_BY_INAME:
+			free(value->name.buf);
+			break;
+		case SK_BY_GROUPS:
+			if(!groups_ranked)
+			{
+				free(value->str);
+			}
+			break;
+		case SK_BY_TARGET:
+#ifndef _WIN32
+		case SK_BY_PERMISSIONS:
+#endif
+			free(value->str);
+			break;
+
+		default:
+			break;
+	}
+}
+
+/* qsort() comparer that sorts items by all sorting keys in turn.  Returns
+ * standard -1, 0, 1 for comparisons. */
+static int
+compare_items(const void *one, const void *two)
+{
+	int k;
+	const sort_item_t *const a = one;
+	const sort_item_t *const b = two;
+
+	if(a->is_parent != b->is_parent)
+	{
+		return a->is_parent ? -1 : 1;
 	}
-	else if(sort_descending)
+
+	for(k = 0; k < nkeys; ++k)
 	{
-		retval = -retval;
+		const int result = compare_values(&keys[k], a, b, k);
+		if(result != 0)
+		{
+			return keys[k].descending ? -result : result;
+		}
 	}
 
-	return retval;
+	return (a->idx < b->idx) ? -1 : (a->idx > b->idx);
 }
 
-/* Compares two file sizes.  Returns standard -1, 0, 1 for comparisons. */
+/* Compares values of k-th key of two items.  Returns positive value if a is
+ * greater than b, zero if they are equal, otherwise negative value is
+ * returned. */
 static int
-compare_file_sizes(const dir_entry_t *f, int fdir, const dir_entry_t *s,
-		int sdir)
+compare_values(const sort_key_t *key, const sort_item_t *a,
+		const sort_item_t *b, int k)
 {
-	uint64_t fsize = f->size;
-	uint64_t ssize = s->size;
+	const sort_value_t *const av = &a->values[k];
+	const sort_value_t *const bv = &b->values[k];
 
-	if(fdir)
+	switch(key->key)
 	{
-		uint64_t size;
-		dcache_get_of(f, &size, NULL);
-		if(size != DCACHE_UNKNOWN)
-		{
-			fsize = size;
-		}
+		case SK_BY_NAME:
+		case SK_BY_INAME:
+			return compare_name_keys(&av->name, &bv->name,
+					key->key == SK_BY_INAME);
+
+		case SK_BY_FILEEXT:
+		case SK_BY_EXTENSION:
+			return compare_extensions(a->entry, a->is_dir, b->entry, b->is_dir,
+					key->key == SK_BY_FILEEXT);
+
+		case SK_BY_TYPE:
+#ifndef _WIN32
+		case SK_BY_PERMISSIONS:
+#endif
+			return strcmp(av->str, bv->str);
+
+		case SK_BY_TARGET:
+			if((a->entry->type == FT_LINK) != (b->entry->type == FT_LINK))
+			{
+				/* One of the entries is not a link. */
+				return (a->entry->type == FT_LINK) ? 1 : -1;
+			}
+			/* Entries that aren't links or whose targets can't be read are
+			 * equal. */
+			if(av->str == NULL || bv->str == NULL)
+			{
+				return 0;
+			}
+			return stroscmp(av->str, bv->str);
+
+		case SK_BY_TIME_MODIFIED:
+		case SK_BY_TIME_ACCESSED:
+		case SK_BY_TIME_CHANGED:
+			return (av->time < bv->time) ? -1 : (av->time > bv->time);
+
+		case SK_BY_GROUPS:
+			if(!groups_ranked)
+			{
+				return compare_matches(av->str, bv->str);
+			}
+			return (av->num < bv->num) ? -1 : (av->num > bv->num);
+
+		default:
+			return (av->num < bv->num) ? -1 : (av->num > bv->num);
+	}
+}
+
+/* Compares two entries by their extensions.  With non-zero dirs_first,
+ * directories go first and are compared by name.  Returns positive value if f
+ * is greater than s, zero if they are equal, otherwise negative value is
+ * returned. */
+static int
+compare_extensions(const dir_entry_t *f, int fdir, const dir_entry_t *s,
+		int sdir, int dirs_first)
+{
+	const char *fext = strrchr(f->name, '.');
+	const char *sext = strrchr(s->name, '.');
+
+	if(fdir && sdir && dirs_first)
+	{
+		return compare_file_names(f->name, s->name, 0);
+	}
+	if(fdir != sdir && dirs_first)
+	{
+		return fdir ? -1 : 1;
 	}
 
-	if(sdir)
+	if(fext != NULL && sext != NULL)
 	{
-		uint64_t size;
-		dcache_get_of(s, &size, NULL);
-		if(size != DCACHE_UNKNOWN)
+		if(fext == f->name && sext != s->name)
+		{
+			return -1;
+		}
+		if(fext != f->name && sext == s->name)
 		{
-			ssize = size;
+			return 1;
 		}
+		return compare_file_names(fext + 1, sext + 1, 0);
+	}
+
+	if(fext != NULL || sext != NULL)
+	{
+		return (fext != NULL) ? -1 : 1;
 	}
 
-	return (fsize < ssize) ? -1 : (fsize > ssize);
+	return compare_file_names(f->name, s->name, 0);
 }
 
-/* Compares number of items in two directories (taken as zero for files).
- * Returns standard -1, 0, 1 for comparisons. */
-static int
-compare_item_count(const dir_entry_t *f, int fdir, const dir_entry_t *s,
-		int sdir)
+/* Compares file names containing numbers correctly. */
+TSTATIC int
+strnumcmp(const char s[], const char t[])
 {
-	/* We don't want to call entry_get_nitems() for files as sorting huge lists
-	 * of files can call this function a lot of times, thus even small extra
-	 * performance overhead is not desirable. */
-	const uint64_t fsize = fdir ? entry_get_nitems(view, f) : 0U;
-	const uint64_t ssize = sdir ? entry_get_nitems(view, s) : 0U;
-	return (fsize > ssize) ? 1 : (fsize < ssize) ? -1 : 0;
+#if !defined(HAVE_STRVERSCMP_FUNC) || !HAVE_STRVERSCMP_FUNC
+	return vercmp(s, t);
+#else
+	const char *new_s = skip_leading_zeros(s);
+	const char *new_t = skip_leading_zeros(t);
+	return strverscmp(new_s, new_t);
+#endif
 }
 
-/* Compares two file names according to grouping regular expression.  Returns
- * standard -1, 0, 1 for comparisons. */
+#if !defined(HAVE_STRVERSCMP_FUNC) || !HAVE_STRVERSCMP_FUNC
 static int
-compare_group(const char f[], const char s[], regex_t *regex)
+vercmp(const char s[], const char t[])
 {
-	char fname[NAME_MAX], sname[NAME_MAX];
-	regmatch_t fmatch = get_group_match(regex, f);
-	regmatch_t smatch = get_group_match(regex, s);
+	while(*s != '\0' && *t != '\0')
+	{
+		if(isdigit(*s) && isdigit(*t))
+		{
+			int num_a, num_b;
+			const char *os = s, *ot = t;
+			char *p;
 
-	copy_str(fname, MIN(sizeof(fname), fmatch.rm_eo - fmatch.rm_so + 1U),
-			f + fmatch.rm_so);
-	copy_str(sname, MIN(sizeof(sname), smatch.rm_eo - smatch.rm_so + 1U),
-			s + smatch.rm_so);
+			num_a = strtol(s, &p, 10);
+			s = p;
+
+			num_b = strtol(t, &p, 10);
+			t = p;
 
-	return strcmp(fname, sname);
+			if(num_a != num_b)
+				return num_a - num_b;
+			else if(*os != *ot)
+				return *os - *ot;
+		}
+		else if(*s == *t)
+		{
+			s++;
+			t++;
+		}
+		else
+			break;
+	}
+
+	return *s - *t;
+}
+#else
+/* Skips all zeros in front of numbers (correctly handles zero).  Returns str, a
+ * pointer to '0' or a pointer to non-zero digit. */
+static char *
+skip_leading_zeros(const char str[])
+{
+	while(str[0] == '0' && isdigit(str[1]))
+	{
+		str++;
+	}
+	return (char *)str;
 }
+#endif
 
-/* Compares two file names according to symbolic link target.  Returns standard
- * -1, 0, 1 for comparisons. */
-static int
-compare_targets(const dir_entry_t *f, const dir_entry_t *s)
+/* Makes collation key for the name, which is copied if copy is non-zero,
+ * otherwise it must outlive the key.  Returns the key. */
+static name_key_t
+make_name_key(const char name[], int copy, int ignore_case)
 {
-	char full_path[PATH_MAX];
-	char nlink[PATH_MAX], plink[PATH_MAX];
+	/* Too long names are cut in the same way as in compare_file_names(). */
+	char lower[NAME_MAX];
+	const size_t name_len = strlen(name);
+	size_t key_len = 0U;
+	name_key_t result = { .name = name, .key = name, .buf = NULL };
 
-	if((f->type == FT_LINK) != (s->type == FT_LINK))
+	if(ignore_case)
 	{
-		/* One of the entries is not a link. */
-		return (f->type == FT_LINK) ? 1 : -1;
+		(void)str_to_lower(name, lower, sizeof(lower));
+		if(strcmp(lower, name) != 0)
+		{
+			key_len = strlen(lower) + 1U;
+		}
 	}
-	if(f->type != FT_LINK)
+
+	if(!copy && key_len == 0U)
 	{
-		/* Both entries are not symbolic links. */
-		return 0;
+		return result;
 	}
 
-	/* Both entries are symbolic links. */
+	result.buf = malloc((copy ? name_len + 1U : 0U) + key_len);
+	if(result.buf == NULL)
+	{
+		result.name = NULL;
+		return result;
+	}
 
-	get_full_path_of(f, sizeof(full_path), full_path);
-	if(get_link_target(full_path, nlink, sizeof(nlink)) != 0)
+	if(copy)
 	{
-		return 0;
+		memcpy(result.buf, name, name_len + 1U);
+		result.name = result.buf;
+		result.key = result.buf;
 	}
-	get_full_path_of(s, sizeof(full_path), full_path);
-	if(get_link_target(full_path, plink, sizeof(plink)) != 0)
+	if(key_len != 0U)
 	{
-		return 0;
+		char *const key = result.buf + (copy ? name_len + 1U : 0U);
+		memcpy(key, lower, key_len);
+		result.key = key;
 	}
 
-	return stroscmp(nlink, plink);
+	return result;
 }
 
-/* Compares names of two file entries.  Returns positive value if a is greater
+/* Compares two names by their collation keys and assumes that dot character is
+ * smaller than any other character.  Returns positive value if a is greater
  * than b, zero if they are equal, otherwise negative value is returned. */
 static int
-compare_entry_names(const dir_entry_t *a, const dir_entry_t *b, int ignore_case)
+compare_name_keys(const name_key_t *a, const name_key_t *b, int ignore_case)
 {
-	char a_short_path[PATH_MAX];
-	char b_short_path[PATH_MAX];
-
-	get_short_path_of(view, a, 0, sizeof(a_short_path), a_short_path);
-	get_short_path_of(view, b, 0, sizeof(b_short_path), b_short_path);
-
-	return compare_full_file_names(a_short_path, b_short_path, ignore_case);
-}
+	int result;
 
-/* Compares two full filenames and assumes that dot character is smaller than
- * any other character.  Returns positive value if s is greater than t, zero if
- * they are equal, otherwise negative value is returned. */
-static int
-compare_full_file_names(const char s[], const char t[], int ignore_case)
-{
-	if(s[0] == '.' && t[0] != '.')
+	if(a->name == NULL || b->name == NULL)
 	{
-		return -1;
+		return (a->name == NULL) - (b->name == NULL);
 	}
-	else if(s[0] != '.' && t[0] == '.')
+
+	if((a->name[0] == '.') != (b->name[0] == '.'))
 	{
-		return 1;
+		return (a->name[0] == '.') ? -1 : 1;
 	}
-	else
+
+	result = cfg.sort_numbers ? strnumcmp(a->key, b->key)
+	                          : strcmp(a->key, b->key);
+	if(result == 0 && ignore_case)
 	{
-		return compare_file_names(s, t, ignore_case);
+		/* Resort to comparing original names when their normalized versions match
+		 * to always solve ties in deterministic way. */
+		result = strcmp(a->name, b->name);
 	}
+	return result;
 }
 
 /* Compares two file names or their parts (e.g. extensions).  Returns positive
@@ -26,6 +26,18 @@
 /* Sorts entries of the view according to its sorting configuration. */
 void sort_view(FileView *view);
 
+/* Sorts entries that aren't part of the view as a flat list according to
+ * sorting configuration of the view. */
+void sort_entries(FileView *view, dir_entry_t entries[], size_t nentries);
+
+/* Finds position at which the entry should be inserted into sorted list of
+ * the view (after all entries that are equal to it).  Returns the position. */
+int sort_find_position(FileView *view, const dir_entry_t *entry);
+
+/* Drops compiled sorting groups of the view, so that they are compiled anew
+ * on next sorting. */
+void sort_reset_groups_cache(FileView *view);
+
 /* Maps primary sort key to second column type.  Returns secondary key that
  * corresponds to the primary one. */
 SortingKey get_secondary_key(SortingKey primary_key);
@@ -26,23 +26,32 @@
 #undef MIN
 #endif
 
+#include <sys/stat.h> /* stat */
+
 #include <assert.h> /* assert() */
 #include <limits.h> /* INT_MIN */
 #include <stddef.h> /* NULL */
+#include <stdint.h> /* intmax_t uintmax_t */
+#include <stdio.h> /* FILE fclose() fprintf() sscanf() */
+#include <stdlib.h> /* free() malloc() */
 #include <string.h>
 #include <time.h> /* time_t time() */
 
 #include "cfg/config.h"
 #include "compat/fs_limits.h"
+#include "compat/os.h"
 #include "compat/pthread.h"
 #include "ui/colors.h"
 #include "ui/ui.h"
+#include "utils/dynarray.h"
 #include "utils/env.h"
+#include "utils/file_streams.h"
 #include "utils/fsdata.h"
 #include "utils/log.h"
 #include "utils/macros.h"
 #include "utils/path.h"
 #include "utils/str.h"
+#include "utils/trie.h"
 #include "utils/utils.h"
 #include "cmd_completion.h"
 #include "filelist.h"
@@ -52,6 +61,9 @@
 #define SCREEN_ENVVAR "STY"
 #define TMUX_ENVVAR "TMUX"
 
+/* Number of independently locked parts of dcache, must be a power of two. */
+#define DCACHE_SHARDS 16
+
 /* dcache entry. */
 typedef struct
 {
@@ -60,13 +72,73 @@ typedef struct
 }
 dcache_data_t;
 
+/* Part of dcache that holds data of paths with the same hash. */
+typedef struct
+{
+	pthread_mutex_t lock; /* Thread-safety guard for fields below. */
+	fsdata_t *size;       /* Cache for directory sizes. */
+	fsdata_t *nitems;     /* Cache for directory item count. */
+	trie_t *saved;        /* Sizes loaded from a file (dcache_saved_t). */
+}
+dcache_shard_t;
+
+/* Directory size loaded from a file.  Directory is checked to be the same on
+ * first use of the size. */
+typedef struct
+{
+	dcache_data_t data; /* Loaded size. */
+	uintmax_t dev;      /* Device of the directory when size was saved. */
+	uintmax_t ino;      /* Inode of the directory when size was saved. */
+	intmax_t mtime;     /* Modification time of the directory at that time. */
+	int used;           /* Whether the size was checked or replaced. */
+}
+dcache_saved_t;
+
+/* Directory size that is about to be written to a file. */
+typedef struct
+{
+	char *path;         /* Path to the directory. */
+	dcache_data_t data; /* Size of the directory. */
+	int skip;           /* Whether newer size from the file is used instead. */
+}
+dcache_entry_t;
+
+/* State of saving dcache sizes to a file. */
+typedef struct
+{
+	dcache_entry_t *entries;           /* Collected sizes (dynarray). */
+	int nentries;                      /* Number of elements in entries. */
+	int failed;                        /* Whether collecting has failed. */
+	char path[PATH_MAX];               /* Path of the current node. */
+	const void *nodes[PATH_MAX/2 + 1]; /* Data of nodes on the current path. */
+	size_t lens[PATH_MAX/2 + 1];       /* Lengths of paths of those nodes. */
+	int depth;                         /* Number of nodes on the current path. */
+}
+dcache_save_t;
+
 static void load_def_values(status_t *stats, config_t *config);
 static void determine_fuse_umount_cmd(status_t *stats);
 static void set_gtk_available(status_t *stats);
 static int reset_dircache(void);
+static void init_dcache_locks(void);
 static void set_last_cmdline_command(const char cmd[]);
 static void dcache_get(const char path[], uint64_t *size, uint64_t *nitems,
 		time_t ts);
+static void dcache_invalidate_size(char real_path[]);
+static dcache_shard_t * dcache_shard(const char path[], char real_path[]);
+static dcache_shard_t * dcache_shard_of(const char real_path[]);
+static int take_saved_size(dcache_shard_t *shard, const char real_path[],
+		dcache_saved_t *saved);
+static int saved_size_is_valid(const char path[], const dcache_saved_t *saved);
+static void dcache_save_traverser(const char name[], int valid,
+		const void *parent_data, void *data, void *arg);
+static void merge_saved_sizes(FILE *fp, const char path[], trie_t *index);
+static int saved_size_was_dropped(const char path[],
+		const dcache_saved_t *saved);
+static void dcache_save_entry(FILE *fp, const dcache_entry_t *entry);
+static int parse_saved_size(const char line[], dcache_saved_t *saved,
+		const char **path);
+static int dcache_add_saved(const char path[], const dcache_saved_t *saved);
 
 status_t curr_stats;
 
@@ -74,14 +146,11 @@ static int pending_redraw;
 static int inside_screen;
 static int inside_tmux;
 
-/* Thread-safety guard for dcache_size variable. */
-static pthread_mutex_t dcache_size_mutex = PTHREAD_MUTEX_INITIALIZER;
-/* Thread-safety guard for dcache_nitems variable. */
-static pthread_mutex_t dcache_nitems_mutex = PTHREAD_MUTEX_INITIALIZER;
-/* Cache for directory sizes. */
-static fsdata_t *dcache_size;
-/* Cache for directory item count. */
-static fsdata_t *dcache_nitems;
+/* Cache of directory information split into parts to let drawing and
+ * background jobs that update it access it simultaneously. */
+static dcache_shard_t dcache[DCACHE_SHARDS];
+/* Guards one-time initialization of locks of dcache. */
+static pthread_once_t dcache_once = PTHREAD_ONCE_INIT;
 
 int
 init_status(config_t *config)
@@ -213,13 +282,45 @@ reset_status(const config_t *config)
 static int
 reset_dircache(void)
 {
-	fsdata_free(dcache_size);
-	dcache_size = fsdata_create(0, 1);
+	int i;
+	int ret = 0;
+
+	pthread_once(&dcache_once, &init_dcache_locks);
+
+	for(i = 0; i < DCACHE_SHARDS; ++i)
+	{
+		dcache_shard_t *const shard = &dcache[i];
+
+		pthread_mutex_lock(&shard->lock);
 
-	fsdata_free(dcache_nitems);
-	dcache_nitems = fsdata_create(0, 1);
+		/* Paths are resolved before choosing a shard. */
+		fsdata_free(shard->size);
+		shard->size = fsdata_create(0, 0);
 
-	return (dcache_size == NULL || dcache_nitems == NULL);
+		fsdata_free(shard->nitems);
+		shard->nitems = fsdata_create(0, 0);
+
+		trie_free_with_data(shard->saved, &free);
+		shard->saved = trie_create();
+
+		ret |= (shard->size == NULL || shard->nitems == NULL ||
+				shard->saved == NULL);
+
+		pthread_mutex_unlock(&shard->lock);
+	}
+
+	return ret;
+}
+
+/* Initializes locks of all dcache shards. */
+static void
+init_dcache_locks(void)
+{
+	int i;
+	for(i = 0; i < DCACHE_SHARDS; ++i)
+	{
+		pthread_mutex_init(&dcache[i].lock, NULL);
+	}
 }
 
 void
@@ -354,30 +455,57 @@ dcache_get_of(const dir_entry_t *entry, uint64_t *size, uint64_t *nitems)
 static void
 dcache_get(const char path[], uint64_t *size, uint64_t *nitems, time_t ts)
 {
+	char real_path[PATH_MAX];
 	/* Initialization to make condition false by default. */
-	dcache_data_t size_data = { .timestamp = ts };
-	dcache_data_t nitems_data;
+	dcache_data_t size_data = { .value = DCACHE_UNKNOWN, .timestamp = ts };
+	dcache_data_t nitems_data = { .value = DCACHE_UNKNOWN };
 
-	pthread_mutex_lock(&dcache_size_mutex);
-	if(fsdata_get(dcache_size, path, &size_data, sizeof(size_data)) != 0 ||
-			(ts != 0 && ts > size_data.timestamp))
+	dcache_shard_t *const shard = dcache_shard(path, real_path);
+	if(shard != NULL)
 	{
-		size_data.value = DCACHE_UNKNOWN;
+		int outdated;
+		int loaded = 0;
+		dcache_saved_t saved;
+
+		pthread_mutex_lock(&shard->lock);
 
-		if(ts != 0 && ts > size_data.timestamp)
+		if(fsdata_get(shard->size, real_path, &size_data,
+					sizeof(size_data)) != 0)
 		{
-			fsdata_invalidate(dcache_size, path);
+			loaded = take_saved_size(shard, real_path, &saved);
 		}
-	}
-	pthread_mutex_unlock(&dcache_size_mutex);
 
-	pthread_mutex_lock(&dcache_nitems_mutex);
-	if(fsdata_get(dcache_nitems, path, &nitems_data, sizeof(nitems_data)) != 0 ||
-			(ts != 0 && ts > nitems_data.timestamp))
-	{
-		nitems_data.value = DCACHE_UNKNOWN;
+		if(fsdata_get(shard->nitems, real_path, &nitems_data,
+					sizeof(nitems_data)) != 0 ||
+				(ts != 0 && ts > nitems_data.timestamp))
+		{
+			nitems_data.value = DCACHE_UNKNOWN;
+		}
+
+		pthread_mutex_unlock(&shard->lock);
+
+		/* Sizes loaded from a file are checked on first use and outside of the
+		 * lock as this queries file system. */
+		if(loaded && saved_size_is_valid(real_path, &saved))
+		{
+			pthread_mutex_lock(&shard->lock);
+			if(fsdata_get(shard->size, real_path, &size_data,
+						sizeof(size_data)) != 0)
+			{
+				size_data = saved.data;
+				(void)fsdata_set(shard->size, real_path, &size_data,
+						sizeof(size_data));
+			}
+			pthread_mutex_unlock(&shard->lock);
+		}
+
+		outdated = (ts != 0 && ts > size_data.timestamp);
+		if(outdated)
+		{
+			size_data.value = DCACHE_UNKNOWN;
+			dcache_invalidate_size(real_path);
+		}
 	}
-	pthread_mutex_unlock(&dcache_nitems_mutex);
 
 	if(size != NULL)
 	{
@@ -389,30 +517,461 @@ dcache_get(const char path[], uint64_t *size, uint64_t *nitems, time_t ts)
 	}
 }
 
+/* Drops size of the path along with sizes of all its parents as they include
+ * it.  Parents can reside in different shards, so each one is processed
+ * separately.  Modifies the buffer. */
+static void
+dcache_invalidate_size(char real_path[])
+{
+	while(1)
+	{
+		char *slash;
+		dcache_shard_t *const shard = dcache_shard_of(real_path);
+
+		pthread_mutex_lock(&shard->lock);
+		(void)fsdata_invalidate(shard->size, real_path);
+		(void)take_saved_size(shard, real_path, NULL);
+		pthread_mutex_unlock(&shard->lock);
+
+		slash = strrchr(real_path, '/');
+		if(slash == NULL || (slash == real_path && slash[1] == '\0'))
+		{
+			break;
+		}
+		/* Keep slash of the root. */
+		slash[slash == real_path ? 1 : 0] = '\0';
+	}
+}
+
+/* Resolves the path and picks shard of dcache that corresponds to it.  The
+ * real_path buffer should be at least PATH_MAX characters long.  Returns the
+ * shard or NULL on failure to resolve the path. */
+static dcache_shard_t *
+dcache_shard(const char path[], char real_path[])
+{
+	/* This is done outside of locks as it can query file system. */
+	if(os_realpath(path, real_path) != real_path)
+	{
+		return NULL;
+	}
+	return dcache_shard_of(real_path);
+}
+
+/* Picks shard of dcache that corresponds to already resolved path.  Returns the
+ * shard. */
+static dcache_shard_t *
+dcache_shard_of(const char real_path[])
+{
+	/* FNV-1a hash. */
+	uint32_t hash = 2166136261U;
+	const char *p;
+
+	for(p = real_path; *p != '\0'; ++p)
+	{
+		hash = (hash ^ (unsigned char)*p)*16777619U;
+	}
+
+	return &dcache[hash & (DCACHE_SHARDS - 1)];
+}
+
 int
 dcache_set_at(const char path[], uint64_t size, uint64_t nitems)
 {
+	char real_path[PATH_MAX];
 	int ret = 0;
 	const time_t ts = time(NULL);
 
+	dcache_shard_t *const shard = dcache_shard(path, real_path);
+	if(shard == NULL)
+	{
+		return 1;
+	}
+
+	pthread_mutex_lock(&shard->lock);
+
 	if(size != DCACHE_UNKNOWN)
 	{
 		const dcache_data_t data = { .value = size, .timestamp = ts };
-
-		pthread_mutex_lock(&dcache_size_mutex);
-		ret |= fsdata_set(dcache_size, path, &data, sizeof(data));
-		pthread_mutex_unlock(&dcache_size_mutex);
+		ret |= fsdata_set(shard->size, real_path, &data, sizeof(data));
+		(void)take_saved_size(shard, real_path, NULL);
 	}
 
 	if(nitems != DCACHE_UNKNOWN)
 	{
 		const dcache_data_t data = { .value = nitems, .timestamp = ts };
+		ret |= fsdata_set(shard->nitems, real_path, &data, sizeof(data));
+	}
+
+	pthread_mutex_unlock(&shard->lock);
+
+	return ret;
+}
+
+/* Marks size loaded for the path as used and optionally retrieves it.  saved
+ * can be NULL.  Should be called with the lock of the shard held.  Returns
+ * non-zero if there was unused size, otherwise zero is returned. */
+static int
+take_saved_size(dcache_shard_t *shard, const char real_path[],
+		dcache_saved_t *saved)
+{
+	void *data;
+	dcache_saved_t *entry;
+
+	if(trie_get(shard->saved, real_path, &data) != 0 || data == NULL)
+	{
+		return 0;
+	}
+
+	entry = data;
+	if(entry->used)
+	{
+		return 0;
+	}
 
-		pthread_mutex_lock(&dcache_nitems_mutex);
-		ret |= fsdata_set(dcache_nitems, path, &data, sizeof(data));
-		pthread_mutex_unlock(&dcache_nitems_mutex);
+	entry->used = 1;
+	if(saved != NULL)
+	{
+		*saved = *entry;
+	}
+	return 1;
+}
+
+/* Checks whether directory wasn't replaced or modified since its size was
+ * saved.  Returns non-zero if so, otherwise zero is returned. */
+static int
+saved_size_is_valid(const char path[], const dcache_saved_t *saved)
+{
+	struct stat s;
+	return os_stat(path, &s) == 0
+	    && (uintmax_t)s.st_dev == saved->dev
+	    && (uintmax_t)s.st_ino == saved->ino
+	    && (intmax_t)s.st_mtime == saved->mtime;
+}
+
+int
+dcache_save(const char path[], const char prev_path[])
+{
+	dcache_save_t *state;
+	trie_t *index;
+	FILE *fp;
+	int i;
+	int error;
+
+	state = malloc(sizeof(*state));
+	if(state == NULL)
+	{
+		return 1;
+	}
+
+	state->entries = NULL;
+	state->nentries = 0;
+	state->failed = 0;
+
+	/* Only copy sizes while holding locks, the rest is done without them. */
+	for(i = 0; i < DCACHE_SHARDS; ++i)
+	{
+		dcache_shard_t *const shard = &dcache[i];
+
+		state->depth = 0;
+
+		pthread_mutex_lock(&shard->lock);
+		fsdata_traverse(shard->size, &dcache_save_traverser, state);
+		pthread_mutex_unlock(&shard->lock);
+	}
+
+	index = trie_create();
+	error = (state->failed || index == NULL);
+	for(i = 0; i < state->nentries && !error; ++i)
+	{
+		error = (trie_set(index, state->entries[i].path, &state->entries[i]) < 0);
+	}
+
+	fp = error ? NULL : os_fopen(path, "w");
+	if(fp != NULL)
+	{
+		/* Sizes written by other instances are kept unless ours are newer. */
+		merge_saved_sizes(fp, prev_path, index);
+
+		for(i = 0; i < state->nentries; ++i)
+		{
+			if(!state->entries[i].skip)
+			{
+				dcache_save_entry(fp, &state->entries[i]);
+			}
+		}
+
+		error = (fclose(fp) != 0);
+	}
+	else
+	{
+		error = 1;
+	}
+
+	trie_free(index);
+	for(i = 0; i < state->nentries; ++i)
+	{
+		free(state->entries[i].path);
+	}
+	dynarray_free(state->entries);
+	free(state);
+	return error;
+}
+
+/* fsdata_traverse() callback that restores full paths of nodes and collects
+ * valid ones. */
+static void
+dcache_save_traverser(const char name[], int valid, const void *parent_data,
+		void *data, void *arg)
+{
+	dcache_save_t *const state = arg;
+	size_t len;
+
+	if(state->failed)
+	{
+		return;
+	}
+
+	/* Nodes are visited depth-first, so parent is somewhere on the stack. */
+	while(state->depth > 0 && state->nodes[state->depth - 1] != parent_data)
+	{
+		--state->depth;
+	}
+
+	len = (state->depth == 0) ? 0U : state->lens[state->depth - 1];
+	/* Paths are results of realpath(), so this shouldn't happen, but if it does
+	 * paths of the rest of nodes can't be restored. */
+	if(len + 1U + strlen(name) >= sizeof(state->path) ||
+			state->depth == (int)ARRAY_LEN(state->nodes))
+	{
+		state->failed = 1;
+		return;
+	}
+
+#ifdef _WIN32
+	/* Top-level nodes are drives. */
+	if(state->depth != 0)
+#endif
+	{
+		state->path[len++] = '/';
+	}
+	len += copy_str(state->path + len, sizeof(state->path) - len, name) - 1U;
+
+	if(valid)
+	{
+		dcache_entry_t *entry = dynarray_extend(state->entries, sizeof(*entry));
+		if(entry == NULL)
+		{
+			state->failed = 1;
+			return;
+		}
+		state->entries = entry;
+
+		entry = &state->entries[state->nentries];
+		entry->path = strdup(state->path);
+		entry->data = *(const dcache_data_t *)data;
+		entry->skip = 0;
+		if(entry->path == NULL)
+		{
+			state->failed = 1;
+			return;
+		}
+		++state->nentries;
+	}
+
+	state->nodes[state->depth] = data;
+	state->lens[state->depth] = len;
+	++state->depth;
+}
+
+/* Copies lines of the file at the path to the fp unless they are superseded
+ * by sizes in the index, which are marked to be skipped if they are older than
+ * ones from the file. */
+static void
+merge_saved_sizes(FILE *fp, const char path[], trie_t *index)
+{
+	char *line = NULL;
+
+	FILE *const prev = os_fopen(path, "r");
+	if(prev == NULL)
+	{
+		return;
+	}
+
+	while((line = read_line(prev, line)) != NULL)
+	{
+		dcache_saved_t saved;
+		const char *dir;
+		void *data;
+
+		if(parse_saved_size(line, &saved, &dir) != 0)
+		{
+			continue;
+		}
+
+		if(trie_get(index, dir, &data) == 0)
+		{
+			dcache_entry_t *const entry = data;
+			if(entry->data.timestamp >= saved.data.timestamp)
+			{
+				continue;
+			}
+			entry->skip = 1;
+		}
+		else if(saved_size_was_dropped(dir, &saved))
+		{
+			continue;
+		}
+
+		fprintf(fp, "%s\n", line);
+	}
+
+	free(line);
+	fclose(prev);
+}
+
+/* Checks whether saved size was loaded by this instance and dropped because
+ * directory has changed since then.  Returns non-zero if so, otherwise zero is
+ * returned. */
+static int
+saved_size_was_dropped(const char path[], const dcache_saved_t *saved)
+{
+	void *data;
+	int dropped = 0;
+
+	dcache_shard_t *const shard = dcache_shard_of(path);
+
+	pthread_mutex_lock(&shard->lock);
+	if(trie_get(shard->saved, path, &data) == 0 && data != NULL)
+	{
+		const dcache_saved_t *const loaded = data;
+		dropped = loaded->used
+		       && loaded->data.timestamp >= saved->data.timestamp;
+	}
+	pthread_mutex_unlock(&shard->lock);
+
+	return dropped;
+}
+
+/* Writes single dcache entry to the file along with identity of directory it
+ * describes, skipping entries that are already outdated. */
+static void
+dcache_save_entry(FILE *fp, const dcache_entry_t *entry)
+{
+	dcache_saved_t saved = { .used = 0 };
+	void *data;
+
+	/* Line-based format can't represent such paths. */
+	if(strpbrk(entry->path, "\r\n") != NULL)
+	{
+		return;
+	}
+
+	/* Identity of directories whose sizes were loaded and checked is already
+	 * known. */
+	{
+		dcache_shard_t *const shard = dcache_shard_of(entry->path);
+		pthread_mutex_lock(&shard->lock);
+		if(trie_get(shard->saved, entry->path, &data) == 0 && data != NULL)
+		{
+			saved = *(const dcache_saved_t *)data;
+		}
+		pthread_mutex_unlock(&shard->lock);
+	}
+
+	if(!saved.used || saved.data.timestamp != entry->data.timestamp)
+	{
+		struct stat s;
+		if(os_stat(entry->path, &s) != 0 || s.st_mtime > entry->data.timestamp)
+		{
+			return;
+		}
+
+		saved.dev = (uintmax_t)s.st_dev;
+		saved.ino = (uintmax_t)s.st_ino;
+		saved.mtime = (intmax_t)s.st_mtime;
+	}
+
+	fprintf(fp, "%ju %jd %ju %ju %jd %s\n", (uintmax_t)entry->data.value,
+			(intmax_t)entry->data.timestamp, saved.dev, saved.ino, saved.mtime,
+			entry->path);
+}
+
+int
+dcache_load(const char path[])
+{
+	char *line = NULL;
+
+	FILE *const fp = os_fopen(path, "r");
+	if(fp == NULL)
+	{
+		return 1;
+	}
+
+	while((line = read_line(fp, line)) != NULL)
+	{
+		dcache_saved_t saved;
+		const char *dir;
+
+		if(parse_saved_size(line, &saved, &dir) == 0)
+		{
+			(void)dcache_add_saved(dir, &saved);
+		}
+	}
+
+	free(line);
+	fclose(fp);
+	return 0;
+}
+
+/* Parses single line of dcache file.  *path is set to point inside the line.
+ * Returns zero on success, otherwise non-zero is returned. */
+static int
+parse_saved_size(const char line[], dcache_saved_t *saved, const char **path)
+{
+	uintmax_t value;
+	intmax_t timestamp;
+	int path_offset;
+
+	if(sscanf(line, "%ju %jd %ju %ju %jd %n", &value, &timestamp, &saved->dev,
+				&saved->ino, &saved->mtime, &path_offset) != 5)
+	{
+		return 1;
+	}
+
+	saved->data.value = value;
+	saved->data.timestamp = timestamp;
+	saved->used = 0;
+	*path = line + path_offset;
+	return 0;
+}
+
+/* Remembers size loaded from a file to check and use it later.  Paths in the
+ * file are already resolved.  Returns zero on success, otherwise non-zero is
+ * returned. */
+static int
+dcache_add_saved(const char path[], const dcache_saved_t *saved)
+{
+	void *data;
+	int ret;
+
+	dcache_shard_t *const shard = dcache_shard_of(path);
+
+	dcache_saved_t *const copy = malloc(sizeof(*copy));
+	if(copy == NULL)
+	{
+		return 1;
+	}
+	*copy = *saved;
+
+	pthread_mutex_lock(&shard->lock);
+	if(trie_get(shard->saved, path, &data) != 0)
+	{
+		data = NULL;
 	}
+	ret = (trie_set(shard->saved, path, copy) < 0);
+	pthread_mutex_unlock(&shard->lock);
 
+	free(ret ? copy : data);
 	return ret;
 }
 
@@ -242,6 +242,16 @@ void dcache_get_of(const struct dir_entry_t *entry, uint64_t *size,
  * non-zero is returned. */
 int dcache_set_at(const char path[], uint64_t size, uint64_t nitems);
 
+/* Writes known directory sizes to the file at the path merging them with
+ * sizes from the file at prev_path, which might not exist.  Returns zero on
+ * success, otherwise non-zero is returned. */
+int dcache_save(const char path[], const char prev_path[]);
+
+/* Reads directory sizes from the file at the path.  Sizes of directories that
+ * were replaced or changed since they were saved are dropped on first use.
+ * Returns zero on success, otherwise non-zero is returned. */
+int dcache_load(const char path[]);
+
 #endif /* VIFM__STATUS_H__ */
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
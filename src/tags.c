@@ -47,6 +47,7 @@ const char *tags[] = {
 	"vifm-'cvoptions'",
 	"vifm-'deleteprg'",
 	"vifm-'dirsize'",
+	"vifm-'diskusage'",
 	"vifm-'dotdirs'",
 	"vifm-'dotfiles'",
 	"vifm-'fastrun'",
@@ -67,6 +68,7 @@ const char *tags[] = {
 	"vifm-'ignorecase'",
 	"vifm-'incsearch'",
 	"vifm-'iooptions'",
+	"vifm-'iothreads'",
 	"vifm-'is'",
 	"vifm-'laststatus'",
 	"vifm-'lines'",
@@ -323,6 +325,7 @@ const char *tags[] = {
 	"vifm-:tr",
 	"vifm-:trashes",
 	"vifm-:tree",
+	"vifm-:tree-depth",
 	"vifm-:undol",
 	"vifm-:undolist",
 	"vifm-:unl",
@@ -731,6 +734,7 @@ const char *tags[] = {
 	"vifm-zo",
 	"vifm-zr",
 	"vifm-zt",
+	"vifm-zx",
 	"vifm-zz",
 	"vifm-{",
 	"vifm-}",
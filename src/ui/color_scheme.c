@@ -25,7 +25,7 @@
 #include <assert.h> /* assert() */
 #include <stddef.h> /* NULL size_t */
 #include <stdio.h> /* snprintf() */
-#include <stdlib.h> /* free() */
+#include <stdlib.h> /* free() malloc() */
 #include <string.h> /* strcpy() strlen() */
 
 #include "../cfg/config.h"
@@ -40,6 +40,7 @@
 #include "../utils/matchers.h"
 #include "../utils/str.h"
 #include "../utils/string_array.h"
+#include "../utils/trie.h"
 #include "../utils/utils.h"
 #include "../status.h"
 #include "color_manager.h"
@@ -393,11 +394,26 @@ static const col_attr_t default_cs[] = {
 };
 ARRAY_GUARD(default_cs, MAXNUM_COLOR);
 
+/* Maximum number of names remembered by cache of file highlights, which is
+ * emptied when the limit is reached. */
+#define FILE_HI_CACHE_LIMIT 65536
+
+/* Memoized results of matching names against file highlights. */
+struct file_hi_cache_t
+{
+	/* Maps file name to index of first matching highlight plus one.  Data is
+	 * NULL for names that don't match any highlight. */
+	trie_t *names;
+	int count; /* Number of names in the trie. */
+};
+
 static char ** list_cs_files(int *len);
 static void restore_primary_cs(const col_scheme_t *cs);
 static void reset_to_default_cs(col_scheme_t *cs);
 static void free_cs_highlights(col_scheme_t *cs);
 static file_hi_t * clone_cs_highlights(const col_scheme_t *from);
+static void reset_file_hi_cache(col_scheme_t *cs);
+static void free_file_hi_cache(struct file_hi_cache_t *cache);
 static void reset_cs_colors(col_scheme_t *cs);
 static int source_cs(const char name[]);
 static void get_cs_path(const char name[], char buf[], size_t buf_size);
@@ -405,6 +421,8 @@ static const char * get_global_colors_dir(void);
 static void check_cs(col_scheme_t *cs);
 static void load_color_pairs(col_scheme_t *cs);
 static void ensure_dir_map_exists(void);
+static void remember_file_hi(struct file_hi_cache_t *cache, const char fname[],
+		int hi_num);
 
 /* Mapping of color schemes associations onto file system tree. */
 static fsddata_t *dir_map;
@@ -733,6 +751,8 @@ cs_assign(col_scheme_t *to, const col_scheme_t *from)
 	free_cs_highlights(to);
 	*to = *from;
 	to->file_hi = clone_cs_highlights(from);
+	to->file_hi_cache = NULL;
+	reset_file_hi_cache(to);
 }
 
 /* Resets color scheme to default builtin values. */
@@ -762,6 +782,9 @@ free_cs_highlights(col_scheme_t *cs)
 
 	cs->file_hi = NULL;
 	cs->file_hi_count = 0;
+
+	free_file_hi_cache(cs->file_hi_cache);
+	cs->file_hi_cache = NULL;
 }
 
 /* Clones filename specific highlight array of the *from color scheme and
@@ -783,6 +806,52 @@ clone_cs_highlights(const col_scheme_t *from)
 	return file_hi;
 }
 
+/* Replaces cache of file highlights of the color scheme with an empty one.
+ * Cache is created only if there are highlights to match against and all of
+ * them depend only on names of files. */
+static void
+reset_file_hi_cache(col_scheme_t *cs)
+{
+	struct file_hi_cache_t *cache;
+
+	free_file_hi_cache(cs->file_hi_cache);
+	cs->file_hi_cache = NULL;
+
+	/* Same name can refer to files of different types in different
+	 * directories. */
+	if(cs->file_hi_count == 0 || cs_file_hi_needs_contents(cs))
+	{
+		return;
+	}
+
+	cache = malloc(sizeof(*cache));
+	if(cache == NULL)
+	{
+		return;
+	}
+
+	cache->names = trie_create();
+	cache->count = 0;
+	if(cache->names == NULL)
+	{
+		free(cache);
+		return;
+	}
+
+	cs->file_hi_cache = cache;
+}
+
+/* Frees cache of file highlights.  The cache can be NULL. */
+static void
+free_file_hi_cache(struct file_hi_cache_t *cache)
+{
+	if(cache != NULL)
+	{
+		trie_free(cache->names);
+		free(cache);
+	}
+}
+
 int
 cs_load_local(int left, const char dir[])
 {
@@ -1021,6 +1090,23 @@ cs_add_file_hi(struct matchers_t *matchers, const col_attr_t *hi)
 
 	++cs->file_hi_count;
 
+	/* Names that didn't match anything before might match the new highlight. */
+	reset_file_hi_cache(cs);
+
+	return 0;
+}
+
+int
+cs_file_hi_needs_contents(const col_scheme_t *cs)
+{
+	int i;
+	for(i = 0; i < cs->file_hi_count; ++i)
+	{
+		if(!matchers_match_names_only(cs->file_hi[i].matchers))
+		{
+			return 1;
+		}
+	}
 	return 0;
 }
 
@@ -1028,6 +1114,7 @@ const col_attr_t *
 cs_get_file_hi(const col_scheme_t *cs, const char fname[], int *hi_hint)
 {
 	int i;
+	void *data;
 
 	if(*hi_hint != -1)
 	{
@@ -1036,18 +1123,60 @@ cs_get_file_hi(const col_scheme_t *cs, const char fname[], int *hi_hint)
 		return &cs->file_hi[*hi_hint].hi;
 	}
 
+	if(cs->file_hi_cache != NULL &&
+			trie_get(cs->file_hi_cache->names, fname, &data) == 0)
+	{
+		if(data == NULL)
+		{
+			return NULL;
+		}
+		*hi_hint = (int)((size_t)data - 1U);
+		return &cs->file_hi[*hi_hint].hi;
+	}
+
 	for(i = 0; i < cs->file_hi_count; ++i)
 	{
 		const file_hi_t *const file_hi = &cs->file_hi[i];
 		if(matchers_match(file_hi->matchers, fname))
 		{
 			*hi_hint = i;
+			remember_file_hi(cs->file_hi_cache, fname, i);
 			return &file_hi->hi;
 		}
 	}
+
+	remember_file_hi(cs->file_hi_cache, fname, -1);
 	return NULL;
 }
 
+/* Stores result of matching file name against file highlights in the cache,
+ * which can be NULL.  hi_num is -1 if nothing matched. */
+static void
+remember_file_hi(struct file_hi_cache_t *cache, const char fname[], int hi_num)
+{
+	if(cache == NULL)
+	{
+		return;
+	}
+
+	if(cache->count >= FILE_HI_CACHE_LIMIT)
+	{
+		trie_t *const names = trie_create();
+		if(names == NULL)
+		{
+			return;
+		}
+		trie_free(cache->names);
+		cache->names = names;
+		cache->count = 0;
+	}
+
+	if(trie_set(cache->names, fname, (void *)(size_t)(hi_num + 1)) == 0)
+	{
+		++cache->count;
+	}
+}
+
 int
 cs_is_color_set(const col_attr_t *color)
 {
@@ -40,6 +40,7 @@ typedef enum
 }
 ColorSchemeState;
 
+struct file_hi_cache_t;
 struct matchers_t;
 
 /* Single file highlight description. */
@@ -61,6 +62,10 @@ typedef struct
 
 	file_hi_t *file_hi; /* List of file highlight preferences. */
 	int file_hi_count;  /* Number of file highlight definitions. */
+
+	/* Results of matching file names against file_hi, which are shared by all
+	 * views using this color scheme and survive reloads.  Can be NULL. */
+	struct file_hi_cache_t *file_hi_cache;
 }
 col_scheme_t;
 
@@ -139,6 +144,11 @@ void cs_mix_colors(col_attr_t *base, const col_attr_t *mixup);
  * for curr_stats.save_msg. */
 int cs_add_file_hi(struct matchers_t *matchers, const col_attr_t *hi);
 
+/* Checks whether some of file highlights of the color scheme look at contents
+ * of files rather than just their names.  Returns non-zero if so, otherwise
+ * zero is returned. */
+int cs_file_hi_needs_contents(const col_scheme_t *cs);
+
 /* Gets filename-specific highlight.  hi_hint can't be NULL and should be equal
  * to -1 initially.  Returns NULL if nothing is found, otherwise returns pointer
  * to one of color scheme's highlights. */
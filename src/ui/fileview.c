@@ -34,6 +34,8 @@
 #include <string.h> /* strcpy() strlen() */
 
 #include "../cfg/config.h"
+#include "../compat/fs_limits.h"
+#include "../int/file_magic.h"
 #include "../utils/fs.h"
 #include "../utils/macros.h"
 #include "../utils/path.h"
@@ -1155,7 +1157,28 @@ static void
 mix_in_file_name_hi(const FileView *view, dir_entry_t *entry, col_attr_t *col)
 {
 	const col_scheme_t *const cs = ui_view_get_cs(view);
-	const col_attr_t *color = cs_get_file_hi(cs, entry->name, &entry->hi_num);
+	const col_attr_t *color;
+
+	if(entry->hi_num == -1 && cs_file_hi_needs_contents(cs))
+	{
+		char full_path[PATH_MAX];
+		get_full_path_of(entry, sizeof(full_path), full_path);
+
+		/* Don't block drawing on examining files, views will be redrawn once mime
+		 * types are known. */
+		if(!mimetype_is_known(full_path))
+		{
+			mimetype_request(full_path);
+			return;
+		}
+
+		color = cs_get_file_hi(cs, full_path, &entry->hi_num);
+	}
+	else
+	{
+		color = cs_get_file_hi(cs, entry->name, &entry->hi_num);
+	}
+
 	if(color != NULL)
 	{
 		cs_mix_colors(col, color);
@@ -1198,11 +1221,11 @@ format_name(int id, const void *data, size_t buf_len, char buf[])
 		 * reversed below to compensate for it. */
 		if(parent->child_count == child->child_pos + child->child_count)
 		{
-			prefix = (child == entry ? " --`" : "    ");
+			prefix = (child != entry ? "    " : entry->folded ? " +-`" : " --`");
 		}
 		else
 		{
-			prefix = (child == entry ? " --|" : "   |");
+			prefix = (child != entry ? "   |" : entry->folded ? " +-|" : " --|");
 		}
 		(void)sstrappend(buf, &len, buf_len + 1U, prefix);
 
@@ -1210,6 +1233,11 @@ format_name(int id, const void *data, size_t buf_len, char buf[])
 		parent -= parent->child_pos;
 	}
 
+	/* Top-level directories have no connector to mark them as folded, so every
+	 * entry gets a column for such marks to keep the tree aligned. */
+	(void)sstrappend(buf, &len, buf_len + 1U,
+			(child == entry && entry->folded) ? " +" : "  ");
+
 	for(i = 0U; i < len/2U; ++i)
 	{
 		const char t = buf[i];
@@ -20,30 +20,39 @@
 #include "quickview.h"
 
 #include <curses.h> /* mvwaddstr() wattrset() */
-#include <unistd.h> /* usleep() */
+#include <sys/stat.h> /* stat */
+#include <sys/types.h> /* pid_t */
+#include <unistd.h> /* close() read() usleep() */
 
+#include <errno.h> /* EAGAIN EINTR errno */
 #include <limits.h> /* INT_MAX */
 #include <stddef.h> /* NULL size_t */
-#include <stdio.h> /* FILE SEEK_SET fclose() fdopen() feof() fseek()
+#include <stdio.h> /* FILE SEEK_SET fclose() fdopen() feof() fmemopen() fseek()
                       tmpfile() */
-#include <stdlib.h> /* free() */
-#include <string.h> /* memmove() strcat() strlen() strncat() */
+#include <stdlib.h> /* free() realloc() */
+#include <string.h> /* memchr() memcpy() memmove() strcat() strcmp() strlen()
+                       strncat() */
 
 #include "../cfg/config.h"
 #include "../compat/fs_limits.h"
 #include "../compat/os.h"
 #include "../engine/mode.h"
+#include "../int/file_magic.h"
 #include "../modes/dialogs/msg_dialog.h"
 #include "../modes/modes.h"
 #include "../modes/view.h"
 #include "../utils/file_streams.h"
 #include "../utils/fs.h"
+#include "../utils/macros.h"
 #include "../utils/path.h"
 #include "../utils/str.h"
 #include "../utils/string_array.h"
 #include "../utils/test_helpers.h"
 #include "../utils/utf8.h"
 #include "../utils/utils.h"
+#ifndef _WIN32
+#include "../utils/utils_nix.h"
+#endif
 #include "../filelist.h"
 #include "../filetype.h"
 #include "../macros.h"
@@ -61,6 +70,38 @@
 /* Size of buffer holding preview line (in characters). */
 #define PREVIEW_LINE_BUF_LEN 4096
 
+/* Maximum amount of viewer output collected for a single preview. */
+#define ASYNC_PREVIEW_MAX (1024*1024)
+
+/* Number of viewer outputs that are kept around for reuse. */
+#define PREVIEW_CACHE_SIZE 16
+
+/* Number of entries before and after the current one which previews are
+ * prepared in advance. */
+#define PREFETCH_RANGE 2
+
+/* Maximum number of viewers that run in background simultaneously. */
+#define MAX_RUNNING_VIEWERS (2*PREFETCH_RANGE + 1)
+
+/* State of a preview produced by a viewer that runs in background. */
+typedef struct
+{
+	char *path;     /* Previewed file, NULL if the slot is unused. */
+	char *cmd;      /* Expanded command of the viewer. */
+	time_t mtime;   /* Modification time of the file when viewer was started. */
+	off_t size;     /* Size of the file when viewer was started. */
+	int width;      /* Width of the pane when viewer was started. */
+	int height;     /* Number of lines that need to be collected. */
+	pid_t pid;      /* Process group of the viewer or (pid_t)-1. */
+	int fd;         /* Read end of the pipe with viewer's output or -1. */
+	int truncated;  /* Whether viewer was stopped before it finished. */
+	char *data;     /* Output read so far. */
+	size_t len;     /* Length of the data. */
+	size_t nlines;  /* Number of complete lines in the data. */
+	unsigned int last_use; /* Value of use counter on last access. */
+}
+async_preview_t;
+
 /* State of directory tree print functions. */
 typedef struct
 {
@@ -75,6 +116,26 @@ tree_print_state_t;
 
 static void view_entry(const dir_entry_t *entry);
 static void view_file(const char path[]);
+static int view_async(const char path[], const char viewer[]);
+static void prefetch_neighbours(FileView *view);
+static void prefetch_entry(FileView *view, int pos);
+static void draw_async_preview(void);
+TSTATIC int start_async_preview(const char path[], const char cmd[],
+		int height, int width);
+TSTATIC int prefetch_async_preview(const char path[], const char cmd[],
+		int height, int width);
+static int run_preview(const char path[], const char cmd[], int height,
+		int width, async_preview_t **result);
+static async_preview_t * pick_preview_slot(void);
+static void limit_running_viewers(void);
+static void touch_preview(async_preview_t *preview);
+TSTATIC int read_async_preview(void);
+static int read_preview(async_preview_t *preview);
+TSTATIC const char * get_async_preview(size_t *len, int *finished);
+TSTATIC void stop_async_preview(void);
+static void kill_async_previews(void);
+static void drop_preview(async_preview_t *preview);
+static void finish_preview(async_preview_t *preview, int truncated);
 static FILE * view_dir(const char path[], int max_lines);
 static int print_dir_tree(tree_print_state_t *s, const char path[], int last);
 static int enter_dir(tree_print_state_t *s, const char path[], int last);
@@ -93,7 +154,17 @@ static int shift_line(char line[], size_t len, size_t offset);
 static size_t add_to_line(FILE *fp, size_t max, char line[], size_t len);
 static void write_message(const char msg[]);
 static void cleanup_for_text(void);
-static char * expand_viewer_command(const char viewer[]);
+static char * expand_viewer(const char viewer[], dir_entry_t *entry);
+
+/* Outputs of viewers, both finished and still running.  Unused slots have
+ * NULL path. */
+static async_preview_t previews[PREVIEW_CACHE_SIZE];
+
+/* Preview displayed in the other pane or NULL. */
+static async_preview_t *current_preview;
+
+/* Counter used to find least recently used preview. */
+static unsigned int use_counter;
 
 int
 qv_ensure_is_shown(void)
@@ -145,6 +216,8 @@ qv_toggle(void)
 
 		update_string(&curr_stats.preview_cleanup, NULL);
 		curr_stats.graphics_preview = 0;
+
+		stop_async_preview();
 	}
 	else
 	{
@@ -161,17 +234,24 @@ qv_draw(FileView *view)
 	if(curr_stats.load_stage < 2 || curr_stats.number_of_windows == 1 ||
 	   vle_mode_is(VIEW_MODE) || draw_abandoned_view_mode())
 	{
+		/* Something else occupies the other view. */
+		kill_async_previews();
 		return;
 	}
 
 	ui_view_erase(other_view);
 
+	/* view_entry() sets it again if viewer is run in background. */
+	current_preview = NULL;
+
 	curr = get_current_entry(view);
 	if(!fentry_is_fake(curr))
 	{
 		view_entry(curr);
 	}
 
+	prefetch_neighbours(view);
+
 	refresh_view_win(other_view);
 	ui_view_title_update(other_view);
 }
@@ -229,6 +309,12 @@ view_file(const char path[])
 
 	viewer = qv_get_viewer(path);
 
+	if(!is_null_or_empty(viewer) && !is_graphics_viewer(viewer) &&
+			view_async(path, viewer) == 0)
+	{
+		return;
+	}
+
 	if(viewer == NULL && is_dir(path))
 	{
 		ui_cancellation_reset();
@@ -290,6 +376,486 @@ view_file(const char path[])
 	ui_cancellation_disable();
 }
 
+/* Starts viewer in background or reuses its output if it's already running or
+ * finished for the same file.  Returns zero on success, otherwise non-zero is
+ * returned. */
+static int
+view_async(const char path[], const char viewer[])
+{
+#ifndef _WIN32
+	char *const cmd = qv_expand_viewer(viewer);
+	const int result = start_async_preview(path, cmd, ui_qv_height(other_view),
+			ui_qv_width(other_view));
+	free(cmd);
+
+	if(result < 0)
+	{
+		return 1;
+	}
+
+	cleanup_for_text();
+	update_string(&curr_stats.preview_cleanup, ma_get_clear_cmd(viewer));
+
+	(void)read_async_preview();
+	draw_async_preview();
+	return 0;
+#else
+	/* There is no way to kill the whole process tree of a stale viewer. */
+	(void)path;
+	(void)viewer;
+	return 1;
+#endif
+}
+
+/* Starts viewers for entries around the current one, so that their previews
+ * are ready by the time cursor gets there. */
+static void
+prefetch_neighbours(FileView *view)
+{
+	int i;
+
+	/* Macros of viewers are expanded for the current view, so do nothing if
+	 * preview is being done for a different one.  Selection would replace
+	 * neighbours in expansion of macros. */
+	if(view != curr_view ||
+			(curr_stats.preview_hint != NULL && curr_stats.preview_hint != view) ||
+			view->selected_files != 0)
+	{
+		return;
+	}
+
+	for(i = 1; i <= PREFETCH_RANGE; ++i)
+	{
+		prefetch_entry(view, view->list_pos + i);
+		prefetch_entry(view, view->list_pos - i);
+	}
+}
+
+/* Starts viewer for the entry at specified position if it has one that prints
+ * text. */
+static void
+prefetch_entry(FileView *view, int pos)
+{
+	dir_entry_t *entry;
+	const char *viewer;
+	char path[PATH_MAX];
+	char *cmd;
+
+	if(pos < 0 || pos >= view->list_rows)
+	{
+		return;
+	}
+
+	entry = &view->dir_entry[pos];
+	if(fentry_is_fake(entry) || (entry->type != FT_REG && entry->type != FT_DIR))
+	{
+		return;
+	}
+
+	qv_get_path_to_explore(entry, path, sizeof(path));
+
+	/* Don't examine contents of files on this thread, the entry is handled on
+	 * one of the next runs after its type is determined in background. */
+	if(ft_viewers_need_contents() && !mimetype_is_known(path))
+	{
+		mimetype_request(path);
+		return;
+	}
+
+	viewer = qv_get_viewer(path);
+	if(is_null_or_empty(viewer) || is_graphics_viewer(viewer))
+	{
+		return;
+	}
+
+	cmd = expand_viewer(viewer, entry);
+
+	(void)prefetch_async_preview(path, cmd, ui_qv_height(other_view),
+			ui_qv_width(other_view));
+	free(cmd);
+}
+
+void
+qv_check_async(void)
+{
+	/* qv_draw() stops preview when something else is drawn in the other view,
+	 * so only modes that are drawn on top of it need to be checked here. */
+	if(read_async_preview() && curr_stats.view &&
+			curr_stats.number_of_windows != 1 && !vle_mode_is(VIEW_MODE) &&
+			vle_mode_get_primary() != MENU_MODE)
+	{
+		ui_view_erase(other_view);
+		draw_async_preview();
+		refresh_view_win(other_view);
+	}
+}
+
+/* Draws output of the viewer collected so far in the other pane. */
+static void
+draw_async_preview(void)
+{
+#ifndef _WIN32
+	FILE *fp;
+
+	if(current_preview == NULL || current_preview->len == 0U)
+	{
+		return;
+	}
+
+	fp = fmemopen(current_preview->data, current_preview->len, "r");
+	if(fp == NULL)
+	{
+		return;
+	}
+
+	wattrset(other_view->win, 0);
+	view_stream(fp, cfg.wrap_quick_view);
+	fclose(fp);
+#endif
+}
+
+/* Makes preview of the path current starting the viewer command in background
+ * unless preview of the same unchanged file is already available.  height
+ * specifies how many lines of output is enough.  Returns zero if viewer was
+ * started, positive number if preview is reused and negative number on
+ * error. */
+TSTATIC int
+start_async_preview(const char path[], const char cmd[], int height, int width)
+{
+	async_preview_t *preview;
+	const int result = run_preview(path, cmd, height, width, &preview);
+	if(result >= 0)
+	{
+		current_preview = preview;
+	}
+	return result;
+}
+
+/* Same as start_async_preview(), but doesn't change current preview. */
+TSTATIC int
+prefetch_async_preview(const char path[], const char cmd[], int height,
+		int width)
+{
+	async_preview_t *preview;
+	return run_preview(path, cmd, height, width, &preview);
+}
+
+/* Looks up preview in the cache and starts the viewer if there is no suitable
+ * one.  *result is set to the preview on success.  Returns zero if viewer was
+ * started, positive number if preview is reused and negative number on
+ * error. */
+static int
+run_preview(const char path[], const char cmd[], int height, int width,
+		async_preview_t **result)
+{
+#ifndef _WIN32
+	struct stat st;
+	async_preview_t *preview = NULL;
+	pid_t pid;
+	int fd;
+	int i;
+
+	if(os_stat(path, &st) != 0)
+	{
+		st.st_mtime = 0;
+		st.st_size = 0;
+	}
+
+	for(i = 0; i < PREVIEW_CACHE_SIZE; ++i)
+	{
+		async_preview_t *const p = &previews[i];
+		if(p->path == NULL || strcmp(p->path, path) != 0 ||
+				strcmp(p->cmd, cmd) != 0 || p->mtime != st.st_mtime ||
+				p->size != st.st_size || p->width != width)
+		{
+			continue;
+		}
+
+		if(p->fd != -1 || !p->truncated || p->nlines >= (size_t)height ||
+				p->len >= ASYNC_PREVIEW_MAX)
+		{
+			/* Running viewer just needs to collect more lines if asked to. */
+			p->height = MAX(p->height, height);
+			touch_preview(p);
+			*result = p;
+			return 1;
+		}
+
+		/* Output is too short, run the viewer once again in the same slot. */
+		preview = p;
+		break;
+	}
+
+	if(preview == NULL)
+	{
+		preview = pick_preview_slot();
+	}
+	drop_preview(preview);
+	limit_running_viewers();
+
+	fd = read_cmd_output_async(cmd, &pid);
+	if(fd == -1)
+	{
+		return -1;
+	}
+
+	preview->path = strdup(path);
+	preview->cmd = strdup(cmd);
+	preview->mtime = st.st_mtime;
+	preview->size = st.st_size;
+	preview->width = width;
+	preview->height = height;
+	preview->pid = pid;
+	preview->fd = fd;
+	preview->truncated = 0;
+	touch_preview(preview);
+
+	*result = preview;
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+/* Finds unused slot for a preview or the least recently used one except for
+ * the current preview.  Returns the slot. */
+static async_preview_t *
+pick_preview_slot(void)
+{
+	int i;
+	async_preview_t *lru = NULL;
+
+	for(i = 0; i < PREVIEW_CACHE_SIZE; ++i)
+	{
+		async_preview_t *const p = &previews[i];
+		if(p->path == NULL)
+		{
+			return p;
+		}
+		if(p != current_preview && (lru == NULL || p->last_use < lru->last_use))
+		{
+			lru = p;
+		}
+	}
+
+	return lru;
+}
+
+/* Kills least recently used viewers until there is room for one more. */
+static void
+limit_running_viewers(void)
+{
+	while(1)
+	{
+		int i;
+		int nrunning = 0;
+		async_preview_t *lru = NULL;
+
+		for(i = 0; i < PREVIEW_CACHE_SIZE; ++i)
+		{
+			async_preview_t *const p = &previews[i];
+			if(p->path == NULL || p->fd == -1)
+			{
+				continue;
+			}
+
+			++nrunning;
+			if(p != current_preview && (lru == NULL || p->last_use < lru->last_use))
+			{
+				lru = p;
+			}
+		}
+
+		if(nrunning < MAX_RUNNING_VIEWERS || lru == NULL)
+		{
+			break;
+		}
+
+		drop_preview(lru);
+	}
+}
+
+/* Marks preview as the most recently used one. */
+static void
+touch_preview(async_preview_t *preview)
+{
+	preview->last_use = ++use_counter;
+}
+
+/* Reads output of running viewers without blocking.  Returns non-zero if
+ * current preview has changed, otherwise zero is returned. */
+TSTATIC int
+read_async_preview(void)
+{
+	int i;
+	int changed = 0;
+
+	for(i = 0; i < PREVIEW_CACHE_SIZE; ++i)
+	{
+		async_preview_t *const p = &previews[i];
+		if(p->path != NULL && read_preview(p) && p == current_preview)
+		{
+			changed = 1;
+		}
+	}
+
+	return changed;
+}
+
+/* Reads output of the viewer without blocking.  Returns non-zero if something
+ * has changed, otherwise zero is returned. */
+static int
+read_preview(async_preview_t *preview)
+{
+#ifndef _WIN32
+	int changed = 0;
+
+	while(preview->fd != -1)
+	{
+		char buf[4096];
+		char *data;
+		const char *p;
+		const ssize_t n = read(preview->fd, buf, sizeof(buf));
+
+		if(n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if(n <= 0)
+		{
+			if(n == 0 || errno != EAGAIN)
+			{
+				finish_preview(preview, 0);
+				changed = 1;
+			}
+			break;
+		}
+
+		data = realloc(preview->data, preview->len + n + 1U);
+		if(data == NULL)
+		{
+			finish_preview(preview, 1);
+			changed = 1;
+			break;
+		}
+
+		memcpy(data + preview->len, buf, n);
+		preview->data = data;
+		preview->len += n;
+		preview->data[preview->len] = '\0';
+		changed = 1;
+
+		for(p = buf; (p = memchr(p, '\n', buf + n - p)) != NULL; ++p)
+		{
+			++preview->nlines;
+		}
+
+		/* Every line takes at least one line on the screen, so there is no point
+		 * in collecting more of them. */
+		if(preview->nlines >= (size_t)preview->height ||
+				preview->len >= ASYNC_PREVIEW_MAX)
+		{
+			finish_preview(preview, 1);
+			break;
+		}
+	}
+
+	return changed;
+#else
+	return 0;
+#endif
+}
+
+/* Retrieves output of the viewer of current preview collected so far.
+ * *finished is set to non-zero if no more output will be added.  Returns the
+ * data. */
+TSTATIC const char *
+get_async_preview(size_t *len, int *finished)
+{
+	if(current_preview == NULL)
+	{
+		*len = 0U;
+		*finished = 1;
+		return NULL;
+	}
+
+	*len = current_preview->len;
+	*finished = (current_preview->fd == -1);
+	return current_preview->data;
+}
+
+/* Kills all viewers that are still running and forgets about all previews. */
+TSTATIC void
+stop_async_preview(void)
+{
+	int i;
+	for(i = 0; i < PREVIEW_CACHE_SIZE; ++i)
+	{
+		drop_preview(&previews[i]);
+	}
+}
+
+/* Kills all viewers that are still running, but keeps finished previews. */
+static void
+kill_async_previews(void)
+{
+	int i;
+	for(i = 0; i < PREVIEW_CACHE_SIZE; ++i)
+	{
+		if(previews[i].path != NULL && previews[i].fd != -1)
+		{
+			drop_preview(&previews[i]);
+		}
+	}
+	current_preview = NULL;
+}
+
+/* Kills viewer of the preview if it's still running and frees the slot. */
+static void
+drop_preview(async_preview_t *preview)
+{
+	if(preview->path != NULL)
+	{
+		finish_preview(preview, 1);
+	}
+
+	if(preview == current_preview)
+	{
+		current_preview = NULL;
+	}
+
+	update_string(&preview->path, NULL);
+	update_string(&preview->cmd, NULL);
+	free(preview->data);
+	preview->data = NULL;
+	preview->len = 0U;
+	preview->nlines = 0U;
+}
+
+/* Stops reading output of the viewer and kills it if it's still running.
+ * truncated specifies whether the viewer might have produced more output. */
+static void
+finish_preview(async_preview_t *preview, int truncated)
+{
+#ifndef _WIN32
+	if(preview->fd == -1)
+	{
+		return;
+	}
+
+	close(preview->fd);
+	preview->fd = -1;
+	preview->truncated = truncated;
+
+	if(truncated)
+	{
+		/* Viewer might have spawned other processes, kill all of them. */
+		kill_process_group(preview->pid);
+	}
+	preview->pid = (pid_t)-1;
+#endif
+}
+
 FILE *
 qv_view_dir(const char path[])
 {
@@ -645,17 +1211,23 @@ qv_execute_viewer(const char viewer[])
 	FILE *fp;
 	char *expanded;
 
-	expanded = expand_viewer_command(viewer);
+	expanded = qv_expand_viewer(viewer);
 	fp = read_cmd_output(expanded);
 	free(expanded);
 
 	return fp;
 }
 
-/* Returns a pointer to newly allocated memory, which should be released by the
- * caller. */
+char *
+qv_expand_viewer(const char viewer[])
+{
+	return expand_viewer(viewer, NULL);
+}
+
+/* Expands viewer for the entry of the current view or for the current file if
+ * entry is NULL.  Returns newly allocated string. */
 static char *
-expand_viewer_command(const char viewer[])
+expand_viewer(const char viewer[], dir_entry_t *entry)
 {
 	char *result;
 	if(strchr(viewer, '%') == NULL)
@@ -667,14 +1239,19 @@ expand_viewer_command(const char viewer[])
 			view = curr_view;
 		}
 
-		escaped = shell_like_escape(get_current_file_name(view), 0);
+		escaped = shell_like_escape((entry == NULL) ? get_current_file_name(view)
+		                                            : entry->name, 0);
 		result = format_str("%s %s", viewer, escaped);
 		free(escaped);
 	}
-	else
+	else if(entry == NULL)
 	{
 		result = expand_macros(viewer, NULL, NULL, 1);
 	}
+	else
+	{
+		result = ma_expand_for_entry(viewer, entry);
+	}
 	return result;
 }
 
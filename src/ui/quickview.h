@@ -42,9 +42,18 @@ void qv_draw(FileView *view);
 /* Toggles state of the quick view. */
 void qv_toggle(void);
 
+/* Reads output of viewer that runs in background and redraws preview if there
+ * is something new. */
+void qv_check_async(void);
+
 /* Quits preview pane or view modes. */
 void qv_hide(void);
 
+/* Expands macros in viewer command adding name of the current file if there
+ * are no macros.  Returns newly allocated string, which should be freed by the
+ * caller. */
+char * qv_expand_viewer(const char viewer[]);
+
 /* Expands and executes viewer command.  Returns file containing results of the
  * viewer. */
 FILE * qv_execute_viewer(const char viewer[]);
@@ -68,6 +77,13 @@ void qv_get_path_to_explore(const dir_entry_t *entry, char buf[],
 
 TSTATIC_DEFS(
 	void view_stream(FILE *fp, int wrapped);
+	int start_async_preview(const char path[], const char cmd[], int height,
+			int width);
+	int prefetch_async_preview(const char path[], const char cmd[], int height,
+			int width);
+	int read_async_preview(void);
+	const char * get_async_preview(size_t *len, int *finished);
+	void stop_async_preview(void);
 )
 
 #endif /* VIFM__UI__QUICKVIEW_H__ */
@@ -195,6 +195,7 @@ typedef struct dir_entry_t
 	unsigned int was_selected : 1; /* Previous selection state for Visual mode. */
 	unsigned int marked : 1;       /* Whether file should be processed. */
 	unsigned int temporary : 1;    /* Whether this is temporary node. */
+	unsigned int folded : 1;       /* Whether directory of a tree isn't listed. */
 }
 dir_entry_t;
 
@@ -233,6 +234,14 @@ typedef struct
 		 * by tree-view. */
 		struct trie_t *excluded_paths;
 
+		/* Directories of tree-view that were folded (non-NULL data) or unfolded
+		 * (NULL data) explicitly.  Other directories are folded if they are
+		 * deeper than tree_depth levels. */
+		struct trie_t *folded_paths;
+		/* Number of levels of tree-view that are listed by default or zero for no
+		 * limit. */
+		int tree_depth;
+
 		/* Names of files in custom view while it's being composed.  Used for
 		 * duplicate elimination during construction of custom list. */
 		struct trie_t *paths_cache;
@@ -242,6 +251,8 @@ typedef struct
 	/* Monitor that checks for directory changes. */
 	fswatch_t *watch;
 	char watched_dir[PATH_MAX];
+	/* Whether the watch monitors all directories of a tree view. */
+	int watching_tree;
 
 	char last_dir[PATH_MAX];
 
@@ -309,6 +320,13 @@ typedef struct
 		/* Number of entries filtered in other ways. */
 		size_t prefiltered_count;
 
+		/* Positions in the unfiltered array of entries that passed the filter last
+		 * time it was changed.  Only they are checked if new value of the filter
+		 * narrows the previous one.  NULL when all entries need to be checked. */
+		int *candidates;
+		/* Number of elements in the candidates array. */
+		size_t candidate_count;
+
 		/* List of previous cursor positions in the unfiltered array. */
 		int *poshist;
 		/* Number of elements in the poshist field. */
@@ -322,6 +340,15 @@ typedef struct
 	char *sort_groups, *sort_groups_g;
 	/* Primary group in compiled form. */
 	regex_t primary_group;
+	/* Cache of compiled secondary groups, which is managed by sorting unit. */
+	struct
+	{
+		char *src;        /* Value of sort_groups the cache was built for. */
+		int ngroups;      /* Total number of groups. */
+		regex_t *regexes; /* All groups except for the first one. */
+		int nregexes;     /* Number of elements in the regexes array. */
+	}
+	sort_groups_cache;
 
 	int history_num;
 	int history_pos;
@@ -30,11 +30,16 @@
 #endif
 
 #include <sys/stat.h> /* S_* statbuf */
-#include <sys/types.h> /* size_t mode_t */
+#include <sys/types.h> /* size_t mode_t ssize_t */
 #include <unistd.h> /* getcwd() pathconf() readlink() */
 
+#ifndef _WIN32
+#include <dirent.h> /* DIR dirent dirfd() getdents64() */
+#endif
+
 #include <errno.h> /* errno */
 #include <stddef.h> /* NULL */
+#include <stdint.h> /* int64_t uint64_t */
 #include <stdio.h> /* snprintf() remove() */
 #include <stdlib.h> /* free() qsort() */
 #include <string.h> /* strcpy() strdup() strlen() strncmp() strncpy() */
@@ -48,13 +53,40 @@
 #include "string_array.h"
 #include "utils.h"
 
+#if HAVE_GETDENTS64
+#ifndef TEST
+/* Size of buffer for reading directory entries in batches.  Big batches reduce
+ * number of round-trips to slow (e.g., network) file systems. */
+#define DIR_BATCH_SIZE (256*1024)
+#else
+/* Small batches let tests span several of them with few files. */
+#define DIR_BATCH_SIZE (4*1024)
+#endif
+
+/* Layout of a record returned by getdents64(). */
+typedef struct
+{
+	uint64_t ino;          /* Inode number. */
+	int64_t off;           /* Offset of the next record. */
+	unsigned short reclen; /* Size of this record. */
+	unsigned char type;    /* File type (one of DT_*). */
+	char name[];           /* Null-terminated file name. */
+}
+dirent64_rec_t;
+#endif
+
 static int is_dir_fast(const char path[]);
 static int path_exists_internal(const char path[], const char filename[],
 		int deref);
 static int path_sorter(const void *first, const void *second);
+static int read_link_target(const char path[], char buf[], size_t buf_len);
 
 #ifndef _WIN32
 static int is_directory(const char path[], int dereference_links);
+#if HAVE_GETDENTS64
+static int enum_dir_batched(DIR *dir, dir_content_client_func client,
+		void *param);
+#endif
 #else
 static DWORD win_get_file_attrs(const char path[]);
 #endif
@@ -249,25 +281,16 @@ is_symlink(const char path[])
 SymLinkType
 get_symlink_type(const char path[])
 {
-	char cwd[PATH_MAX];
 	char linkto[PATH_MAX + NAME_MAX];
 	int saved_errno;
 	char *filename_copy;
 	char *p;
 
-	if(get_cwd(cwd, sizeof(cwd)) == NULL)
-	{
-		/* getcwd() failed, just use "." rather than fail. */
-		strcpy(cwd, ".");
-	}
-
-	/* Use readlink() (in get_link_target_abs) before realpath() to check for
+	/* Use readlink() (in read_link_target()) before realpath() to check for
 	 * target at slow file system.  realpath() doesn't fit in this case as it
 	 * resolves chains of symbolic links and we want to try only the first one. */
-	if(get_link_target_abs(path, cwd, linkto, sizeof(linkto)) != 0)
+	if(read_link_target(path, linkto, sizeof(linkto)) != 0)
 	{
-		LOG_SERROR_MSG(errno, "Can't readlink \"%s\"", path);
-		log_cwd();
 		return SLT_UNKNOWN;
 	}
 	if(refers_to_slower_fs(path, linkto))
@@ -293,6 +316,37 @@ get_symlink_type(const char path[])
 	return SLT_UNKNOWN;
 }
 
+int
+symlink_target_is_slow(const char path[])
+{
+	char linkto[PATH_MAX + NAME_MAX];
+	return read_link_target(path, linkto, sizeof(linkto)) == 0
+	    && refers_to_slower_fs(path, linkto);
+}
+
+/* Reads absolute path to target of the symbolic link.  Returns zero on success,
+ * otherwise non-zero is returned. */
+static int
+read_link_target(const char path[], char buf[], size_t buf_len)
+{
+	char cwd[PATH_MAX];
+
+	if(get_cwd(cwd, sizeof(cwd)) == NULL)
+	{
+		/* getcwd() failed, just use "." rather than fail. */
+		strcpy(cwd, ".");
+	}
+
+	if(get_link_target_abs(path, cwd, buf, buf_len) != 0)
+	{
+		LOG_SERROR_MSG(errno, "Can't readlink \"%s\"", path);
+		log_cwd();
+		return 1;
+	}
+
+	return 0;
+}
+
 int
 get_link_target_abs(const char link[], const char cwd[], char buf[],
 		size_t buf_len)
@@ -752,6 +806,17 @@ enum_dir_content(const char path[], dir_content_client_func client, void *param)
 		return -1;
 	}
 
+#if HAVE_GETDENTS64
+	{
+		const int result = enum_dir_batched(dir, client, param);
+		if(result <= 0)
+		{
+			os_closedir(dir);
+			return result;
+		}
+	}
+#endif
+
 	while((d = os_readdir(dir)) != NULL)
 	{
 		if(client(d->d_name, d, param) != 0)
@@ -794,6 +859,62 @@ enum_dir_content(const char path[], dir_content_client_func client, void *param)
 #endif
 }
 
+#if HAVE_GETDENTS64
+
+/* Implementation of enum_dir_content() that reads entries in big batches.
+ * Returns zero on success, positive number if batched reading isn't available,
+ * in which case no entries are reported to the client, or negative number if
+ * reading failed after some entries were reported. */
+static int
+enum_dir_batched(DIR *dir, dir_content_client_func client, void *param)
+{
+	const int fd = dirfd(dir);
+	char *const buf = malloc(DIR_BATCH_SIZE);
+	int first_batch = 1;
+
+	if(buf == NULL)
+	{
+		return 1;
+	}
+
+	while(1)
+	{
+		ssize_t pos;
+		const ssize_t len = getdents64(fd, buf, DIR_BATCH_SIZE);
+		if(len <= 0)
+		{
+			free(buf);
+			if(len == 0)
+			{
+				return 0;
+			}
+			return first_batch ? 1 : -1;
+		}
+		first_batch = 0;
+
+		for(pos = 0; pos < len; )
+		{
+			const dirent64_rec_t *const e = (const dirent64_rec_t *)&buf[pos];
+			struct dirent d;
+
+			pos += e->reclen;
+
+			/* Clients expect regular dirent structures. */
+			d.d_ino = e->ino;
+			d.d_type = e->type;
+			copy_str(d.d_name, sizeof(d.d_name), e->name);
+
+			if(client(d.d_name, &d, param) != 0)
+			{
+				free(buf);
+				return 0;
+			}
+		}
+	}
+}
+
+#endif
+
 int
 count_dir_items(const char path[])
 {
@@ -80,6 +80,11 @@ int is_symlink(const char path[]);
  * Returns one of SymLinkType values. */
 SymLinkType get_symlink_type(const char path[]);
 
+/* Checks whether target of the symbolic link is at file system that is slower
+ * than the one of the link.  Doesn't access the target.  Returns non-zero if
+ * so, otherwise zero is returned. */
+int symlink_target_is_slow(const char path[]);
+
 /* Fills the buf of size buf_len with the absolute path to a file pointed to by
  * the link symbolic link.  Uses the cwd parameter to make absolute path from
  * relative symbolic links.  The link and buf can point to the same piece of
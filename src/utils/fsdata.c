@@ -304,6 +304,12 @@ int
 fsdata_invalidate(fsdata_t *fsd, const char path[])
 {
 	char real_path[PATH_MAX];
+
+	if(fsd->root == NULL)
+	{
+		return 1;
+	}
+
 	if(resolve_path(fsd, path, real_path) != 0)
 	{
 		return 1;
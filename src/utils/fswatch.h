@@ -19,11 +19,22 @@
 #ifndef VIFM__UTILS__FSWATCH_H__
 #define VIFM__UTILS__FSWATCH_H__
 
-/* Implementation of file system changes checks via polling. */
+/* Implementation of file system changes checks via polling.  A watcher can
+ * monitor several directories at once. */
 
 /* Opaque type of a watcher. */
 typedef struct fswatch_t fswatch_t;
 
+/* Names of entries of the watched directory that were changed. */
+typedef struct
+{
+	char **names; /* Names of changed entries (each name appears once). */
+	int *created; /* Whether corresponding entry didn't exist before. */
+	int count;    /* Number of elements in names and created arrays. */
+	int complete; /* Whether names describe all changes that happened. */
+}
+fswatch_changes_t;
+
 /* Creates new watcher for the specified path.  Returns the watcher or NULL on
  * error. */
 fswatch_t * fswatch_create(const char path[]);
@@ -31,11 +42,25 @@ fswatch_t * fswatch_create(const char path[]);
 /* Frees a watcher.  w can be NULL. */
 void fswatch_free(fswatch_t *w);
 
+/* Makes the watcher also monitor changes of another directory.  Fails if
+ * implementation can't do this cheaply.  Returns zero on success, otherwise
+ * non-zero is returned. */
+int fswatch_add(fswatch_t *w, const char path[]);
+
 /* Checks whether any changes were made to the entity being watched since last
  * query.  Sets *error to indicate whether any issues occurred.  Returns
  * non-zero if so, otherwise zero is returned. */
 int fswatch_changed(fswatch_t *w, int *error);
 
+/* Same as fswatch_changed(), but also collects names of changed entries of the
+ * directory passed to fswatch_create() into *changes, which should be freed
+ * with fswatch_changes_free().  Implementations that can't provide the names
+ * reset complete field to zero. */
+int fswatch_poll(fswatch_t *w, int *error, fswatch_changes_t *changes);
+
+/* Frees resources of the changes, but not the structure itself. */
+void fswatch_changes_free(fswatch_changes_t *changes);
+
 #endif /* VIFM__UTILS__FSWATCH_H__ */
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
@@ -20,6 +20,8 @@
 
 #include <stdlib.h> /* free() malloc() */
 
+#include "string_array.h"
+
 #ifdef HAVE_INOTIFY
 
 #include <sys/inotify.h> /* IN_* inotify_* */
@@ -28,12 +30,20 @@
 #include <errno.h> /* EAGAIN errno */
 #include <stddef.h> /* NULL */
 #include <stdint.h> /* uint32_t */
-#include <stdlib.h> /* free() */
+#include <stdio.h> /* snprintf() */
+#include <stdlib.h> /* free() realloc() */
+#include <string.h> /* memset() strcmp() */
 #include <time.h> /* time_t time() */
 
 #include "../compat/fs_limits.h"
+#include "str.h"
 #include "trie.h"
 
+/* Events of watched directories that are of interest. */
+#define WATCH_MASK (IN_ATTRIB | IN_MODIFY | IN_CREATE | IN_DELETE | \
+                    IN_MOVED_FROM | IN_MOVED_TO | IN_EXCL_UNLINK | \
+                    IN_CLOSE_WRITE)
+
 /* TODO: consider implementation that could reuse already available descriptor
  *       by just removing old watch and then adding a new one. */
 
@@ -44,6 +54,14 @@ struct fswatch_t
 	int fd;
 	/* Trie to keep track of per file frequency of notifications. */
 	trie_t *stats;
+	/* Paths of watched directories indexed by watch descriptors. */
+	char **paths;
+	/* Number of elements in the paths array. */
+	int npaths;
+	/* Watch descriptor of the directory passed to fswatch_create(). */
+	int root_wd;
+	/* Whether last read of events left some of them in the queue. */
+	int partial;
 };
 
 /* Per file statistics information. */
@@ -57,20 +75,26 @@ typedef struct
 }
 notif_stat_t;
 
+static int add_watch(fswatch_t *w, const char path[]);
+static int read_events(fswatch_t *w, int *error, fswatch_changes_t *changes);
 static int update_file_stats(fswatch_t *w, const struct inotify_event *e,
 		time_t now);
+static void record_change(fswatch_t *w, const struct inotify_event *e,
+		fswatch_changes_t *changes);
 
 fswatch_t *
 fswatch_create(const char path[])
 {
-	int wd;
-
 	fswatch_t *const w = malloc(sizeof(*w));
 	if(w == NULL)
 	{
 		return NULL;
 	}
 
+	w->paths = NULL;
+	w->npaths = 0;
+	w->partial = 0;
+
 	/* Create tree to collect update frequency statistics. */
 	w->stats = trie_create();
 	if(w->stats == NULL)
@@ -90,14 +114,10 @@ fswatch_create(const char path[])
 	}
 
 	/* Add directory to watch. */
-	wd = inotify_add_watch(w->fd, path, IN_ATTRIB | IN_MODIFY | IN_CREATE |
-			IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_EXCL_UNLINK |
-			IN_CLOSE_WRITE);
-	if(wd == -1)
+	w->root_wd = add_watch(w, path);
+	if(w->root_wd < 0)
 	{
-		close(w->fd);
-		trie_free_with_data(w->stats, &free);
-		free(w);
+		fswatch_free(w);
 		return NULL;
 	}
 
@@ -109,14 +129,78 @@ fswatch_free(fswatch_t *w)
 {
 	if(w != NULL)
 	{
+		int i;
+		for(i = 0; i < w->npaths; ++i)
+		{
+			free(w->paths[i]);
+		}
+		free(w->paths);
+
 		trie_free_with_data(w->stats, &free);
 		close(w->fd);
 		free(w);
 	}
 }
 
+int
+fswatch_add(fswatch_t *w, const char path[])
+{
+	return (add_watch(w, path) < 0);
+}
+
+/* Starts watching the directory and remembers its path to be able to report
+ * which file an event is about.  Returns watch descriptor on success, otherwise
+ * -1 is returned. */
+static int
+add_watch(fswatch_t *w, const char path[])
+{
+	const int wd = inotify_add_watch(w->fd, path, WATCH_MASK);
+	if(wd < 0)
+	{
+		return -1;
+	}
+
+	if(wd >= w->npaths)
+	{
+		const int npaths = (wd + 1 > w->npaths*2) ? (wd + 1) : w->npaths*2;
+		char **const paths = realloc(w->paths, sizeof(*paths)*npaths);
+		if(paths == NULL)
+		{
+			(void)inotify_rm_watch(w->fd, wd);
+			return -1;
+		}
+
+		memset(paths + w->npaths, 0, sizeof(*paths)*(npaths - w->npaths));
+		w->paths = paths;
+		w->npaths = npaths;
+	}
+
+	/* Adding the same directory again yields the same descriptor. */
+	return (replace_string(&w->paths[wd], path) == 0) ? wd : -1;
+}
+
 int
 fswatch_changed(fswatch_t *w, int *error)
+{
+	return read_events(w, error, NULL);
+}
+
+int
+fswatch_poll(fswatch_t *w, int *error, fswatch_changes_t *changes)
+{
+	changes->names = NULL;
+	changes->created = NULL;
+	changes->count = 0;
+	/* Remaining events of previous read might be about any file. */
+	changes->complete = !w->partial;
+	return read_events(w, error, changes);
+}
+
+/* Reads all pending events.  Sets *error to indicate whether any issues
+ * occurred.  changes can be NULL.  Returns non-zero if any of the events is
+ * interesting, otherwise zero is returned. */
+static int
+read_events(fswatch_t *w, int *error, fswatch_changes_t *changes)
 {
 	enum { MAX_READS = 100 };
 	enum { BUF_LEN = (10 * (sizeof(struct inotify_event) + NAME_MAX + 1)) };
@@ -143,6 +227,10 @@ fswatch_changed(fswatch_t *w, int *error)
 			}
 
 			*error = 1;
+			if(changes != NULL)
+			{
+				changes->complete = 0;
+			}
 			break;
 		}
 
@@ -153,6 +241,10 @@ fswatch_changed(fswatch_t *w, int *error)
 			if(update_file_stats(w, e, now))
 			{
 				changed = 1;
+				if(changes != NULL)
+				{
+					record_change(w, e, changes);
+				}
 			}
 		}
 
@@ -160,11 +252,17 @@ fswatch_changed(fswatch_t *w, int *error)
 		 * in this loop. */
 		if(++nreads > MAX_READS)
 		{
-			break;
+			w->partial = 1;
+			if(changes != NULL)
+			{
+				changes->complete = 0;
+			}
+			return changed;
 		}
 	}
 	while(nread != 0);
 
+	w->partial = 0;
 	return changed;
 }
 
@@ -177,12 +275,35 @@ update_file_stats(fswatch_t *w, const struct inotify_event *e, time_t now)
 	enum { HITS_TO_BAN_AFTER = 5, BAN_SECS = 5 };
 
 	const uint32_t IMPORTANT_EVENTS = IN_CREATE | IN_DELETE | IN_MOVED_FROM
-	                                | IN_MOVED_TO | IN_Q_OVERFLOW;
+	                                | IN_MOVED_TO;
 
-	const char *const fname = (e->len == 0U) ? "." : e->name;
+	char fname[PATH_MAX];
+	const char *dir;
 	void *data;
 	notif_stat_t *stats;
 
+	/* Some events were lost, so everything needs to be checked anew. */
+	if(e->mask & IN_Q_OVERFLOW)
+	{
+		return 1;
+	}
+
+	dir = (e->wd >= 0 && e->wd < w->npaths) ? w->paths[e->wd] : NULL;
+	if(dir == NULL)
+	{
+		return 1;
+	}
+
+	/* Statistics is kept per path as several directories might be watched. */
+	if(e->len == 0U)
+	{
+		copy_str(fname, sizeof(fname), dir);
+	}
+	else
+	{
+		snprintf(fname, sizeof(fname), "%s/%s", dir, e->name);
+	}
+
 	/* See if we already know this file and retrieve associated information if
 	 * so. */
 	if(trie_get(w->stats, fname, &data) != 0)
@@ -234,6 +355,59 @@ update_file_stats(fswatch_t *w, const struct inotify_event *e, time_t now)
 	return 1;
 }
 
+/* Adds name of the file event is about to the list of changes or marks the list
+ * as incomplete if the event can't be described by a name. */
+static void
+record_change(fswatch_t *w, const struct inotify_event *e,
+		fswatch_changes_t *changes)
+{
+	/* Reporting many names is no cheaper than rereading the directory. */
+	enum { MAX_NAMES = 256 };
+
+	int i;
+	int *created;
+
+	if(!changes->complete)
+	{
+		return;
+	}
+
+	/* Lost events, events of the directory itself or of other directories. */
+	if((e->mask & IN_Q_OVERFLOW) || e->wd != w->root_wd || e->len == 0U ||
+			changes->count == MAX_NAMES)
+	{
+		changes->complete = 0;
+		return;
+	}
+
+	for(i = 0; i < changes->count; ++i)
+	{
+		if(strcmp(changes->names[i], e->name) == 0)
+		{
+			return;
+		}
+	}
+
+	created = realloc(changes->created,
+			sizeof(*changes->created)*(changes->count + 1));
+	if(created == NULL)
+	{
+		changes->complete = 0;
+		return;
+	}
+	changes->created = created;
+
+	if(add_to_string_array(&changes->names, changes->count, 1, e->name) ==
+			changes->count)
+	{
+		changes->complete = 0;
+		return;
+	}
+
+	/* Only the first event tells whether the file existed before. */
+	created[changes->count++] = (e->mask & (IN_CREATE | IN_MOVED_TO)) != 0U;
+}
+
 #else
 
 #include "filemon.h"
@@ -282,6 +456,15 @@ fswatch_free(fswatch_t *w)
 	}
 }
 
+int
+fswatch_add(fswatch_t *w, const char path[])
+{
+	/* Polling of many directories isn't cheaper than what callers can do. */
+	(void)w;
+	(void)path;
+	return 1;
+}
+
 int
 fswatch_changed(fswatch_t *w, int *error)
 {
@@ -302,7 +485,28 @@ fswatch_changed(fswatch_t *w, int *error)
 	return changed;
 }
 
+int
+fswatch_poll(fswatch_t *w, int *error, fswatch_changes_t *changes)
+{
+	/* Timestamps don't tell which files were changed. */
+	changes->names = NULL;
+	changes->created = NULL;
+	changes->count = 0;
+	changes->complete = 0;
+	return fswatch_changed(w, error);
+}
+
 #endif
 
+void
+fswatch_changes_free(fswatch_changes_t *changes)
+{
+	free_string_array(changes->names, changes->count);
+	free(changes->created);
+	changes->names = NULL;
+	changes->created = NULL;
+	changes->count = 0;
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
@@ -24,8 +24,10 @@
 #include <string.h> /* strdup */
 
 #include "../compat/fs_limits.h"
+#include "fs.h"
 #include "macros.h"
 #include "str.h"
+#include "string_array.h"
 #include "utf8.h"
 
 /* Watcher data. */
@@ -34,6 +36,7 @@ struct fswatch_t
 	FILETIME dir_mtime;
 	HANDLE dir_watcher;
 	wchar_t *wpath;
+	char *path;
 };
 
 static int get_dir_mtime(const wchar_t dir_path[], FILETIME *ft);
@@ -54,8 +57,17 @@ fswatch_create(const char path[])
 		return NULL;
 	}
 
+	w->path = strdup(path);
+	if(w->path == NULL)
+	{
+		free(w->wpath);
+		free(w);
+		return NULL;
+	}
+
 	if(get_dir_mtime(w->wpath, &w->dir_mtime) != 0)
 	{
+		free(w->path);
 		free(w->wpath);
 		free(w);
 		return NULL;
@@ -67,6 +79,7 @@ fswatch_create(const char path[])
 			FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SECURITY);
 	if(w->dir_watcher == INVALID_HANDLE_VALUE)
 	{
+		free(w->path);
 		free(w->wpath);
 		free(w);
 		return NULL;
@@ -81,11 +94,19 @@ fswatch_free(fswatch_t *w)
 	if(w != NULL)
 	{
 		FindCloseChangeNotification(w->dir_watcher);
+		free(w->path);
 		free(w->wpath);
 		free(w);
 	}
 }
 
+int
+fswatch_add(fswatch_t *w, const char path[])
+{
+	/* Whole subtree is watched already. */
+	return !is_in_subtree(path, w->path);
+}
+
 int
 fswatch_changed(fswatch_t *w, int *error)
 {
@@ -112,6 +133,27 @@ fswatch_changed(fswatch_t *w, int *error)
 	return changed;
 }
 
+int
+fswatch_poll(fswatch_t *w, int *error, fswatch_changes_t *changes)
+{
+	/* Notifications don't tell which files were changed. */
+	changes->names = NULL;
+	changes->created = NULL;
+	changes->count = 0;
+	changes->complete = 0;
+	return fswatch_changed(w, error);
+}
+
+void
+fswatch_changes_free(fswatch_changes_t *changes)
+{
+	free_string_array(changes->names, changes->count);
+	free(changes->created);
+	changes->names = NULL;
+	changes->created = NULL;
+	changes->count = 0;
+}
+
 /* Gets last directory modification time.  Returns non-zero on error, otherwise
  * zero is returned. */
 static int
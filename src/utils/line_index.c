@@ -0,0 +1,487 @@
+/* vifm
+ * Copyright (C) 2026 agent.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "line_index.h"
+
+#ifndef _WIN32
+#include <sys/mman.h> /* MAP_FAILED MAP_PRIVATE PROT_READ mmap() munmap() */
+#include <sys/stat.h> /* S_ISREG() fstat() stat */
+#include <fcntl.h> /* O_RDONLY open() */
+#include <unistd.h> /* close() */
+#endif
+
+#include <errno.h> /* ETIMEDOUT */
+#include <limits.h> /* INT_MAX */
+#ifndef _WIN32
+#include <setjmp.h> /* sigjmp_buf siglongjmp() sigsetjmp() */
+#include <signal.h> /* SIGBUS sigaction sigemptyset() */
+#endif
+#include <stddef.h> /* NULL size_t */
+#include <stdlib.h> /* calloc() free() malloc() */
+#include <string.h> /* memcmp() memcpy() */
+#include <time.h> /* timespec */
+
+#include "../compat/pthread.h"
+#include "macros.h"
+#include "tpool.h"
+
+/* Number of bits of line number that address line inside a block. */
+#define BLOCK_BITS 16
+
+/* Number of lines in a single block of the index. */
+#define BLOCK_SIZE (1 << BLOCK_BITS)
+
+/* Maximum number of blocks, enough to address INT_MAX lines. */
+#define MAX_BLOCKS (INT_MAX/BLOCK_SIZE + 1)
+
+/* Number of lines indexed between updates of the number of available lines. */
+#define PUBLISH_STEP 4096
+
+/* Number of bytes indexed between updates of the number of available lines, so
+ * that long lines don't delay them (and reaction to stop request). */
+#define PUBLISH_BYTES (64*1024)
+
+/* Memory-mapped file with its index.  Blocks are never moved, so that lines
+ * which are already published can be accessed without locking. */
+struct line_index_t
+{
+	const char *data;       /* Contents of the file. */
+	size_t size;            /* Size of the file. */
+	li_measure_func measure; /* Function to compute values of lines or NULL. */
+
+	size_t **starts; /* Offsets of beginnings of lines in blocks. */
+	int **measures;  /* Results of measure function in blocks. */
+
+	pthread_mutex_t lock;     /* Protects fields below. */
+	pthread_cond_t published; /* Signaled when more lines become available. */
+	int count;                /* Number of lines available to readers. */
+	int complete;             /* Whether indexing is finished. */
+	int stop;                 /* Whether indexing should be stopped. */
+
+	pthread_t thread; /* Indexing thread. */
+};
+
+#ifndef _WIN32
+static void init_fault_guard(void);
+static void handle_sigbus(int sig);
+static void * indexer(void *arg);
+static void index_lines(line_index_t *li, volatile int *count);
+#endif
+static int add_line(line_index_t *li, int line, const char start[],
+		const char end[]);
+static int publish(line_index_t *li, int count, int complete);
+static void free_index(line_index_t *li);
+static const char * skip_eol(const char eol[], const char end[]);
+
+#ifndef _WIN32
+/* Makes sure that fault guard is initialized only once. */
+static pthread_once_t fault_guard_once = PTHREAD_ONCE_INIT;
+/* Whether handler of SIGBUS was installed successfully. */
+static int fault_guard_ok;
+/* Thread-specific pointer to sigjmp_buf to jump to on SIGBUS or NULL. */
+static pthread_key_t fault_jump;
+/* Handler of SIGBUS that was active before ours. */
+static struct sigaction prev_sigbus;
+#endif
+
+line_index_t *
+li_open(const char path[], li_measure_func measure)
+{
+#ifndef _WIN32
+	struct stat st;
+	void *data;
+	line_index_t *li;
+	int fd;
+
+	/* Pages of the file that is truncated after being mapped can't be accessed,
+	 * it's only safe to proceed if we can survive such accesses. */
+	(void)pthread_once(&fault_guard_once, &init_fault_guard);
+	if(!fault_guard_ok)
+	{
+		return NULL;
+	}
+
+	fd = open(path, O_RDONLY);
+	if(fd == -1)
+	{
+		return NULL;
+	}
+
+	if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+			(off_t)(size_t)st.st_size != st.st_size)
+	{
+		close(fd);
+		return NULL;
+	}
+
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED)
+	{
+		return NULL;
+	}
+
+	li = calloc(1, sizeof(*li));
+	if(li == NULL)
+	{
+		munmap(data, st.st_size);
+		return NULL;
+	}
+
+	li->data = data;
+	li->size = st.st_size;
+	li->measure = measure;
+	li->starts = calloc(MAX_BLOCKS, sizeof(*li->starts));
+	li->measures = calloc(MAX_BLOCKS, sizeof(*li->measures));
+	if(li->starts == NULL || li->measures == NULL)
+	{
+		free_index(li);
+		return NULL;
+	}
+
+	pthread_mutex_init(&li->lock, NULL);
+	pthread_cond_init(&li->published, NULL);
+
+	if(pthread_create(&li->thread, NULL, &indexer, li) != 0)
+	{
+		pthread_cond_destroy(&li->published);
+		pthread_mutex_destroy(&li->lock);
+		free_index(li);
+		return NULL;
+	}
+
+	return li;
+#else
+	(void)path;
+	(void)measure;
+	return NULL;
+#endif
+}
+
+void
+li_close(line_index_t *li)
+{
+	if(li == NULL)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&li->lock);
+	li->stop = 1;
+	pthread_mutex_unlock(&li->lock);
+
+	pthread_join(li->thread, NULL);
+
+	pthread_cond_destroy(&li->published);
+	pthread_mutex_destroy(&li->lock);
+	free_index(li);
+}
+
+int
+li_count(line_index_t *li, int *complete)
+{
+	int count;
+
+	pthread_mutex_lock(&li->lock);
+	count = li->count;
+	*complete = li->complete;
+	pthread_mutex_unlock(&li->lock);
+
+	return count;
+}
+
+int
+li_wait(line_index_t *li, int count, int timeout_ms)
+{
+	struct timespec deadline;
+	tpool_deadline(timeout_ms, &deadline);
+
+	pthread_mutex_lock(&li->lock);
+	while(li->count <= count && !li->complete)
+	{
+		if(timeout_ms < 0)
+		{
+			pthread_cond_wait(&li->published, &li->lock);
+		}
+		else if(pthread_cond_timedwait(&li->published, &li->lock,
+					&deadline) == ETIMEDOUT)
+		{
+			break;
+		}
+	}
+	count = li->count;
+	pthread_mutex_unlock(&li->lock);
+
+	return count;
+}
+
+size_t
+li_get(line_index_t *li, int line, char buf[], size_t max_len)
+{
+#ifndef _WIN32
+	sigjmp_buf env;
+	volatile size_t copied = 0U;
+	const size_t offset =
+		li->starts[line >> BLOCK_BITS][line & (BLOCK_SIZE - 1)];
+	const char *const start = li->data + offset;
+	const char *const end = start + MIN(li->size - offset, max_len);
+
+	if(sigsetjmp(env, 1) == 0)
+	{
+		size_t len;
+
+		(void)pthread_setspecific(fault_jump, &env);
+		len = li_find_eol(start, end) - start;
+		memcpy(buf, start, len);
+		copied = len;
+	}
+	(void)pthread_setspecific(fault_jump, NULL);
+
+	buf[copied] = '\0';
+	return copied;
+#else
+	(void)li;
+	(void)line;
+	(void)max_len;
+	buf[0] = '\0';
+	return 0U;
+#endif
+}
+
+int
+li_measure(line_index_t *li, int line)
+{
+	return (li->measure == NULL)
+	     ? 0
+	     : li->measures[line >> BLOCK_BITS][line & (BLOCK_SIZE - 1)];
+}
+
+const char *
+li_find_eol(const char from[], const char end[])
+{
+	while(from < end && *from != '\n' && *from != '\r' && *from != '\0')
+	{
+		++from;
+	}
+	return from;
+}
+
+#ifndef _WIN32
+
+/* Installs handler of SIGBUS that turns faults on accessing truncated part of
+ * the file into jumps out of the code that accesses it. */
+static void
+init_fault_guard(void)
+{
+	struct sigaction action;
+
+	if(pthread_key_create(&fault_jump, NULL) != 0)
+	{
+		return;
+	}
+
+	action.sa_handler = &handle_sigbus;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = 0;
+	fault_guard_ok = (sigaction(SIGBUS, &action, &prev_sigbus) == 0);
+}
+
+/* Handles SIGBUS by jumping out of code that accessed the mapping.  Faults
+ * elsewhere are passed to the previous handler by restoring it, which makes the
+ * faulting instruction raise the signal again. */
+static void
+handle_sigbus(int sig)
+{
+	sigjmp_buf *const env = pthread_getspecific(fault_jump);
+	if(env != NULL)
+	{
+		siglongjmp(*env, 1);
+	}
+
+	(void)sigaction(SIGBUS, &prev_sigbus, NULL);
+}
+
+/* Entry point of indexing thread.  Returns NULL. */
+static void *
+indexer(void *arg)
+{
+	line_index_t *const li = arg;
+	sigjmp_buf env;
+	volatile int count = 0;
+
+	/* Fault means that the file was truncated, lines indexed before that are
+	 * still available and the rest of the file is treated as missing. */
+	if(sigsetjmp(env, 1) == 0)
+	{
+		(void)pthread_setspecific(fault_jump, &env);
+		index_lines(li, &count);
+	}
+	(void)pthread_setspecific(fault_jump, NULL);
+
+	(void)publish(li, count, 1);
+	return NULL;
+}
+
+/* Indexes lines of the file until its end or until stop is requested.  *count
+ * is kept equal to number of indexed lines. */
+static void
+index_lines(line_index_t *li, volatile int *count)
+{
+	const char *const end = li->data + li->size;
+	const char *p = li->data;
+	const char *last_publish;
+
+	/* Skip UTF-8 BOM. */
+	if(li->size >= 3U && memcmp(p, "\xef\xbb\xbf", 3U) == 0)
+	{
+		p += 3;
+	}
+
+	last_publish = p;
+	while(p < end && *count < INT_MAX)
+	{
+		const char *const eol = li_find_eol(p, end);
+		if(add_line(li, *count, p, eol) != 0)
+		{
+			break;
+		}
+
+		++*count;
+		p = skip_eol(eol, end);
+
+		if(*count%PUBLISH_STEP == 0 || p - last_publish >= PUBLISH_BYTES)
+		{
+			if(publish(li, *count, 0) != 0)
+			{
+				break;
+			}
+			last_publish = p;
+		}
+	}
+}
+
+#endif
+
+/* Adds line that spans from start to end to the index, allocating new block if
+ * needed.  Returns zero on success, otherwise non-zero is returned. */
+static int
+add_line(line_index_t *li, int line, const char start[], const char end[])
+{
+	const int block = line >> BLOCK_BITS;
+	const int index = line & (BLOCK_SIZE - 1);
+
+	if(index == 0)
+	{
+		li->starts[block] = malloc(sizeof(**li->starts)*BLOCK_SIZE);
+		if(li->starts[block] == NULL)
+		{
+			return 1;
+		}
+
+		if(li->measure != NULL)
+		{
+			li->measures[block] = malloc(sizeof(**li->measures)*BLOCK_SIZE);
+			if(li->measures[block] == NULL)
+			{
+				return 1;
+			}
+		}
+	}
+
+	li->starts[block][index] = start - li->data;
+
+	if(li->measure != NULL)
+	{
+		li->measures[block][index] = li->measure(start, end - start);
+	}
+
+	return 0;
+}
+/* Makes count lines available to readers.  Returns non-zero if indexing should
+ * be stopped, otherwise zero is returned. */
+static int
+publish(line_index_t *li, int count, int complete)
+{
+	int stop;
+
+	pthread_mutex_lock(&li->lock);
+	li->count = count;
+	li->complete = complete;
+	stop = li->stop;
+	pthread_cond_broadcast(&li->published);
+	pthread_mutex_unlock(&li->lock);
+
+	return stop;
+}
+
+/* Frees index along with all its blocks and unmaps the file. */
+static void
+free_index(line_index_t *li)
+{
+	int i;
+
+	for(i = 0; i < MAX_BLOCKS; ++i)
+	{
+		if(li->starts != NULL)
+		{
+			free(li->starts[i]);
+		}
+		if(li->measures != NULL)
+		{
+			free(li->measures[i]);
+		}
+	}
+	free(li->starts);
+	free(li->measures);
+
+#ifndef _WIN32
+	munmap((void *)li->data, li->size);
+#endif
+	free(li);
+}
+
+/* Skips line separator at eol.  Returns pointer to the beginning of the next
+ * line or end. */
+static const char *
+skip_eol(const char eol[], const char end[])
+{
+	if(eol == end)
+	{
+		return end;
+	}
+
+	if(*eol == '\n')
+	{
+		return eol + 1;
+	}
+
+	if(*eol == '\r')
+	{
+		return (eol + 1 < end && eol[1] == '\n') ? eol + 2 : eol + 1;
+	}
+
+	do
+	{
+		++eol;
+	}
+	while(eol < end && *eol == '\0');
+	return eol;
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
@@ -0,0 +1,74 @@
+/* vifm
+ * Copyright (C) 2026 agent.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef VIFM__UTILS__LINE_INDEX_H__
+#define VIFM__UTILS__LINE_INDEX_H__
+
+#include <stddef.h> /* size_t */
+
+/* line_index - memory-mapped file with list of its lines built in
+ * background */
+
+/* Lines are split in the same way as read_file_lines() does it: on "\n", "\r",
+ * "\r\n" and sequences of null characters.  Leading UTF-8 BOM is skipped.
+ * Truncation of the file while it's mapped doesn't cause a crash, part of the
+ * file that became unavailable is treated as missing. */
+
+/* Declaration of opaque line index type. */
+typedef struct line_index_t line_index_t;
+
+/* Type of function that computes a number associated with a line.  Invoked on
+ * indexing thread with the line inside of the mapping, which is len bytes long
+ * and isn't null-terminated. */
+typedef int (*li_measure_func)(const char line[], size_t len);
+
+/* Maps the file into memory and starts indexing it in background.  measure
+ * can be NULL.  Returns NULL on error or if file can't be mapped. */
+line_index_t * li_open(const char path[], li_measure_func measure);
+
+/* Stops indexing and unmaps the file.  Closing NULL index is OK. */
+void li_close(line_index_t *li);
+
+/* Retrieves number of lines indexed so far.  *complete is set to non-zero if
+ * the whole file is indexed.  Returns the number. */
+int li_count(line_index_t *li, int *complete);
+
+/* Waits until there are more than count lines or indexing is finished for at
+ * most timeout_ms milliseconds, negative timeout means waiting without a limit.
+ * Returns number of lines indexed by that time. */
+int li_wait(line_index_t *li, int count, int timeout_ms);
+
+/* Copies at most max_len leading bytes of the line, which must be less than the
+ * last value returned by li_count() or li_wait(), into the buf and
+ * null-terminates the copy (buf must be at least max_len + 1 bytes long).  Line
+ * that can't be read anymore is empty.  Returns number of copied bytes. */
+size_t li_get(line_index_t *li, int line, char buf[], size_t max_len);
+
+/* Retrieves result of measure function for the line, which must be less than
+ * the last value returned by li_count() or li_wait().  Returns the value or
+ * zero if there is no measure function. */
+int li_measure(line_index_t *li, int line);
+
+/* Finds end of the line that starts at from in the same way as indexing does
+ * it.  Returns pointer to the first line separator or end. */
+const char * li_find_eol(const char from[], const char end[]);
+
+#endif /* VIFM__UTILS__LINE_INDEX_H__ */
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
@@ -20,15 +20,17 @@
 
 #include <regex.h> /* regex_t regcomp() regexec() regfree() */
 
-#include <stddef.h> /* NULL */
-#include <stdlib.h> /* free() malloc() */
-#include <string.h> /* strdup() strlen() strrchr() strspn() */
+#include <stddef.h> /* NULL size_t */
+#include <stdlib.h> /* calloc() free() malloc() */
+#include <string.h> /* strcspn() strdup() strlen() strrchr() strspn() */
 
+#include "../compat/fs_limits.h"
 #include "../int/file_magic.h"
 #include "globs.h"
 #include "path.h"
 #include "regexp.h"
 #include "str.h"
+#include "trie.h"
 
 /* Type of a matcher. */
 typedef enum
@@ -39,6 +41,19 @@ typedef enum
 }
 MType;
 
+/* Globs of a list that can be matched without regular expressions, which
+ * covers most of patterns in practice (exact names, extensions and prefixes).
+ * Everything is stored in lower case to account for case insensitivity. */
+typedef struct
+{
+	trie_t *names;    /* Globs without wildcards. */
+	trie_t *heads;    /* Literal parts of "head*" globs. */
+	trie_t *tails;    /* Reversed literal parts of "*tail" globs. */
+	int has_rest;     /* Whether there are globs handled by regular expression. */
+	regex_t rest;     /* Regular expression for globs that don't fit above. */
+}
+literal_globs_t;
+
 /* Wrapper for a regular expression, its state and compiled form. */
 struct matcher_t
 {
@@ -50,6 +65,9 @@ struct matcher_t
 	int cflags;    /* Regular expression compilation flags. */
 	int negated;   /* Whether match is inverted. */
 	regex_t regex; /* The expression in compiled form. */
+
+	/* Faster alternative to the regex for globs, can be NULL. */
+	literal_globs_t *literals;
 };
 
 static int is_full_path(const char expr[], int re, int glob, int *strip);
@@ -61,6 +79,10 @@ static int parse_glob(matcher_t *m, int strip, char **error);
 static int parse_re(matcher_t *m, int strip, int cs_by_def,
 		const char on_empty_re[], char **error);
 static void free_matcher_items(matcher_t *matcher);
+static literal_globs_t * make_literal_globs(const char globs[]);
+static int add_literal_glob(literal_globs_t *lits, const char glob[]);
+static void free_literal_globs(literal_globs_t *lits);
+static int match_literal_globs(const literal_globs_t *lits, const char str[]);
 static int is_negated(const char **expr, int allow_empty);
 static int is_re_expr(const char expr[], int allow_empty);
 static int is_globs_expr(const char expr[]);
@@ -199,6 +221,12 @@ compile_expr(matcher_t *m, int strip, int cs_by_def, const char on_empty_re[],
 		return 1;
 	}
 
+	if(m->type != MT_REGEX)
+	{
+		/* Failing to make this is not an error, the regex will do. */
+		m->literals = make_literal_globs(m->undec);
+	}
+
 	return 0;
 }
 
@@ -289,6 +317,8 @@ matcher_clone(const matcher_t *matcher)
 	clone->raw = strdup(matcher->raw);
 	clone->undec = strdup(matcher->undec);
 
+	clone->literals = NULL;
+
 	err = regcomp(&clone->regex, matcher->raw, matcher->cflags);
 
 	if(err != 0 || clone->expr == NULL || clone->raw == NULL ||
@@ -298,6 +328,11 @@ matcher_clone(const matcher_t *matcher)
 		return NULL;
 	}
 
+	if(matcher->literals != NULL)
+	{
+		clone->literals = make_literal_globs(clone->undec);
+	}
+
 	return clone;
 }
 
@@ -320,6 +355,193 @@ free_matcher_items(matcher_t *matcher)
 	free(matcher->raw);
 	free(matcher->undec);
 	regfree(&matcher->regex);
+	free_literal_globs(matcher->literals);
+}
+
+/* Splits list of globs into those that can be matched literally and the rest,
+ * which are turned into regular expression.  Returns NULL if there are no
+ * globs of the first kind or on error. */
+static literal_globs_t *
+make_literal_globs(const char globs[])
+{
+	char *rest = NULL;
+	size_t rest_len = 0U;
+	int nliterals = 0;
+	char *glob, *state = NULL;
+
+	char *const globs_copy = strdup(globs);
+	literal_globs_t *const lits = calloc(1, sizeof(*lits));
+	if(lits == NULL || globs_copy == NULL)
+	{
+		free(globs_copy);
+		free(lits);
+		return NULL;
+	}
+
+	lits->names = trie_create();
+	lits->heads = trie_create();
+	lits->tails = trie_create();
+
+	/* Globs are split the same way as it's done by globs_to_regex(). */
+	glob = globs_copy;
+	while((glob = split_and_get(glob, ',', &state)) != NULL)
+	{
+		const int error = add_literal_glob(lits, glob);
+		if(error < 0)
+		{
+			break;
+		}
+		if(error == 0)
+		{
+			++nliterals;
+		}
+		else if(strappend(&rest, &rest_len, rest_len == 0U ? "" : ",") != 0 ||
+				strappend(&rest, &rest_len, glob) != 0)
+		{
+			break;
+		}
+	}
+	free(globs_copy);
+
+	if(glob == NULL && nliterals != 0 && rest != NULL)
+	{
+		char *const re = globs_to_regex(rest);
+		lits->has_rest = (re != NULL &&
+				regcomp(&lits->rest, re, REG_EXTENDED | REG_ICASE) == 0);
+		if(!lits->has_rest)
+		{
+			/* Don't leave out any globs. */
+			nliterals = 0;
+		}
+		free(re);
+	}
+	free(rest);
+
+	if(glob != NULL || nliterals == 0 || lits->names == NULL ||
+			lits->heads == NULL || lits->tails == NULL)
+	{
+		free_literal_globs(lits);
+		return NULL;
+	}
+
+	return lits;
+}
+
+/* Adds glob to the literal globs if it's of suitable form.  Returns zero if it
+ * was added, positive number if it's of unsuitable form and negative number on
+ * error. */
+static int
+add_literal_glob(literal_globs_t *lits, const char glob[])
+{
+	char lower[NAME_MAX + 1];
+	size_t len = strlen(glob);
+	size_t i;
+	int head = 0, tail = 0;
+
+	if(glob[0] == '*')
+	{
+		++glob;
+		--len;
+		tail = 1;
+	}
+	else if(len != 0U && glob[len - 1U] == '*')
+	{
+		--len;
+		head = 1;
+	}
+
+	if(len >= sizeof(lower) || strcspn(glob, "*?[\\") < len)
+	{
+		return 1;
+	}
+
+	for(i = 0U; i < len; ++i)
+	{
+		const unsigned char c = glob[i];
+		/* Case folding of non-ASCII characters depends on locale. */
+		if(c >= 0x80)
+		{
+			return 1;
+		}
+		lower[tail ? (len - 1U - i) : i] = (c >= 'A' && c <= 'Z')
+		                                 ? (c - 'A' + 'a')
+		                                 : c;
+	}
+	lower[len] = '\0';
+
+	if(tail)
+	{
+		return (trie_put(lits->tails, lower) < 0) ? -1 : 0;
+	}
+	if(head)
+	{
+		return (trie_put(lits->heads, lower) < 0) ? -1 : 0;
+	}
+	return (trie_put(lits->names, lower) < 0) ? -1 : 0;
+}
+
+/* Frees literal globs.  lits can be NULL. */
+static void
+free_literal_globs(literal_globs_t *lits)
+{
+	if(lits != NULL)
+	{
+		trie_free(lits->names);
+		trie_free(lits->heads);
+		trie_free(lits->tails);
+		if(lits->has_rest)
+		{
+			regfree(&lits->rest);
+		}
+		free(lits);
+	}
+}
+
+/* Matches the string against literal globs and the rest of globs.  Returns
+ * non-zero on match, zero on mismatch and negative value if the string can't be
+ * checked this way. */
+static int
+match_literal_globs(const literal_globs_t *lits, const char str[])
+{
+	char lower[PATH_MAX + 1];
+	char reversed[PATH_MAX + 1];
+	size_t len;
+	void *data;
+
+	for(len = 0U; str[len] != '\0'; ++len)
+	{
+		const unsigned char c = str[len];
+		if(c >= 0x80 || len == sizeof(lower) - 1U)
+		{
+			return -1;
+		}
+		lower[len] = (c >= 'A' && c <= 'Z') ? (c - 'A' + 'a') : c;
+	}
+	lower[len] = '\0';
+
+	if(trie_get(lits->names, lower, &data) == 0 ||
+			trie_has_prefix(lits->heads, lower, len))
+	{
+		return 1;
+	}
+
+	/* Leading "*" doesn't match empty string nor leading dot (see globs.h). */
+	if(len != 0U && lower[0] != '.')
+	{
+		size_t i;
+		for(i = 0U; i < len; ++i)
+		{
+			reversed[len - 1U - i] = lower[i];
+		}
+		reversed[len] = '\0';
+
+		if(trie_has_prefix(lits->tails, reversed, len - 1U))
+		{
+			return 1;
+		}
+	}
+
+	return lits->has_rest && regexec(&lits->rest, str, 0, NULL, 0) == 0;
 }
 
 int
@@ -338,6 +560,15 @@ matcher_matches(const matcher_t *matcher, const char path[])
 		path = get_last_path_component(path);
 	}
 
+	if(matcher->literals != NULL)
+	{
+		const int match = match_literal_globs(matcher->literals, path);
+		if(match >= 0)
+		{
+			return (match != 0)^matcher->negated;
+		}
+	}
+
 	return (regexec(&matcher->regex, path, 0, NULL, 0) == 0)^matcher->negated;
 }
 
@@ -410,5 +641,11 @@ matcher_is_full_path(const matcher_t *matcher)
 	return matcher->full_path;
 }
 
+int
+matcher_is_mime(const matcher_t *matcher)
+{
+	return matcher->type == MT_MIME;
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
@@ -232,6 +232,20 @@ matchers_includes(const matchers_t *matchers, const matchers_t *like)
 	return 1;
 }
 
+int
+matchers_match_names_only(const matchers_t *matchers)
+{
+	int i;
+	for(i = 0; i < matchers->count; ++i)
+	{
+		if(matcher_is_mime(matchers->list[i]))
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
 int
 matchers_is_expr(const char str[])
 {
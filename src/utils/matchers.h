@@ -50,6 +50,10 @@ const char * matchers_get_expr(const matchers_t *matchers);
  * Returns non-zero if so, otherwise zero is returned. */
 int matchers_includes(const matchers_t *matchers, const matchers_t *like);
 
+/* Checks whether result of matching depends only on path/name and not on
+ * contents of a file.  Returns non-zero if so, otherwise zero is returned. */
+int matchers_match_names_only(const matchers_t *matchers);
+
 /* Checks whether given string is a list of match expressions.  Returns non-zero
  * if so, otherwise zero is returned. */
 int matchers_is_expr(const char str[]);
@@ -0,0 +1,290 @@
+/* vifm
+ * Copyright (C) 2026 agent.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "tpool.h"
+
+#include <sys/time.h> /* gettimeofday() */
+
+#include <errno.h> /* ETIMEDOUT */
+#include <stdlib.h> /* calloc() free() malloc() */
+#include <time.h> /* timespec */
+
+#include "../compat/pthread.h"
+
+/* Single queued task. */
+typedef struct task_t
+{
+	tpool_func func;     /* Function to invoke. */
+	void *arg;           /* Argument for the function. */
+	struct task_t *next; /* Next task in the queue. */
+}
+task_t;
+
+/* Thread pool. */
+struct tpool_t
+{
+	pthread_mutex_t lock;      /* Protects all fields below. */
+	pthread_cond_t task_added; /* Signaled when a task is queued or on exit. */
+	pthread_cond_t task_taken; /* Signaled when a task leaves the queue. */
+	pthread_cond_t task_done;  /* Signaled when a task is finished. */
+
+	task_t *head;   /* First task in the queue. */
+	task_t *tail;   /* Last task in the queue. */
+	int queued;     /* Number of tasks in the queue. */
+	int max_queued; /* Maximum number of tasks in the queue. */
+	int pending;    /* Number of queued or running tasks. */
+	int exiting;    /* Whether threads should finish. */
+
+	pthread_t *threads; /* Pool threads. */
+	int nthreads;       /* Number of elements in the threads array. */
+};
+
+static void * worker(void *arg);
+static int timed_wait(pthread_cond_t *cond, pthread_mutex_t *lock,
+		const struct timespec *deadline);
+
+tpool_t *
+tpool_alloc(int nthreads, int max_queued)
+{
+	tpool_t *pool;
+
+	if(nthreads <= 0)
+	{
+		return NULL;
+	}
+
+	pool = calloc(1, sizeof(*pool));
+	if(pool == NULL)
+	{
+		return NULL;
+	}
+
+	pool->max_queued = (max_queued > 0) ? max_queued : 1;
+	pool->threads = calloc(nthreads, sizeof(*pool->threads));
+	if(pool->threads == NULL)
+	{
+		free(pool->threads);
+		free(pool);
+		return NULL;
+	}
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->task_added, NULL);
+	pthread_cond_init(&pool->task_taken, NULL);
+	pthread_cond_init(&pool->task_done, NULL);
+
+	for(pool->nthreads = 0; pool->nthreads < nthreads; ++pool->nthreads)
+	{
+		if(pthread_create(&pool->threads[pool->nthreads], NULL, &worker,
+					pool) != 0)
+		{
+			break;
+		}
+	}
+
+	if(pool->nthreads == 0)
+	{
+		tpool_free(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+void
+tpool_free(tpool_t *pool)
+{
+	int i;
+
+	if(pool == NULL)
+	{
+		return;
+	}
+
+	(void)tpool_wait(pool, -1);
+
+	pthread_mutex_lock(&pool->lock);
+	pool->exiting = 1;
+	pthread_cond_broadcast(&pool->task_added);
+	pthread_mutex_unlock(&pool->lock);
+
+	for(i = 0; i < pool->nthreads; ++i)
+	{
+		(void)pthread_join(pool->threads[i], NULL);
+	}
+
+	pthread_cond_destroy(&pool->task_done);
+	pthread_cond_destroy(&pool->task_taken);
+	pthread_cond_destroy(&pool->task_added);
+	pthread_mutex_destroy(&pool->lock);
+
+	free(pool->threads);
+	free(pool);
+}
+
+int
+tpool_push(tpool_t *pool, tpool_func func, void *arg, int timeout_ms)
+{
+	struct timespec deadline;
+	task_t *task;
+
+	task = malloc(sizeof(*task));
+	if(task == NULL)
+	{
+		return -1;
+	}
+
+	task->func = func;
+	task->arg = arg;
+	task->next = NULL;
+
+	tpool_deadline(timeout_ms, &deadline);
+
+	pthread_mutex_lock(&pool->lock);
+
+	while(pool->queued >= pool->max_queued)
+	{
+		if(timed_wait(&pool->task_taken, &pool->lock,
+					timeout_ms < 0 ? NULL : &deadline) != 0)
+		{
+			pthread_mutex_unlock(&pool->lock);
+			free(task);
+			return 1;
+		}
+	}
+
+	if(pool->tail == NULL)
+	{
+		pool->head = task;
+	}
+	else
+	{
+		pool->tail->next = task;
+	}
+	pool->tail = task;
+	++pool->queued;
+	++pool->pending;
+
+	pthread_cond_signal(&pool->task_added);
+	pthread_mutex_unlock(&pool->lock);
+	return 0;
+}
+
+int
+tpool_wait(tpool_t *pool, int timeout_ms)
+{
+	struct timespec deadline;
+	int result = 0;
+
+	tpool_deadline(timeout_ms, &deadline);
+
+	pthread_mutex_lock(&pool->lock);
+	while(pool->pending != 0)
+	{
+		if(timed_wait(&pool->task_done, &pool->lock,
+					timeout_ms < 0 ? NULL : &deadline) != 0)
+		{
+			result = 1;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return result;
+}
+
+void
+tpool_deadline(int timeout_ms, struct timespec *deadline)
+{
+	struct timeval now;
+
+	if(timeout_ms < 0)
+	{
+		return;
+	}
+
+	(void)gettimeofday(&now, NULL);
+	deadline->tv_sec = now.tv_sec + timeout_ms/1000;
+	deadline->tv_nsec = (now.tv_usec + (timeout_ms%1000)*1000L)*1000L;
+	if(deadline->tv_nsec >= 1000000000L)
+	{
+		++deadline->tv_sec;
+		deadline->tv_nsec -= 1000000000L;
+	}
+}
+
+/* Entry point of pool threads.  Processes tasks until pool is freed.  Returns
+ * NULL. */
+static void *
+worker(void *arg)
+{
+	tpool_t *const pool = arg;
+
+	pthread_mutex_lock(&pool->lock);
+	while(1)
+	{
+		task_t *task;
+
+		while(pool->head == NULL && !pool->exiting)
+		{
+			pthread_cond_wait(&pool->task_added, &pool->lock);
+		}
+
+		if(pool->head == NULL)
+		{
+			break;
+		}
+
+		task = pool->head;
+		pool->head = task->next;
+		if(pool->head == NULL)
+		{
+			pool->tail = NULL;
+		}
+		--pool->queued;
+		pthread_cond_signal(&pool->task_taken);
+
+		pthread_mutex_unlock(&pool->lock);
+		task->func(task->arg);
+		free(task);
+		pthread_mutex_lock(&pool->lock);
+
+		--pool->pending;
+		pthread_cond_broadcast(&pool->task_done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+/* Waits on condition variable until it's signaled or deadline is reached.  NULL
+ * deadline means no limit.  Returns zero if condition was signaled, otherwise
+ * non-zero is returned. */
+static int
+timed_wait(pthread_cond_t *cond, pthread_mutex_t *lock,
+		const struct timespec *deadline)
+{
+	if(deadline == NULL)
+	{
+		return pthread_cond_wait(cond, lock);
+	}
+	return pthread_cond_timedwait(cond, lock, deadline) == ETIMEDOUT;
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
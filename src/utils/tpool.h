@@ -0,0 +1,58 @@
+/* vifm
+ * Copyright (C) 2026 agent.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef VIFM__UTILS__TPOOL_H__
+#define VIFM__UTILS__TPOOL_H__
+
+#include <time.h> /* timespec */
+
+/* tpool - thread pool with a bounded queue of tasks */
+
+/* Declaration of opaque thread pool type. */
+typedef struct tpool_t tpool_t;
+
+/* Type of function that performs a task.  Invoked on one of pool threads. */
+typedef void (*tpool_func)(void *arg);
+
+/* Creates pool of nthreads threads that accepts at most max_queued tasks which
+ * aren't yet picked up by any of the threads.  Returns NULL on error. */
+tpool_t * tpool_alloc(int nthreads, int max_queued);
+
+/* Waits for all tasks to finish, stops threads and frees the pool.  Freeing of
+ * NULL pool is OK. */
+void tpool_free(tpool_t *pool);
+
+/* Enqueues a task.  Waits for free space in the queue for at most timeout_ms
+ * milliseconds, negative timeout means waiting without a limit.  Returns zero
+ * if the task was enqueued, positive number on timeout (retrying might
+ * succeed) and negative number on failure to allocate memory. */
+int tpool_push(tpool_t *pool, tpool_func func, void *arg, int timeout_ms);
+
+/* Waits for all enqueued tasks to finish for at most timeout_ms milliseconds,
+ * negative timeout means waiting without a limit.  Returns zero if there are no
+ * more pending tasks, otherwise non-zero is returned. */
+int tpool_wait(tpool_t *pool, int timeout_ms);
+
+/* Computes absolute time that is timeout_ms milliseconds away from now for use
+ * with pthread_cond_timedwait().  Does nothing for negative timeout. */
+void tpool_deadline(int timeout_ms, struct timespec *deadline);
+
+#endif /* VIFM__UTILS__TPOOL_H__ */
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
@@ -34,6 +34,7 @@ struct trie_t
 static trie_t *clone_nodes(trie_t *trie, int *error);
 static void get_or_create(trie_t *trie, const char str[], void *data,
 		int *result);
+static trie_t * find_sibling(trie_t *trie, char value);
 
 trie_t *
 trie_create(void)
@@ -204,5 +205,47 @@ trie_get(trie_t *trie, const char str[], void **data)
 	}
 }
 
+int
+trie_has_prefix(trie_t *trie, const char str[], size_t max_len)
+{
+	size_t len = 0U;
+	while(trie != NULL)
+	{
+		const trie_t *const end = find_sibling(trie, '\0');
+		if(end != NULL && end->exists)
+		{
+			return 1;
+		}
+
+		if(*str == '\0' || len == max_len)
+		{
+			break;
+		}
+
+		trie = find_sibling(trie, *str);
+		if(trie == NULL)
+		{
+			break;
+		}
+
+		trie = trie->children;
+		++str;
+		++len;
+	}
+	return 0;
+}
+
+/* Looks up node with specified value among the node and its siblings.  Returns
+ * the node or NULL if there is no such node. */
+static trie_t *
+find_sibling(trie_t *trie, char value)
+{
+	while(trie != NULL && trie->value != value)
+	{
+		trie = (value < trie->value) ? trie->left : trie->right;
+	}
+	return trie;
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
@@ -19,7 +19,7 @@
 #ifndef VIFM__UTILS__TRIE_H__
 #define VIFM__UTILS__TRIE_H__
 
-#include <stddef.h> /* NULL */
+#include <stddef.h> /* NULL size_t */
 
 /* Declaration of opaque trie type. */
 typedef struct trie_t trie_t;
@@ -54,6 +54,12 @@ int trie_set(trie_t *trie, const char str[], const void *data);
  * non-zero. */
 int trie_get(trie_t *trie, const char str[], void **data);
 
+/* Checks whether the trie contains a string that is a prefix of the str (or the
+ * str itself) and is at most max_len characters long.  trie can be NULL, which
+ * is treated as an empty trie.  Returns non-zero if so, otherwise zero is
+ * returned. */
+int trie_has_prefix(trie_t *trie, const char str[], size_t max_len);
+
 #endif /* VIFM__UTILS__TRIE_H__ */
 
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
@@ -186,6 +186,10 @@ int executable_exists(const char path[]);
  * non-zero is returned. */
 int get_exe_dir(char dir_buf[], size_t dir_buf_len);
 
+/* Queries number of processors available to the application.  Returns the
+ * number, which is always positive. */
+int get_cpu_count(void);
+
 /* Gets type of operating environment the application is running in.  Returns
  * the type. */
 EnvType get_env_type(void);
@@ -31,11 +31,11 @@
 #include <sys/time.h> /* timeval futimens() utimes() */
 #include <sys/types.h> /* gid_t mode_t pid_t uid_t */
 #include <sys/wait.h> /* waitpid */
-#include <fcntl.h> /* open() close() */
+#include <fcntl.h> /* F_GETFL F_SETFL O_NONBLOCK fcntl() open() close() */
 #include <grp.h> /* getgrnam() getgrgid_r() */
 #include <pwd.h> /* getpwnam() getpwuid_r() */
-#include <unistd.h> /* X_OK dup() dup2() getpid() isatty() pause() sysconf()
-                       ttyname() */
+#include <unistd.h> /* X_OK dup() dup2() getpid() isatty() pause() setpgid()
+                       sysconf() ttyname() */
 
 #include <assert.h> /* assert() */
 #include <ctype.h> /* isdigit() */
@@ -703,6 +703,13 @@ get_exe_dir(char dir_buf[], size_t dir_buf_len)
 	return 1;
 }
 
+int
+get_cpu_count(void)
+{
+	const long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return (count > 0) ? count : 1;
+}
+
 EnvType
 get_env_type(void)
 {
@@ -985,6 +992,51 @@ read_cmd_output(const char cmd[])
 	return fp;
 }
 
+int
+read_cmd_output_async(const char cmd[], pid_t *pid)
+{
+	int out_pipe[2];
+	int flags;
+
+	if(pipe(out_pipe) != 0)
+	{
+		return -1;
+	}
+
+	*pid = fork();
+	if(*pid == (pid_t)-1)
+	{
+		close(out_pipe[0]);
+		close(out_pipe[1]);
+		return -1;
+	}
+
+	if(*pid == 0)
+	{
+		/* Put the command and its children into a separate group to be able to
+		 * kill all of them at once. */
+		(void)setpgid(0, 0);
+		run_from_fork(out_pipe, 0, (char *)cmd);
+	}
+
+	/* Do the same in parent to avoid race with kill_process_group(). */
+	(void)setpgid(*pid, *pid);
+	close(out_pipe[1]);
+
+	flags = fcntl(out_pipe[0], F_GETFL);
+	(void)fcntl(out_pipe[0], F_SETFL, flags | O_NONBLOCK);
+
+	return out_pipe[0];
+}
+
+void
+kill_process_group(pid_t pid)
+{
+	/* SIGCHLD handler can reap the process before us, so ignore errors. */
+	(void)kill(-pid, SIGKILL);
+	(void)waitpid(pid, NULL, 0);
+}
+
 const char *
 get_installed_data_dir(void)
 {
@@ -43,6 +43,16 @@ int get_proc_exit_status(pid_t pid);
  * and stderr are redirected to the pipe. */
 void _gnuc_noreturn run_from_fork(int pipe[2], int err_only, char cmd[]);
 
+/* Starts the command in background in a separate process group with both its
+ * stdout and stderr redirected to a non-blocking pipe.  *pid is set to
+ * identifier of the process, which is also identifier of its group.  Returns
+ * read end of the pipe or -1 on error. */
+int read_cmd_output_async(const char cmd[], pid_t *pid);
+
+/* Kills all processes of the group started by read_cmd_output_async() and
+ * reaps its leader. */
+void kill_process_group(pid_t pid);
+
 /* Extracts name of the shell to be used with execv*() function.  Returns
  * pointer to statically allocated buffer. */
 char * get_execv_path(char shell[]);
@@ -497,6 +497,14 @@ get_exe_dir(char dir_buf[], size_t dir_buf_len)
 	return 0;
 }
 
+int
+get_cpu_count(void)
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (info.dwNumberOfProcessors > 0) ? info.dwNumberOfProcessors : 1;
+}
+
 EnvType
 get_env_type(void)
 {
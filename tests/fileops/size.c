@@ -1,12 +1,18 @@
 #include <stic.h>
 
-#include <unistd.h> /* usleep() */
+#include <sys/stat.h> /* stat */
+#include <unistd.h> /* link() rmdir() unlink() usleep() */
 
-#include <string.h> /* strcpy() strdup() */
+#include <stdint.h> /* uint64_t */
+#include <stdio.h> /* FILE fclose() fopen() fwrite() */
+#include <string.h> /* memset() strcpy() strdup() */
 
 #include "../../src/cfg/config.h"
+#include "../../src/compat/os.h"
+#include "../../src/utils/cancellation.h"
 #include "../../src/utils/dynarray.h"
 #include "../../src/filelist.h"
+#include "../../src/fops_common.h"
 #include "../../src/fops_misc.h"
 #include "../../src/status.h"
 
@@ -14,6 +20,8 @@
 
 static void setup_single_entry(FileView *view, const char name[]);
 static uint64_t wait_for_size(const char path[]);
+static void make_file(const char path[], size_t size);
+static uint64_t allocated_size(const char path[]);
 
 SETUP()
 {
@@ -47,6 +55,124 @@ TEST(parent_dir_entry_triggers_calculation_of_current_dir)
 	assert_int_equal(73728, wait_for_size(TEST_DATA_PATH "/various-sizes"));
 }
 
+TEST(sizes_of_nested_directories_are_summed_and_cached)
+{
+	uint64_t size;
+
+	assert_success(os_mkdir(SANDBOX_PATH "/a", 0700));
+	assert_success(os_mkdir(SANDBOX_PATH "/a/b", 0700));
+	assert_success(os_mkdir(SANDBOX_PATH "/a/b/c", 0700));
+	assert_success(os_mkdir(SANDBOX_PATH "/a/d", 0700));
+	make_file(SANDBOX_PATH "/a/file", 1);
+	make_file(SANDBOX_PATH "/a/b/file", 10);
+	make_file(SANDBOX_PATH "/a/b/c/file", 100);
+	make_file(SANDBOX_PATH "/a/d/file", 1000);
+
+	assert_int_equal(1111, fops_dir_size(SANDBOX_PATH "/a", 1, 0,
+				&no_cancellation, NULL, NULL));
+
+	dcache_get_at(SANDBOX_PATH "/a/b", &size, NULL);
+	assert_int_equal(110, size);
+	dcache_get_at(SANDBOX_PATH "/a/b/c", &size, NULL);
+	assert_int_equal(100, size);
+	dcache_get_at(SANDBOX_PATH "/a/d", &size, NULL);
+	assert_int_equal(1000, size);
+
+	assert_success(unlink(SANDBOX_PATH "/a/d/file"));
+	assert_success(unlink(SANDBOX_PATH "/a/b/c/file"));
+	assert_success(unlink(SANDBOX_PATH "/a/b/file"));
+	assert_success(unlink(SANDBOX_PATH "/a/file"));
+	assert_success(rmdir(SANDBOX_PATH "/a/d"));
+	assert_success(rmdir(SANDBOX_PATH "/a/b/c"));
+	assert_success(rmdir(SANDBOX_PATH "/a/b"));
+	assert_success(rmdir(SANDBOX_PATH "/a"));
+}
+
+TEST(cached_sizes_of_subdirectories_are_used_unless_forced)
+{
+	assert_success(os_mkdir(SANDBOX_PATH "/a", 0700));
+	assert_success(os_mkdir(SANDBOX_PATH "/a/b", 0700));
+	make_file(SANDBOX_PATH "/a/b/file", 10);
+
+	assert_success(dcache_set_at(SANDBOX_PATH "/a/b", 5, DCACHE_UNKNOWN));
+	assert_int_equal(5, fops_dir_size(SANDBOX_PATH "/a", 0, 0,
+				&no_cancellation, NULL, NULL));
+	assert_int_equal(10, fops_dir_size(SANDBOX_PATH "/a", 1, 0,
+				&no_cancellation, NULL, NULL));
+
+	assert_success(unlink(SANDBOX_PATH "/a/b/file"));
+	assert_success(rmdir(SANDBOX_PATH "/a/b"));
+	assert_success(rmdir(SANDBOX_PATH "/a"));
+}
+
+TEST(hard_links_are_counted_once, IF(not_windows))
+{
+	assert_success(os_mkdir(SANDBOX_PATH "/a", 0700));
+	assert_success(os_mkdir(SANDBOX_PATH "/a/b", 0700));
+	make_file(SANDBOX_PATH "/a/file", 100);
+	make_file(SANDBOX_PATH "/a/other", 10);
+#ifndef _WIN32
+	assert_success(link(SANDBOX_PATH "/a/file", SANDBOX_PATH "/a/link"));
+	assert_success(link(SANDBOX_PATH "/a/file", SANDBOX_PATH "/a/b/link"));
+#endif
+
+	assert_int_equal(110, fops_dir_size(SANDBOX_PATH "/a", 1, 0,
+				&no_cancellation, NULL, NULL));
+
+	assert_success(unlink(SANDBOX_PATH "/a/b/link"));
+	assert_success(unlink(SANDBOX_PATH "/a/link"));
+	assert_success(unlink(SANDBOX_PATH "/a/other"));
+	assert_success(unlink(SANDBOX_PATH "/a/file"));
+	assert_success(rmdir(SANDBOX_PATH "/a/b"));
+	assert_success(rmdir(SANDBOX_PATH "/a"));
+}
+
+TEST(hard_links_are_counted_in_each_subdirectory, IF(not_windows))
+{
+	uint64_t size;
+
+	assert_success(os_mkdir(SANDBOX_PATH "/a", 0700));
+	assert_success(os_mkdir(SANDBOX_PATH "/a/b", 0700));
+	assert_success(os_mkdir(SANDBOX_PATH "/a/c", 0700));
+	make_file(SANDBOX_PATH "/a/b/file", 100);
+	make_file(SANDBOX_PATH "/a/c/other", 10);
+#ifndef _WIN32
+	assert_success(link(SANDBOX_PATH "/a/b/file", SANDBOX_PATH "/a/c/link"));
+#endif
+
+	assert_int_equal(110, fops_dir_size(SANDBOX_PATH "/a", 1, 0,
+				&no_cancellation, NULL, NULL));
+
+	dcache_get_at(SANDBOX_PATH "/a/b", &size, NULL);
+	assert_int_equal(100, size);
+	dcache_get_at(SANDBOX_PATH "/a/c", &size, NULL);
+	assert_int_equal(110, size);
+
+	assert_success(unlink(SANDBOX_PATH "/a/c/link"));
+	assert_success(unlink(SANDBOX_PATH "/a/c/other"));
+	assert_success(unlink(SANDBOX_PATH "/a/b/file"));
+	assert_success(rmdir(SANDBOX_PATH "/a/c"));
+	assert_success(rmdir(SANDBOX_PATH "/a/b"));
+	assert_success(rmdir(SANDBOX_PATH "/a"));
+}
+
+TEST(allocated_space_can_be_counted, IF(not_windows))
+{
+	assert_success(os_mkdir(SANDBOX_PATH "/a", 0700));
+	assert_success(os_mkdir(SANDBOX_PATH "/a/b", 0700));
+	make_file(SANDBOX_PATH "/a/file", 10000);
+	make_file(SANDBOX_PATH "/a/b/file", 1);
+
+	assert_int_equal(allocated_size(SANDBOX_PATH "/a/b/file") +
+			allocated_size(SANDBOX_PATH "/a/file"),
+			fops_dir_size(SANDBOX_PATH "/a", 1, 1, &no_cancellation, NULL, NULL));
+
+	assert_success(unlink(SANDBOX_PATH "/a/b/file"));
+	assert_success(unlink(SANDBOX_PATH "/a/file"));
+	assert_success(rmdir(SANDBOX_PATH "/a/b"));
+	assert_success(rmdir(SANDBOX_PATH "/a"));
+}
+
 static void
 setup_single_entry(FileView *view, const char name[])
 {
@@ -82,5 +208,34 @@ wait_for_size(const char path[])
 	return size;
 }
 
+static void
+make_file(const char path[], size_t size)
+{
+	char buf[10000];
+	FILE *const f = fopen(path, "wb");
+
+	assert_true(size <= sizeof(buf));
+	memset(buf, 'x', size);
+
+	assert_non_null(f);
+	if(f != NULL)
+	{
+		assert_int_equal(size, fwrite(buf, 1, size, f));
+		fclose(f);
+	}
+}
+
+static uint64_t
+allocated_size(const char path[])
+{
+#ifndef _WIN32
+	struct stat s;
+	assert_success(os_lstat(path, &s));
+	return (uint64_t)s.st_blocks*512U;
+#else
+	return 0U;
+#endif
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
@@ -8,6 +8,7 @@
 
 #include "../../src/compat/fs_limits.h"
 #include "../../src/compat/os.h"
+#include "../../src/io/private/ioeta.h"
 #include "../../src/io/iop.h"
 #include "../../src/utils/fs.h"
 #include "../../src/utils/utils.h"
@@ -151,6 +152,35 @@ TEST(double_block_size_plus_one_file_is_copied)
 			"/various-sizes/double-block-size-plus-one-file");
 }
 
+TEST(progress_is_reported_for_all_bytes)
+{
+	const io_cancellation_t no_cancellation = {};
+	ioeta_estim_t *const estim = ioeta_alloc(NULL, no_cancellation);
+
+	ioeta_calculate(estim,
+			TEST_DATA_PATH "/various-sizes/double-block-size-plus-one-file", 0);
+
+	{
+		io_args_t args = {
+			.arg1.src = TEST_DATA_PATH
+					"/various-sizes/double-block-size-plus-one-file",
+			.arg2.dst = SANDBOX_PATH "/copy",
+			.estim = estim,
+		};
+		ioe_errlst_init(&args.result.errors);
+
+		assert_success(iop_cp(&args));
+
+		assert_int_equal(0, args.result.errors.error_count);
+	}
+
+	assert_int_equal(estim->total_bytes, estim->current_byte);
+	assert_int_equal(1, estim->current_item);
+
+	ioeta_free(estim);
+	delete_test_file(SANDBOX_PATH "/copy");
+}
+
 static void
 file_is_copied(const char original[])
 {
@@ -5,6 +5,7 @@
 #include <unistd.h> /* F_OK access() lstat() */
 
 #include "../../src/compat/os.h"
+#include "../../src/io/private/ioeta.h"
 #include "../../src/io/iop.h"
 #include "../../src/io/ior.h"
 #include "../../src/utils/fs.h"
@@ -497,6 +498,104 @@ TEST(permissions_are_set_in_correct_order)
 	}
 }
 
+TEST(directory_is_copied_in_parallel)
+{
+	const io_cancellation_t no_cancellation = {};
+	ioeta_estim_t *const estim = ioeta_alloc(NULL, no_cancellation);
+
+	ioeta_calculate(estim, TEST_DATA_PATH "/various-sizes", 0);
+
+	{
+		io_args_t args = {
+			.arg1.src = TEST_DATA_PATH "/various-sizes",
+			.arg2.dst = SANDBOX_PATH "/various-sizes",
+			.arg5.max_parallel = 4,
+			.estim = estim,
+		};
+		ioe_errlst_init(&args.result.errors);
+
+		assert_success(ior_cp(&args));
+		assert_int_equal(0, args.result.errors.error_count);
+	}
+
+	assert_int_equal(estim->total_bytes, estim->current_byte);
+	assert_int_equal(get_file_size(TEST_DATA_PATH
+				"/various-sizes/double-block-size-plus-one-file"),
+			get_file_size(SANDBOX_PATH
+				"/various-sizes/double-block-size-plus-one-file"));
+	assert_true(file_exists(SANDBOX_PATH "/various-sizes/empty-file"));
+
+	ioeta_free(estim);
+
+	{
+		io_args_t args = {
+			.arg1.path = SANDBOX_PATH "/various-sizes",
+		};
+		ioe_errlst_init(&args.result.errors);
+
+		assert_success(ior_rm(&args));
+		assert_int_equal(0, args.result.errors.error_count);
+	}
+}
+
+TEST(parallel_copying_sets_permissions_after_files)
+{
+	struct stat src;
+	struct stat dst;
+
+	create_non_empty_nested_dir(SANDBOX_PATH "/dir", "nested-dir", "a-file");
+	create_empty_file(SANDBOX_PATH "/dir/b-file");
+	assert_success(chmod(SANDBOX_PATH "/dir/nested-dir", 0500));
+	assert_success(chmod(SANDBOX_PATH "/dir", 0500));
+
+	{
+		io_args_t args = {
+			.arg1.src = SANDBOX_PATH "/dir",
+			.arg2.dst = SANDBOX_PATH "/dir-copy",
+			.arg5.max_parallel = 2,
+		};
+		ioe_errlst_init(&args.result.errors);
+
+		assert_success(ior_cp(&args));
+		assert_int_equal(0, args.result.errors.error_count);
+	}
+
+	assert_true(file_exists(SANDBOX_PATH "/dir-copy/nested-dir/a-file"));
+	assert_true(file_exists(SANDBOX_PATH "/dir-copy/b-file"));
+
+	assert_success(os_stat(SANDBOX_PATH "/dir", &src));
+	assert_success(os_stat(SANDBOX_PATH "/dir-copy", &dst));
+	assert_int_equal(src.st_mode & 0777, dst.st_mode & 0777);
+	assert_success(os_stat(SANDBOX_PATH "/dir/nested-dir", &src));
+	assert_success(os_stat(SANDBOX_PATH "/dir-copy/nested-dir", &dst));
+	assert_int_equal(src.st_mode & 0777, dst.st_mode & 0777);
+
+	assert_success(chmod(SANDBOX_PATH "/dir", 0700));
+	assert_success(chmod(SANDBOX_PATH "/dir/nested-dir", 0700));
+	assert_success(chmod(SANDBOX_PATH "/dir-copy", 0700));
+	assert_success(chmod(SANDBOX_PATH "/dir-copy/nested-dir", 0700));
+
+	{
+		io_args_t args = {
+			.arg1.path = SANDBOX_PATH "/dir",
+		};
+		ioe_errlst_init(&args.result.errors);
+
+		assert_success(ior_rm(&args));
+		assert_int_equal(0, args.result.errors.error_count);
+	}
+
+	{
+		io_args_t args = {
+			.arg1.path = SANDBOX_PATH "/dir-copy",
+		};
+		ioe_errlst_init(&args.result.errors);
+
+		assert_success(ior_rm(&args));
+		assert_int_equal(0, args.result.errors.error_count);
+	}
+}
+
 /* Creating symbolic links on Windows requires administrator rights. */
 TEST(symlink_to_file_is_symlink_after_copy, IF(not_windows))
 {
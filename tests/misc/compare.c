@@ -1,9 +1,13 @@
 #include <stic.h>
 
+#ifndef _WIN32
+#include <sys/socket.h> /* AF_UNIX SOCK_STREAM bind() socket() */
+#include <sys/un.h> /* sockaddr_un */
+#endif
 #include <sys/stat.h> /* chmod() */
-#include <unistd.h> /* rmdir() symlink() */
+#include <unistd.h> /* close() rmdir() symlink() */
 
-#include <stdio.h> /* remove() */
+#include <stdio.h> /* FILE fclose() fopen() fputs() remove() */
 #include <string.h> /* strcpy() */
 
 #include "../../src/compat/os.h"
@@ -23,6 +27,7 @@
 #include "utils.h"
 
 static void basic_panes_check(int expected_len);
+static void make_socket(const char path[]);
 
 SETUP()
 {
@@ -245,6 +250,79 @@ TEST(single_pane_unique)
 	assert_success(remove(SANDBOX_PATH "/utf8-bom-2"));
 }
 
+TEST(files_of_same_size_are_compared_by_contents)
+{
+	FILE *f;
+
+	f = fopen(SANDBOX_PATH "/a", "w");
+	fputs("abc", f);
+	fclose(f);
+	f = fopen(SANDBOX_PATH "/b", "w");
+	fputs("abd", f);
+	fclose(f);
+	f = fopen(SANDBOX_PATH "/c", "w");
+	fputs("abcd", f);
+	fclose(f);
+
+	strcpy(lwin.curr_dir, SANDBOX_PATH);
+	compare_one_pane(&lwin, CT_CONTENTS, LT_UNIQUE, 0);
+
+	assert_int_equal(CV_REGULAR, lwin.custom.type);
+	assert_int_equal(3, lwin.list_rows);
+
+	assert_success(remove(SANDBOX_PATH "/a"));
+	assert_success(remove(SANDBOX_PATH "/b"));
+	assert_success(remove(SANDBOX_PATH "/c"));
+}
+
+TEST(unreadable_files_of_unique_size_are_dropped, IF(not_windows))
+{
+	FILE *f;
+
+	f = fopen(SANDBOX_PATH "/a", "w");
+	fputs("abc", f);
+	fclose(f);
+	f = fopen(SANDBOX_PATH "/b", "w");
+	fputs("abc", f);
+	fclose(f);
+	/* Socket isn't hashed because of its unique size, but it can't be hashed
+	 * either. */
+	make_socket(SANDBOX_PATH "/sock");
+
+	strcpy(lwin.curr_dir, SANDBOX_PATH);
+	compare_one_pane(&lwin, CT_CONTENTS, LT_ALL, 0);
+
+	assert_true(flist_custom_active(&lwin));
+	assert_int_equal(2, lwin.list_rows);
+	assert_string_equal("a", lwin.dir_entry[0].name);
+	assert_string_equal("b", lwin.dir_entry[1].name);
+	assert_int_equal(lwin.dir_entry[0].id, lwin.dir_entry[1].id);
+
+	assert_success(remove(SANDBOX_PATH "/a"));
+	assert_success(remove(SANDBOX_PATH "/b"));
+	assert_success(remove(SANDBOX_PATH "/sock"));
+}
+
+TEST(unreadable_files_of_same_size_are_dropped, IF(not_windows))
+{
+	FILE *f = fopen(SANDBOX_PATH "/a", "w");
+	fputs("abc", f);
+	fclose(f);
+	make_socket(SANDBOX_PATH "/sock1");
+	make_socket(SANDBOX_PATH "/sock2");
+
+	strcpy(lwin.curr_dir, SANDBOX_PATH);
+	compare_one_pane(&lwin, CT_CONTENTS, LT_ALL, 0);
+
+	assert_true(flist_custom_active(&lwin));
+	assert_int_equal(1, lwin.list_rows);
+	assert_string_equal("a", lwin.dir_entry[0].name);
+
+	assert_success(remove(SANDBOX_PATH "/a"));
+	assert_success(remove(SANDBOX_PATH "/sock1"));
+	assert_success(remove(SANDBOX_PATH "/sock2"));
+}
+
 TEST(empty_root_directories_abort_single_comparison)
 {
 	strcpy(lwin.curr_dir, SANDBOX_PATH);
@@ -713,5 +791,20 @@ basic_panes_check(int expected_len)
 	}
 }
 
+/* Creates socket file at the path. */
+static void
+make_socket(const char path[])
+{
+#ifndef _WIN32
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	assert_true(fd != -1);
+
+	strcpy(addr.sun_path, path);
+	assert_success(bind(fd, (struct sockaddr *)&addr, sizeof(addr)));
+	close(fd);
+#endif
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 : */
@@ -0,0 +1,215 @@
+#include <stic.h>
+
+#include <unistd.h> /* rmdir() */
+
+#include <stdio.h> /* FILE fclose() fopen() fputs() remove() snprintf() */
+#include <string.h> /* strcpy() */
+
+#include "../../src/compat/fs_limits.h"
+#include "../../src/compat/os.h"
+#include "../../src/ui/ui.h"
+#include "../../src/compare.h"
+
+#include "utils.h"
+
+static void basic_panes_check(int expected_len);
+static void write_file(const char path[], const char contents[]);
+static void make_lists(int count, int reverse);
+static void remove_lists(int count);
+
+SETUP()
+{
+	curr_view = &lwin;
+	other_view = &rwin;
+
+	view_setup(&lwin);
+	view_setup(&rwin);
+
+	opt_handlers_setup();
+
+	assert_success(os_mkdir(SANDBOX_PATH "/l", 0777));
+	assert_success(os_mkdir(SANDBOX_PATH "/r", 0777));
+
+	strcpy(lwin.curr_dir, SANDBOX_PATH "/l");
+	strcpy(rwin.curr_dir, SANDBOX_PATH "/r");
+}
+
+TEARDOWN()
+{
+	assert_success(rmdir(SANDBOX_PATH "/l"));
+	assert_success(rmdir(SANDBOX_PATH "/r"));
+
+	view_teardown(&lwin);
+	view_teardown(&rwin);
+
+	opt_handlers_teardown();
+}
+
+TEST(crossing_matches_are_resolved_by_consuming_left_list_first)
+{
+	write_file(SANDBOX_PATH "/l/a", "1");
+	write_file(SANDBOX_PATH "/l/b", "2");
+	write_file(SANDBOX_PATH "/r/c", "2");
+	write_file(SANDBOX_PATH "/r/d", "1");
+
+	compare_two_panes(CT_CONTENTS, LT_ALL, 1, 0);
+
+	basic_panes_check(3);
+
+	assert_string_equal("a", lwin.dir_entry[0].name);
+	assert_string_equal("", rwin.dir_entry[0].name);
+	assert_string_equal("b", lwin.dir_entry[1].name);
+	assert_string_equal("c", rwin.dir_entry[1].name);
+	assert_string_equal("", lwin.dir_entry[2].name);
+	assert_string_equal("d", rwin.dir_entry[2].name);
+
+	assert_success(remove(SANDBOX_PATH "/l/a"));
+	assert_success(remove(SANDBOX_PATH "/l/b"));
+	assert_success(remove(SANDBOX_PATH "/r/c"));
+	assert_success(remove(SANDBOX_PATH "/r/d"));
+}
+
+TEST(deletion_goes_before_insertion)
+{
+	write_file(SANDBOX_PATH "/l/a", "1");
+	write_file(SANDBOX_PATH "/l/c", "3");
+	write_file(SANDBOX_PATH "/r/b", "2");
+	write_file(SANDBOX_PATH "/r/d", "3");
+
+	compare_two_panes(CT_CONTENTS, LT_ALL, 1, 0);
+
+	basic_panes_check(3);
+
+	assert_string_equal("a", lwin.dir_entry[0].name);
+	assert_string_equal("", rwin.dir_entry[0].name);
+	assert_string_equal("", lwin.dir_entry[1].name);
+	assert_string_equal("b", rwin.dir_entry[1].name);
+	assert_string_equal("c", lwin.dir_entry[2].name);
+	assert_string_equal("d", rwin.dir_entry[2].name);
+
+	assert_success(remove(SANDBOX_PATH "/l/a"));
+	assert_success(remove(SANDBOX_PATH "/l/c"));
+	assert_success(remove(SANDBOX_PATH "/r/b"));
+	assert_success(remove(SANDBOX_PATH "/r/d"));
+}
+
+TEST(long_shifted_lists_are_aligned)
+{
+	int i;
+
+	/* Right file i has the same contents as left file i + 1. */
+	make_lists(70, 0);
+
+	compare_two_panes(CT_CONTENTS, LT_ALL, 1, 0);
+
+	basic_panes_check(71);
+
+	assert_string_equal("l00", lwin.dir_entry[0].name);
+	assert_string_equal("", rwin.dir_entry[0].name);
+	for(i = 1; i < 70; ++i)
+	{
+		char name[16];
+		snprintf(name, sizeof(name), "l%02d", i);
+		assert_string_equal(name, lwin.dir_entry[i].name);
+		snprintf(name, sizeof(name), "r%02d", i - 1);
+		assert_string_equal(name, rwin.dir_entry[i].name);
+	}
+	assert_string_equal("", lwin.dir_entry[70].name);
+	assert_string_equal("r69", rwin.dir_entry[70].name);
+
+	remove_lists(70);
+}
+
+TEST(long_reversed_lists_match_last_left_entry)
+{
+	int i;
+
+	/* Any single pair of files can be matched here. */
+	make_lists(70, 1);
+
+	compare_two_panes(CT_CONTENTS, LT_ALL, 1, 0);
+
+	basic_panes_check(139);
+
+	for(i = 0; i < 139; ++i)
+	{
+		char name[16];
+
+		snprintf(name, sizeof(name), "l%02d", i);
+		assert_string_equal(i < 70 ? name : "", lwin.dir_entry[i].name);
+
+		snprintf(name, sizeof(name), "r%02d", i - 69);
+		assert_string_equal(i >= 69 ? name : "", rwin.dir_entry[i].name);
+	}
+
+	remove_lists(70);
+}
+
+static void
+basic_panes_check(int expected_len)
+{
+	int i;
+
+	assert_int_equal(expected_len, lwin.list_rows);
+	assert_int_equal(expected_len, rwin.list_rows);
+
+	for(i = 0; i < expected_len; ++i)
+	{
+		assert_int_equal(lwin.dir_entry[i].id, rwin.dir_entry[i].id);
+	}
+}
+
+/* Creates file with specified contents. */
+static void
+write_file(const char path[], const char contents[])
+{
+	FILE *const f = fopen(path, "w");
+	assert_non_null(f);
+	if(f != NULL)
+	{
+		fputs(contents, f);
+		fclose(f);
+	}
+}
+
+/* Creates count files in each of l/ and r/ directories of sandbox.  Left file i
+ * has contents i, right file i has contents of left file count - 1 - i if
+ * reverse is set and of left file (i + 1)%count otherwise. */
+static void
+make_lists(int count, int reverse)
+{
+	int i;
+	for(i = 0; i < count; ++i)
+	{
+		char path[PATH_MAX];
+		char contents[16];
+		const int other = reverse ? count - 1 - i : (i + 1)%count;
+
+		snprintf(path, sizeof(path), "%s/l/l%02d", SANDBOX_PATH, i);
+		snprintf(contents, sizeof(contents), "%02d", i);
+		write_file(path, contents);
+
+		snprintf(path, sizeof(path), "%s/r/r%02d", SANDBOX_PATH, i);
+		snprintf(contents, sizeof(contents), "%02d", other);
+		write_file(path, contents);
+	}
+}
+
+/* Removes files created by make_lists(). */
+static void
+remove_lists(int count)
+{
+	int i;
+	for(i = 0; i < count; ++i)
+	{
+		char path[PATH_MAX];
+
+		snprintf(path, sizeof(path), "%s/l/l%02d", SANDBOX_PATH, i);
+		assert_success(remove(path));
+		snprintf(path, sizeof(path), "%s/r/r%02d", SANDBOX_PATH, i);
+		assert_success(remove(path));
+	}
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 : */
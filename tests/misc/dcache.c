@@ -1,16 +1,24 @@
 #include <stic.h>
 
+#include <sys/stat.h> /* stat */
+#include <unistd.h> /* rmdir() */
+#include <utime.h> /* utimbuf utime() */
+
 #include <stddef.h> /* NULL */
+#include <stdio.h> /* remove() */
 #include <string.h> /* memset() strcpy() */
 #include <time.h> /* time() */
 
 #include "../../src/cfg/config.h"
+#include "../../src/compat/os.h"
 #include "../../src/ui/ui.h"
 #include "../../src/utils/str.h"
 #include "../../src/status.h"
 
 #include "utils.h"
 
+static void set_old_mtime(const char path[]);
+
 SETUP()
 {
 	update_string(&cfg.shell, "");
@@ -64,5 +72,194 @@ TEST(outdated_data_is_not_returned)
 	assert_ulong_equal((unsigned long)DCACHE_UNKNOWN, nitems);
 }
 
+TEST(outdated_size_invalidates_sizes_of_parents)
+{
+	uint64_t size;
+	dir_entry_t entry = { .name = "dir", .origin = SANDBOX_PATH };
+
+	assert_success(os_mkdir(SANDBOX_PATH "/dir", 0700));
+
+	assert_success(dcache_set_at(SANDBOX_PATH, 20, DCACHE_UNKNOWN));
+	assert_success(dcache_set_at(SANDBOX_PATH "/dir", 10, DCACHE_UNKNOWN));
+
+	entry.mtime = time(NULL) + 1;
+	dcache_get_of(&entry, &size, NULL);
+	assert_ulong_equal((unsigned long)DCACHE_UNKNOWN, size);
+
+	dcache_get_at(SANDBOX_PATH, &size, NULL);
+	assert_ulong_equal((unsigned long)DCACHE_UNKNOWN, size);
+
+	assert_success(rmdir(SANDBOX_PATH "/dir"));
+}
+
+TEST(sizes_survive_save_and_load)
+{
+	uint64_t size;
+
+	assert_success(os_mkdir(SANDBOX_PATH "/dir", 0700));
+	set_old_mtime(SANDBOX_PATH "/dir");
+
+	assert_success(dcache_set_at(SANDBOX_PATH "/dir", 10, 11));
+	assert_success(dcache_save(SANDBOX_PATH "/dirsizes", SANDBOX_PATH "/absent"));
+
+	assert_success(init_status(&cfg));
+	dcache_get_at(SANDBOX_PATH "/dir", &size, NULL);
+	assert_ulong_equal((unsigned long)DCACHE_UNKNOWN, size);
+
+	assert_success(dcache_load(SANDBOX_PATH "/dirsizes"));
+	dcache_get_at(SANDBOX_PATH "/dir", &size, NULL);
+	assert_ulong_equal(10, size);
+
+	assert_success(remove(SANDBOX_PATH "/dirsizes"));
+	assert_success(rmdir(SANDBOX_PATH "/dir"));
+}
+
+TEST(sizes_of_changed_directories_are_not_loaded)
+{
+	uint64_t size;
+	struct utimbuf times = { .actime = 100, .modtime = 100 };
+
+	assert_success(os_mkdir(SANDBOX_PATH "/dir", 0700));
+	set_old_mtime(SANDBOX_PATH "/dir");
+
+	assert_success(dcache_set_at(SANDBOX_PATH "/dir", 10, 11));
+	assert_success(dcache_save(SANDBOX_PATH "/dirsizes", SANDBOX_PATH "/absent"));
+
+	assert_success(utime(SANDBOX_PATH "/dir", &times));
+
+	assert_success(init_status(&cfg));
+	assert_success(dcache_load(SANDBOX_PATH "/dirsizes"));
+	dcache_get_at(SANDBOX_PATH "/dir", &size, NULL);
+	assert_ulong_equal((unsigned long)DCACHE_UNKNOWN, size);
+
+	assert_success(remove(SANDBOX_PATH "/dirsizes"));
+	assert_success(rmdir(SANDBOX_PATH "/dir"));
+}
+
+TEST(sizes_of_removed_directories_are_not_loaded)
+{
+	uint64_t size;
+
+	assert_success(os_mkdir(SANDBOX_PATH "/dir", 0700));
+	set_old_mtime(SANDBOX_PATH "/dir");
+
+	assert_success(dcache_set_at(SANDBOX_PATH "/dir", 10, 11));
+	assert_success(dcache_save(SANDBOX_PATH "/dirsizes", SANDBOX_PATH "/absent"));
+
+	assert_success(rmdir(SANDBOX_PATH "/dir"));
+
+	assert_success(init_status(&cfg));
+	assert_success(dcache_load(SANDBOX_PATH "/dirsizes"));
+	dcache_get_at(SANDBOX_PATH "/dir", &size, NULL);
+	assert_ulong_equal((unsigned long)DCACHE_UNKNOWN, size);
+
+	assert_success(remove(SANDBOX_PATH "/dirsizes"));
+}
+
+TEST(outdated_sizes_are_not_saved)
+{
+	uint64_t size;
+	struct utimbuf times = { .actime = 100, .modtime = time(NULL) + 100 };
+
+	assert_success(os_mkdir(SANDBOX_PATH "/dir", 0700));
+
+	assert_success(dcache_set_at(SANDBOX_PATH "/dir", 10, 11));
+	assert_success(utime(SANDBOX_PATH "/dir", &times));
+	assert_success(dcache_save(SANDBOX_PATH "/dirsizes", SANDBOX_PATH "/absent"));
+
+	assert_success(init_status(&cfg));
+	assert_success(dcache_load(SANDBOX_PATH "/dirsizes"));
+	dcache_get_at(SANDBOX_PATH "/dir", &size, NULL);
+	assert_ulong_equal((unsigned long)DCACHE_UNKNOWN, size);
+
+	assert_success(remove(SANDBOX_PATH "/dirsizes"));
+	assert_success(rmdir(SANDBOX_PATH "/dir"));
+}
+
+TEST(sizes_saved_by_other_instances_are_kept)
+{
+	uint64_t size;
+
+	assert_success(os_mkdir(SANDBOX_PATH "/dir1", 0700));
+	assert_success(os_mkdir(SANDBOX_PATH "/dir2", 0700));
+	set_old_mtime(SANDBOX_PATH "/dir1");
+	set_old_mtime(SANDBOX_PATH "/dir2");
+
+	assert_success(dcache_set_at(SANDBOX_PATH "/dir1", 10, 11));
+	assert_success(dcache_save(SANDBOX_PATH "/dirsizes1",
+				SANDBOX_PATH "/absent"));
+
+	assert_success(init_status(&cfg));
+	assert_success(dcache_set_at(SANDBOX_PATH "/dir2", 20, 21));
+	assert_success(dcache_save(SANDBOX_PATH "/dirsizes2",
+				SANDBOX_PATH "/dirsizes1"));
+
+	assert_success(init_status(&cfg));
+	assert_success(dcache_load(SANDBOX_PATH "/dirsizes2"));
+	dcache_get_at(SANDBOX_PATH "/dir1", &size, NULL);
+	assert_ulong_equal(10, size);
+	dcache_get_at(SANDBOX_PATH "/dir2", &size, NULL);
+	assert_ulong_equal(20, size);
+
+	assert_success(remove(SANDBOX_PATH "/dirsizes1"));
+	assert_success(remove(SANDBOX_PATH "/dirsizes2"));
+	assert_success(rmdir(SANDBOX_PATH "/dir1"));
+	assert_success(rmdir(SANDBOX_PATH "/dir2"));
+}
+
+TEST(newer_sizes_win_on_save)
+{
+	uint64_t size;
+
+	assert_success(os_mkdir(SANDBOX_PATH "/dir", 0700));
+	set_old_mtime(SANDBOX_PATH "/dir");
+
+	assert_success(dcache_set_at(SANDBOX_PATH "/dir", 10, 11));
+	assert_success(dcache_save(SANDBOX_PATH "/dirsizes1",
+				SANDBOX_PATH "/absent"));
+	assert_success(dcache_set_at(SANDBOX_PATH "/dir", 20, 21));
+	assert_success(dcache_save(SANDBOX_PATH "/dirsizes2",
+				SANDBOX_PATH "/dirsizes1"));
+
+	assert_success(init_status(&cfg));
+	assert_success(dcache_load(SANDBOX_PATH "/dirsizes2"));
+	dcache_get_at(SANDBOX_PATH "/dir", &size, NULL);
+	assert_ulong_equal(20, size);
+
+	assert_success(remove(SANDBOX_PATH "/dirsizes1"));
+	assert_success(remove(SANDBOX_PATH "/dirsizes2"));
+	assert_success(rmdir(SANDBOX_PATH "/dir"));
+}
+
+TEST(loaded_sizes_are_checked_on_use)
+{
+	uint64_t size;
+	struct utimbuf times = { .actime = 100, .modtime = 100 };
+
+	assert_success(os_mkdir(SANDBOX_PATH "/dir", 0700));
+	set_old_mtime(SANDBOX_PATH "/dir");
+
+	assert_success(dcache_set_at(SANDBOX_PATH "/dir", 10, 11));
+	assert_success(dcache_save(SANDBOX_PATH "/dirsizes", SANDBOX_PATH "/absent"));
+
+	assert_success(init_status(&cfg));
+	assert_success(dcache_load(SANDBOX_PATH "/dirsizes"));
+	assert_success(utime(SANDBOX_PATH "/dir", &times));
+	dcache_get_at(SANDBOX_PATH "/dir", &size, NULL);
+	assert_ulong_equal((unsigned long)DCACHE_UNKNOWN, size);
+
+	assert_success(remove(SANDBOX_PATH "/dirsizes"));
+	assert_success(rmdir(SANDBOX_PATH "/dir"));
+}
+
+/* Moves modification time of the directory to the past so that cached data is
+ * newer. */
+static void
+set_old_mtime(const char path[])
+{
+	struct utimbuf times = { .actime = 1000, .modtime = 1000 };
+	assert_success(utime(path, &times));
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
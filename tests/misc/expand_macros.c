@@ -452,5 +452,19 @@ TEST(singly_not_expanded_multiple_files_register)
 	regs_reset();
 }
 
+TEST(entry_replaces_current_file_and_selection)
+{
+	char *expanded;
+
+	expanded = ma_expand_for_entry("%c %f %F", &lwin.dir_entry[1]);
+	assert_string_equal(
+			"lfile1 lfile1 " SL "rwin" SL "rfile1 " SL "rwin" SL "rfile3 " SL "rwin"
+			SL "rfile5", expanded);
+	free(expanded);
+
+	assert_int_equal(2, lwin.list_pos);
+	assert_int_equal(2, lwin.selected_files);
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
@@ -1,8 +1,10 @@
 #include <stic.h>
 
-#include <unistd.h> /* symlink() unlink() */
+#include <unistd.h> /* symlink() unlink() usleep() */
 
-#include <stdio.h> /* fopen() fclose() */
+#include <stdio.h> /* FILE fclose() fopen() fputs() */
+#include <stdlib.h> /* free() */
+#include <string.h> /* strcmp() strdup() */
 
 #include "../../src/compat/os.h"
 #include "../../src/int/file_magic.h"
@@ -12,6 +14,8 @@
 #include "utils.h"
 
 static void check_empty_file(const char fname[]);
+static void write_file(const char path[], const char contents[]);
+static int not_windows_and_has_mime_type_detection(void);
 static int has_mime_type_detection_and_symlinks(void);
 static int has_mime_type_detection(void);
 
@@ -55,6 +59,60 @@ TEST(relatively_large_file_name_does_not_crash,
 	assert_success(rmdir(SANDBOX_PATH "/A"));
 }
 
+TEST(mime_type_is_cached, IF(not_windows_and_has_mime_type_detection))
+{
+	const char *const path = SANDBOX_PATH "/file";
+
+	/* Contents differ between tests so that reused inode doesn't look like the
+	 * same file. */
+	write_file(path, "first");
+	assert_false(mimetype_is_known(path));
+	assert_non_null(get_mimetype(path));
+	assert_true(mimetype_is_known(path));
+
+	assert_success(unlink(path));
+}
+
+TEST(changed_file_is_classified_again,
+		IF(not_windows_and_has_mime_type_detection))
+{
+	const char *const path = SANDBOX_PATH "/file";
+	const char *type;
+	char *empty_type;
+
+	create_file(path);
+	assert_non_null(type = get_mimetype(path));
+	empty_type = strdup(type);
+
+	write_file(path, "#!/bin/sh\necho text\n");
+	assert_false(mimetype_is_known(path));
+	assert_non_null(type = get_mimetype(path));
+	assert_true(strcmp(empty_type, type) != 0);
+
+	free(empty_type);
+	assert_success(unlink(path));
+}
+
+TEST(requested_files_are_classified_in_background,
+		IF(not_windows_and_has_mime_type_detection))
+{
+	const char *const path = SANDBOX_PATH "/file";
+	int i;
+
+	write_file(path, "third file");
+	assert_false(mimetype_is_known(path));
+
+	mimetype_request(path);
+	for(i = 0; i < 1000 && !mimetype_is_known(path); ++i)
+	{
+		usleep(5000);
+	}
+	assert_true(mimetype_is_known(path));
+	assert_non_null(get_mimetype(path));
+
+	assert_success(unlink(path));
+}
+
 static void
 check_empty_file(const char fname[])
 {
@@ -67,6 +125,24 @@ check_empty_file(const char fname[])
 	}
 }
 
+static void
+write_file(const char path[], const char contents[])
+{
+	FILE *const f = fopen(path, "w");
+	assert_non_null(f);
+	if(f != NULL)
+	{
+		fputs(contents, f);
+		fclose(f);
+	}
+}
+
+static int
+not_windows_and_has_mime_type_detection(void)
+{
+	return not_windows() && has_mime_type_detection();
+}
+
 static int
 has_mime_type_detection_and_symlinks(void)
 {
@@ -110,5 +110,51 @@ TEST(negation)
 			matchers_get_expr(cfg.cs.file_hi[0].matchers));
 }
 
+TEST(results_are_shared_between_entries)
+{
+	int hint1 = -1, hint2 = -1, hint3 = -1;
+
+	assert_success(exec_commands("highlight {*.c} ctermfg=red", &lwin,
+				CIT_COMMAND));
+	assert_success(exec_commands("highlight {*.h} ctermfg=blue", &lwin,
+				CIT_COMMAND));
+	assert_non_null(cfg.cs.file_hi_cache);
+
+	assert_true(cs_get_file_hi(&cfg.cs, "a.h", &hint1) == &cfg.cs.file_hi[1].hi);
+	assert_int_equal(1, hint1);
+	assert_true(cs_get_file_hi(&cfg.cs, "a.h", &hint2) == &cfg.cs.file_hi[1].hi);
+	assert_int_equal(1, hint2);
+
+	assert_null(cs_get_file_hi(&cfg.cs, "a.txt", &hint3));
+	assert_null(cs_get_file_hi(&cfg.cs, "a.txt", &hint3));
+	assert_int_equal(-1, hint3);
+}
+
+TEST(new_highlight_invalidates_results)
+{
+	int hint = -1;
+
+	assert_success(exec_commands("highlight {*.c} ctermfg=red", &lwin,
+				CIT_COMMAND));
+	assert_null(cs_get_file_hi(&cfg.cs, "a.txt", &hint));
+
+	assert_success(exec_commands("highlight {*.txt} ctermfg=red", &lwin,
+				CIT_COMMAND));
+	assert_true(cs_get_file_hi(&cfg.cs, "a.txt", &hint) == &cfg.cs.file_hi[1].hi);
+	assert_int_equal(1, hint);
+}
+
+TEST(results_are_not_cached_for_mime_types)
+{
+	assert_success(exec_commands("highlight {*.c} ctermfg=red", &lwin,
+				CIT_COMMAND));
+	assert_false(cs_file_hi_needs_contents(&cfg.cs));
+
+	assert_success(exec_commands("highlight <text/plain> ctermfg=red", &lwin,
+				CIT_COMMAND));
+	assert_true(cs_file_hi_needs_contents(&cfg.cs));
+	assert_null(cfg.cs.file_hi_cache);
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
@@ -0,0 +1,159 @@
+#include <stic.h>
+
+#include <sys/stat.h> /* S_ISDIR() */
+#include <unistd.h> /* chdir() rmdir() symlink() unlink() */
+
+#include <stdio.h> /* fclose() fopen() snprintf() */
+#include <stdlib.h> /* free() */
+#include <string.h> /* memset() strcmp() */
+
+#include "../../src/cfg/config.h"
+#include "../../src/compat/fs_limits.h"
+#include "../../src/compat/os.h"
+#include "../../src/ui/ui.h"
+#include "../../src/utils/dynarray.h"
+#include "../../src/utils/fs.h"
+#include "../../src/utils/str.h"
+#include "../../src/filelist.h"
+
+#include "utils.h"
+
+/* Number of files that is big enough to load them in parallel. */
+#define NFILES 1500
+
+static void make_name(char buf[], size_t buf_len, int i);
+
+static FileView *const view = &lwin;
+
+SETUP()
+{
+	char cwd[PATH_MAX];
+	int i;
+
+	assert_success(chdir(SANDBOX_PATH));
+
+	update_string(&cfg.slow_fs_list, "");
+
+	assert_true(get_cwd(cwd, sizeof(cwd)) == cwd);
+	copy_str(view->curr_dir, sizeof(view->curr_dir), cwd);
+
+	for(i = 0; i < NFILES; ++i)
+	{
+		char name[NAME_MAX];
+		make_name(name, sizeof(name), i);
+
+		if(i%2 == 0)
+		{
+			assert_success(os_mkdir(name, 0700));
+		}
+		else
+		{
+			FILE *const f = fopen(name, "w");
+			assert_non_null(f);
+			if(f != NULL)
+			{
+				fclose(f);
+			}
+		}
+	}
+
+#ifndef _WIN32
+	assert_success(symlink("0000", "link"));
+#endif
+
+	filter_init(&view->local_filter.filter, 1);
+	filter_init(&view->manual_filter, 1);
+	filter_init(&view->auto_filter, 1);
+	view->sort[0] = SK_BY_NAME;
+	memset(&view->sort[1], SK_NONE, sizeof(view->sort) - 1);
+	view->dir_entry = NULL;
+	view->list_rows = 0;
+}
+
+TEARDOWN()
+{
+	int i;
+
+	for(i = 0; i < view->list_rows; ++i)
+	{
+		free(view->dir_entry[i].name);
+	}
+	dynarray_free(view->dir_entry);
+
+	filter_dispose(&view->auto_filter);
+	filter_dispose(&view->manual_filter);
+	filter_dispose(&view->local_filter.filter);
+
+	for(i = 0; i < NFILES; ++i)
+	{
+		char name[NAME_MAX];
+		make_name(name, sizeof(name), i);
+		assert_success((i%2 == 0) ? rmdir(name) : unlink(name));
+	}
+
+#ifndef _WIN32
+	assert_success(unlink("link"));
+#endif
+
+	update_string(&cfg.slow_fs_list, NULL);
+}
+
+TEST(metadata_of_all_files_of_big_directory_is_loaded)
+{
+	int i;
+	int nfiles = 0;
+
+	populate_dir_list(view, 0);
+
+	for(i = 0; i < view->list_rows; ++i)
+	{
+		const dir_entry_t *const entry = &view->dir_entry[i];
+		int n;
+
+		if(strcmp(entry->name, "..") == 0 || strcmp(entry->name, "link") == 0)
+		{
+			continue;
+		}
+
+		assert_int_equal(1, sscanf(entry->name, "%d", &n));
+		assert_int_equal((n%2 == 0) ? FT_DIR : FT_REG, entry->type);
+		++nfiles;
+	}
+
+	assert_int_equal(NFILES, nfiles);
+}
+
+TEST(mode_of_symlink_target_is_loaded, IF(not_windows))
+{
+	int i;
+	const dir_entry_t *link = NULL;
+
+	populate_dir_list(view, 0);
+
+	for(i = 0; i < view->list_rows; ++i)
+	{
+		if(strcmp(view->dir_entry[i].name, "link") == 0)
+		{
+			link = &view->dir_entry[i];
+		}
+	}
+
+	assert_non_null(link);
+	if(link != NULL)
+	{
+		assert_int_equal(FT_LINK, link->type);
+#ifndef _WIN32
+		assert_true(S_ISDIR(link->mode));
+#endif
+	}
+}
+
+/* Formats name of i-th file. */
+static void
+make_name(char buf[], size_t buf_len, int i)
+{
+	snprintf(buf, buf_len, "%04d", i);
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
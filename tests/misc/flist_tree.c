@@ -3,6 +3,7 @@
 #include <unistd.h> /* rmdir() symlink() */
 
 #include <stddef.h> /* NULL */
+#include <stdio.h> /* FILE fclose() fopen() fputs() */
 #include <stdlib.h> /* remove() */
 #include <string.h> /* memset() */
 
@@ -29,6 +30,7 @@ static void column_line_print(const void *data, int column_id, const char buf[],
 static int remove_selected(FileView *view, const dir_entry_t *entry, void *arg);
 static void validate_tree(const FileView *view);
 static void validate_parents(const dir_entry_t *entries, int nchildren);
+static int using_inotify(void);
 
 SETUP()
 {
@@ -331,6 +333,33 @@ TEST(nested_directory_change_detection)
 	update_string(&cfg.ruler_format, NULL);
 }
 
+TEST(changes_of_nested_files_are_detected_without_polling, IF(using_inotify))
+{
+	FILE *f;
+
+	assert_success(os_mkdir(SANDBOX_PATH "/nested-dir", 0700));
+	create_file(SANDBOX_PATH "/nested-dir/a");
+
+	assert_success(flist_load_tree(&lwin, SANDBOX_PATH));
+	assert_true(lwin.watching_tree);
+	(void)ui_view_query_scheduled_event(&lwin);
+
+	check_if_filelist_have_changed(&lwin);
+	assert_int_equal(UUE_NONE, ui_view_query_scheduled_event(&lwin));
+
+	/* Changing file contents doesn't update modification time of directory. */
+	f = fopen(SANDBOX_PATH "/nested-dir/a", "w");
+	assert_non_null(f);
+	fputs("contents", f);
+	fclose(f);
+
+	check_if_filelist_have_changed(&lwin);
+	assert_int_equal(UUE_RELOAD, ui_view_query_scheduled_event(&lwin));
+
+	assert_success(remove(SANDBOX_PATH "/nested-dir/a"));
+	assert_success(rmdir(SANDBOX_PATH "/nested-dir"));
+}
+
 TEST(excluding_dir_in_tree_excludes_its_children)
 {
 	assert_success(os_mkdir(SANDBOX_PATH "/nested-dir", 0700));
@@ -675,16 +704,16 @@ TEST(tree_prefixes_are_correct)
 	assert_int_equal(10, lwin.list_rows);
 	validate_tree(&lwin);
 
-	verify_tree_node(&cdt, 0, "dir1");
-	verify_tree_node(&cdt, 1, "|-- dir2");
-	verify_tree_node(&cdt, 2, "|   |-- dir3");
-	verify_tree_node(&cdt, 3, "|   |   |-- file1");
-	verify_tree_node(&cdt, 4, "|   |   `-- file2");
-	verify_tree_node(&cdt, 5, "|   `-- dir4");
-	verify_tree_node(&cdt, 6, "|       `-- file3");
-	verify_tree_node(&cdt, 7, "`-- file4");
-	verify_tree_node(&cdt, 8, "dir5");
-	verify_tree_node(&cdt, 9, "`-- file5");
+	verify_tree_node(&cdt, 0, "  dir1");
+	verify_tree_node(&cdt, 1, "  |-- dir2");
+	verify_tree_node(&cdt, 2, "  |   |-- dir3");
+	verify_tree_node(&cdt, 3, "  |   |   |-- file1");
+	verify_tree_node(&cdt, 4, "  |   |   `-- file2");
+	verify_tree_node(&cdt, 5, "  |   `-- dir4");
+	verify_tree_node(&cdt, 6, "  |       `-- file3");
+	verify_tree_node(&cdt, 7, "  `-- file4");
+	verify_tree_node(&cdt, 8, "  dir5");
+	verify_tree_node(&cdt, 9, "  `-- file5");
 }
 
 TEST(dotdirs_do_not_mess_up_change_detection)
@@ -823,5 +852,15 @@ validate_parents(const dir_entry_t *entries, int nchildren)
 	}
 }
 
+static int
+using_inotify(void)
+{
+#ifdef HAVE_INOTIFY
+	return 1;
+#else
+	return 0;
+#endif
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
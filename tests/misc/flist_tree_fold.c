@@ -0,0 +1,239 @@
+#include <stic.h>
+
+#include <unistd.h> /* rmdir() */
+
+#include <stdio.h> /* remove() */
+#include <string.h> /* memset() */
+
+#include "../../src/cfg/config.h"
+#include "../../src/compat/fs_limits.h"
+#include "../../src/compat/os.h"
+#include "../../src/ui/column_view.h"
+#include "../../src/ui/fileview.h"
+#include "../../src/ui/ui.h"
+#include "../../src/utils/str.h"
+#include "../../src/filelist.h"
+#include "../../src/filtering.h"
+
+#include "utils.h"
+
+static void verify_tree_node(column_data_t *cdt, int idx, const char
+		expected[]);
+static void validate_tree(const FileView *view);
+static void column_line_print(const void *data, int column_id, const char buf[],
+		size_t offset, AlignType align, const char full_column[]);
+
+SETUP()
+{
+	update_string(&cfg.fuse_home, "no");
+	update_string(&cfg.slow_fs_list, "");
+
+	view_setup(&lwin);
+
+	curr_view = &lwin;
+	other_view = &lwin;
+
+	columns_set_line_print_func(&column_line_print);
+	lwin.columns = columns_create();
+
+	assert_success(os_mkdir(SANDBOX_PATH "/a", 0700));
+	assert_success(os_mkdir(SANDBOX_PATH "/a/sub", 0700));
+	assert_success(os_mkdir(SANDBOX_PATH "/b", 0700));
+	create_file(SANDBOX_PATH "/a/sub/f");
+	create_file(SANDBOX_PATH "/a/file");
+	create_file(SANDBOX_PATH "/file");
+}
+
+TEARDOWN()
+{
+	assert_success(remove(SANDBOX_PATH "/file"));
+	assert_success(remove(SANDBOX_PATH "/a/file"));
+	assert_success(remove(SANDBOX_PATH "/a/sub/f"));
+	assert_success(rmdir(SANDBOX_PATH "/b"));
+	assert_success(rmdir(SANDBOX_PATH "/a/sub"));
+	assert_success(rmdir(SANDBOX_PATH "/a"));
+
+	update_string(&cfg.slow_fs_list, NULL);
+	update_string(&cfg.fuse_home, NULL);
+
+	view_teardown(&lwin);
+
+	columns_set_line_print_func(NULL);
+	columns_free(lwin.columns);
+	lwin.columns = NULL;
+}
+
+TEST(only_requested_number_of_levels_is_listed)
+{
+	assert_success(flist_load_tree_lazily(&lwin, SANDBOX_PATH, 1));
+
+	assert_int_equal(3, lwin.list_rows);
+	assert_string_equal("a", lwin.dir_entry[0].name);
+	assert_true(lwin.dir_entry[0].folded);
+	assert_int_equal(0, lwin.dir_entry[0].child_count);
+	assert_string_equal("b", lwin.dir_entry[1].name);
+	assert_true(lwin.dir_entry[1].folded);
+	assert_string_equal("file", lwin.dir_entry[2].name);
+	assert_false(lwin.dir_entry[2].folded);
+	validate_tree(&lwin);
+}
+
+TEST(unfolding_inserts_directory_into_the_tree)
+{
+	assert_success(flist_load_tree_lazily(&lwin, SANDBOX_PATH, 1));
+	lwin.list_pos = 2;
+
+	assert_success(flist_toggle_fold(&lwin, 0));
+	assert_int_equal(5, lwin.list_rows);
+	assert_false(lwin.dir_entry[0].folded);
+	assert_int_equal(2, lwin.dir_entry[0].child_count);
+	assert_string_equal("sub", lwin.dir_entry[1].name);
+	assert_true(lwin.dir_entry[1].folded);
+	assert_string_equal("file", lwin.dir_entry[2].name);
+	assert_int_equal(2, lwin.dir_entry[2].child_pos);
+	assert_string_equal("b", lwin.dir_entry[3].name);
+	assert_int_equal(0, lwin.dir_entry[3].child_pos);
+	assert_int_equal(4, lwin.list_pos);
+	validate_tree(&lwin);
+
+	assert_success(flist_toggle_fold(&lwin, 1));
+	assert_int_equal(6, lwin.list_rows);
+	assert_int_equal(3, lwin.dir_entry[0].child_count);
+	assert_int_equal(1, lwin.dir_entry[1].child_count);
+	assert_string_equal("f", lwin.dir_entry[2].name);
+	assert_int_equal(3, lwin.dir_entry[3].child_pos);
+	validate_tree(&lwin);
+}
+
+TEST(unfolding_empty_directory_adds_leaf)
+{
+	assert_success(flist_load_tree_lazily(&lwin, SANDBOX_PATH, 1));
+
+	assert_success(flist_toggle_fold(&lwin, 1));
+	assert_int_equal(4, lwin.list_rows);
+	assert_int_equal(1, lwin.dir_entry[1].child_count);
+	assert_string_equal("..", lwin.dir_entry[2].name);
+	validate_tree(&lwin);
+}
+
+TEST(folding_removes_subtree)
+{
+	assert_success(flist_load_tree(&lwin, SANDBOX_PATH));
+	assert_int_equal(7, lwin.list_rows);
+	lwin.list_pos = 2;
+
+	assert_success(flist_toggle_fold(&lwin, 0));
+	assert_int_equal(4, lwin.list_rows);
+	assert_true(lwin.dir_entry[0].folded);
+	assert_int_equal(0, lwin.dir_entry[0].child_count);
+	assert_string_equal("b", lwin.dir_entry[1].name);
+	assert_int_equal(0, lwin.list_pos);
+	validate_tree(&lwin);
+
+	assert_success(flist_toggle_fold(&lwin, 0));
+	assert_int_equal(7, lwin.list_rows);
+	assert_false(lwin.dir_entry[0].folded);
+	validate_tree(&lwin);
+}
+
+TEST(fold_state_is_kept_on_reload)
+{
+	assert_success(flist_load_tree_lazily(&lwin, SANDBOX_PATH, 1));
+	assert_success(flist_toggle_fold(&lwin, 0));
+	assert_int_equal(5, lwin.list_rows);
+
+	load_dir_list(&lwin, 1);
+	assert_int_equal(5, lwin.list_rows);
+	assert_false(lwin.dir_entry[0].folded);
+	assert_true(lwin.dir_entry[1].folded);
+	validate_tree(&lwin);
+}
+
+TEST(only_tree_directories_can_be_folded)
+{
+	assert_success(flist_load_tree(&lwin, SANDBOX_PATH));
+	assert_failure(flist_toggle_fold(&lwin, 5));
+	assert_failure(flist_toggle_fold(&lwin, 6));
+	assert_int_equal(7, lwin.list_rows);
+}
+
+TEST(folded_directories_are_not_traversed_for_local_filter)
+{
+	(void)filter_set(&lwin.local_filter.filter, "f");
+	assert_success(flist_load_tree_lazily(&lwin, SANDBOX_PATH, 1));
+
+	assert_int_equal(1, lwin.list_rows);
+	assert_string_equal("file", lwin.dir_entry[0].name);
+}
+
+TEST(fold_state_is_dropped_on_leaving_tree)
+{
+	assert_success(flist_load_tree_lazily(&lwin, SANDBOX_PATH, 1));
+	assert_success(flist_toggle_fold(&lwin, 0));
+	assert_non_null(lwin.custom.folded_paths);
+
+	assert_true(change_directory(&lwin, SANDBOX_PATH) >= 0);
+	assert_null(lwin.custom.folded_paths);
+	assert_int_equal(0, lwin.custom.tree_depth);
+}
+
+TEST(folded_directories_are_marked_in_tree_prefix)
+{
+	size_t prefix_len = 0U;
+	column_data_t cdt = { .view = &lwin, .prefix_len = &prefix_len };
+
+	memset(&cfg.type_decs, '\0', sizeof(cfg.type_decs));
+
+	assert_success(flist_load_tree_lazily(&lwin, SANDBOX_PATH, 1));
+	verify_tree_node(&cdt, 0, "+ a");
+	verify_tree_node(&cdt, 1, "+ b");
+	verify_tree_node(&cdt, 2, "  file");
+
+	assert_success(flist_toggle_fold(&lwin, 0));
+	verify_tree_node(&cdt, 0, "  a");
+	verify_tree_node(&cdt, 1, "  |-+ sub");
+	verify_tree_node(&cdt, 2, "  `-- file");
+	verify_tree_node(&cdt, 3, "+ b");
+}
+
+static void
+verify_tree_node(column_data_t *cdt, int idx, const char expected[])
+{
+	char name[NAME_MAX];
+	cdt->line_pos = idx;
+	format_name(-1, cdt, sizeof(name), name);
+	assert_string_equal(expected, name);
+}
+
+/* Checks that child counts and parent links of tree nodes are consistent. */
+static void
+validate_tree(const FileView *view)
+{
+	int i;
+	for(i = 0; i < view->list_rows; ++i)
+	{
+		const dir_entry_t *const entry = &view->dir_entry[i];
+		const int parent = i - entry->child_pos;
+
+		assert_true(i + entry->child_count < view->list_rows);
+		if(entry->child_pos != 0)
+		{
+			assert_true(parent >= 0);
+			assert_true(i <= parent + view->dir_entry[parent].child_count);
+		}
+		if(entry->folded)
+		{
+			assert_int_equal(0, entry->child_count);
+		}
+	}
+}
+
+static void
+column_line_print(const void *data, int column_id, const char buf[],
+		size_t offset, AlignType align, const char full_column[])
+{
+	/* Do nothing. */
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
@@ -0,0 +1,176 @@
+#include <stic.h>
+
+#include <unistd.h> /* rmdir() */
+
+#include <stdio.h> /* remove() snprintf() */
+#include <string.h> /* strcmp() */
+
+#include "../../src/cfg/config.h"
+#include "../../src/compat/fs_limits.h"
+#include "../../src/compat/os.h"
+#include "../../src/ui/column_view.h"
+#include "../../src/ui/ui.h"
+#include "../../src/utils/str.h"
+#include "../../src/filelist.h"
+#include "../../src/filtering.h"
+
+#include "utils.h"
+
+/* Number of directories that is big enough to list them in parallel. */
+#define NDIRS 50
+
+static void make_tree(void);
+static void remove_tree(void);
+static const dir_entry_t * get_parent(const dir_entry_t *entry);
+static void column_line_print(const void *data, int column_id, const char buf[],
+		size_t offset, AlignType align, const char full_column[]);
+
+SETUP()
+{
+	update_string(&cfg.fuse_home, "no");
+	update_string(&cfg.slow_fs_list, "");
+
+	view_setup(&lwin);
+
+	curr_view = &lwin;
+	other_view = &lwin;
+
+	columns_set_line_print_func(&column_line_print);
+	lwin.columns = columns_create();
+
+	make_tree();
+}
+
+TEARDOWN()
+{
+	remove_tree();
+
+	update_string(&cfg.slow_fs_list, NULL);
+	update_string(&cfg.fuse_home, NULL);
+
+	view_teardown(&lwin);
+
+	columns_set_line_print_func(NULL);
+	columns_free(lwin.columns);
+	lwin.columns = NULL;
+}
+
+TEST(wide_tree_is_built_correctly)
+{
+	int i;
+	int nfiles = 0;
+
+	assert_success(flist_load_tree(&lwin, SANDBOX_PATH));
+
+	/* Each directory contributes itself, two subdirectories, a file and a leaf
+	 * of empty directory. */
+	assert_int_equal(NDIRS*5, lwin.list_rows);
+
+	for(i = 0; i < lwin.list_rows; ++i)
+	{
+		const dir_entry_t *const entry = &lwin.dir_entry[i];
+		const dir_entry_t *const parent = get_parent(entry);
+
+		assert_true(i + entry->child_count < lwin.list_rows);
+
+		if(strcmp(entry->name, "f") == 0)
+		{
+			assert_non_null(parent);
+			assert_string_equal("sub", parent->name);
+			assert_int_equal(FT_REG, entry->type);
+			++nfiles;
+		}
+		else if(strcmp(entry->name, "sub") == 0)
+		{
+			assert_int_equal(1, entry->child_count);
+			assert_non_null(parent);
+		}
+		else if(strcmp(entry->name, "..") == 0)
+		{
+			assert_non_null(parent);
+			assert_string_equal("empty", parent->name);
+		}
+		else if(entry->name[0] == 'd')
+		{
+			assert_int_equal(4, entry->child_count);
+			assert_null(parent);
+		}
+	}
+
+	assert_int_equal(NDIRS, nfiles);
+}
+
+TEST(files_of_hidden_directories_are_attached_to_visible_parent)
+{
+	int i;
+
+	(void)filter_set(&lwin.local_filter.filter, "f");
+	assert_success(flist_load_tree(&lwin, SANDBOX_PATH));
+
+	assert_int_equal(NDIRS, lwin.list_rows);
+	assert_int_equal(NDIRS*3, lwin.filtered);
+	for(i = 0; i < lwin.list_rows; ++i)
+	{
+		assert_string_equal("f", lwin.dir_entry[i].name);
+		assert_null(get_parent(&lwin.dir_entry[i]));
+	}
+}
+
+/* Creates NDIRS directories with a nested directory containing a file and an
+ * empty directory in each. */
+static void
+make_tree(void)
+{
+	int i;
+	char path[PATH_MAX];
+
+	for(i = 0; i < NDIRS; ++i)
+	{
+		snprintf(path, sizeof(path), "%s/d%02d", SANDBOX_PATH, i);
+		assert_success(os_mkdir(path, 0700));
+		snprintf(path, sizeof(path), "%s/d%02d/sub", SANDBOX_PATH, i);
+		assert_success(os_mkdir(path, 0700));
+		snprintf(path, sizeof(path), "%s/d%02d/sub/f", SANDBOX_PATH, i);
+		create_file(path);
+		snprintf(path, sizeof(path), "%s/d%02d/empty", SANDBOX_PATH, i);
+		assert_success(os_mkdir(path, 0700));
+	}
+}
+
+/* Removes files created by make_tree(). */
+static void
+remove_tree(void)
+{
+	int i;
+	char path[PATH_MAX];
+
+	for(i = 0; i < NDIRS; ++i)
+	{
+		snprintf(path, sizeof(path), "%s/d%02d/empty", SANDBOX_PATH, i);
+		assert_success(rmdir(path));
+		snprintf(path, sizeof(path), "%s/d%02d/sub/f", SANDBOX_PATH, i);
+		assert_success(remove(path));
+		snprintf(path, sizeof(path), "%s/d%02d/sub", SANDBOX_PATH, i);
+		assert_success(rmdir(path));
+		snprintf(path, sizeof(path), "%s/d%02d", SANDBOX_PATH, i);
+		assert_success(rmdir(path));
+	}
+}
+
+/* Finds parent of the entry in the tree.  Returns the parent or NULL for
+ * top-level entries. */
+static const dir_entry_t *
+get_parent(const dir_entry_t *entry)
+{
+	return (entry->child_pos == 0) ? NULL : entry - entry->child_pos;
+}
+
+static void
+column_line_print(const void *data, int column_id, const char buf[],
+		size_t offset, AlignType align, const char full_column[])
+{
+	/* Do nothing. */
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
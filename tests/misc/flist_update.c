@@ -0,0 +1,223 @@
+#include <stic.h>
+
+#include <unistd.h> /* unlink() */
+
+#include <stdio.h> /* FILE fclose() fopen() fputs() */
+#include <string.h> /* memset() */
+
+#include "../../src/cfg/config.h"
+#include "../../src/ui/column_view.h"
+#include "../../src/ui/fileview.h"
+#include "../../src/ui/ui.h"
+#include "../../src/utils/fswatch.h"
+#include "../../src/utils/str.h"
+#include "../../src/filelist.h"
+#include "../../src/filtering.h"
+#include "../../src/status.h"
+
+#include "utils.h"
+
+static void check_changes(void);
+static void column_line_print(const void *data, int column_id, const char buf[],
+		size_t offset, AlignType align, const char full_column[]);
+static int using_inotify(void);
+
+SETUP()
+{
+	update_string(&cfg.fuse_home, "no");
+	update_string(&cfg.slow_fs_list, "");
+
+	view_setup(&lwin);
+
+	curr_view = &lwin;
+	other_view = &lwin;
+
+	columns_set_line_print_func(&column_line_print);
+	lwin.columns = columns_create();
+
+	copy_str(lwin.curr_dir, sizeof(lwin.curr_dir), SANDBOX_PATH);
+
+	create_file(SANDBOX_PATH "/a");
+	create_file(SANDBOX_PATH "/c");
+}
+
+TEARDOWN()
+{
+	(void)unlink(SANDBOX_PATH "/a");
+	(void)unlink(SANDBOX_PATH "/c");
+
+	update_string(&cfg.slow_fs_list, NULL);
+	update_string(&cfg.fuse_home, NULL);
+
+	fswatch_free(lwin.watch);
+	lwin.watch = NULL;
+	view_teardown(&lwin);
+
+	columns_set_line_print_func(NULL);
+	columns_free(lwin.columns);
+	lwin.columns = NULL;
+}
+
+TEST(new_files_are_inserted_in_sorted_order, IF(using_inotify))
+{
+	populate_dir_list(&lwin, 0);
+	assert_int_equal(2, lwin.list_rows);
+	lwin.list_pos = 1;
+
+	create_file(SANDBOX_PATH "/b");
+	check_changes();
+
+	assert_int_equal(UUE_REDRAW, ui_view_query_scheduled_event(&lwin));
+	assert_int_equal(3, lwin.list_rows);
+	assert_string_equal("a", lwin.dir_entry[0].name);
+	assert_string_equal("b", lwin.dir_entry[1].name);
+	assert_string_equal("c", lwin.dir_entry[2].name);
+	assert_int_equal(2, lwin.list_pos);
+
+	assert_success(unlink(SANDBOX_PATH "/b"));
+}
+
+TEST(removed_files_are_removed_from_the_list, IF(using_inotify))
+{
+	populate_dir_list(&lwin, 0);
+	assert_int_equal(2, lwin.list_rows);
+	lwin.dir_entry[0].selected = 1;
+	lwin.selected_files = 1;
+
+	assert_success(unlink(SANDBOX_PATH "/a"));
+	check_changes();
+
+	assert_int_equal(UUE_REDRAW, ui_view_query_scheduled_event(&lwin));
+	assert_int_equal(1, lwin.list_rows);
+	assert_string_equal("c", lwin.dir_entry[0].name);
+	assert_int_equal(0, lwin.selected_files);
+}
+
+TEST(changed_files_are_repositioned, IF(using_inotify))
+{
+	FILE *f;
+
+	lwin.sort[0] = SK_BY_SIZE;
+	lwin.sort[1] = SK_BY_NAME;
+	populate_dir_list(&lwin, 0);
+	assert_int_equal(2, lwin.list_rows);
+	assert_string_equal("a", lwin.dir_entry[0].name);
+	lwin.dir_entry[0].selected = 1;
+	lwin.selected_files = 1;
+
+	f = fopen(SANDBOX_PATH "/a", "w");
+	assert_non_null(f);
+	fputs("contents", f);
+	fclose(f);
+	check_changes();
+
+	assert_int_equal(UUE_REDRAW, ui_view_query_scheduled_event(&lwin));
+	assert_int_equal(2, lwin.list_rows);
+	assert_string_equal("c", lwin.dir_entry[0].name);
+	assert_string_equal("a", lwin.dir_entry[1].name);
+	assert_int_equal(8, lwin.dir_entry[1].size);
+	assert_true(lwin.dir_entry[1].selected);
+	assert_int_equal(1, lwin.selected_files);
+}
+
+TEST(hidden_files_are_counted_as_filtered, IF(using_inotify))
+{
+	lwin.hide_dot = 1;
+	populate_dir_list(&lwin, 0);
+	assert_int_equal(0, lwin.filtered);
+
+	create_file(SANDBOX_PATH "/.hidden");
+	check_changes();
+	assert_int_equal(2, lwin.list_rows);
+	assert_int_equal(1, lwin.filtered);
+
+	assert_success(unlink(SANDBOX_PATH "/.hidden"));
+	check_changes();
+	assert_int_equal(2, lwin.list_rows);
+	assert_int_equal(0, lwin.filtered);
+}
+
+TEST(several_changes_are_merged_in_sorted_order, IF(using_inotify))
+{
+	populate_dir_list(&lwin, 0);
+	assert_int_equal(2, lwin.list_rows);
+	lwin.list_pos = 1;
+
+	create_file(SANDBOX_PATH "/0");
+	create_file(SANDBOX_PATH "/b");
+	create_file(SANDBOX_PATH "/d");
+	assert_success(unlink(SANDBOX_PATH "/a"));
+	check_changes();
+
+	assert_int_equal(UUE_REDRAW, ui_view_query_scheduled_event(&lwin));
+	assert_int_equal(4, lwin.list_rows);
+	assert_string_equal("0", lwin.dir_entry[0].name);
+	assert_string_equal("b", lwin.dir_entry[1].name);
+	assert_string_equal("c", lwin.dir_entry[2].name);
+	assert_string_equal("d", lwin.dir_entry[3].name);
+	assert_int_equal(2, lwin.list_pos);
+
+	assert_success(unlink(SANDBOX_PATH "/0"));
+	assert_success(unlink(SANDBOX_PATH "/b"));
+	assert_success(unlink(SANDBOX_PATH "/d"));
+}
+
+TEST(changes_before_reload_are_not_counted_twice, IF(using_inotify))
+{
+	lwin.hide_dot = 1;
+	populate_dir_list(&lwin, 0);
+	assert_int_equal(0, lwin.filtered);
+
+	create_file(SANDBOX_PATH "/.hidden");
+	populate_dir_list(&lwin, 1);
+	assert_int_equal(1, lwin.filtered);
+
+	check_changes();
+	assert_int_equal(1, lwin.filtered);
+
+	assert_success(unlink(SANDBOX_PATH "/.hidden"));
+}
+
+TEST(local_filter_causes_full_reload, IF(using_inotify))
+{
+	populate_dir_list(&lwin, 0);
+	assert_int_equal(0, filter_set(&lwin.local_filter.filter, "a"));
+
+	create_file(SANDBOX_PATH "/b");
+	check_changes();
+
+	assert_int_equal(UUE_RELOAD, ui_view_query_scheduled_event(&lwin));
+	assert_int_equal(2, lwin.list_rows);
+
+	assert_success(unlink(SANDBOX_PATH "/b"));
+}
+
+/* Checks view for changes as if it was done after startup. */
+static void
+check_changes(void)
+{
+	curr_stats.load_stage = 2;
+	check_if_filelist_have_changed(&lwin);
+	curr_stats.load_stage = 0;
+}
+
+static void
+column_line_print(const void *data, int column_id, const char buf[],
+		size_t offset, AlignType align, const char full_column[])
+{
+	/* Do nothing. */
+}
+
+/* Checks whether names of changed files are reported by the watcher. */
+static int
+using_inotify(void)
+{
+#ifdef HAVE_INOTIFY
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
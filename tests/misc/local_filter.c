@@ -0,0 +1,182 @@
+#include <stic.h>
+
+#include <stdio.h> /* snprintf() */
+#include <stdlib.h> /* free() */
+#include <string.h> /* strdup() strstr() */
+
+#include "../../src/cfg/config.h"
+#include "../../src/ui/ui.h"
+#include "../../src/utils/dynarray.h"
+#include "../../src/utils/str.h"
+#include "../../src/filelist.h"
+#include "../../src/filtering.h"
+
+#include "utils.h"
+
+/* Number of files that is big enough to filter them in parallel. */
+#define NFILES 20000
+
+static void fill_view(FileView *view, int count);
+static int count_matches(const char substr[], int count);
+static void make_name(char buf[], size_t buf_len, int i);
+
+SETUP()
+{
+	update_string(&cfg.slow_fs_list, "");
+	view_setup(&lwin);
+	curr_view = &lwin;
+	other_view = &lwin;
+}
+
+TEARDOWN()
+{
+	int i;
+
+	for(i = 0; i < lwin.local_filter.entry_count; ++i)
+	{
+		free_dir_entry(&lwin, &lwin.local_filter.entries[i]);
+	}
+	dynarray_free(lwin.local_filter.entries);
+	lwin.local_filter.entries = NULL;
+	lwin.local_filter.entry_count = 0;
+
+	view_teardown(&lwin);
+	update_string(&cfg.slow_fs_list, NULL);
+}
+
+TEST(typing_literal_pattern_narrows_results)
+{
+	fill_view(&lwin, 100);
+
+	assert_int_equal(0, local_filter_set(&lwin, "1"));
+	assert_int_equal(count_matches("1", 100), lwin.list_rows);
+	assert_int_equal(0, local_filter_set(&lwin, "12"));
+	assert_int_equal(count_matches("12", 100), lwin.list_rows);
+	assert_string_equal("f0012", lwin.dir_entry[0].name);
+
+	local_filter_cancel(&lwin);
+	assert_int_equal(100, lwin.list_rows);
+}
+
+TEST(removing_characters_rescans_all_files)
+{
+	fill_view(&lwin, 100);
+
+	assert_int_equal(0, local_filter_set(&lwin, "12"));
+	assert_int_equal(count_matches("12", 100), lwin.list_rows);
+	assert_int_equal(0, local_filter_set(&lwin, "1"));
+	assert_int_equal(count_matches("1", 100), lwin.list_rows);
+	assert_int_equal(0, local_filter_set(&lwin, ""));
+	assert_int_equal(100, lwin.list_rows);
+
+	local_filter_cancel(&lwin);
+}
+
+TEST(regular_expression_rescans_all_files)
+{
+	fill_view(&lwin, 100);
+
+	assert_int_equal(0, local_filter_set(&lwin, "1"));
+	assert_int_equal(0, local_filter_set(&lwin, "1|2"));
+	assert_int_equal(count_matches("1", 100) + count_matches("2", 100) -
+			count_matches("12", 100) - count_matches("21", 100), lwin.list_rows);
+
+	local_filter_cancel(&lwin);
+}
+
+TEST(switching_to_case_sensitive_matching_narrows_results)
+{
+	cfg.ignore_case = 1;
+	cfg.smart_case = 1;
+
+	fill_view(&lwin, 100);
+	assert_success(replace_string(&lwin.dir_entry[10].name, "x0Fa"));
+	assert_success(replace_string(&lwin.dir_entry[11].name, "x0fb"));
+
+	assert_int_equal(0, local_filter_set(&lwin, "x0"));
+	assert_int_equal(2, lwin.list_rows);
+	assert_int_equal(0, local_filter_set(&lwin, "x0F"));
+	assert_int_equal(1, lwin.list_rows);
+	assert_string_equal("x0Fa", lwin.dir_entry[0].name);
+
+	local_filter_cancel(&lwin);
+
+	cfg.ignore_case = 0;
+	cfg.smart_case = 0;
+}
+
+TEST(filtering_out_everything_and_back_works)
+{
+	fill_view(&lwin, 100);
+
+	assert_int_equal(0, local_filter_set(&lwin, "9"));
+	assert_int_equal(1, local_filter_set(&lwin, "9x"));
+	assert_int_equal(1, local_filter_set(&lwin, "9xy"));
+	assert_int_equal(0, local_filter_set(&lwin, "9"));
+	assert_int_equal(count_matches("9", 100), lwin.list_rows);
+
+	local_filter_cancel(&lwin);
+}
+
+TEST(big_lists_are_filtered_correctly)
+{
+	fill_view(&lwin, NFILES);
+
+	assert_int_equal(0, local_filter_set(&lwin, "3"));
+	assert_int_equal(count_matches("3", NFILES), lwin.list_rows);
+	assert_int_equal(0, local_filter_set(&lwin, "34"));
+	assert_int_equal(count_matches("34", NFILES), lwin.list_rows);
+	assert_int_equal(0, local_filter_set(&lwin, "345"));
+	assert_int_equal(count_matches("345", NFILES), lwin.list_rows);
+	assert_string_equal("f0345", lwin.dir_entry[0].name);
+
+	local_filter_accept(&lwin);
+	assert_int_equal(count_matches("345", NFILES), lwin.list_rows);
+}
+
+/* Fills the view with count files. */
+static void
+fill_view(FileView *view, int count)
+{
+	int i;
+
+	view->list_rows = count;
+	view->list_pos = 0;
+	view->dir_entry = dynarray_cextend(NULL,
+			view->list_rows*sizeof(*view->dir_entry));
+
+	for(i = 0; i < count; ++i)
+	{
+		char name[16];
+		make_name(name, sizeof(name), i);
+		view->dir_entry[i].name = strdup(name);
+		view->dir_entry[i].origin = &view->curr_dir[0];
+		view->dir_entry[i].type = FT_REG;
+	}
+}
+
+/* Counts names among the first count files that contain the substring.
+ * Returns the number. */
+static int
+count_matches(const char substr[], int count)
+{
+	int i;
+	int n = 0;
+	for(i = 0; i < count; ++i)
+	{
+		char name[16];
+		make_name(name, sizeof(name), i);
+		n += (strstr(name, substr) != NULL);
+	}
+	return n;
+}
+
+/* Formats name of i-th file. */
+static void
+make_name(char buf[], size_t buf_len, int i)
+{
+	snprintf(buf, buf_len, "f%04d", i);
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
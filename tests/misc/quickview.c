@@ -1,6 +1,8 @@
 #include <stic.h>
 
-#include <stdio.h> /* FILE fclose() fopen() */
+#include <unistd.h> /* usleep() */
+
+#include <stdio.h> /* FILE fclose() fopen() snprintf() */
 #include <string.h> /* strcpy() */
 
 #include "../../src/cfg/config.h"
@@ -13,7 +15,10 @@
 #include "../../src/utils/string_array.h"
 #include "../../src/filetype.h"
 
+#include "utils.h"
+
 static void check_only_one_line_displayed(void);
+static void wait_for_async_preview(void);
 
 SETUP()
 {
@@ -152,5 +157,189 @@ check_only_one_line_displayed(void)
 	fclose(fp);
 }
 
+TEST(output_of_viewer_is_collected_in_background, IF(not_windows))
+{
+	size_t len;
+	int finished;
+	const char *data;
+
+	update_string(&cfg.shell, "/bin/sh");
+
+	assert_int_equal(0, start_async_preview(TEST_DATA_PATH "/read/two-lines",
+				"echo first; echo second", 10, 80));
+	wait_for_async_preview();
+
+	data = get_async_preview(&len, &finished);
+	assert_true(finished);
+	assert_int_equal(13, len);
+	assert_string_equal("first\nsecond\n", data);
+
+	stop_async_preview();
+	update_string(&cfg.shell, NULL);
+}
+
+TEST(preview_of_the_same_file_is_reused, IF(not_windows))
+{
+	update_string(&cfg.shell, "/bin/sh");
+
+	assert_int_equal(0, start_async_preview(TEST_DATA_PATH "/read/two-lines",
+				"echo text", 10, 80));
+	wait_for_async_preview();
+	assert_int_equal(1, start_async_preview(TEST_DATA_PATH "/read/two-lines",
+				"echo text", 10, 80));
+	assert_int_equal(0, start_async_preview(TEST_DATA_PATH "/read/two-lines",
+				"echo other", 10, 80));
+
+	stop_async_preview();
+	update_string(&cfg.shell, NULL);
+}
+
+TEST(viewer_is_stopped_after_enough_lines, IF(not_windows))
+{
+	size_t len;
+	int finished;
+	const char *data;
+
+	update_string(&cfg.shell, "/bin/sh");
+
+	assert_int_equal(0, start_async_preview(TEST_DATA_PATH "/read/two-lines",
+				"echo 1; echo 2; sleep 5; echo 3", 2, 80));
+	wait_for_async_preview();
+
+	data = get_async_preview(&len, &finished);
+	assert_true(finished);
+	assert_true(starts_with_lit(data, "1\n2\n"));
+
+	/* Larger preview needs to run the viewer again. */
+	assert_int_equal(0, start_async_preview(TEST_DATA_PATH "/read/two-lines",
+				"echo 1; echo 2; sleep 5; echo 3", 3, 80));
+
+	stop_async_preview();
+	update_string(&cfg.shell, NULL);
+}
+
+TEST(stale_viewer_is_killed, IF(not_windows))
+{
+	size_t len;
+	int finished;
+
+	update_string(&cfg.shell, "/bin/sh");
+
+	/* Viewer must be killed or this will wait for it to finish. */
+	assert_int_equal(0, start_async_preview(TEST_DATA_PATH "/read/two-lines",
+				"sleep 10", 10, 80));
+	assert_int_equal(0, start_async_preview(TEST_DATA_PATH "/read/dos-eof",
+				"echo text", 10, 80));
+	wait_for_async_preview();
+
+	assert_string_equal("text\n", get_async_preview(&len, &finished));
+
+	stop_async_preview();
+	update_string(&cfg.shell, NULL);
+}
+
+TEST(finished_preview_is_taken_from_cache, IF(not_windows))
+{
+	size_t len;
+	int finished;
+
+	update_string(&cfg.shell, "/bin/sh");
+
+	assert_int_equal(0, start_async_preview(TEST_DATA_PATH "/read/two-lines",
+				"echo first", 10, 80));
+	wait_for_async_preview();
+	assert_int_equal(0, start_async_preview(TEST_DATA_PATH "/read/dos-eof",
+				"echo second", 10, 80));
+	wait_for_async_preview();
+
+	assert_int_equal(1, start_async_preview(TEST_DATA_PATH "/read/two-lines",
+				"echo first", 10, 80));
+	assert_string_equal("first\n", get_async_preview(&len, &finished));
+	assert_true(finished);
+
+	stop_async_preview();
+	update_string(&cfg.shell, NULL);
+}
+
+TEST(preview_depends_on_width_of_the_pane, IF(not_windows))
+{
+	update_string(&cfg.shell, "/bin/sh");
+
+	assert_int_equal(0, start_async_preview(TEST_DATA_PATH "/read/two-lines",
+				"echo text", 10, 80));
+	wait_for_async_preview();
+	assert_int_equal(0, start_async_preview(TEST_DATA_PATH "/read/two-lines",
+				"echo text", 10, 40));
+
+	stop_async_preview();
+	update_string(&cfg.shell, NULL);
+}
+
+TEST(prefetched_preview_is_reused, IF(not_windows))
+{
+	size_t len;
+	int finished;
+
+	update_string(&cfg.shell, "/bin/sh");
+
+	assert_int_equal(0, prefetch_async_preview(TEST_DATA_PATH "/read/two-lines",
+				"echo text", 10, 80));
+	assert_null(get_async_preview(&len, &finished));
+
+	assert_int_equal(1, start_async_preview(TEST_DATA_PATH "/read/two-lines",
+				"echo text", 10, 80));
+	wait_for_async_preview();
+	assert_string_equal("text\n", get_async_preview(&len, &finished));
+
+	stop_async_preview();
+	update_string(&cfg.shell, NULL);
+}
+
+TEST(least_recently_used_preview_is_evicted, IF(not_windows))
+{
+	int i;
+	char cmd[32];
+
+	update_string(&cfg.shell, "/bin/sh");
+
+	for(i = 0; i < 17; ++i)
+	{
+		snprintf(cmd, sizeof(cmd), "echo %d", i);
+		assert_int_equal(0, start_async_preview(TEST_DATA_PATH "/read/two-lines",
+					cmd, 10, 80));
+		wait_for_async_preview();
+	}
+
+	assert_int_equal(1, start_async_preview(TEST_DATA_PATH "/read/two-lines",
+				"echo 16", 10, 80));
+	assert_int_equal(1, start_async_preview(TEST_DATA_PATH "/read/two-lines",
+				"echo 1", 10, 80));
+	assert_int_equal(0, start_async_preview(TEST_DATA_PATH "/read/two-lines",
+				"echo 0", 10, 80));
+
+	stop_async_preview();
+	update_string(&cfg.shell, NULL);
+}
+
+/* Polls output of background viewer until it's finished or for at most a couple
+ * of seconds. */
+static void
+wait_for_async_preview(void)
+{
+	int i;
+	size_t len;
+	int finished = 0;
+
+	for(i = 0; i < 500 && !finished; ++i)
+	{
+		(void)read_async_preview();
+		(void)get_async_preview(&len, &finished);
+		if(!finished)
+		{
+			usleep(5000);
+		}
+	}
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
@@ -18,6 +18,8 @@
 #define ASSERT_STRCMP_EQUAL(a, b) \
 		do { assert_int_equal(SIGN(a), SIGN(b)); } while(0)
 
+static void set_names(FileView *view, const char *names[], int count);
+
 SETUP_ONCE()
 {
 	(void)setlocale(LC_ALL, "");
@@ -289,6 +291,61 @@ TEST(ignore_case_name_sort_breaks_ties_deterministically)
 	assert_string_equal("аааааааааа", rwin.dir_entry[1].name);
 }
 
+TEST(natural_order_of_names_is_kept)
+{
+	const char *names[] = { "file10", "file2", "File2", ".hidden3", "file1",
+	                        "file01" };
+	set_names(&lwin, names, 6);
+
+	lwin.sort[0] = SK_BY_NAME;
+	memset(&lwin.sort[1], SK_NONE, sizeof(lwin.sort) - 1);
+
+	sort_view(&lwin);
+
+	assert_string_equal(".hidden3", lwin.dir_entry[0].name);
+	assert_string_equal("File2", lwin.dir_entry[1].name);
+	assert_string_equal("file01", lwin.dir_entry[2].name);
+	assert_string_equal("file1", lwin.dir_entry[3].name);
+	assert_string_equal("file2", lwin.dir_entry[4].name);
+	assert_string_equal("file10", lwin.dir_entry[5].name);
+}
+
+TEST(natural_order_of_names_is_kept_ignoring_case)
+{
+	const char *names[] = { "file10", "file2", "File2", ".hidden3", "FILE1",
+	                        "file01" };
+	set_names(&lwin, names, 6);
+
+	lwin.sort[0] = SK_BY_INAME;
+	memset(&lwin.sort[1], SK_NONE, sizeof(lwin.sort) - 1);
+
+	sort_view(&lwin);
+
+	assert_string_equal(".hidden3", lwin.dir_entry[0].name);
+	assert_string_equal("file01", lwin.dir_entry[1].name);
+	assert_string_equal("FILE1", lwin.dir_entry[2].name);
+	assert_string_equal("File2", lwin.dir_entry[3].name);
+	assert_string_equal("file2", lwin.dir_entry[4].name);
+	assert_string_equal("file10", lwin.dir_entry[5].name);
+}
+
+TEST(lexicographic_order_of_names_is_kept)
+{
+	const char *names[] = { "file10", "file2", "File2", "file1" };
+	set_names(&lwin, names, 4);
+
+	cfg.sort_numbers = 0;
+	lwin.sort[0] = SK_BY_INAME;
+	memset(&lwin.sort[1], SK_NONE, sizeof(lwin.sort) - 1);
+
+	sort_view(&lwin);
+
+	assert_string_equal("file1", lwin.dir_entry[0].name);
+	assert_string_equal("file10", lwin.dir_entry[1].name);
+	assert_string_equal("File2", lwin.dir_entry[2].name);
+	assert_string_equal("file2", lwin.dir_entry[3].name);
+}
+
 TEST(extensions_of_dot_files_are_sorted_correctly)
 {
 	view_teardown(&lwin);
@@ -431,5 +488,125 @@ TEST(groups_sorting_works)
 	assert_string_equal("11-todo-publish", lwin.dir_entry[6].name);
 }
 
+TEST(groups_cache_is_dropped_when_groups_are_not_used)
+{
+	const char *names[] = { "b-todo", "a-done", "c-done,x" };
+	set_names(&lwin, names, 3);
+
+	lwin.sort[0] = SK_BY_GROUPS;
+	memset(&lwin.sort[1], SK_NONE, sizeof(lwin.sort) - 1);
+
+	update_string(&lwin.sort_groups, "-(done|todo),(x)");
+	(void)regcomp(&lwin.primary_group, "-(done|todo)", REG_EXTENDED | REG_ICASE);
+
+	sort_view(&lwin);
+	assert_string_equal("-(done|todo),(x)", lwin.sort_groups_cache.src);
+	assert_int_equal(2, lwin.sort_groups_cache.ngroups);
+	assert_int_equal(1, lwin.sort_groups_cache.nregexes);
+
+	lwin.sort[0] = SK_BY_NAME;
+	sort_view(&lwin);
+	assert_null(lwin.sort_groups_cache.src);
+	assert_null(lwin.sort_groups_cache.regexes);
+	assert_int_equal(0, lwin.sort_groups_cache.ngroups);
+
+	regfree(&lwin.primary_group);
+	update_string(&lwin.sort_groups, NULL);
+}
+
+TEST(descending_groups_sorting_works)
+{
+	view_teardown(&lwin);
+	assert_success(init_status(&cfg));
+
+	strcpy(lwin.curr_dir, TEST_DATA_PATH);
+	lwin.list_rows = 3;
+	lwin.dir_entry = dynarray_cextend(NULL,
+			lwin.list_rows*sizeof(*lwin.dir_entry));
+	lwin.dir_entry[0].name = strdup("1-done");
+	lwin.dir_entry[0].type = FT_REG;
+	lwin.dir_entry[0].origin = lwin.curr_dir;
+	lwin.dir_entry[1].name = strdup("2-todo");
+	lwin.dir_entry[1].type = FT_REG;
+	lwin.dir_entry[1].origin = lwin.curr_dir;
+	lwin.dir_entry[2].name = strdup("3-done");
+	lwin.dir_entry[2].type = FT_REG;
+	lwin.dir_entry[2].origin = lwin.curr_dir;
+
+	lwin.sort[0] = -SK_BY_GROUPS;
+	lwin.sort[1] = SK_BY_NAME;
+	memset(&lwin.sort[2], SK_NONE, sizeof(lwin.sort) - 2);
+
+	update_string(&lwin.sort_groups, "-(done|todo)");
+	(void)regcomp(&lwin.primary_group, "-(done|todo)", REG_EXTENDED | REG_ICASE);
+
+	sort_view(&lwin);
+
+	regfree(&lwin.primary_group);
+	update_string(&lwin.sort_groups, NULL);
+
+	assert_string_equal("2-todo", lwin.dir_entry[0].name);
+	assert_string_equal("1-done", lwin.dir_entry[1].name);
+	assert_string_equal("3-done", lwin.dir_entry[2].name);
+}
+
+TEST(insertion_position_respects_groups)
+{
+	dir_entry_t entry = { .name = "4-done", .type = FT_REG };
+
+	view_teardown(&lwin);
+	assert_success(init_status(&cfg));
+
+	strcpy(lwin.curr_dir, TEST_DATA_PATH);
+	lwin.list_rows = 3;
+	lwin.dir_entry = dynarray_cextend(NULL,
+			lwin.list_rows*sizeof(*lwin.dir_entry));
+	lwin.dir_entry[0].name = strdup("1-done");
+	lwin.dir_entry[0].type = FT_REG;
+	lwin.dir_entry[0].origin = lwin.curr_dir;
+	lwin.dir_entry[1].name = strdup("3-done");
+	lwin.dir_entry[1].type = FT_REG;
+	lwin.dir_entry[1].origin = lwin.curr_dir;
+	lwin.dir_entry[2].name = strdup("2-todo");
+	lwin.dir_entry[2].type = FT_REG;
+	lwin.dir_entry[2].origin = lwin.curr_dir;
+	entry.origin = lwin.curr_dir;
+
+	lwin.sort[0] = SK_BY_GROUPS;
+	lwin.sort[1] = SK_BY_NAME;
+	memset(&lwin.sort[2], SK_NONE, sizeof(lwin.sort) - 2);
+
+	update_string(&lwin.sort_groups, "-(done|todo)");
+	(void)regcomp(&lwin.primary_group, "-(done|todo)", REG_EXTENDED | REG_ICASE);
+
+	assert_int_equal(2, sort_find_position(&lwin, &entry));
+	entry.name = "0-todo";
+	assert_int_equal(2, sort_find_position(&lwin, &entry));
+	entry.name = "5-todo";
+	assert_int_equal(3, sort_find_position(&lwin, &entry));
+
+	regfree(&lwin.primary_group);
+	update_string(&lwin.sort_groups, NULL);
+}
+
+/* Replaces entries of the view with regular files of specified names. */
+static void
+set_names(FileView *view, const char *names[], int count)
+{
+	int i;
+
+	view_teardown(view);
+
+	view->list_rows = count;
+	view->dir_entry = dynarray_cextend(NULL,
+			view->list_rows*sizeof(*view->dir_entry));
+	for(i = 0; i < count; ++i)
+	{
+		view->dir_entry[i].name = strdup(names[i]);
+		view->dir_entry[i].type = FT_REG;
+		view->dir_entry[i].origin = view->curr_dir;
+	}
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
@@ -15,9 +15,11 @@
 #include "../../src/utils/fswatch.h"
 #include "../../src/utils/path.h"
 #include "../../src/utils/str.h"
+#include "../../src/utils/trie.h"
 #include "../../src/filelist.h"
 #include "../../src/filtering.h"
 #include "../../src/opt_handlers.h"
+#include "../../src/sort.h"
 
 void
 opt_handlers_setup(void)
@@ -128,6 +130,14 @@ view_teardown(FileView *view)
 
 	view->custom.type = CV_REGULAR;
 
+	trie_free(view->custom.excluded_paths);
+	view->custom.excluded_paths = NULL;
+	trie_free(view->custom.folded_paths);
+	view->custom.folded_paths = NULL;
+	view->custom.tree_depth = 0;
+
+	sort_reset_groups_cache(view);
+
 	fswatch_free(view->watch);
 	view->watch = NULL;
 }
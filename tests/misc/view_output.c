@@ -0,0 +1,131 @@
+#include <stic.h>
+
+#include <unistd.h> /* unlink() */
+
+#include <stddef.h> /* size_t */
+#include <stdio.h> /* FILE fclose() fopen() fwrite() */
+#include <stdlib.h> /* free() malloc() */
+#include <string.h> /* memcpy() memset() */
+
+#include "../../src/modes/view.h"
+#include "../../src/utils/string_array.h"
+
+static void check_cuts(const char text[], size_t len, const size_t cuts[],
+		size_t ncuts);
+static void check_all_cuts(const char text[], size_t len);
+static void check_byte_by_byte(const char text[], size_t len);
+
+TEST(cr_and_lf_in_different_pieces_form_single_separator)
+{
+	static const char text[] = "a\r\nb\r\nc";
+	static const size_t cuts[] = { 2U, 5U };
+	check_cuts(text, sizeof(text) - 1U, cuts, 2U);
+	check_all_cuts(text, sizeof(text) - 1U);
+}
+
+TEST(runs_of_nuls_in_different_pieces_form_single_separator)
+{
+	static const char text[] = "a\0\0\0b\0\0c";
+	static const size_t cuts[] = { 2U, 3U, 6U };
+	check_cuts(text, sizeof(text) - 1U, cuts, 3U);
+	check_all_cuts(text, sizeof(text) - 1U);
+	check_byte_by_byte(text, sizeof(text) - 1U);
+}
+
+TEST(bom_arriving_in_pieces_is_skipped)
+{
+	static const char text[] = "\xef\xbb\xbf" "a\nb";
+	check_all_cuts(text, sizeof(text) - 1U);
+	check_byte_by_byte(text, sizeof(text) - 1U);
+}
+
+TEST(pending_partial_line_is_added_at_eof)
+{
+	static const char text[] = "a\nbc";
+	static const size_t cuts[] = { 3U };
+	check_cuts(text, sizeof(text) - 1U, cuts, 1U);
+	check_all_cuts(text, sizeof(text) - 1U);
+}
+
+TEST(mixed_separators_are_split_like_on_reading)
+{
+	static const char text[] = "a\rb\n\nc\r\r\nd\0\re\r";
+	check_all_cuts(text, sizeof(text) - 1U);
+	check_byte_by_byte(text, sizeof(text) - 1U);
+}
+
+/* Feeds text to split_output() in pieces that end at cuts offsets and checks
+ * that result matches reading the text from a file. */
+static void
+check_cuts(const char text[], size_t len, const size_t cuts[], size_t ncuts)
+{
+	view_output_t out;
+	char **lines = NULL;
+	int nlines = 0;
+	char **expected;
+	int nexpected;
+	size_t i;
+	size_t from = 0U;
+	FILE *f;
+
+	f = fopen(SANDBOX_PATH "/text", "wb");
+	assert_non_null(f);
+	assert_int_equal(len, fwrite(text, 1U, len, f));
+	fclose(f);
+
+	expected = read_file_of_lines(SANDBOX_PATH "/text", &nexpected);
+	assert_success(unlink(SANDBOX_PATH "/text"));
+
+	memset(&out, '\0', sizeof(out));
+	out.buf = malloc(len + 1U);
+	assert_non_null(out.buf);
+
+	for(i = 0U; i <= ncuts; ++i)
+	{
+		const size_t to = (i == ncuts) ? len : cuts[i];
+		memcpy(out.buf + out.len, text + from, to - from);
+		out.len += to - from;
+		from = to;
+
+		nlines = split_output(&out, &lines, nlines, 0);
+	}
+	nlines = split_output(&out, &lines, nlines, 1);
+
+	assert_int_equal(nexpected, nlines);
+	for(i = 0U; i < (size_t)nlines && i < (size_t)nexpected; ++i)
+	{
+		assert_string_equal(expected[i], lines[i]);
+	}
+
+	free(out.buf);
+	free_string_array(lines, nlines);
+	free_string_array(expected, nexpected);
+}
+
+/* Checks splitting of the text broken into two pieces in all possible
+ * ways. */
+static void
+check_all_cuts(const char text[], size_t len)
+{
+	size_t i;
+	for(i = 0U; i <= len; ++i)
+	{
+		check_cuts(text, len, &i, 1U);
+	}
+}
+
+/* Checks splitting of the text that arrives byte by byte. */
+static void
+check_byte_by_byte(const char text[], size_t len)
+{
+	size_t i;
+	size_t cuts[len];
+	for(i = 0U; i < len; ++i)
+	{
+		cuts[i] = i;
+	}
+	check_cuts(text, len, cuts, len);
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
@@ -1,19 +1,23 @@
 #include <stic.h>
 
 #include <sys/stat.h> /* stat */
-#include <unistd.h> /* stat() */
+#include <unistd.h> /* rmdir() stat() */
+#include <utime.h> /* utimbuf utime() */
 
+#include <stdint.h> /* uint64_t */
 #include <stdio.h> /* fclose() fopen() fprintf() remove() */
 
 #include "../../src/cfg/config.h"
 #include "../../src/cfg/info.h"
 #include "../../src/cfg/info_chars.h"
+#include "../../src/compat/os.h"
 #include "../../src/ui/ui.h"
 #include "../../src/utils/matchers.h"
 #include "../../src/utils/str.h"
 #include "../../src/cmd_core.h"
 #include "../../src/filetype.h"
 #include "../../src/opt_handlers.h"
+#include "../../src/status.h"
 
 #include "utils.h"
 
@@ -76,5 +80,64 @@ TEST(filetypes_are_deduplicated)
 	reset_cmds();
 }
 
+TEST(dirsizes_file_is_written_only_if_enabled)
+{
+	struct stat s;
+
+	update_string(&cfg.shell, "");
+	assert_success(init_status(&cfg));
+	copy_str(cfg.config_dir, sizeof(cfg.config_dir), SANDBOX_PATH);
+
+	cfg.vifm_info = VIFMINFO_DIRSIZES;
+	write_info_file();
+	assert_success(stat(SANDBOX_PATH "/dirsizes", &s));
+
+	cfg.vifm_info = 0;
+	write_info_file();
+	assert_failure(stat(SANDBOX_PATH "/dirsizes", &s));
+
+	assert_success(remove(SANDBOX_PATH "/vifminfo"));
+	update_string(&cfg.shell, NULL);
+}
+
+TEST(dirsizes_are_read_only_if_enabled)
+{
+	uint64_t size;
+	struct utimbuf times = { .actime = 1000, .modtime = 1000 };
+	FILE *const f = fopen(SANDBOX_PATH "/vifminfo", "w");
+	fclose(f);
+
+	update_string(&cfg.shell, "");
+	assert_success(init_status(&cfg));
+	copy_str(cfg.config_dir, sizeof(cfg.config_dir), SANDBOX_PATH);
+
+	assert_success(os_mkdir(SANDBOX_PATH "/dir", 0700));
+	assert_success(utime(SANDBOX_PATH "/dir", &times));
+	assert_success(dcache_set_at(SANDBOX_PATH "/dir", 10, 11));
+	assert_success(dcache_save(SANDBOX_PATH "/dirsizes", SANDBOX_PATH "/absent"));
+
+	/* ls-like view blocks view column updates. */
+	lwin.ls_view = 1;
+
+	assert_success(init_status(&cfg));
+	cfg.vifm_info = 0;
+	read_info_file(1);
+	dcache_get_at(SANDBOX_PATH "/dir", &size, NULL);
+	assert_ulong_equal((unsigned long)DCACHE_UNKNOWN, size);
+
+	cfg.vifm_info = VIFMINFO_DIRSIZES;
+	read_info_file(1);
+	dcache_get_at(SANDBOX_PATH "/dir", &size, NULL);
+	assert_ulong_equal(10, size);
+
+	lwin.ls_view = 0;
+	cfg.vifm_info = 0;
+
+	assert_success(remove(SANDBOX_PATH "/dirsizes"));
+	assert_success(remove(SANDBOX_PATH "/vifminfo"));
+	assert_success(rmdir(SANDBOX_PATH "/dir"));
+	update_string(&cfg.shell, NULL);
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */
@@ -0,0 +1,134 @@
+#include <stic.h>
+
+#ifndef _WIN32
+#include <dirent.h> /* DT_REG DT_UNKNOWN dirent */
+#endif
+#include <unistd.h> /* unlink() */
+
+#include <stdio.h> /* fclose() fopen() snprintf() sscanf() */
+#include <string.h> /* memset() strcmp() */
+
+#include "../../src/compat/fs_limits.h"
+#include "../../src/utils/fs.h"
+
+/* Number of files enough to span several batches of directory entries (they
+ * are small in tests). */
+#define NFILES 300
+
+static int count_files(const char name[], const void *data, void *param);
+static int stop_early(const char name[], const void *data, void *param);
+static void make_name(char buf[], size_t buf_len, int i);
+
+static char seen[NFILES];
+
+SETUP()
+{
+	int i;
+	for(i = 0; i < NFILES; ++i)
+	{
+		char path[PATH_MAX];
+		FILE *f;
+
+		make_name(path, sizeof(path), i);
+		f = fopen(path, "w");
+		assert_non_null(f);
+		if(f != NULL)
+		{
+			fclose(f);
+		}
+	}
+
+	memset(seen, 0, sizeof(seen));
+}
+
+TEARDOWN()
+{
+	int i;
+	for(i = 0; i < NFILES; ++i)
+	{
+		char path[PATH_MAX];
+		make_name(path, sizeof(path), i);
+		assert_success(unlink(path));
+	}
+}
+
+TEST(all_entries_are_enumerated_exactly_once)
+{
+	int count = 0;
+	int i;
+
+	assert_success(enum_dir_content(SANDBOX_PATH, &count_files, &count));
+	assert_int_equal(NFILES, count);
+
+	for(i = 0; i < NFILES; ++i)
+	{
+		assert_int_equal(1, seen[i]);
+	}
+}
+
+TEST(enumeration_stops_on_client_request)
+{
+	int count = 0;
+	assert_success(enum_dir_content(SANDBOX_PATH, &stop_early, &count));
+	assert_int_equal(10, count);
+}
+
+TEST(missing_directory_is_an_error)
+{
+	int count = 0;
+	assert_failure(enum_dir_content(SANDBOX_PATH "/no-such-dir", &count_files,
+				&count));
+	assert_int_equal(0, count);
+}
+
+/* Counts files and marks them as seen. */
+static int
+count_files(const char name[], const void *data, void *param)
+{
+	int *const count = param;
+	int i;
+
+	if(strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+	{
+		return 0;
+	}
+
+	/* Entries are described by dirent structures only on POSIX systems. */
+#ifndef _WIN32
+	{
+		const struct dirent *const d = data;
+		assert_string_equal(d->d_name, name);
+		if(d->d_type != DT_UNKNOWN)
+		{
+			assert_int_equal(DT_REG, d->d_type);
+		}
+	}
+#endif
+
+	assert_int_equal(1, sscanf(name, "f%d", &i));
+	if(i >= 0 && i < NFILES)
+	{
+		++seen[i];
+	}
+
+	++*count;
+	return 0;
+}
+
+/* Stops enumeration after visiting several entries. */
+static int
+stop_early(const char name[], const void *data, void *param)
+{
+	int *const count = param;
+	return (++*count == 10);
+}
+
+/* Formats path to i-th file with long name. */
+static void
+make_name(char buf[], size_t buf_len, int i)
+{
+	snprintf(buf, buf_len, "%s/f%0100d", SANDBOX_PATH, i);
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
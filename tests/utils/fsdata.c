@@ -209,6 +209,13 @@ TEST(data_size_can_change)
 	fsdata_free(fsd);
 }
 
+TEST(empty_tree_can_be_invalidated)
+{
+	fsdata_t *const fsd = fsdata_create(0, 0);
+	assert_failure(fsdata_invalidate(fsd, ROOT));
+	fsdata_free(fsd);
+}
+
 TEST(empty_tree_is_not_traversed)
 {
 	fsdata_t *const fsd = fsdata_create(0, 0);
@@ -155,6 +155,92 @@ TEST(file_recreation_removes_ban, IF(using_inotify))
 	assert_success(remove(SANDBOX_PATH "/testdir"));
 }
 
+TEST(added_directories_are_watched, IF(using_inotify))
+{
+	fswatch_t *watch;
+	int error;
+
+	assert_success(os_mkdir(SANDBOX_PATH "/testdir", 0700));
+
+	assert_non_null(watch = fswatch_create(sandbox));
+	assert_success(fswatch_add(watch, SANDBOX_PATH "/testdir"));
+	assert_false(fswatch_changed(watch, &error));
+	assert_false(error);
+
+	assert_success(os_mkdir(SANDBOX_PATH "/testdir/nested", 0700));
+	assert_true(fswatch_changed(watch, &error));
+	assert_false(error);
+
+	assert_success(remove(SANDBOX_PATH "/testdir/nested"));
+	assert_true(fswatch_changed(watch, &error));
+	assert_false(error);
+
+	fswatch_free(watch);
+
+	assert_success(remove(SANDBOX_PATH "/testdir"));
+}
+
+TEST(names_of_changed_files_are_reported, IF(using_inotify))
+{
+	fswatch_t *watch;
+	fswatch_changes_t changes;
+	int error;
+
+	assert_success(os_mkdir(SANDBOX_PATH "/existing", 0700));
+	assert_non_null(watch = fswatch_create(sandbox));
+
+	assert_success(os_mkdir(SANDBOX_PATH "/testdir", 0700));
+	assert_success(remove(SANDBOX_PATH "/existing"));
+	assert_success(remove(SANDBOX_PATH "/testdir"));
+	assert_true(fswatch_poll(watch, &error, &changes));
+	assert_false(error);
+
+	assert_true(changes.complete);
+	assert_int_equal(2, changes.count);
+	if(changes.count == 2)
+	{
+		assert_string_equal("testdir", changes.names[0]);
+		assert_true(changes.created[0]);
+		assert_string_equal("existing", changes.names[1]);
+		assert_false(changes.created[1]);
+	}
+	fswatch_changes_free(&changes);
+
+	fswatch_free(watch);
+}
+
+TEST(changes_of_added_directories_make_list_incomplete, IF(using_inotify))
+{
+	fswatch_t *watch;
+	fswatch_changes_t changes;
+	int error;
+
+	assert_success(os_mkdir(SANDBOX_PATH "/testdir", 0700));
+
+	assert_non_null(watch = fswatch_create(sandbox));
+	assert_success(fswatch_add(watch, SANDBOX_PATH "/testdir"));
+
+	assert_success(os_mkdir(SANDBOX_PATH "/testdir/nested", 0700));
+	assert_true(fswatch_poll(watch, &error, &changes));
+	assert_false(error);
+	assert_false(changes.complete);
+	fswatch_changes_free(&changes);
+
+	fswatch_free(watch);
+
+	assert_success(remove(SANDBOX_PATH "/testdir/nested"));
+	assert_success(remove(SANDBOX_PATH "/testdir"));
+}
+
+TEST(missing_directory_is_not_added)
+{
+	fswatch_t *watch;
+
+	assert_non_null(watch = fswatch_create(sandbox));
+	assert_failure(fswatch_add(watch, SANDBOX_PATH "/no-such-dir"));
+	fswatch_free(watch);
+}
+
 static int
 using_inotify(void)
 {
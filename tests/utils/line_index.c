@@ -0,0 +1,219 @@
+#include <stic.h>
+
+#include <unistd.h> /* truncate() unlink() */
+
+#include <stddef.h> /* size_t */
+#include <stdio.h> /* FILE fclose() fopen() fprintf() fwrite() */
+#include <string.h> /* strlen() */
+
+#include "../../src/utils/line_index.h"
+#include "../../src/utils/string_array.h"
+
+/* Number of lines that is big enough to be indexed in several steps. */
+#define NLINES 100000
+
+static void write_file(const char path[], const char contents[], size_t len);
+static void write_lines(const char path[]);
+static int measure(const char line[], size_t len);
+static int wait_all(line_index_t *li);
+static int not_windows(void);
+
+TEST(files_are_split_into_lines_like_on_reading, IF(not_windows))
+{
+	static const char contents[] = "\xef\xbb\xbf" "a\nbb\r\nc\r\rd\0\0e";
+	int nlines;
+	int i;
+	char **lines;
+	line_index_t *li;
+
+	write_file(SANDBOX_PATH "/file", contents, sizeof(contents) - 1U);
+
+	li = li_open(SANDBOX_PATH "/file", NULL);
+	assert_non_null(li);
+	lines = read_file_of_lines(SANDBOX_PATH "/file", &nlines);
+
+	assert_int_equal(nlines, wait_all(li));
+	for(i = 0; i < nlines; ++i)
+	{
+		char line[16];
+		assert_int_equal(strlen(lines[i]), li_get(li, i, line, sizeof(line) - 1U));
+		assert_string_equal(lines[i], line);
+		assert_int_equal(0, li_measure(li, i));
+	}
+
+	free_string_array(lines, nlines);
+	li_close(li);
+	assert_success(unlink(SANDBOX_PATH "/file"));
+}
+
+TEST(lines_are_measured, IF(not_windows))
+{
+	line_index_t *li;
+
+	write_file(SANDBOX_PATH "/file", "a\nbbb\n\ncc", 9U);
+
+	li = li_open(SANDBOX_PATH "/file", &measure);
+	assert_non_null(li);
+
+	assert_int_equal(4, wait_all(li));
+	assert_int_equal(1, li_measure(li, 0));
+	assert_int_equal(3, li_measure(li, 1));
+	assert_int_equal(0, li_measure(li, 2));
+	assert_int_equal(2, li_measure(li, 3));
+
+	li_close(li);
+	assert_success(unlink(SANDBOX_PATH "/file"));
+}
+
+TEST(lines_can_be_retrieved_partially, IF(not_windows))
+{
+	char line[16];
+	line_index_t *li;
+
+	write_file(SANDBOX_PATH "/file", "abcdef\nx", 8U);
+
+	li = li_open(SANDBOX_PATH "/file", NULL);
+	assert_non_null(li);
+
+	assert_int_equal(2, wait_all(li));
+	assert_int_equal(3, li_get(li, 0, line, 3U));
+	assert_string_equal("abc", line);
+	assert_int_equal(1, li_get(li, 1, line, 3U));
+	assert_string_equal("x", line);
+
+	li_close(li);
+	assert_success(unlink(SANDBOX_PATH "/file"));
+}
+
+TEST(big_files_are_indexed_in_background, IF(not_windows))
+{
+	char line[16];
+	line_index_t *li;
+
+	write_lines(SANDBOX_PATH "/file");
+
+	li = li_open(SANDBOX_PATH "/file", &measure);
+	assert_non_null(li);
+
+	assert_true(li_wait(li, 0, -1) > 0);
+	assert_int_equal(6, li_get(li, 0, line, sizeof(line) - 1U));
+	assert_string_equal("line 0", line);
+
+	assert_int_equal(NLINES, wait_all(li));
+	assert_int_equal(10, li_get(li, NLINES - 1, line, sizeof(line) - 1U));
+	assert_string_equal("line 99999", line);
+	assert_int_equal(10, li_measure(li, NLINES - 1));
+
+	li_close(li);
+	assert_success(unlink(SANDBOX_PATH "/file"));
+}
+
+TEST(truncated_part_of_file_is_empty, IF(not_windows))
+{
+	char line[16];
+	line_index_t *li;
+
+	write_lines(SANDBOX_PATH "/file");
+
+	li = li_open(SANDBOX_PATH "/file", &measure);
+	assert_non_null(li);
+	assert_int_equal(NLINES, wait_all(li));
+
+	assert_success(truncate(SANDBOX_PATH "/file", 0));
+	assert_int_equal(0, li_get(li, NLINES - 1, line, sizeof(line) - 1U));
+	assert_string_equal("", line);
+
+	li_close(li);
+	assert_success(unlink(SANDBOX_PATH "/file"));
+}
+
+TEST(index_can_be_closed_while_indexing, IF(not_windows))
+{
+	line_index_t *li;
+
+	write_lines(SANDBOX_PATH "/file");
+
+	li = li_open(SANDBOX_PATH "/file", &measure);
+	assert_non_null(li);
+	li_close(li);
+
+	assert_success(unlink(SANDBOX_PATH "/file"));
+}
+
+TEST(empty_files_and_directories_are_not_mapped)
+{
+	write_file(SANDBOX_PATH "/file", "", 0U);
+	assert_null(li_open(SANDBOX_PATH "/file", NULL));
+	assert_success(unlink(SANDBOX_PATH "/file"));
+
+	assert_null(li_open(SANDBOX_PATH, NULL));
+	assert_null(li_open(SANDBOX_PATH "/no-such-file", NULL));
+}
+
+TEST(closing_null_index_is_ok)
+{
+	li_close(NULL);
+}
+
+/* Creates file at the path with specified contents. */
+static void
+write_file(const char path[], const char contents[], size_t len)
+{
+	FILE *const f = fopen(path, "wb");
+	assert_non_null(f);
+	if(f != NULL)
+	{
+		assert_int_equal(len, fwrite(contents, 1U, len, f));
+		fclose(f);
+	}
+}
+
+/* Creates file at the path with NLINES lines. */
+static void
+write_lines(const char path[])
+{
+	int i;
+	FILE *const f = fopen(path, "w");
+
+	assert_non_null(f);
+	for(i = 0; i < NLINES; ++i)
+	{
+		fprintf(f, "line %d\n", i);
+	}
+	fclose(f);
+}
+
+/* Measures line as its length.  Returns the length. */
+static int
+measure(const char line[], size_t len)
+{
+	return len;
+}
+
+/* Waits for indexing to finish.  Returns number of lines. */
+static int
+wait_all(line_index_t *li)
+{
+	int complete;
+	int count;
+	do
+	{
+		count = li_wait(li, li_count(li, &complete), -1);
+		(void)li_count(li, &complete);
+	}
+	while(!complete);
+	return count;
+}
+
+static int
+not_windows(void)
+{
+#ifdef _WIN32
+	return 0;
+#else
+	return 1;
+#endif
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
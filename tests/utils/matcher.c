@@ -313,6 +313,82 @@ TEST(mime_type_inclusion, IF(has_mime_type_detection))
 	matcher_free(m);
 }
 
+TEST(literal_globs_are_matched_as_globs)
+{
+	char *error;
+	matcher_t *m;
+
+	assert_non_null(m = matcher_alloc("{*.c,Makefile,read*,*}", 0, 1, "",
+				&error));
+	assert_null(error);
+
+	assert_true(matcher_matches(m, "a.C"));
+	assert_true(matcher_matches(m, "makefile"));
+	assert_true(matcher_matches(m, "README"));
+	assert_true(matcher_matches(m, "read"));
+	assert_true(matcher_matches(m, "x"));
+	assert_true(matcher_matches(m, "dir/file.c"));
+
+	assert_false(matcher_matches(m, ".c"));
+	assert_false(matcher_matches(m, ".hidden"));
+
+	matcher_free(m);
+}
+
+TEST(literal_globs_are_combined_with_other_globs)
+{
+	char *error;
+	matcher_t *m, *clone;
+
+	assert_non_null(m = matcher_alloc("{*.c,*.[ch]pp,file?}", 0, 1, "",
+				&error));
+	assert_null(error);
+	assert_non_null(clone = matcher_clone(m));
+
+	assert_true(matcher_matches(m, "a.c"));
+	assert_true(matcher_matches(m, "a.cpp"));
+	assert_true(matcher_matches(m, "a.HPP"));
+	assert_true(matcher_matches(m, "file1"));
+	assert_false(matcher_matches(m, "a.h"));
+	assert_false(matcher_matches(m, "file"));
+
+	assert_true(matcher_matches(clone, "a.c"));
+	assert_true(matcher_matches(clone, "a.cpp"));
+	assert_false(matcher_matches(clone, "a.h"));
+
+	matcher_free(clone);
+	matcher_free(m);
+}
+
+TEST(non_ascii_names_are_matched_by_literal_globs)
+{
+	char *error;
+	matcher_t *m;
+
+	assert_non_null(m = matcher_alloc("{*.txt,имя}", 0, 1, "", &error));
+	assert_null(error);
+
+	assert_true(matcher_matches(m, "файл.TXT"));
+	assert_true(matcher_matches(m, "имя"));
+	assert_false(matcher_matches(m, "файл.doc"));
+
+	matcher_free(m);
+}
+
+TEST(negated_literal_globs)
+{
+	char *error;
+	matcher_t *m;
+
+	assert_non_null(m = matcher_alloc("!{*.o}", 0, 1, "", &error));
+	assert_null(error);
+
+	assert_true(matcher_matches(m, "a.c"));
+	assert_false(matcher_matches(m, "a.o"));
+
+	matcher_free(m);
+}
+
 static void
 check_glob(matcher_t *m)
 {
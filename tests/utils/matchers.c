@@ -244,6 +244,23 @@ TEST(inclusion_check_works)
 	matchers_free(ms2);
 }
 
+TEST(mime_matchers_do_not_match_by_names_only)
+{
+	char *error;
+	matchers_t *ms1, *ms2;
+
+	assert_non_null(ms1 = matchers_alloc("{*.c}/x/", 0, 1, "", &error));
+	assert_null(error);
+	assert_non_null(ms2 = matchers_alloc("{*.c}<text/*>", 0, 1, "", &error));
+	assert_null(error);
+
+	assert_true(matchers_match_names_only(ms1));
+	assert_false(matchers_match_names_only(ms2));
+
+	matchers_free(ms1);
+	matchers_free(ms2);
+}
+
 TEST(breaking_list_of_lists)
 {
 	int nmatchers;
@@ -0,0 +1,96 @@
+#include <stic.h>
+
+#include <stddef.h> /* NULL */
+
+#include "../../src/compat/pthread.h"
+#include "../../src/utils/tpool.h"
+
+static void count_task(void *arg);
+static void blocking_task(void *arg);
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static int counter;
+static int unblocked;
+
+SETUP()
+{
+	counter = 0;
+	unblocked = 0;
+}
+
+TEST(zero_threads_is_an_error)
+{
+	assert_null(tpool_alloc(0, 1));
+	assert_null(tpool_alloc(-1, 1));
+}
+
+TEST(freeing_null_pool_is_ok)
+{
+	tpool_free(NULL);
+}
+
+TEST(all_tasks_are_executed)
+{
+	int i;
+	tpool_t *const pool = tpool_alloc(4, 2);
+	assert_non_null(pool);
+
+	for(i = 0; i < 100; ++i)
+	{
+		assert_success(tpool_push(pool, &count_task, NULL, -1));
+	}
+
+	assert_success(tpool_wait(pool, -1));
+	assert_int_equal(100, counter);
+
+	tpool_free(pool);
+}
+
+TEST(push_and_wait_time_out)
+{
+	tpool_t *const pool = tpool_alloc(1, 1);
+	assert_non_null(pool);
+
+	/* One task is running, another one is queued. */
+	assert_success(tpool_push(pool, &blocking_task, NULL, -1));
+	assert_success(tpool_push(pool, &count_task, NULL, 10));
+	while(tpool_push(pool, &count_task, NULL, 10) == 0)
+	{
+		/* The first task might not have been picked up yet. */
+	}
+
+	assert_failure(tpool_wait(pool, 10));
+
+	pthread_mutex_lock(&lock);
+	unblocked = 1;
+	pthread_cond_broadcast(&cond);
+	pthread_mutex_unlock(&lock);
+
+	assert_success(tpool_wait(pool, -1));
+	assert_true(counter >= 1);
+
+	tpool_free(pool);
+}
+
+static void
+count_task(void *arg)
+{
+	pthread_mutex_lock(&lock);
+	++counter;
+	pthread_mutex_unlock(&lock);
+}
+
+static void
+blocking_task(void *arg)
+{
+	pthread_mutex_lock(&lock);
+	while(!unblocked)
+	{
+		pthread_cond_wait(&cond, &lock);
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+/* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
+/* vim: set cinoptions+=t0 filetype=c : */
@@ -164,5 +164,53 @@ TEST(trie_cloning_works)
 	trie_free(trie);
 }
 
+TEST(prefixes_are_found)
+{
+	trie_t *const trie = trie_create();
+
+	assert_false(trie_has_prefix(trie, "string", 6));
+
+	assert_int_equal(0, trie_put(trie, "str"));
+	assert_int_equal(0, trie_put(trie, "strong"));
+
+	assert_true(trie_has_prefix(trie, "string", 6));
+	assert_true(trie_has_prefix(trie, "str", 3));
+	assert_true(trie_has_prefix(trie, "strongest", 9));
+	assert_false(trie_has_prefix(trie, "st", 2));
+	assert_false(trie_has_prefix(trie, "sting", 5));
+
+	trie_free(trie);
+}
+
+TEST(prefixes_are_limited_in_length)
+{
+	trie_t *const trie = trie_create();
+
+	assert_int_equal(0, trie_put(trie, "str"));
+
+	assert_true(trie_has_prefix(trie, "string", 3));
+	assert_false(trie_has_prefix(trie, "string", 2));
+	assert_false(trie_has_prefix(trie, "str", 2));
+
+	trie_free(trie);
+}
+
+TEST(empty_string_is_prefix_of_everything)
+{
+	trie_t *const trie = trie_create();
+
+	assert_int_equal(0, trie_put(trie, ""));
+
+	assert_true(trie_has_prefix(trie, "", 0));
+	assert_true(trie_has_prefix(trie, "string", 0));
+
+	trie_free(trie);
+}
+
+TEST(prefix_lookup_in_null_trie_is_ok)
+{
+	assert_false(trie_has_prefix(NULL, "string", 6));
+}
+
 /* vim: set tabstop=2 softtabstop=2 shiftwidth=2 noexpandtab cinoptions-=(0 : */
 /* vim: set cinoptions+=t0 filetype=c : */